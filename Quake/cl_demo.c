@@ -22,6 +22,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "quakedef.h"
 
 static void CL_FinishTimeDemo (void);
+static void CL_FinishCaptureDemo (void);
 
 /*
 ==============================================================================
@@ -60,6 +61,8 @@ void CL_StopPlayback (void)
 
 	if (cls.timedemo)
 		CL_FinishTimeDemo ();
+	if (cls.capturedemo)
+		CL_FinishCaptureDemo ();
 }
 
 /*
@@ -374,31 +377,20 @@ void CL_Record_f (void)
 
 /*
 ====================
-CL_PlayDemo_f
-
-play [demoname]
+CL_PlayDemo
 ====================
 */
-void CL_PlayDemo_f (void)
+static void CL_PlayDemo (const char *demoname)
 {
 	char	name[MAX_OSPATH];
 	int	i, c;
 	qboolean neg;
 
-	if (cmd_source != src_command)
-		return;
-
-	if (Cmd_Argc() != 2)
-	{
-		Con_Printf ("playdemo <demoname> : plays a demo\n");
-		return;
-	}
-
 // disconnect from server
 	CL_Disconnect ();
 
 // open the demo file
-	q_strlcpy (name, Cmd_Argv(1), sizeof(name));
+	q_strlcpy (name, demoname, sizeof(name));
 	COM_AddExtension (name, ".dem", sizeof(name));
 
 	Con_Printf ("Playing demo from %s.\n", name);
@@ -450,6 +442,27 @@ void CL_PlayDemo_f (void)
 	key_dest = key_game;
 }
 
+/*
+====================
+CL_PlayDemo_f
+
+play [demoname]
+====================
+*/
+void CL_PlayDemo_f (void)
+{
+	if (cmd_source != src_command)
+		return;
+
+	if (Cmd_Argc() != 2)
+	{
+		Con_Printf ("playdemo <demoname> : plays a demo\n");
+		return;
+	}
+
+	CL_PlayDemo (Cmd_Argv(1));
+}
+
 /*
 ====================
 CL_FinishTimeDemo
@@ -501,3 +514,73 @@ void CL_TimeDemo_f (void)
 	cls.td_lastframe = -1;	// get a new message this frame
 }
 
+/*
+====================
+CL_FinishCaptureDemo
+
+====================
+*/
+static void CL_FinishCaptureDemo (void)
+{
+	cls.capturedemo = false;
+	Capture_EndVideo ();
+}
+
+/*
+====================
+CL_CaptureDemo_f
+
+capturedemo [demoname] [fps] [tga|y4m]
+====================
+*/
+void CL_CaptureDemo_f (void)
+{
+	char	name[MAX_QPATH];
+	float	fps;
+	qboolean	y4m;
+
+	if (cmd_source != src_command)
+		return;
+
+	if (Cmd_Argc() < 2 || Cmd_Argc() > 4)
+	{
+		Con_Printf ("capturedemo <demoname> [fps] [tga|y4m] : writes a demo out as video frames and sound\n");
+		return;
+	}
+
+	fps = (Cmd_Argc() > 2) ? Q_atof (Cmd_Argv(2)) : 30;
+	if (fps < 1 || fps > 1000)
+	{
+		Con_Printf ("capturedemo: fps must be between 1 and 1000\n");
+		return;
+	}
+	y4m = (Cmd_Argc() <= 3 || q_strcasecmp (Cmd_Argv(3), "tga") != 0);
+
+	CL_PlayDemo (Cmd_Argv(1));
+	if (!cls.demofile)
+		return;
+
+	COM_StripExtension (COM_SkipPath (Cmd_Argv(1)), name, sizeof(name));
+	if (!Capture_BeginVideo (name, fps, y4m))
+	{
+		CL_StopPlayback ();
+		return;
+	}
+
+	cls.capturedemo = true;
+	cls.capturefps = fps;
+}
+
+/*
+====================
+CL_CaptureDemoFrame -- the fixed length of the next host frame while capturing, or 0
+====================
+*/
+double CL_CaptureDemoFrame (void)
+{
+	if (!cls.capturedemo)
+		return 0;
+
+	Capture_VideoTick ();
+	return 1.0 / cls.capturefps;
+}
@@ -51,7 +51,6 @@ cvar_t	cl_minpitch = {"cl_minpitch", "-90", CVAR_ARCHIVE}; //johnfitz -- variabl
 client_static_t	cls;
 client_state_t	cl;
 // FIXME: put these on hunk?
-efrag_t			cl_efrags[MAX_EFRAGS];
 entity_t		cl_static_entities[MAX_STATIC_ENTITIES];
 lightstyle_t	cl_lightstyle[MAX_LIGHTSTYLES];
 dlight_t		cl_dlights[MAX_DLIGHTS];
@@ -62,8 +61,46 @@ int				cl_max_edicts; //johnfitz -- only changes when new map loads
 int				cl_numvisedicts;
 entity_t		*cl_visedicts[MAX_VISEDICTS];
 
+// entity slots that have had an update since they were last emptied, so
+// CL_RelinkEntities doesn't have to walk every slot up to cl.num_entities
+static int		*cl_activeentities;
+static int		*cl_activeindex;	// position in cl_activeentities + 1, or 0 if not there
+static int		cl_numactiveentities;
+
+// loose grid of the relinked entities, for CL_AddVisibleEntities.  each
+// entity goes in the cell its origin is in, and the cell's bounds grow to
+// hold the whole entity, so only cells with entities are ever looked at.
+#define	CL_GRIDSIZE		64		// cells along each horizontal axis
+
+typedef struct
+{
+	vec3_t	mins, maxs;
+	int		head;				// first entity number, or 0 if empty
+} entgridcell_t;
+
+static entgridcell_t	cl_entgrid[CL_GRIDSIZE*CL_GRIDSIZE];
+static int		cl_gridcells[CL_GRIDSIZE*CL_GRIDSIZE]; // cells in use this frame
+static int		cl_numgridcells;
+static int		*cl_gridnext;		// next entity number in the same cell, or 0
+static int		cl_basevisedicts;	// cl_numvisedicts before the first CL_AddVisibleEntities, or -1
+
 extern cvar_t	r_lerpmodels, r_lerpmove; //johnfitz
 
+/*
+===============
+CL_ClearEntityGrid
+===============
+*/
+static void CL_ClearEntityGrid (void)
+{
+	int		i;
+
+	for (i=0 ; i<cl_numgridcells ; i++)
+		cl_entgrid[cl_gridcells[i]].head = 0;
+	cl_numgridcells = 0;
+	cl_basevisedicts = -1;
+}
+
 /*
 =====================
 CL_ClearState
@@ -72,8 +109,6 @@ CL_ClearState
 */
 void CL_ClearState (void)
 {
-	int			i;
-
 	if (!sv.active)
 		Host_ClearMemory ();
 
@@ -83,7 +118,6 @@ void CL_ClearState (void)
 	SZ_Clear (&cls.message);
 
 // clear other arrays
-	memset (cl_efrags, 0, sizeof(cl_efrags));
 	memset (cl_dlights, 0, sizeof(cl_dlights));
 	memset (cl_lightstyle, 0, sizeof(cl_lightstyle));
 	memset (cl_temp_entities, 0, sizeof(cl_temp_entities));
@@ -94,13 +128,11 @@ void CL_ClearState (void)
 	cl_entities = (entity_t *) Hunk_AllocName (cl_max_edicts*sizeof(entity_t), "cl_entities");
 	//johnfitz
 
-//
-// allocate the efrags and chain together into a free list
-//
-	cl.free_efrags = cl_efrags;
-	for (i=0 ; i<MAX_EFRAGS-1 ; i++)
-		cl.free_efrags[i].entnext = &cl.free_efrags[i+1];
-	cl.free_efrags[i].entnext = NULL;
+	cl_activeentities = (int *) Hunk_AllocName (cl_max_edicts*sizeof(int)*3, "cl_active");
+	cl_activeindex = cl_activeentities + cl_max_edicts;
+	cl_gridnext = cl_activeindex + cl_max_edicts;
+	cl_numactiveentities = 0;
+	CL_ClearEntityGrid ();
 }
 
 /*
@@ -407,6 +439,120 @@ float	CL_LerpPoint (void)
 	return frac;
 }
 
+/*
+===============
+CL_ActivateEntity -- called when entity num gets an update
+===============
+*/
+void CL_ActivateEntity (int num)
+{
+	if (num > 0 && !cl_activeindex[num])
+	{
+		cl_activeentities[cl_numactiveentities++] = num;
+		cl_activeindex[num] = cl_numactiveentities;
+	}
+}
+
+/*
+===============
+CL_DeactivateEntity -- takes the entity at position i out of the active list
+===============
+*/
+static void CL_DeactivateEntity (int i)
+{
+	int		num;
+
+	num = cl_activeentities[i];
+	cl_activeindex[num] = 0;
+
+	cl_numactiveentities--;
+	if (i < cl_numactiveentities)
+	{
+		num = cl_activeentities[cl_numactiveentities];
+		cl_activeentities[i] = num;
+		cl_activeindex[num] = i + 1;
+	}
+}
+
+/*
+===============
+CL_GridLinkEntity
+===============
+*/
+static void CL_GridLinkEntity (int num, entity_t *ent)
+{
+	entgridcell_t	*cell;
+	vec3_t	mins, maxs;
+	int		i, x, y, c;
+
+	x = (int)((ent->origin[0] - cl.worldmodel->mins[0]) * CL_GRIDSIZE / (cl.worldmodel->maxs[0] - cl.worldmodel->mins[0] + 1));
+	y = (int)((ent->origin[1] - cl.worldmodel->mins[1]) * CL_GRIDSIZE / (cl.worldmodel->maxs[1] - cl.worldmodel->mins[1] + 1));
+	x = CLAMP (0, x, CL_GRIDSIZE - 1);
+	y = CLAMP (0, y, CL_GRIDSIZE - 1);
+	c = y * CL_GRIDSIZE + x;
+	cell = &cl_entgrid[c];
+
+	R_EntityBounds (ent, mins, maxs);
+	if (!cell->head)
+	{
+		VectorCopy (mins, cell->mins);
+		VectorCopy (maxs, cell->maxs);
+		cl_gridcells[cl_numgridcells++] = c;
+	}
+	else
+	{
+		for (i=0 ; i<3 ; i++)
+		{
+			cell->mins[i] = q_min (cell->mins[i], mins[i]);
+			cell->maxs[i] = q_max (cell->maxs[i], maxs[i]);
+		}
+	}
+
+	cl_gridnext[num] = cell->head;
+	cell->head = num;
+}
+
+/*
+===============
+CL_AddVisibleEntities
+
+adds the relinked entities in the grid cells that are in the view frustum to
+cl_visedicts.  call after R_SetFrustum.  when a frame is rendered more than
+once (one per eye), each call replaces what the last one and the static
+entities after it added.
+===============
+*/
+void CL_AddVisibleEntities (void)
+{
+	entgridcell_t	*cell;
+	int		i, num;
+
+	if (cl_basevisedicts < 0)
+		cl_basevisedicts = cl_numvisedicts;
+	else
+		cl_numvisedicts = cl_basevisedicts;
+
+	for (i=0 ; i<cl_numgridcells ; i++)
+	{
+		cell = &cl_entgrid[cl_gridcells[i]];
+		if (R_CullBox (cell->mins, cell->maxs))
+			continue;
+
+		for (num = cell->head ; num && cl_numvisedicts < MAX_VISEDICTS ; num = cl_gridnext[num])
+			cl_visedicts[cl_numvisedicts++] = &cl_entities[num];
+	}
+
+//johnfitz -- devstats
+
+	//visedicts
+	if (cl_numvisedicts > 256 && dev_peakstats.visedicts <= 256)
+		Con_DWarning ("%i visedicts exceeds standard limit of 256.\n", cl_numvisedicts);
+	dev_stats.visedicts = cl_numvisedicts;
+	dev_peakstats.visedicts = q_max(cl_numvisedicts, dev_peakstats.visedicts);
+
+//johnfitz
+}
+
 /*
 ===============
 CL_RelinkEntities
@@ -415,7 +561,7 @@ CL_RelinkEntities
 void CL_RelinkEntities (void)
 {
 	entity_t	*ent;
-	int			i, j;
+	int			i, j, k;
 	float		frac, f, d;
 	vec3_t		delta;
 	float		bobjrotate;
@@ -426,6 +572,7 @@ void CL_RelinkEntities (void)
 	frac = CL_LerpPoint ();
 
 	cl_numvisedicts = 0;
+	CL_ClearEntityGrid ();
 
 //
 // interpolate player info
@@ -450,13 +597,15 @@ void CL_RelinkEntities (void)
 
 	bobjrotate = anglemod(100*cl.time);
 
-// start on the entity after the world
-	for (i=1,ent=cl_entities+1 ; i<cl.num_entities ; i++,ent++)
+// only the entities that have been updated since their slot was last emptied
+	for (k=0 ; k<cl_numactiveentities ; )
 	{
+		i = cl_activeentities[k];
+		ent = &cl_entities[i];
+
 		if (!ent->model)
 		{	// empty slot
-			if (ent->forcelink)
-				R_RemoveEfrags (ent);	// just became empty
+			CL_DeactivateEntity (k);
 			continue;
 		}
 
@@ -465,8 +614,10 @@ void CL_RelinkEntities (void)
 		{
 			ent->model = NULL;
 			ent->lerpflags |= LERP_RESETMOVE|LERP_RESETANIM; //johnfitz -- next time this entity slot is reused, the lerp will need to be reset
+			CL_DeactivateEntity (k);
 			continue;
 		}
+		k++;
 
 		VectorCopy (ent->origin, oldorg);
 
@@ -581,11 +732,7 @@ void CL_RelinkEntities (void)
 		if (i == cl.viewentity && !chase_active.value)
 			continue;
 
-		if (cl_numvisedicts < MAX_VISEDICTS)
-		{
-			cl_visedicts[cl_numvisedicts] = ent;
-			cl_numvisedicts++;
-		}
+		CL_GridLinkEntity (i, ent);
 	}
 }
 
@@ -631,12 +778,6 @@ int CL_ReadFromServer (void)
 
 //johnfitz -- devstats
 
-	//visedicts
-	if (cl_numvisedicts > 256 && dev_peakstats.visedicts <= 256)
-		Con_DWarning ("%i visedicts exceeds standard limit of 256.\n", cl_numvisedicts);
-	dev_stats.visedicts = cl_numvisedicts;
-	dev_peakstats.visedicts = q_max(cl_numvisedicts, dev_peakstats.visedicts);
-
 	//temp entities
 	if (num_temp_entities > 64 && dev_peakstats.tempents <= 64)
 		Con_DWarning ("%i tempentities exceeds standard limit of 64.\n", num_temp_entities);
@@ -809,6 +950,7 @@ void CL_Init (void)
 	Cmd_AddCommand ("stop", CL_Stop_f);
 	Cmd_AddCommand ("playdemo", CL_PlayDemo_f);
 	Cmd_AddCommand ("timedemo", CL_TimeDemo_f);
+	Cmd_AddCommand ("capturedemo", CL_CaptureDemo_f);
 
 	Cmd_AddCommand ("tracepos", CL_Tracepos_f); //johnfitz
 	Cmd_AddCommand ("viewpos", CL_Viewpos_f); //johnfitz
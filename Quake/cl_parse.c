@@ -357,6 +357,11 @@ void CL_ParseServerInfo (void)
 	// copy the naked name of the map file to the cl structure -- O.S
 	COM_StripExtension (COM_SkipPath(model_precache[1]), cl.mapname, sizeof(cl.mapname));
 
+	// read the model files and mesh the alias models on the task threads first
+	for (i = 1; i < nummodels; i++)
+		Mod_Prefetch (model_precache[i]);
+	Mod_RunPrefetch ();
+
 	for (i = 1; i < nummodels; i++)
 	{
 		cl.model_precache[i] = Mod_ForName (model_precache[i], false);
@@ -364,9 +369,13 @@ void CL_ParseServerInfo (void)
 		{
 			Host_Error ("Model %s not found", model_precache[i]);
 		}
+		Mod_AddRef (cl.model_precache[i]);
 		CL_KeepaliveMessage ();
 	}
+	Mod_ClearPrefetch ();
+	Mod_ReleaseUnused ();
 
+	// sounds are queued and then loaded together by S_EndPrecaching
 	S_BeginPrecaching ();
 	for (i = 1; i < numsounds; i++)
 	{
@@ -456,6 +465,7 @@ void CL_ParseUpdate (int bits)
 	//johnfitz
 
 	ent->msgtime = cl.mtime[0];
+	CL_ActivateEntity (num);
 
 	if (bits & U_MODEL)
 	{
@@ -882,7 +892,7 @@ void CL_ParseStatic (int version) //johnfitz -- added a parameter
 
 	VectorCopy (ent->baseline.origin, ent->origin);
 	VectorCopy (ent->baseline.angles, ent->angles);
-	R_AddEfrags (ent);
+	R_AddStaticEntity (i);
 }
 
 /*
@@ -128,6 +128,9 @@ typedef struct
 	int		td_startframe;		// host_framecount at start
 	float		td_starttime;		// realtime at second frame of timedemo
 
+	qboolean	capturedemo;		// running at a fixed timestep, writing every frame
+	float		capturefps;
+
 // connection information
 	int		signon;			// 0 to SIGNONS
 	struct qsocket_s	*netcon;
@@ -219,7 +222,6 @@ typedef struct
 
 // refresh related state
 	struct qmodel_s	*worldmodel;	// cl_entitites[0].model
-	struct efrag_s	*free_efrags;
 	int			num_entities;	// held in cl_entities array
 	int			num_statics;	// held in cl_staticentities array
 	entity_t	viewent;			// the gun model
@@ -276,7 +278,6 @@ extern	cvar_t	m_side;
 extern	client_state_t	cl;
 
 // FIXME, allocate dynamically
-extern	efrag_t			cl_efrags[MAX_EFRAGS];
 extern	entity_t		cl_static_entities[MAX_STATIC_ENTITIES];
 extern	lightstyle_t	cl_lightstyle[MAX_LIGHTSTYLES];
 extern	dlight_t		cl_dlights[MAX_DLIGHTS];
@@ -331,6 +332,8 @@ void CL_ParseTEnt (void);
 void CL_UpdateTEnts (void);
 
 void CL_ClearState (void);
+void CL_ActivateEntity (int num);
+void CL_AddVisibleEntities (void);
 
 //
 // cl_demo.c
@@ -342,6 +345,8 @@ void CL_Stop_f (void);
 void CL_Record_f (void);
 void CL_PlayDemo_f (void);
 void CL_TimeDemo_f (void);
+void CL_CaptureDemo_f (void);
+double CL_CaptureDemoFrame (void);
 
 //
 // cl_parse.c
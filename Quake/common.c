@@ -1809,6 +1809,184 @@ byte *COM_LoadMallocFile (const char *path, unsigned int *path_id)
 }
 
 
+/*
+===========
+COM_LocateFile
+
+Finds where a file's data lives without reading it: the pak or loose file
+to open and the offset of the data in it, for COM_ReadFileAt on the task
+threads.  Returns the length, or -1 if the file isn't found.
+===========
+*/
+int COM_LocateFile (const char *filename, char *path, size_t pathsize, long *offset, unsigned int *path_id)
+{
+	searchpath_t	*search;
+	pack_t		*pak;
+	FILE		*f;
+	int		i, len;
+
+	for (search = com_searchpaths; search; search = search->next)
+	{
+		if (search->pack)
+		{
+			pak = search->pack;
+			for (i = 0; i < pak->numfiles; i++)
+			{
+				if (strcmp(pak->files[i].name, filename) != 0)
+					continue;
+				q_strlcpy (path, pak->filename, pathsize);
+				*offset = pak->files[i].filepos;
+				if (path_id)
+					*path_id = search->path_id;
+				return pak->files[i].filelen;
+			}
+		}
+		else
+		{
+			if (!registered.value)
+			{ /* if not a registered version, don't ever go beyond base */
+				if ( strchr (filename, '/') || strchr (filename,'\\'))
+					continue;
+			}
+
+			q_snprintf (path, pathsize, "%s/%s", search->filename, filename);
+			if (Sys_FileTime (path) == -1)
+				continue;
+			f = fopen (path, "rb");
+			if (!f)
+				continue;
+			len = COM_filelength (f);
+			fclose (f);
+			*offset = 0;
+			if (path_id)
+				*path_id = search->path_id;
+			return len;
+		}
+	}
+
+	return -1;
+}
+
+/*
+===========
+COM_ReadFileAt
+
+Reads len bytes at offset in an explicit path into a malloc'd buffer with a
+0 byte appended.  Touches only stdio and malloc, so it is safe to call from
+any thread.  Returns NULL on failure.
+===========
+*/
+byte *COM_ReadFileAt (const char *path, long offset, int len)
+{
+	FILE	*f;
+	byte	*buf;
+
+	f = fopen (path, "rb");
+	if (!f)
+		return NULL;
+
+	buf = (byte *) malloc (len + 1);
+	if (buf && (fseek (f, offset, SEEK_SET) != 0 || (int) fread (buf, 1, len, f) != len))
+	{
+		free (buf);
+		buf = NULL;
+	}
+	fclose (f);
+
+	if (buf)
+		buf[len] = 0;
+	return buf;
+}
+
+/*
+===========
+COM_HashBytes -- 32 bit FNV-1a, continuing from hash (start with COM_HASH_INIT)
+===========
+*/
+unsigned int COM_HashBytes (unsigned int hash, const void *data, int size)
+{
+	const byte	*p = (const byte *)data;
+
+	while (size-- > 0)
+	{
+		hash ^= *p++;
+		hash *= 16777619;
+	}
+
+	return hash;
+}
+
+/*
+===========
+COM_UserCacheDir
+
+Sets out to <userdir>/sub, creating it, for the on-disk caches.  Returns
+false and leaves out empty if the user directory can't be written to.
+===========
+*/
+qboolean COM_UserCacheDir (const char *sub, char *out, size_t outsize)
+{
+	char	probe[MAX_OSPATH];
+	FILE	*f;
+
+	out[0] = 0;
+
+	// Sys_mkdir gives up the whole game if it fails, so only try where we can write
+	q_snprintf (probe, sizeof(probe), "%s/%s.tmp", host_parms->userdir, sub);
+	f = fopen (probe, "wb");
+	if (!f)
+	{
+		Con_DPrintf ("No %s: can't write to %s\n", sub, host_parms->userdir);
+		return false;
+	}
+	fclose (f);
+	remove (probe);
+
+	q_snprintf (out, outsize, "%s/%s", host_parms->userdir, sub);
+	Sys_mkdir (out);
+	return true;
+}
+
+/*
+===========
+COM_OpenTempFile
+
+Opens a scratch file next to path for writing, to be finished with
+COM_ReplaceFile.  tag keeps the name apart from other threads writing the
+same path.  Safe to call from any thread.
+===========
+*/
+FILE *COM_OpenTempFile (const char *path, const void *tag, char *temp, size_t tempsize)
+{
+	q_snprintf (temp, tempsize, "%s.%p.tmp", path, tag);
+	return fopen (temp, "wb");
+}
+
+/*
+===========
+COM_ReplaceFile
+
+Closes a file from COM_OpenTempFile and, if everything written to it went
+through, renames it over path, so readers never see half a file.  Otherwise
+the scratch file is removed.  Safe to call from any thread.
+===========
+*/
+qboolean COM_ReplaceFile (FILE *f, const char *temp, const char *path, qboolean ok)
+{
+	ok = (fclose (f) == 0) && ok;
+
+	if (ok)
+	{
+		remove (path); // rename won't replace a file on windows
+		ok = (rename (temp, path) == 0);
+	}
+	if (!ok)
+		remove (temp);
+
+	return ok;
+}
+
+
 /*
 =================
 COM_LoadPackFile -- johnfitz -- modified based on topaz's tutorial
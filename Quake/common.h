@@ -252,6 +252,20 @@ void COM_LoadCacheFile (const char *path, struct cache_user_s *cu,
 byte *COM_LoadMallocFile (const char *path, unsigned int *path_id);
 	// allocates the buffer on the system mem (malloc).
 
+int COM_LocateFile (const char *filename, char *path, size_t pathsize, long *offset,
+						unsigned int *path_id);
+	// finds the pak or loose file holding filename and the offset of its
+	// data, without reading it.  returns the length or -1.
+byte *COM_ReadFileAt (const char *path, long offset, int len);
+	// reads a located file into malloc'd memory; safe on any thread.
+
+// on-disk caches under the user directory
+#define COM_HASH_INIT	2166136261u
+unsigned int COM_HashBytes (unsigned int hash, const void *data, int size);
+qboolean COM_UserCacheDir (const char *sub, char *out, size_t outsize);
+FILE *COM_OpenTempFile (const char *path, const void *tag, char *temp, size_t tempsize);
+qboolean COM_ReplaceFile (FILE *f, const char *temp, const char *path, qboolean ok);
+
 /* The following FS_*() stdio replacements are necessary if one is
  * to perform non-sequential reads on files reopened on pak files
  * because we need the bookkeeping about file start/end positions.
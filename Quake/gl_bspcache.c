@@ -0,0 +1,417 @@
+/*
+Copyright (C) 1996-2001 Id Software, Inc.
+Copyright (C) 2002-2009 John Fitzgibbons and others
+Copyright (C) 2010-2014 QuakeSpasm developers
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// gl_bspcache.c -- on-disk cache of the surface data built while loading a brush model
+
+#include "quakedef.h"
+
+/*
+everything the loader derives from the faces of a map -- extents, bounds,
+flags, the unlit and subdivided warp polys, the lightmap packing and the
+lightmapped display lists -- is written to <userdir>/bspcache once the world
+has been packed into lightmaps, one file per bsp, named after a hash of the
+whole file.  later loads of the same bsp copy it back instead of computing
+it.  the lightmap half is only good for a model packed first, from empty
+lightmaps, which is what the world always is; anything else repacks.
+
+the model is a graph of hunk pointers to planes, texinfos and textures that
+are rebuilt on every load anyway, so the file holds plain per-surface
+records and vertex runs rather than an image of the model to map in.
+*/
+
+#define BSPCACHE_VERSION	1
+
+typedef struct
+{
+	unsigned int	hash;			// of the bsp file
+	int		size;
+	float		subdivide;		// gl_subdivide_size the warp polys were cut with
+	int		vertexsize;
+	int		blockwidth, blockheight;
+} bspcachekey_t;
+
+typedef struct
+{
+	char		magic[4];		// "QBSC"
+	int		version;
+	bspcachekey_t	key;
+	int		numsurfaces;
+	int		numlightmaps, lastlightmap;
+	int		size;			// of the data after the header
+	unsigned int	checksum;		// of the data after the header
+} bspcacheheader_t;
+
+// followed by numlightmaps*LMBLOCK_WIDTH ints of allocated[], then for each
+// surface numpolys runs of (int numverts, float verts[numverts][VERTEXSIZE])
+typedef struct
+{
+	float		mins[3], maxs[3];
+	int		flags;
+	short		texturemins[2];
+	short		extents[2];
+	int		lightmaptexturenum;
+	int		light_s, light_t;
+	int		numpolys;
+} bspcachesurf_t;
+
+static cvar_t	gl_bspcache = {"gl_bspcache", "1", CVAR_ARCHIVE};
+static char	bspcache_dir[MAX_OSPATH];
+
+// the cache being read for the model that is loading
+static byte		*bspcache_data;
+static bspcacheheader_t	bspcache_header;
+static bspcachesurf_t	*bspcache_surfs;
+static int		*bspcache_allocated;
+static byte		*bspcache_polys;	// next poly run to read
+
+/*
+================
+BSPCache_Key
+================
+*/
+static void BSPCache_Key (const bspcache_t *cache, bspcachekey_t *key)
+{
+	extern cvar_t gl_subdivide_size;
+
+	memset (key, 0, sizeof(*key));
+	key->hash = cache->hash;
+	key->size = cache->size;
+	key->subdivide = gl_subdivide_size.value;
+	key->vertexsize = VERTEXSIZE;
+	key->blockwidth = LMBLOCK_WIDTH;
+	key->blockheight = LMBLOCK_HEIGHT;
+}
+
+/*
+================
+BSPCache_Path
+================
+*/
+static void BSPCache_Path (const bspcachekey_t *key, char *path, size_t pathsize)
+{
+	q_snprintf (path, pathsize, "%s/%08x%08x.bsc", bspcache_dir, key->hash,
+		COM_HashBytes (COM_HASH_INIT, key, sizeof(*key)));
+}
+
+/*
+================
+BSPCache_Free
+================
+*/
+static void BSPCache_Free (void)
+{
+	free (bspcache_data);
+	bspcache_data = NULL;
+	bspcache_surfs = NULL;
+	bspcache_allocated = NULL;
+	bspcache_polys = NULL;
+}
+
+/*
+================
+BSPCache_Check -- walks the whole file, so nothing can go wrong once surfaces start being filled in
+================
+*/
+static qboolean BSPCache_Check (void)
+{
+	const bspcacheheader_t	*h = &bspcache_header;
+	bspcachesurf_t		*s;
+	byte			*p, *end;
+	int			i, j, numverts;
+
+	if (h->numsurfaces < 0 || h->numlightmaps < 0 || h->numlightmaps > MAX_LIGHTMAPS ||
+		h->lastlightmap < 0 || h->lastlightmap >= q_max(h->numlightmaps, 1))
+		return false;
+	if ((size_t)h->size < h->numsurfaces * sizeof(bspcachesurf_t) + h->numlightmaps * LMBLOCK_WIDTH * sizeof(int))
+		return false;
+
+	bspcache_surfs = (bspcachesurf_t *)bspcache_data;
+	bspcache_allocated = (int *)(bspcache_surfs + h->numsurfaces);
+	bspcache_polys = (byte *)(bspcache_allocated + h->numlightmaps * LMBLOCK_WIDTH);
+
+	p = bspcache_polys;
+	end = bspcache_data + h->size;
+	for (i=0, s=bspcache_surfs ; i<h->numsurfaces ; i++, s++)
+	{
+		if (!(s->flags & SURF_DRAWTILED))
+		{
+			if (s->lightmaptexturenum < 0 || s->lightmaptexturenum >= h->numlightmaps ||
+				s->light_s < 0 || s->light_s + (s->extents[0]>>4) + 1 > LMBLOCK_WIDTH ||
+				s->light_t < 0 || s->light_t + (s->extents[1]>>4) + 1 > LMBLOCK_HEIGHT)
+				return false;
+		}
+		if (s->numpolys < 0)
+			return false;
+		for (j=0 ; j<s->numpolys ; j++)
+		{
+			if (end - p < (int)sizeof(int))
+				return false;
+			memcpy (&numverts, p, sizeof(int));
+			p += sizeof(int);
+			if (numverts < 1 || (end - p) / (VERTEXSIZE*sizeof(float)) < (size_t)numverts)
+				return false;
+			p += numverts * VERTEXSIZE*sizeof(float);
+		}
+	}
+
+	return p == end;
+}
+
+/*
+================
+BSPCache_BeginModel -- called with the raw bsp, before Mod_LoadBrushModel touches it
+================
+*/
+void BSPCache_BeginModel (qmodel_t *mod, const byte *buffer, int size)
+{
+	bspcachekey_t	key;
+	char		path[MAX_OSPATH];
+	FILE		*f;
+
+	BSPCache_Free (); // left over if the last load was cut off by an error
+
+	mod->bspcache = NULL;
+	if (!gl_bspcache.value || !bspcache_dir[0])
+		return;
+
+	mod->bspcache = (bspcache_t *) Hunk_AllocName (sizeof(bspcache_t), "bspcache");
+	mod->bspcache->hash = COM_HashBytes (COM_HASH_INIT, buffer, size);
+	mod->bspcache->size = size;
+
+	BSPCache_Key (mod->bspcache, &key);
+	BSPCache_Path (&key, path, sizeof(path));
+
+	f = fopen (path, "rb");
+	if (!f)
+		return;
+
+	if (fread (&bspcache_header, 1, sizeof(bspcache_header), f) != sizeof(bspcache_header) ||
+		memcmp (bspcache_header.magic, "QBSC", 4) || bspcache_header.version != BSPCACHE_VERSION ||
+		memcmp (&bspcache_header.key, &key, sizeof(key)) || bspcache_header.size <= 0)
+	{
+		fclose (f);
+		return;
+	}
+
+	bspcache_data = (byte *) malloc (bspcache_header.size);
+	if (!bspcache_data || fread (bspcache_data, 1, bspcache_header.size, f) != (size_t)bspcache_header.size ||
+		COM_HashBytes (COM_HASH_INIT, bspcache_data, bspcache_header.size) != bspcache_header.checksum ||
+		!BSPCache_Check ())
+	{
+		Con_DPrintf ("Ignoring bad bsp cache %s\n", path);
+		BSPCache_Free ();
+	}
+	fclose (f);
+}
+
+/*
+================
+BSPCache_Surfaces -- true if the model's surfaces can be read with BSPCache_LoadSurface
+================
+*/
+qboolean BSPCache_Surfaces (int count)
+{
+	if (!bspcache_data)
+		return false;
+	if (bspcache_header.numsurfaces != count)
+	{
+		BSPCache_Free ();
+		return false;
+	}
+	return true;
+}
+
+/*
+================
+BSPCache_LoadSurface -- fills in what Mod_LoadFaces and GL_BuildLightmaps would have computed
+================
+*/
+void BSPCache_LoadSurface (msurface_t *s, int surfnum)
+{
+	bspcachesurf_t	*in = &bspcache_surfs[surfnum];
+	glpoly_t	*poly, **link;
+	int		i, numverts;
+
+	VectorCopy (in->mins, s->mins);
+	VectorCopy (in->maxs, s->maxs);
+	s->flags = in->flags;
+	s->texturemins[0] = in->texturemins[0];
+	s->texturemins[1] = in->texturemins[1];
+	s->extents[0] = in->extents[0];
+	s->extents[1] = in->extents[1];
+	s->lightmaptexturenum = in->lightmaptexturenum;
+	s->light_s = in->light_s;
+	s->light_t = in->light_t;
+
+	// same allocations, in the same order, as the polys were first built with
+	link = &s->polys;
+	for (i=0 ; i<in->numpolys ; i++)
+	{
+		memcpy (&numverts, bspcache_polys, sizeof(int));
+		bspcache_polys += sizeof(int);
+
+		poly = (glpoly_t *) Hunk_Alloc (sizeof(glpoly_t) + (numverts-4) * VERTEXSIZE*sizeof(float));
+		poly->numverts = numverts;
+		memcpy (poly->verts, bspcache_polys, numverts * VERTEXSIZE*sizeof(float));
+		bspcache_polys += numverts * VERTEXSIZE*sizeof(float);
+
+		*link = poly;
+		link = &poly->next;
+	}
+	*link = NULL;
+}
+
+/*
+================
+BSPCache_EndModel
+================
+*/
+void BSPCache_EndModel (qmodel_t *mod)
+{
+	bspcache_t	*cache = mod->bspcache;
+	int		size;
+
+	if (cache && bspcache_data && bspcache_polys)
+	{
+		cache->loaded = true;
+		cache->numlightmaps = bspcache_header.numlightmaps;
+		cache->lastlightmap = bspcache_header.lastlightmap;
+		size = cache->numlightmaps * LMBLOCK_WIDTH * sizeof(int);
+		cache->allocated = (int *) Hunk_AllocName (q_max(size, 1), "bspcache");
+		memcpy (cache->allocated, bspcache_allocated, size);
+		Con_DPrintf ("Loaded %i surfaces of %s from the bsp cache\n", mod->numsurfaces, mod->name);
+	}
+
+	BSPCache_Free ();
+}
+
+/*
+================
+BSPCache_RestoreLightmaps -- puts back AllocBlock's state after packing mod from empty lightmaps
+================
+*/
+qboolean BSPCache_RestoreLightmaps (qmodel_t *mod)
+{
+	bspcache_t	*cache = mod->bspcache;
+
+	if (!cache || !cache->loaded)
+		return false;
+
+	memcpy (allocated, cache->allocated, cache->numlightmaps * LMBLOCK_WIDTH * sizeof(int));
+	last_lightmap_allocated = cache->lastlightmap;
+	return true;
+}
+
+/*
+================
+BSPCache_WriteData -- writes and hashes the part after the header
+================
+*/
+static qboolean BSPCache_WriteData (FILE *f, const void *data, int size, bspcacheheader_t *header)
+{
+	header->checksum = COM_HashBytes (header->checksum, data, size);
+	header->size += size;
+	return fwrite (data, 1, size, f) == (size_t)size;
+}
+
+/*
+================
+BSPCache_Write -- called once mod has been packed into lightmaps, starting from empty ones
+================
+*/
+void BSPCache_Write (qmodel_t *mod)
+{
+	bspcacheheader_t	header;
+	bspcachesurf_t		out;
+	msurface_t		*s;
+	glpoly_t		*poly;
+	char			path[MAX_OSPATH], temp[MAX_OSPATH];
+	FILE			*f;
+	qboolean		ok;
+	int			i;
+
+	if (!mod->bspcache || mod->bspcache->loaded || !bspcache_dir[0])
+		return;
+
+	memset (&header, 0, sizeof(header));
+	memcpy (header.magic, "QBSC", 4);
+	header.version = BSPCACHE_VERSION;
+	BSPCache_Key (mod->bspcache, &header.key);
+	header.numsurfaces = mod->numsurfaces;
+	header.numlightmaps = allocated[0][0] ? last_lightmap_allocated + 1 : 0;
+	header.lastlightmap = header.numlightmaps ? last_lightmap_allocated : 0;
+	header.checksum = COM_HASH_INIT;
+
+	BSPCache_Path (&header.key, path, sizeof(path));
+	f = COM_OpenTempFile (path, mod, temp, sizeof(temp));
+	if (!f)
+		return;
+
+	// the header goes in again at the end, with the size and checksum
+	ok = fwrite (&header, 1, sizeof(header), f) == sizeof(header);
+
+	for (i=0, s=mod->surfaces ; ok && i<mod->numsurfaces ; i++, s++)
+	{
+		memset (&out, 0, sizeof(out));
+		VectorCopy (s->mins, out.mins);
+		VectorCopy (s->maxs, out.maxs);
+		out.flags = s->flags;
+		out.texturemins[0] = s->texturemins[0];
+		out.texturemins[1] = s->texturemins[1];
+		out.extents[0] = s->extents[0];
+		out.extents[1] = s->extents[1];
+		out.lightmaptexturenum = s->lightmaptexturenum;
+		out.light_s = s->light_s;
+		out.light_t = s->light_t;
+		for (poly = s->polys ; poly ; poly = poly->next)
+			out.numpolys++;
+		ok = BSPCache_WriteData (f, &out, sizeof(out), &header);
+	}
+
+	if (ok && header.numlightmaps)
+		ok = BSPCache_WriteData (f, allocated, header.numlightmaps * LMBLOCK_WIDTH * sizeof(int), &header);
+
+	for (i=0, s=mod->surfaces ; ok && i<mod->numsurfaces ; i++, s++)
+	{
+		for (poly = s->polys ; ok && poly ; poly = poly->next)
+		{
+			ok = BSPCache_WriteData (f, &poly->numverts, sizeof(int), &header) &&
+				BSPCache_WriteData (f, poly->verts, poly->numverts * VERTEXSIZE*sizeof(float), &header);
+		}
+	}
+
+	ok = ok && fseek (f, 0, SEEK_SET) == 0 && fwrite (&header, 1, sizeof(header), f) == sizeof(header);
+	if (COM_ReplaceFile (f, temp, path, ok))
+		Con_DPrintf ("Wrote %s to the bsp cache\n", mod->name);
+}
+
+/*
+================
+BSPCache_Init
+================
+*/
+void BSPCache_Init (void)
+{
+	Cvar_RegisterVariable (&gl_bspcache);
+
+	if (!COM_CheckParm ("-nobspcache"))
+		COM_UserCacheDir ("bspcache", bspcache_dir, sizeof(bspcache_dir));
+}
@@ -0,0 +1,765 @@
+/*
+Copyright (C) 1996-2001 Id Software, Inc.
+Copyright (C) 2002-2009 John Fitzgibbons and others
+Copyright (C) 2010-2014 QuakeSpasm developers
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// gl_capture.c -- framebuffer captures without stalling the frame
+
+#include "quakedef.h"
+
+/*
+a capture is read into a pixel buffer object, which lets glReadPixels
+return before the copy has happened.  the buffer is mapped a couple of
+frames later, when the gpu is long done with it, and the pixels are handed
+to a writer thread that does the file i/o.  without pbo support the
+readback is synchronous, but the writing still happens on the thread.
+
+the writer only touches stdio and its own queue; everything it needs,
+the full path included, is resolved on the main thread.
+
+video capture (capturedemo) runs the host at a fixed timestep and sends
+every frame down the same path, either as numbered TGAs or appended to a
+YUV4MPEG2 stream, which the writer converts to 4:2:0.  jobs are written in
+the order they were queued, so the stream needs no reordering.  a host
+frame that presents nothing still owes a video frame, so the next one is
+written as many times as it takes to stay in step with the audio.
+*/
+
+#define CAPTURE_SLOTS		4	// readbacks in flight: a screenshot and two vr eyes fit at once
+#define CAPTURE_LATENCY		2	// frames between a readback and mapping its buffer
+#define CAPTURE_MAXQUEUED	8	// images waiting for the writer before the main thread blocks
+
+typedef enum
+{
+	CAPJOB_IMAGE,		// one TGA at path
+	CAPJOB_SEQUENCE,	// TGAs numbered from frame, path is the prefix
+	CAPJOB_Y4M			// frames appended to capture_video.y4m
+} capjobkind_t;
+
+typedef struct capturejob_s
+{
+	struct capturejob_s	*next;
+	capjobkind_t	kind;
+	char		path[MAX_OSPATH];	// full path
+	char		name[MAX_QPATH];	// relative to the gamedir, for messages
+	int			width, height;
+	int			frame, repeat;		// video frame number, and how many times to write it
+	qboolean	report;				// print a message once written
+	qboolean	ok;
+	byte		*data;				// BGR rows, bottom to top
+} capturejob_t;
+
+typedef struct
+{
+	GLuint			pbo;
+	int				size;
+	int				frame;			// capture_framecount at readback
+	capturejob_t	*job;			// NULL when idle
+} captureslot_t;
+
+static captureslot_t	capture_slots[CAPTURE_SLOTS];
+static int				capture_framecount;
+static char				capture_pending[MAX_QPATH];	// screenshot to take at the end of this frame
+
+static SDL_Thread		*capture_thread;
+static SDL_mutex		*capture_mutex;
+static SDL_cond			*capture_wake;		// a job was queued, or shutting down
+static SDL_cond			*capture_written;	// the writer finished a job
+static capturejob_t		*capture_queue, *capture_queuetail;
+static capturejob_t		*capture_done;		// written, waiting to be reported and freed
+static int				capture_numqueued;
+static qboolean			capture_quit;
+
+static struct
+{
+	qboolean	active;
+	float		fps;
+	capjobkind_t	kind;
+	char		name[MAX_QPATH];	// gamedir-relative prefix of every output file
+	FILE		*y4m;				// only the writer touches it while capturing
+	FILE		*wav;
+	int			wavbytes;
+	int			framesdue;			// host frames run since the start
+	int			frameswritten;		// video frames queued
+	int			width, height;		// fixed at the first frame; y4m can't change size
+} capture_video;
+
+/*
+================
+Capture_WriteTGA -- runs on the writer thread
+================
+*/
+static qboolean Capture_WriteTGA (const char *path, capturejob_t *job)
+{
+	byte	header[18];
+	FILE	*f;
+	size_t	size;
+
+	f = fopen (path, "wb");
+	if (!f)
+		return false;
+
+	memset (header, 0, sizeof(header));
+	header[2] = 2; // uncompressed type
+	header[12] = job->width & 255;
+	header[13] = job->width >> 8;
+	header[14] = job->height & 255;
+	header[15] = job->height >> 8;
+	header[16] = 24; // pixel size
+
+	size = (size_t)job->width * job->height * 3;
+	if (fwrite (header, 1, sizeof(header), f) != sizeof(header) ||
+		fwrite (job->data, 1, size, f) != size)
+	{
+		fclose (f);
+		return false;
+	}
+
+	return fclose (f) == 0;
+}
+
+/*
+================
+Capture_WriteY4M -- runs on the writer thread; BT.601 full range (C420jpeg), chroma averaged over 2x2 blocks
+================
+*/
+static qboolean Capture_WriteY4M (capturejob_t *job)
+{
+	static byte	*yuv;
+	static int	yuvsize;
+	int			w = job->width & ~1, h = job->height & ~1;
+	int			x, y, r, g, b, i, size;
+	byte		*row0, *row1, *py, *pu, *pv;
+
+	size = w * h * 3 / 2;
+	if (yuvsize < size)
+	{
+		free (yuv);
+		yuv = (byte *) malloc (size);
+		yuvsize = yuv ? size : 0;
+		if (!yuv)
+			return false;
+	}
+
+	py = yuv;
+	pu = yuv + w * h;
+	pv = pu + (w / 2) * (h / 2);
+
+	// readback rows run bottom to top, y4m runs top to bottom
+	for (y=0 ; y<h ; y+=2)
+	{
+		row0 = job->data + (job->height - 1 - y) * job->width * 3;
+		row1 = row0 - job->width * 3;
+		for (x=0 ; x<w ; x+=2)
+		{
+			r = g = b = 0;
+			for (i=0 ; i<4 ; i++)
+			{
+				byte *p = ((i & 2) ? row1 : row0) + (x + (i & 1)) * 3;
+				py[(y + (i >> 1)) * w + x + (i & 1)] = (77*p[2] + 150*p[1] + 29*p[0] + 128) >> 8;
+				b += p[0];
+				g += p[1];
+				r += p[2];
+			}
+			// sums of four pixels, so shift by two more
+			*pu++ = 128 + ((-43*r - 85*g + 128*b + 512) >> 10);
+			*pv++ = 128 + ((128*r - 107*g - 21*b + 512) >> 10);
+		}
+	}
+
+	for (i=0 ; i<job->repeat ; i++)
+	{
+		if (fwrite ("FRAME\n", 1, 6, capture_video.y4m) != 6 ||
+			fwrite (yuv, 1, size, capture_video.y4m) != (size_t)size)
+			return false;
+	}
+
+	return true;
+}
+
+/*
+================
+Capture_WriteJob -- runs on the writer thread
+================
+*/
+static qboolean Capture_WriteJob (capturejob_t *job)
+{
+	char	path[MAX_OSPATH];
+	int		i;
+
+	switch (job->kind)
+	{
+	case CAPJOB_SEQUENCE:
+		for (i=0 ; i<job->repeat ; i++)
+		{
+			q_snprintf (path, sizeof(path), "%s%06i.tga", job->path, job->frame + i);
+			if (!Capture_WriteTGA (path, job))
+				return false;
+		}
+		return true;
+	case CAPJOB_Y4M:
+		return Capture_WriteY4M (job);
+	default:
+		return Capture_WriteTGA (job->path, job);
+	}
+}
+
+/*
+================
+Capture_Writer
+================
+*/
+static int SDLCALL Capture_Writer (void *unused)
+{
+	capturejob_t	*job;
+
+	SDL_LockMutex (capture_mutex);
+	for (;;)
+	{
+		while (!capture_queue && !capture_quit)
+			SDL_CondWait (capture_wake, capture_mutex);
+
+		if (!capture_queue)
+			break; // quitting, and everything is written
+
+		job = capture_queue;
+		capture_queue = job->next;
+		if (!capture_queue)
+			capture_queuetail = NULL;
+		SDL_UnlockMutex (capture_mutex);
+
+		job->ok = Capture_WriteJob (job);
+
+		SDL_LockMutex (capture_mutex);
+		job->next = capture_done;
+		capture_done = job;
+		capture_numqueued--;
+		SDL_CondSignal (capture_written);
+	}
+	SDL_UnlockMutex (capture_mutex);
+
+	return 0;
+}
+
+/*
+================
+Capture_Queue -- hands a filled job to the writer
+================
+*/
+static void Capture_Queue (capturejob_t *job)
+{
+	job->next = NULL;
+
+	if (!capture_thread)
+	{
+		job->ok = Capture_WriteJob (job);
+		job->next = capture_done;
+		capture_done = job;
+		return;
+	}
+
+	SDL_LockMutex (capture_mutex);
+	while (capture_numqueued >= CAPTURE_MAXQUEUED)
+		SDL_CondWait (capture_written, capture_mutex);
+	if (capture_queuetail)
+		capture_queuetail->next = job;
+	else
+		capture_queue = job;
+	capture_queuetail = job;
+	capture_numqueued++;
+	SDL_CondSignal (capture_wake);
+	SDL_UnlockMutex (capture_mutex);
+}
+
+/*
+================
+Capture_Report -- prints and frees whatever the writer has finished
+================
+*/
+static void Capture_Report (void)
+{
+	capturejob_t	*job, *next;
+
+	if (capture_thread)
+		SDL_LockMutex (capture_mutex);
+	job = capture_done;
+	capture_done = NULL;
+	if (capture_thread)
+		SDL_UnlockMutex (capture_mutex);
+
+	for ( ; job ; job = next)
+	{
+		next = job->next;
+		if (!job->ok)
+			Con_Printf ("Couldn't write %s\n", job->name);
+		else if (job->report)
+			Con_Printf ("Wrote %s\n", job->name);
+		free (job->data);
+		free (job);
+	}
+}
+
+/*
+================
+Capture_FinishSlot -- maps a readback and queues it for writing; stalls if the copy is not done yet
+================
+*/
+static void Capture_FinishSlot (captureslot_t *slot)
+{
+	capturejob_t	*job = slot->job;
+	void			*pixels;
+
+	slot->job = NULL;
+
+	GL_BindBufferFunc (GL_PIXEL_PACK_BUFFER_ARB, slot->pbo);
+	pixels = GL_MapBufferFunc (GL_PIXEL_PACK_BUFFER_ARB, GL_READ_ONLY_ARB);
+	if (pixels)
+	{
+		memcpy (job->data, pixels, job->width * job->height * 3);
+		GL_UnmapBufferFunc (GL_PIXEL_PACK_BUFFER_ARB);
+	}
+	GL_BindBufferFunc (GL_PIXEL_PACK_BUFFER_ARB, 0);
+
+	if (pixels)
+		Capture_Queue (job);
+	else
+	{
+		Con_Printf ("Couldn't read back %s\n", job->name);
+		free (job->data);
+		free (job);
+	}
+}
+
+/*
+================
+Capture_NewJob
+================
+*/
+static capturejob_t *Capture_NewJob (capjobkind_t kind, const char *name, int width, int height)
+{
+	capturejob_t	*job;
+
+	job = (capturejob_t *) calloc (1, sizeof(capturejob_t));
+	if (job)
+		job->data = (byte *) malloc (width * height * 3);
+	if (!job || !job->data)
+	{
+		Con_Printf ("Capture: couldn't allocate memory for %s\n", name);
+		free (job);
+		return NULL;
+	}
+
+	job->kind = kind;
+	q_strlcpy (job->name, name, sizeof(job->name));
+	q_snprintf (job->path, sizeof(job->path), "%s/%s", com_gamedir, name);
+	COM_CreatePath (job->path);
+	job->width = width;
+	job->height = height;
+	job->repeat = 1;
+	return job;
+}
+
+/*
+================
+Capture_Read -- starts reading a job's pixels from the bound read framebuffer
+================
+*/
+static void Capture_Read (capturejob_t *job, int x, int y)
+{
+	captureslot_t	*slot, *oldest;
+	int				i, size;
+	int				width = job->width, height = job->height;
+
+	size = width * height * 3;
+
+	glPixelStorei (GL_PACK_ALIGNMENT, 1); /* for widths that aren't a multiple of 4 */
+
+	if (!gl_pbo_able)
+	{
+		glReadPixels (x, y, width, height, GL_BGR, GL_UNSIGNED_BYTE, job->data);
+		Capture_Queue (job);
+		return;
+	}
+
+// find an idle slot, or make one by finishing the oldest readback early
+	slot = oldest = NULL;
+	for (i=0 ; i<CAPTURE_SLOTS ; i++)
+	{
+		if (!capture_slots[i].job)
+		{
+			slot = &capture_slots[i];
+			break;
+		}
+		if (!oldest || capture_slots[i].frame < oldest->frame)
+			oldest = &capture_slots[i];
+	}
+	if (!slot)
+	{
+		Capture_FinishSlot (oldest);
+		slot = oldest;
+	}
+
+	if (!slot->pbo)
+		GL_GenBuffersFunc (1, &slot->pbo);
+	GL_BindBufferFunc (GL_PIXEL_PACK_BUFFER_ARB, slot->pbo);
+	if (slot->size < size)
+	{
+		GL_BufferDataFunc (GL_PIXEL_PACK_BUFFER_ARB, size, NULL, GL_STREAM_READ_ARB);
+		slot->size = size;
+	}
+	glReadPixels (x, y, width, height, GL_BGR, GL_UNSIGNED_BYTE, NULL);
+	GL_BindBufferFunc (GL_PIXEL_PACK_BUFFER_ARB, 0);
+
+	slot->job = job;
+	slot->frame = capture_framecount;
+}
+
+/*
+================
+Capture_ReadPixels -- captures a rectangle of the bound read framebuffer to name, relative to the gamedir
+================
+*/
+void Capture_ReadPixels (const char *name, int x, int y, int width, int height, qboolean report)
+{
+	capturejob_t	*job;
+
+	job = Capture_NewJob (CAPJOB_IMAGE, name, width, height);
+	if (!job)
+		return;
+	job->report = report;
+	Capture_Read (job, x, y);
+}
+
+/*
+================
+Capture_Flush -- finishes every readback and waits for the writer to empty its queue
+================
+*/
+static void Capture_Flush (void)
+{
+	int		i;
+
+	for (i=0 ; i<CAPTURE_SLOTS ; i++)
+		if (capture_slots[i].job)
+			Capture_FinishSlot (&capture_slots[i]);
+
+	if (capture_thread)
+	{
+		SDL_LockMutex (capture_mutex);
+		while (capture_numqueued)
+			SDL_CondWait (capture_written, capture_mutex);
+		SDL_UnlockMutex (capture_mutex);
+	}
+}
+
+/*
+================
+Capture_WriteWavHeader -- canonical 44 byte header for 16 bit stereo; rewritten with the real sizes at the end
+================
+*/
+static void Capture_WriteWavHeader (FILE *f, int rate, int databytes)
+{
+	byte	h[44];
+
+	memcpy (h, "RIFF", 4);
+	h[4] = (36 + databytes) & 255; h[5] = ((36 + databytes) >> 8) & 255; h[6] = ((36 + databytes) >> 16) & 255; h[7] = ((36 + databytes) >> 24) & 255;
+	memcpy (h + 8, "WAVEfmt ", 8);
+	h[16] = 16; h[17] = h[18] = h[19] = 0;	// fmt chunk size
+	h[20] = 1; h[21] = 0;					// pcm
+	h[22] = 2; h[23] = 0;					// channels
+	h[24] = rate & 255; h[25] = (rate >> 8) & 255; h[26] = (rate >> 16) & 255; h[27] = (rate >> 24) & 255;
+	h[28] = (rate * 4) & 255; h[29] = ((rate * 4) >> 8) & 255; h[30] = ((rate * 4) >> 16) & 255; h[31] = ((rate * 4) >> 24) & 255;
+	h[32] = 4; h[33] = 0;					// block align
+	h[34] = 16; h[35] = 0;					// bits per sample
+	memcpy (h + 36, "data", 4);
+	h[40] = databytes & 255; h[41] = (databytes >> 8) & 255; h[42] = (databytes >> 16) & 255; h[43] = (databytes >> 24) & 255;
+
+	fseek (f, 0, SEEK_SET);
+	fwrite (h, 1, sizeof(h), f);
+}
+
+/*
+================
+Capture_BeginVideo -- starts writing every frame to capture/<name>, with the mixed sound alongside
+================
+*/
+qboolean Capture_BeginVideo (const char *name, float fps, qboolean y4m)
+{
+	char	path[MAX_OSPATH];
+
+	if (capture_video.active)
+		Capture_EndVideo ();
+
+	memset (&capture_video, 0, sizeof(capture_video));
+	q_snprintf (capture_video.name, sizeof(capture_video.name), "capture/%s", name);
+	capture_video.fps = fps;
+	capture_video.kind = y4m ? CAPJOB_Y4M : CAPJOB_SEQUENCE;
+
+	if (y4m)
+	{
+		q_snprintf (path, sizeof(path), "%s/%s.y4m", com_gamedir, capture_video.name);
+		COM_CreatePath (path);
+		capture_video.y4m = fopen (path, "wb");
+		if (!capture_video.y4m)
+		{
+			Con_Printf ("Couldn't open %s\n", path);
+			return false;
+		}
+		// the header goes out with the first frame, once the size is known
+	}
+
+	if (shm)
+	{
+		q_snprintf (path, sizeof(path), "%s/%s.wav", com_gamedir, capture_video.name);
+		COM_CreatePath (path);
+		capture_video.wav = fopen (path, "wb");
+		if (capture_video.wav)
+			Capture_WriteWavHeader (capture_video.wav, shm->speed, 0);
+		else
+			Con_Printf ("Couldn't open %s, capturing without sound\n", path);
+	}
+
+	capture_video.active = true;
+	if (capture_video.wav)
+		S_BeginCapture (fps);
+
+	Con_Printf ("Capturing to %s at %g fps\n", capture_video.name, fps);
+	return true;
+}
+
+/*
+================
+Capture_EndVideo
+================
+*/
+void Capture_EndVideo (void)
+{
+	if (!capture_video.active)
+		return;
+
+	capture_video.active = false;
+	S_EndCapture ();
+
+	Capture_Flush ();
+	Capture_Report ();
+
+	if (capture_video.y4m)
+		fclose (capture_video.y4m);
+	if (capture_video.wav)
+	{
+		Capture_WriteWavHeader (capture_video.wav, shm ? shm->speed : 0, capture_video.wavbytes);
+		fclose (capture_video.wav);
+	}
+
+	Con_Printf ("Captured %i frames (%.1f seconds) to %s\n", capture_video.frameswritten,
+		capture_video.frameswritten / capture_video.fps, capture_video.name);
+	memset (&capture_video, 0, sizeof(capture_video));
+}
+
+/*
+================
+Capture_VideoTick -- a fixed-timestep host frame is starting, and owes one video frame
+================
+*/
+void Capture_VideoTick (void)
+{
+	if (capture_video.active)
+		capture_video.framesdue++;
+}
+
+/*
+================
+Capture_VideoFrame -- reads back the frame being presented, covering any frames that presented nothing
+================
+*/
+static void Capture_VideoFrame (void)
+{
+	capturejob_t	*job;
+	int				repeat;
+
+	repeat = capture_video.framesdue - capture_video.frameswritten;
+	if (repeat <= 0)
+		return;
+
+	if (!capture_video.frameswritten)
+	{
+		capture_video.width = glwidth;
+		capture_video.height = glheight;
+		if (capture_video.y4m)
+			fprintf (capture_video.y4m, "YUV4MPEG2 W%i H%i F%i:1000 Ip A1:1 C420jpeg\n",
+				capture_video.width & ~1, capture_video.height & ~1, (int)(capture_video.fps * 1000 + 0.5));
+	}
+
+	job = Capture_NewJob (capture_video.kind, capture_video.name, capture_video.width, capture_video.height);
+	if (!job)
+		return;
+	if (job->kind == CAPJOB_SEQUENCE)
+		q_strlcat (job->path, "_", sizeof(job->path));
+	job->frame = capture_video.frameswritten;
+	job->repeat = repeat;
+	capture_video.frameswritten += repeat;
+
+	Capture_Read (job, glx, gly);
+}
+
+/*
+================
+Capture_AudioSamples -- called by the mixer with every block it paints
+================
+*/
+void Capture_AudioSamples (const portable_samplepair_t *samples, int count)
+{
+	short	out[2*512];
+	int		i, n, val;
+
+	if (!capture_video.active || !capture_video.wav)
+		return;
+
+	while (count > 0)
+	{
+		n = q_min (count, 512);
+		for (i=0 ; i<n ; i++)
+		{
+			val = samples[i].left >> 8;
+			out[i*2] = LittleShort (CLAMP (-32768, val, 32767));
+			val = samples[i].right >> 8;
+			out[i*2+1] = LittleShort (CLAMP (-32768, val, 32767));
+		}
+		fwrite (out, 4, n, capture_video.wav);
+		capture_video.wavbytes += n * 4;
+		samples += n;
+		count -= n;
+	}
+}
+
+/*
+================
+Capture_Request -- screenshot the next presented frame as basename.tga
+================
+*/
+void Capture_Request (const char *basename)
+{
+	q_strlcpy (capture_pending, basename, sizeof(capture_pending));
+}
+
+/*
+================
+Capture_PendingName -- base name of the screenshot this frame will produce, for extra views such as vr eyes
+================
+*/
+const char *Capture_PendingName (void)
+{
+	return capture_pending[0] ? capture_pending : NULL;
+}
+
+/*
+================
+Capture_EndFrame -- called once per presented frame, before the buffer swap
+================
+*/
+void Capture_EndFrame (void)
+{
+	char	name[MAX_QPATH];
+	int		i;
+
+	if (capture_pending[0])
+	{
+		q_snprintf (name, sizeof(name), "%s.tga", capture_pending);
+		Capture_ReadPixels (name, glx, gly, glwidth, glheight, true);
+		capture_pending[0] = 0;
+	}
+
+	if (capture_video.active)
+		Capture_VideoFrame ();
+
+	capture_framecount++;
+	for (i=0 ; i<CAPTURE_SLOTS ; i++)
+		if (capture_slots[i].job && capture_framecount - capture_slots[i].frame >= CAPTURE_LATENCY)
+			Capture_FinishSlot (&capture_slots[i]);
+
+	Capture_Report ();
+}
+
+/*
+================
+Capture_Init
+================
+*/
+void Capture_Init (void)
+{
+	capture_mutex = SDL_CreateMutex ();
+	capture_wake = SDL_CreateCond ();
+	capture_written = SDL_CreateCond ();
+	if (!capture_mutex || !capture_wake || !capture_written)
+	{
+		Con_Warning ("Couldn't create capture mutex: %s\n", SDL_GetError());
+		return;
+	}
+
+#if defined(USE_SDL2)
+	capture_thread = SDL_CreateThread (Capture_Writer, "capture", NULL);
+#else
+	capture_thread = SDL_CreateThread (Capture_Writer, NULL);
+#endif
+	if (!capture_thread)
+		Con_Warning ("Couldn't create capture thread, writing on the main thread: %s\n", SDL_GetError());
+}
+
+/*
+================
+Capture_DeleteBuffers -- finishes pending readbacks and deletes the pbos; Capture_Read makes new ones as needed
+================
+*/
+void Capture_DeleteBuffers (void)
+{
+	int		i;
+
+	for (i=0 ; i<CAPTURE_SLOTS ; i++)
+	{
+		if (capture_slots[i].job)
+			Capture_FinishSlot (&capture_slots[i]);
+		if (capture_slots[i].pbo)
+			GL_DeleteBuffersFunc (1, &capture_slots[i].pbo);
+		capture_slots[i].pbo = 0;
+		capture_slots[i].size = 0;
+	}
+}
+
+/*
+================
+Capture_Shutdown -- finishes every outstanding capture; needs the GL context
+================
+*/
+void Capture_Shutdown (void)
+{
+	Capture_EndVideo ();
+	Capture_DeleteBuffers ();
+
+	if (capture_thread)
+	{
+		SDL_LockMutex (capture_mutex);
+		capture_quit = true;
+		SDL_CondSignal (capture_wake);
+		SDL_UnlockMutex (capture_mutex);
+		SDL_WaitThread (capture_thread, NULL);
+		capture_thread = NULL;
+	}
+
+	Capture_Report ();
+}
@@ -24,6 +24,269 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "quakedef.h"
 
 
+/*
+=================================================================
+
+MESH CACHE
+
+=================================================================
+*/
+
+/*
+built meshes are kept in <userdir>/meshcache, one file per mesh, named after
+a hash of the triangles and s/t vertices they were built from.  the header
+repeats the whole key and the counts, the data is checksummed and every
+index in it is range checked before use, and anything that doesn't hold up
+is built again and rewritten.  the file is the part of the aliasbuild_t
+block after the struct -- commands, vertex order, VBO vertex descriptions
+and indexes -- so a hit is a single read.  like the texture cache, files are
+written under a temporary name and renamed, and the cache is never trimmed.
+*/
+
+#define MESHCACHE_VERSION	1
+#define MESHCACHE_MINTRIS	64	// below this, opening a file costs more than meshing
+
+typedef struct
+{
+	unsigned int	hash;			// triangles and s/t vertices
+	int		numtris, numverts;
+	int		skinwidth, skinheight;
+	int		vbo;			// whether the VBO layout is included
+} meshcachekey_t;
+
+typedef struct
+{
+	char		magic[4];		// "QMSH"
+	int		version;
+	meshcachekey_t	key;
+	int		numcommands;
+	int		numorder;
+	int		numverts_vbo;
+	int		numindexes;
+	int		size;			// of the data after the header
+	unsigned int	checksum;		// of the data after the header
+} meshcacheheader_t;
+
+static cvar_t	gl_meshcache = {"gl_meshcache", "1", CVAR_ARCHIVE};
+static char	meshcache_dir[MAX_OSPATH];
+
+/*
+================
+GLMesh_BuildSize -- bytes of data after the aliasbuild_t struct
+================
+*/
+static int GLMesh_BuildSize (int numcommands, int numorder, int numverts_vbo, int numindexes)
+{
+	return (numcommands + numorder) * sizeof(int) + numverts_vbo * sizeof(aliasmesh_t) + numindexes * sizeof(unsigned short);
+}
+
+/*
+================
+GLMesh_SetPointers
+================
+*/
+static void GLMesh_SetPointers (aliasbuild_t *build)
+{
+	build->commands = (int *)(build + 1);
+	build->vertexorder = build->commands + build->numcommands;
+	if (build->numindexes)
+	{
+		build->meshdesc = (aliasmesh_t *)(build->vertexorder + build->numorder);
+		build->indexes = (unsigned short *)(build->meshdesc + build->numverts_vbo);
+	}
+	else
+	{
+		build->meshdesc = NULL;
+		build->indexes = NULL;
+	}
+}
+
+/*
+================
+GLMesh_CheckBuild -- whether every count and index in a cached mesh is in range
+================
+*/
+static qboolean GLMesh_CheckBuild (const aliasbuild_t *build)
+{
+	const int	*cmds, *end;
+	int		i, count, total;
+
+	// the command list is runs of (count, count * s/t pairs), then a 0
+	cmds = build->commands;
+	end = cmds + build->numcommands;
+	total = 0;
+	while (1)
+	{
+		if (cmds == end)
+			return false;
+		count = *cmds++;
+		if (!count)
+			break;
+		if (count < 0)
+			count = -count;
+		if (count < 3 || (end - cmds) / 2 < count)
+			return false;
+		cmds += count * 2;
+		total += count;
+	}
+	if (cmds != end || total != build->numorder)
+		return false;
+
+	for (i = 0; i < build->numorder; i++)
+		if (build->vertexorder[i] < 0 || build->vertexorder[i] >= build->numverts)
+			return false;
+
+	for (i = 0; i < build->numverts_vbo; i++)
+		if (build->meshdesc[i].vertindex >= build->numverts)
+			return false;
+
+	for (i = 0; i < build->numindexes; i++)
+		if (build->indexes[i] >= build->numverts_vbo)
+			return false;
+
+	return true;
+}
+
+/*
+================
+GLMesh_SourceHash -- of the triangles and st verts a mesh is built from
+================
+*/
+static unsigned int GLMesh_SourceHash (const mtriangle_t *tris, int numtris, const stvert_t *verts, int numverts)
+{
+	unsigned int	hash;
+
+	hash = COM_HashBytes (COM_HASH_INIT, tris, numtris * sizeof(mtriangle_t));
+	return COM_HashBytes (hash, verts, numverts * sizeof(stvert_t));
+}
+
+/*
+================
+GLMesh_CacheKey -- false if the mesh shouldn't be cached
+================
+*/
+static qboolean GLMesh_CacheKey (const mtriangle_t *tris, int numtris, const stvert_t *verts, int numverts,
+	int skinwidth, int skinheight, meshcachekey_t *key, char *path, size_t pathsize)
+{
+	if (!gl_meshcache.value || !meshcache_dir[0] || numtris < MESHCACHE_MINTRIS)
+		return false;
+
+	memset (key, 0, sizeof(*key));
+	key->hash = GLMesh_SourceHash (tris, numtris, verts, numverts);
+	key->numtris = numtris;
+	key->numverts = numverts;
+	key->skinwidth = skinwidth;
+	key->skinheight = skinheight;
+	key->vbo = (gl_glsl_alias_able != false);
+
+	q_snprintf (path, pathsize, "%s/%08x%08x.msh", meshcache_dir, key->hash,
+		COM_HashBytes (COM_HASH_INIT, key, sizeof(*key)));
+	return true;
+}
+
+/*
+================
+GLMesh_CacheRead -- the cached mesh, if it's there and sound
+================
+*/
+static aliasbuild_t *GLMesh_CacheRead (const meshcachekey_t *key, const char *path)
+{
+	meshcacheheader_t	header;
+	aliasbuild_t		*build;
+	FILE			*f;
+
+	f = fopen (path, "rb");
+	if (!f)
+		return NULL;
+
+	if (fread (&header, 1, sizeof(header), f) != sizeof(header) ||
+		memcmp (header.magic, "QMSH", 4) || header.version != MESHCACHE_VERSION ||
+		memcmp (&header.key, key, sizeof(*key)) ||
+		header.numcommands < 1 || header.numcommands > 8192 ||
+		header.numorder < 0 || header.numorder > 8192 ||
+		header.numverts_vbo < 0 || header.numverts_vbo > key->numtris * 3 ||
+		header.numindexes != (key->vbo ? key->numtris * 3 : 0) ||
+		(!key->vbo && header.numverts_vbo) ||
+		header.size != GLMesh_BuildSize (header.numcommands, header.numorder, header.numverts_vbo, header.numindexes))
+	{
+		fclose (f);
+		return NULL;
+	}
+
+	build = (aliasbuild_t *) malloc (sizeof(aliasbuild_t) + header.size);
+	if (!build)
+	{
+		fclose (f);
+		return NULL;
+	}
+
+	build->numtris = key->numtris;
+	build->numverts = key->numverts;
+	build->skinwidth = key->skinwidth;
+	build->skinheight = key->skinheight;
+	build->numcommands = header.numcommands;
+	build->numorder = header.numorder;
+	build->numverts_vbo = header.numverts_vbo;
+	build->numindexes = header.numindexes;
+	GLMesh_SetPointers (build);
+
+	if (fread (build + 1, 1, header.size, f) != (size_t)header.size ||
+		COM_HashBytes (COM_HASH_INIT, build + 1, header.size) != header.checksum ||
+		!GLMesh_CheckBuild (build))
+	{
+		fclose (f);
+		free (build);
+		return NULL;
+	}
+	fclose (f);
+
+	return build;
+}
+
+/*
+================
+GLMesh_CacheWrite
+================
+*/
+static void GLMesh_CacheWrite (const aliasbuild_t *build, const meshcachekey_t *key, const char *path)
+{
+	meshcacheheader_t	header;
+	char			temp[MAX_OSPATH];
+	FILE			*f;
+	qboolean		ok;
+
+	memset (&header, 0, sizeof(header));
+	memcpy (header.magic, "QMSH", 4);
+	header.version = MESHCACHE_VERSION;
+	header.key = *key;
+	header.numcommands = build->numcommands;
+	header.numorder = build->numorder;
+	header.numverts_vbo = build->numverts_vbo;
+	header.numindexes = build->numindexes;
+	header.size = GLMesh_BuildSize (build->numcommands, build->numorder, build->numverts_vbo, build->numindexes);
+	header.checksum = COM_HashBytes (COM_HASH_INIT, build + 1, header.size);
+
+	f = COM_OpenTempFile (path, build, temp, sizeof(temp));
+	if (!f)
+		return;
+	ok = fwrite (&header, 1, sizeof(header), f) == sizeof(header) &&
+		fwrite (build + 1, 1, header.size, f) == (size_t)header.size;
+	COM_ReplaceFile (f, temp, path, ok);
+}
+
+/*
+================
+GLMesh_Init
+================
+*/
+void GLMesh_Init (void)
+{
+	Cvar_RegisterVariable (&gl_meshcache);
+
+	if (!COM_CheckParm ("-nomeshcache"))
+		COM_UserCacheDir ("meshcache", meshcache_dir, sizeof(meshcache_dir));
+}
+
 /*
 =================================================================
 
@@ -32,56 +295,64 @@ ALIAS MODEL DISPLAY LIST GENERATION
 =================================================================
 */
 
-qmodel_t	*aliasmodel;
-aliashdr_t	*paliashdr;
+// working state for building one mesh; kept off the stack because it is
+// large, and per call rather than global so meshes can be built on the
+// task threads
+typedef struct
+{
+	const mtriangle_t	*triangles;
+	const stvert_t		*stverts;
+	int		numtris;
+	int		skinwidth, skinheight;
 
-int		used[8192]; // qboolean
+	int		used[8192]; // qboolean
 
-// the command list holds counts and s/t values that are valid for
-// every frame
-int		commands[8192];
-int		numcommands;
+	// the command list holds counts and s/t values that are valid for
+	// every frame
+	int		commands[8192];
+	int		numcommands;
 
-// all frames will have their vertexes rearranged and expanded
-// so they are in the order expected by the command list
-int		vertexorder[8192];
-int		numorder;
+	// all frames will have their vertexes rearranged and expanded
+	// so they are in the order expected by the command list
+	int		vertexorder[8192];
+	int		numorder;
 
-int		allverts, alltris;
+	int		stripverts[128];
+	int		striptris[128];
+	int		stripcount;
+} meshbuild_t;
 
-int		stripverts[128];
-int		striptris[128];
-int		stripcount;
+int		allverts, alltris;
 
 /*
 ================
 StripLength
 ================
 */
-int	StripLength (int starttri, int startv)
+static int StripLength (meshbuild_t *b, int starttri, int startv)
 {
 	int			m1, m2;
 	int			j;
-	mtriangle_t	*last, *check;
+	const mtriangle_t	*last, *check;
 	int			k;
 
-	used[starttri] = 2;
+	b->used[starttri] = 2;
 
-	last = &triangles[starttri];
+	last = &b->triangles[starttri];
 
-	stripverts[0] = last->vertindex[(startv)%3];
-	stripverts[1] = last->vertindex[(startv+1)%3];
-	stripverts[2] = last->vertindex[(startv+2)%3];
+	b->stripverts[0] = last->vertindex[(startv)%3];
+	b->stripverts[1] = last->vertindex[(startv+1)%3];
+	b->stripverts[2] = last->vertindex[(startv+2)%3];
 
-	striptris[0] = starttri;
-	stripcount = 1;
+	b->striptris[0] = starttri;
+	b->stripcount = 1;
 
 	m1 = last->vertindex[(startv+2)%3];
 	m2 = last->vertindex[(startv+1)%3];
 
 	// look for a matching triangle
 nexttri:
-	for (j=starttri+1, check=&triangles[starttri+1] ; j<pheader->numtris ; j++, check++)
+	for (j=starttri+1, check=&b->triangles[starttri+1] ; j<b->numtris ; j++, check++)
 	{
 		if (check->facesfront != last->facesfront)
 			continue;
@@ -95,31 +366,31 @@ nexttri:
 			// this is the next part of the fan
 
 			// if we can't use this triangle, this tristrip is done
-			if (used[j])
+			if (b->used[j])
 				goto done;
 
 			// the new edge
-			if (stripcount & 1)
+			if (b->stripcount & 1)
 				m2 = check->vertindex[ (k+2)%3 ];
 			else
 				m1 = check->vertindex[ (k+2)%3 ];
 
-			stripverts[stripcount+2] = check->vertindex[ (k+2)%3 ];
-			striptris[stripcount] = j;
-			stripcount++;
+			b->stripverts[b->stripcount+2] = check->vertindex[ (k+2)%3 ];
+			b->striptris[b->stripcount] = j;
+			b->stripcount++;
 
-			used[j] = 2;
+			b->used[j] = 2;
 			goto nexttri;
 		}
 	}
 done:
 
 	// clear the temp used flags
-	for (j=starttri+1 ; j<pheader->numtris ; j++)
-		if (used[j] == 2)
-			used[j] = 0;
+	for (j=starttri+1 ; j<b->numtris ; j++)
+		if (b->used[j] == 2)
+			b->used[j] = 0;
 
-	return stripcount;
+	return b->stripcount;
 }
 
 /*
@@ -127,23 +398,23 @@ done:
 FanLength
 ===========
 */
-int	FanLength (int starttri, int startv)
+static int FanLength (meshbuild_t *b, int starttri, int startv)
 {
 	int		m1, m2;
 	int		j;
-	mtriangle_t	*last, *check;
+	const mtriangle_t	*last, *check;
 	int		k;
 
-	used[starttri] = 2;
+	b->used[starttri] = 2;
 
-	last = &triangles[starttri];
+	last = &b->triangles[starttri];
 
-	stripverts[0] = last->vertindex[(startv)%3];
-	stripverts[1] = last->vertindex[(startv+1)%3];
-	stripverts[2] = last->vertindex[(startv+2)%3];
+	b->stripverts[0] = last->vertindex[(startv)%3];
+	b->stripverts[1] = last->vertindex[(startv+1)%3];
+	b->stripverts[2] = last->vertindex[(startv+2)%3];
 
-	striptris[0] = starttri;
-	stripcount = 1;
+	b->striptris[0] = starttri;
+	b->stripcount = 1;
 
 	m1 = last->vertindex[(startv+0)%3];
 	m2 = last->vertindex[(startv+2)%3];
@@ -151,7 +422,7 @@ int	FanLength (int starttri, int startv)
 
 	// look for a matching triangle
 nexttri:
-	for (j=starttri+1, check=&triangles[starttri+1] ; j<pheader->numtris ; j++, check++)
+	for (j=starttri+1, check=&b->triangles[starttri+1] ; j<b->numtris ; j++, check++)
 	{
 		if (check->facesfront != last->facesfront)
 			continue;
@@ -165,28 +436,28 @@ nexttri:
 			// this is the next part of the fan
 
 			// if we can't use this triangle, this tristrip is done
-			if (used[j])
+			if (b->used[j])
 				goto done;
 
 			// the new edge
 			m2 = check->vertindex[ (k+2)%3 ];
 
-			stripverts[stripcount+2] = m2;
-			striptris[stripcount] = j;
-			stripcount++;
+			b->stripverts[b->stripcount+2] = m2;
+			b->striptris[b->stripcount] = j;
+			b->stripcount++;
 
-			used[j] = 2;
+			b->used[j] = 2;
 			goto nexttri;
 		}
 	}
 done:
 
 	// clear the temp used flags
-	for (j=starttri+1 ; j<pheader->numtris ; j++)
-		if (used[j] == 2)
-			used[j] = 0;
+	for (j=starttri+1 ; j<b->numtris ; j++)
+		if (b->used[j] == 2)
+			b->used[j] = 0;
 
-	return stripcount;
+	return b->stripcount;
 }
 
 
@@ -198,7 +469,7 @@ Generate a list of trifans or strips
 for the model, which holds for all frames
 ================
 */
-void BuildTris (void)
+static void BuildTris (meshbuild_t *b)
 {
 	int		i, j, k;
 	int		startv;
@@ -211,13 +482,13 @@ void BuildTris (void)
 	//
 	// build tristrips
 	//
-	numorder = 0;
-	numcommands = 0;
-	memset (used, 0, sizeof(used));
-	for (i = 0; i < pheader->numtris; i++)
+	b->numorder = 0;
+	b->numcommands = 0;
+	memset (b->used, 0, sizeof(b->used));
+	for (i = 0; i < b->numtris; i++)
 	{
 		// pick an unused triangle and start the trifan
-		if (used[i])
+		if (b->used[i])
 			continue;
 
 		bestlen = 0;
@@ -228,29 +499,29 @@ void BuildTris (void)
 			for (startv = 0; startv < 3; startv++)
 			{
 				if (type == 1)
-					len = StripLength (i, startv);
+					len = StripLength (b, i, startv);
 				else
-					len = FanLength (i, startv);
+					len = FanLength (b, i, startv);
 				if (len > bestlen)
 				{
 					besttype = type;
 					bestlen = len;
 					for (j = 0; j < bestlen+2; j++)
-						bestverts[j] = stripverts[j];
+						bestverts[j] = b->stripverts[j];
 					for (j = 0; j < bestlen; j++)
-						besttris[j] = striptris[j];
+						besttris[j] = b->striptris[j];
 				}
 			}
 		}
 
 		// mark the tris on the best strip as used
 		for (j = 0; j < bestlen; j++)
-			used[besttris[j]] = 1;
+			b->used[besttris[j]] = 1;
 
 		if (besttype == 1)
-			commands[numcommands++] = (bestlen+2);
+			b->commands[b->numcommands++] = (bestlen+2);
 		else
-			commands[numcommands++] = -(bestlen+2);
+			b->commands[b->numcommands++] = -(bestlen+2);
 
 		for (j = 0; j < bestlen+2; j++)
 		{
@@ -258,73 +529,259 @@ void BuildTris (void)
 
 			// emit a vertex into the reorder buffer
 			k = bestverts[j];
-			vertexorder[numorder++] = k;
+			b->vertexorder[b->numorder++] = k;
 
 			// emit s/t coords into the commands stream
-			s = stverts[k].s;
-			t = stverts[k].t;
-			if (!triangles[besttris[0]].facesfront && stverts[k].onseam)
-				s += pheader->skinwidth / 2;	// on back side
-			s = (s + 0.5) / pheader->skinwidth;
-			t = (t + 0.5) / pheader->skinheight;
+			s = b->stverts[k].s;
+			t = b->stverts[k].t;
+			if (!b->triangles[besttris[0]].facesfront && b->stverts[k].onseam)
+				s += b->skinwidth / 2;	// on back side
+			s = (s + 0.5) / b->skinwidth;
+			t = (t + 0.5) / b->skinheight;
 
 		//	*(float *)&commands[numcommands++] = s;
 		//	*(float *)&commands[numcommands++] = t;
 			// NOTE: 4 == sizeof(int)
 			//	   == sizeof(float)
 			memcpy (&tmp, &s, 4);
-			commands[numcommands++] = tmp;
+			b->commands[b->numcommands++] = tmp;
 			memcpy (&tmp, &t, 4);
-			commands[numcommands++] = tmp;
+			b->commands[b->numcommands++] = tmp;
 		}
 	}
 
-	commands[numcommands++] = 0;		// end of list marker
+	b->commands[b->numcommands++] = 0;		// end of list marker
+}
 
-	Con_DPrintf2 ("%3i tri %3i vert %3i cmd\n", pheader->numtris, numorder, numcommands);
+/*
+================
+BuildMeshDesc
+
+Index the unique xyz/st pairs for the VBO path.
+
+Original code by MH from RMQEngine
+================
+*/
+static int BuildMeshDesc (const meshbuild_t *b, aliasmesh_t *desc, unsigned short *indexes)
+{
+	int i, j;
+	int numverts_vbo, numindexes;
+
+	numindexes = 0;
+	numverts_vbo = 0;
+
+	for (i = 0; i < b->numtris; i++)
+	{
+		for (j = 0; j < 3; j++)
+		{
+			int v;
 
-	allverts += numorder;
-	alltris += pheader->numtris;
+			// index into hdr->vertexes
+			unsigned short vertindex = b->triangles[i].vertindex[j];
+
+			// basic s/t coords
+			int s = b->stverts[vertindex].s;
+			int t = b->stverts[vertindex].t;
+
+			// check for back side and adjust texcoord s
+			if (!b->triangles[i].facesfront && b->stverts[vertindex].onseam) s += b->skinwidth / 2;
+
+			// see does this vert already exist
+			for (v = 0; v < numverts_vbo; v++)
+			{
+				// it could use the same xyz but have different s and t
+				if (desc[v].vertindex == vertindex && (int) desc[v].st[0] == s && (int) desc[v].st[1] == t)
+				{
+					// exists; emit an index for it
+					indexes[numindexes++] = v;
+
+					// no need to check any more
+					break;
+				}
+			}
+
+			if (v == numverts_vbo)
+			{
+				// doesn't exist; emit a new vert and index
+				indexes[numindexes++] = numverts_vbo;
+
+				desc[numverts_vbo].vertindex = vertindex;
+				desc[numverts_vbo].st[0] = s;
+				desc[numverts_vbo++].st[1] = t;
+			}
+		}
+	}
+
+	return numverts_vbo;
+}
+
+/*
+================
+GLMesh_GenerateMesh -- builds the strips, vertex order and VBO layout of an
+alias mesh into one malloc'd block; returns NULL if out of memory
+================
+*/
+static aliasbuild_t *GLMesh_GenerateMesh (const mtriangle_t *tris, int numtris, const stvert_t *verts, int numverts, int skinwidth, int skinheight)
+{
+	meshbuild_t	*b;
+	aliasbuild_t	*out;
+	aliasmesh_t	*desc;
+	unsigned short	*indexes;
+	int		numverts_vbo;
+	size_t		size;
+
+	b = (meshbuild_t *) malloc (sizeof(*b));
+	if (!b)
+		return NULL;
+
+	b->triangles = tris;
+	b->stverts = verts;
+	b->numtris = numtris;
+	b->skinwidth = skinwidth;
+	b->skinheight = skinheight;
+	BuildTris (b);
+
+	desc = NULL;
+	indexes = NULL;
+	numverts_vbo = 0;
+	if (gl_glsl_alias_able)
+	{
+		desc = (aliasmesh_t *) malloc (numtris * 3 * (sizeof(aliasmesh_t) + sizeof(unsigned short)));
+		if (!desc)
+		{
+			free (b);
+			return NULL;
+		}
+		indexes = (unsigned short *)(desc + numtris * 3);
+		numverts_vbo = BuildMeshDesc (b, desc, indexes);
+	}
+
+	size = sizeof(aliasbuild_t) + GLMesh_BuildSize (b->numcommands, b->numorder, numverts_vbo, desc ? numtris * 3 : 0);
+	out = (aliasbuild_t *) calloc (1, size);	// cleared so the padding in meshdesc hashes the same every time
+	if (out)
+	{
+		out->numtris = numtris;
+		out->numverts = numverts;
+		out->skinwidth = skinwidth;
+		out->skinheight = skinheight;
+		out->numcommands = b->numcommands;
+		out->numorder = b->numorder;
+		out->numverts_vbo = numverts_vbo;
+		out->numindexes = desc ? numtris * 3 : 0;
+		GLMesh_SetPointers (out);
+		memcpy (out->commands, b->commands, out->numcommands * sizeof(int));
+		memcpy (out->vertexorder, b->vertexorder, out->numorder * sizeof(int));
+		if (desc)
+		{
+			memcpy (out->meshdesc, desc, numverts_vbo * sizeof(aliasmesh_t));
+			memcpy (out->indexes, indexes, out->numindexes * sizeof(unsigned short));
+		}
+	}
+
+	free (desc);
+	free (b);
+	return out;
 }
 
-static void GL_MakeAliasModelDisplayLists_VBO (void);
+/*
+================
+GLMesh_BuildMesh -- the mesh for these triangles, from the mesh cache or built
+fresh.  only touches its arguments and the cache directory, so it can run on
+the task threads.  returns NULL if out of memory
+================
+*/
+aliasbuild_t *GLMesh_BuildMesh (const mtriangle_t *tris, int numtris, const stvert_t *verts, int numverts, int skinwidth, int skinheight)
+{
+	meshcachekey_t	key;
+	char		path[MAX_OSPATH];
+	qboolean	cache;
+	aliasbuild_t	*build;
+
+	cache = GLMesh_CacheKey (tris, numtris, verts, numverts, skinwidth, skinheight, &key, path, sizeof(path));
+	if (cache && (build = GLMesh_CacheRead (&key, path)) != NULL)
+	{
+		build->cached = true;
+		build->srchash = key.hash;
+		return build;
+	}
+
+	build = GLMesh_GenerateMesh (tris, numtris, verts, numverts, skinwidth, skinheight);
+	if (build)
+	{
+		build->cached = false;
+		build->srchash = cache ? key.hash : GLMesh_SourceHash (tris, numtris, verts, numverts);
+		if (cache)
+			GLMesh_CacheWrite (build, &key, path);
+	}
+
+	return build;
+}
+
+/*
+================
+GLMesh_MatchesBuild -- whether a prebuilt mesh was made from this header and
+the triangles and st verts just loaded for it
+================
+*/
+static qboolean GLMesh_MatchesBuild (const aliasbuild_t *build, const aliashdr_t *hdr)
+{
+	return build->numtris == hdr->numtris && build->numverts == hdr->numverts &&
+		build->skinwidth == hdr->skinwidth && build->skinheight == hdr->skinheight &&
+		(build->meshdesc != NULL) == (gl_glsl_alias_able != false) &&
+		build->srchash == GLMesh_SourceHash (triangles, hdr->numtris, stverts, hdr->numverts);
+}
+
+static void GL_MakeAliasModelDisplayLists_VBO (qmodel_t *m, aliashdr_t *hdr, const aliasbuild_t *build);
 static void GLMesh_LoadVertexBuffer (qmodel_t *m, const aliashdr_t *hdr);
 
 /*
 ================
 GL_MakeAliasModelDisplayLists
+
+prebuilt is an optional GLMesh_BuildMesh result for this model, made ahead of
+time on the task threads; it is used if it matches the header
 ================
 */
-void GL_MakeAliasModelDisplayLists (qmodel_t *m, aliashdr_t *hdr)
+void GL_MakeAliasModelDisplayLists (qmodel_t *m, aliashdr_t *hdr, const aliasbuild_t *prebuilt)
 {
 	int		i, j;
 	int			*cmds;
 	trivertx_t	*verts;
 	float	hscale, vscale; //johnfitz -- padded skins
 	int		count; //johnfitz -- precompute texcoords for padded skins
-	int		*loadcmds; //johnfitz
+	const int	*loadcmds; //johnfitz
+	const aliasbuild_t	*build;
 
 	//johnfitz -- padded skins
 	hscale = (float)hdr->skinwidth/(float)TexMgr_PadConditional(hdr->skinwidth);
 	vscale = (float)hdr->skinheight/(float)TexMgr_PadConditional(hdr->skinheight);
 	//johnfitz
 
-	aliasmodel = m;
-	paliashdr = hdr;	// (aliashdr_t *)Mod_Extradata (m);
-
 //johnfitz -- generate meshes
-	Con_DPrintf2 ("meshing %s...\n",m->name);
-	BuildTris ();
+	if (prebuilt && GLMesh_MatchesBuild (prebuilt, hdr))
+		build = prebuilt;
+	else
+	{
+		build = GLMesh_BuildMesh (triangles, hdr->numtris, stverts, hdr->numverts, hdr->skinwidth, hdr->skinheight);
+		if (!build)
+			Sys_Error ("GL_MakeAliasModelDisplayLists: out of memory meshing %s", m->name);
+	}
+
+	Con_DPrintf2 ("%s %s: %3i tri %3i vert %3i cmd\n", build->cached ? "cached mesh" : "meshed", m->name,
+		hdr->numtris, build->numorder, build->numcommands);
+
+	allverts += build->numorder;
+	alltris += hdr->numtris;
 
 	// save the data out
 
-	paliashdr->poseverts = numorder;
+	hdr->poseverts = build->numorder;
 
-	cmds = (int *) Hunk_Alloc (numcommands * 4);
-	paliashdr->commands = (byte *)cmds - (byte *)paliashdr;
+	cmds = (int *) Hunk_Alloc (build->numcommands * 4);
+	hdr->commands = (byte *)cmds - (byte *)hdr;
 
 	//johnfitz -- precompute texcoords for padded skins
-	loadcmds = commands;
+	loadcmds = build->commands;
 	while(1)
 	{
 		*cmds++ = count = *loadcmds++;
@@ -337,20 +794,23 @@ void GL_MakeAliasModelDisplayLists (qmodel_t *m, aliashdr_t *hdr)
 
 		do
 		{
-			*(float *)cmds++ = hscale * (*(float *)loadcmds++);
-			*(float *)cmds++ = vscale * (*(float *)loadcmds++);
+			*(float *)cmds++ = hscale * (*(const float *)loadcmds++);
+			*(float *)cmds++ = vscale * (*(const float *)loadcmds++);
 		} while (--count);
 	}
 	//johnfitz
 
-	verts = (trivertx_t *) Hunk_Alloc (paliashdr->numposes * paliashdr->poseverts * sizeof(trivertx_t));
-	paliashdr->posedata = (byte *)verts - (byte *)paliashdr;
-	for (i=0 ; i<paliashdr->numposes ; i++)
-		for (j=0 ; j<numorder ; j++)
-			*verts++ = poseverts[i][vertexorder[j]];
+	verts = (trivertx_t *) Hunk_Alloc (hdr->numposes * hdr->poseverts * sizeof(trivertx_t));
+	hdr->posedata = (byte *)verts - (byte *)hdr;
+	for (i=0 ; i<hdr->numposes ; i++)
+		for (j=0 ; j<build->numorder ; j++)
+			*verts++ = poseverts[i][build->vertexorder[j]];
 
 	// ericw
-	GL_MakeAliasModelDisplayLists_VBO ();
+	GL_MakeAliasModelDisplayLists_VBO (m, hdr, build);
+
+	if (build != prebuilt)
+		free ((void *)build);
 }
 
 unsigned int r_meshindexbuffer = 0;
@@ -366,7 +826,7 @@ is copied to Mod_Extradata.
 Original code by MH from RMQEngine
 ================
 */
-void GL_MakeAliasModelDisplayLists_VBO (void)
+static void GL_MakeAliasModelDisplayLists_VBO (qmodel_t *m, aliashdr_t *hdr, const aliasbuild_t *build)
 {
 	int i, j;
 	int maxverts_vbo;
@@ -378,68 +838,29 @@ void GL_MakeAliasModelDisplayLists_VBO (void)
 		return;
 
 	// first, copy the verts onto the hunk
-	verts = (trivertx_t *) Hunk_Alloc (paliashdr->numposes * paliashdr->numverts * sizeof(trivertx_t));
-	paliashdr->vertexes = (byte *)verts - (byte *)paliashdr;
-	for (i=0 ; i<paliashdr->numposes ; i++)
-		for (j=0 ; j<paliashdr->numverts ; j++)
-			verts[i*paliashdr->numverts + j] = poseverts[i][j];
+	verts = (trivertx_t *) Hunk_Alloc (hdr->numposes * hdr->numverts * sizeof(trivertx_t));
+	hdr->vertexes = (byte *)verts - (byte *)hdr;
+	for (i=0 ; i<hdr->numposes ; i++)
+		for (j=0 ; j<hdr->numverts ; j++)
+			verts[i*hdr->numverts + j] = poseverts[i][j];
 
 	// there can never be more than this number of verts and we just put them all on the hunk
-	maxverts_vbo = pheader->numtris * 3;
+	maxverts_vbo = hdr->numtris * 3;
 	desc = (aliasmesh_t *) Hunk_Alloc (sizeof (aliasmesh_t) * maxverts_vbo);
 
 	// there will always be this number of indexes
 	indexes = (unsigned short *) Hunk_Alloc (sizeof (unsigned short) * maxverts_vbo);
 
-	pheader->indexes = (intptr_t) indexes - (intptr_t) pheader;
-	pheader->meshdesc = (intptr_t) desc - (intptr_t) pheader;
-	pheader->numindexes = 0;
-	pheader->numverts_vbo = 0;
+	hdr->indexes = (intptr_t) indexes - (intptr_t) hdr;
+	hdr->meshdesc = (intptr_t) desc - (intptr_t) hdr;
+	hdr->numindexes = build->numindexes;
+	hdr->numverts_vbo = build->numverts_vbo;
 
-	for (i = 0; i < pheader->numtris; i++)
-	{
-		for (j = 0; j < 3; j++)
-		{
-			int v;
-
-			// index into hdr->vertexes
-			unsigned short vertindex = triangles[i].vertindex[j];
-
-			// basic s/t coords
-			int s = stverts[vertindex].s;
-			int t = stverts[vertindex].t;
-
-			// check for back side and adjust texcoord s
-			if (!triangles[i].facesfront && stverts[vertindex].onseam) s += pheader->skinwidth / 2;
-
-			// see does this vert already exist
-			for (v = 0; v < pheader->numverts_vbo; v++)
-			{
-				// it could use the same xyz but have different s and t
-				if (desc[v].vertindex == vertindex && (int) desc[v].st[0] == s && (int) desc[v].st[1] == t)
-				{
-					// exists; emit an index for it
-					indexes[pheader->numindexes++] = v;
+	memcpy (desc, build->meshdesc, build->numverts_vbo * sizeof(aliasmesh_t));
+	memcpy (indexes, build->indexes, build->numindexes * sizeof(unsigned short));
 
-					// no need to check any more
-					break;
-				}
-			}
-
-			if (v == pheader->numverts_vbo)
-			{
-				// doesn't exist; emit a new vert and index
-				indexes[pheader->numindexes++] = pheader->numverts_vbo;
-
-				desc[pheader->numverts_vbo].vertindex = vertindex;
-				desc[pheader->numverts_vbo].st[0] = s;
-				desc[pheader->numverts_vbo++].st[1] = t;
-			}
-		}
-	}
-	
 	// upload immediately
-	GLMesh_LoadVertexBuffer (aliasmodel, pheader);
+	GLMesh_LoadVertexBuffer (m, hdr);
 }
 
 #define NUMVERTEXNORMALS	 162
@@ -583,6 +1004,27 @@ void GLMesh_LoadVertexBuffers (void)
 	}
 }
 
+/*
+================
+GLMesh_DeleteVertexBuffer
+
+Delete the VBOs of one alias model, e.g. when Mod_ReleaseUnused drops it
+================
+*/
+void GLMesh_DeleteVertexBuffer (qmodel_t *m)
+{
+	if (!gl_glsl_alias_able)
+		return;
+
+	GL_DeleteBuffersFunc (1, &m->meshvbo);
+	m->meshvbo = 0;
+
+	GL_DeleteBuffersFunc (1, &m->meshindexesvbo);
+	m->meshindexesvbo = 0;
+
+	GL_ClearBufferBindings ();
+}
+
 /*
 ================
 GLMesh_DeleteVertexBuffers
@@ -35,6 +35,8 @@ void Mod_LoadAliasModel (qmodel_t *mod, void *buffer);
 qmodel_t *Mod_LoadModel (qmodel_t *mod, qboolean crash);
 
 cvar_t	external_ents = {"external_ents", "1", CVAR_ARCHIVE};
+static cvar_t	gl_pvscache = {"gl_pvscache", "256", CVAR_ARCHIVE};	// rows, clamped to 2..65536; there's no "off"
+static cvar_t	gl_fatpvs = {"gl_fatpvs", "32", CVAR_ARCHIVE};		// megabytes allowed for a fat pvs table, 0 for none
 
 byte	mod_novis[MAX_MAP_LEAFS/8];
 
@@ -45,6 +47,8 @@ int		mod_numknown;
 texture_t	*r_notexture_mip; //johnfitz -- moved here from r_main.c
 texture_t	*r_notexture_mip2; //johnfitz -- used for non-lightmapped surfs with a missing texture
 
+static void Mod_PVSInfo_f (void);
+
 /*
 ===============
 Mod_Init
@@ -54,6 +58,12 @@ void Mod_Init (void)
 {
 	Cvar_RegisterVariable (&gl_subdivide_size);
 	Cvar_RegisterVariable (&external_ents);
+	Cvar_RegisterVariable (&gl_pvscache);
+	Cvar_RegisterVariable (&gl_fatpvs);
+	Cmd_AddCommand ("pvsinfo", Mod_PVSInfo_f);
+
+	BSPCache_Init ();
+	GLMesh_Init ();
 
 	memset (mod_novis, 0xff, sizeof(mod_novis));
 
@@ -123,30 +133,21 @@ mleaf_t *Mod_PointInLeaf (vec3_t p, qmodel_t *model)
 
 /*
 ===================
-Mod_DecompressVis
+Mod_DecompressRow -- run-length decodes a pvs row into out, which has room for the whole row
 ===================
 */
-byte *Mod_DecompressVis (byte *in, qmodel_t *model)
+static void Mod_DecompressRow (const byte *in, qmodel_t *model, byte *out)
 {
-	static byte	decompressed[MAX_MAP_LEAFS/8];
-	int		c;
-	byte	*out;
-	int		row;
+	int		c, row;
+	byte	*end;
 
 	row = (model->numleafs+7)>>3;
-	out = decompressed;
+	end = out + row;
 
-#if 0
-	memcpy (out, in, row);
-#else
 	if (!in)
 	{	// no vis info, so make all visible
-		while (row)
-		{
-			*out++ = 0xff;
-			row--;
-		}
-		return decompressed;
+		memset (out, 0xff, row);
+		return;
 	}
 
 	do
@@ -157,24 +158,377 @@ byte *Mod_DecompressVis (byte *in, qmodel_t *model)
 			continue;
 		}
 
-		c = in[1];
+		c = q_min(in[1], end - out); // a bad run shouldn't go past the row
 		in += 2;
-		while (c)
-		{
-			*out++ = 0;
-			c--;
-		}
-	} while (out - decompressed < row);
-#endif
+		memset (out, 0, c);
+		out += c;
+	} while (out < end);
+}
+
+/*
+===================
+Mod_DecompressVis
+===================
+*/
+byte *Mod_DecompressVis (byte *in, qmodel_t *model)
+{
+	static byte	decompressed[MAX_MAP_LEAFS/8];
 
+	Mod_DecompressRow (in, model, decompressed);
 	return decompressed;
 }
 
+/*
+===============================================================================
+
+PVS ROW CACHE
+
+decompressed rows of the most recently asked for leafs are kept in a fixed
+number of slots, and each leaf remembers the slot its row went to, so a leaf
+that's still cached costs a pointer check.  rows are padded to a multiple of
+four bytes, like the fat pvs, and the padding is zero.  a returned row stays
+good until gl_pvscache other leafs have been asked for, which is always longer
+than the static buffer it replaces.
+
+===============================================================================
+*/
+
+typedef struct
+{
+	mleaf_t		*leaf;		// NULL if free
+	int			prev, next;	// lru list, most recent first
+	byte		*row;
+} pvsslot_t;
+
+static pvsslot_t	*pvscache_slots;
+static byte			*pvscache_rows;
+static int			pvscache_numslots;
+static int			pvscache_rowbytes;
+static qmodel_t		*pvscache_model;
+static int			pvscache_head, pvscache_tail;
+static unsigned int	pvscache_hits, pvscache_misses;
+
+/*
+===================
+Mod_FlushPVSCache -- forgets every row; leafs that point at a slot find someone else there
+===================
+*/
+static void Mod_FlushPVSCache (void)
+{
+	int		i;
+
+	for (i=0 ; i<pvscache_numslots ; i++)
+	{
+		pvscache_slots[i].leaf = NULL;
+		pvscache_slots[i].prev = i-1;
+		pvscache_slots[i].next = (i+1 < pvscache_numslots) ? i+1 : -1;
+	}
+	pvscache_head = pvscache_numslots ? 0 : -1;
+	pvscache_tail = pvscache_numslots-1;
+	pvscache_model = NULL;
+}
+
+/*
+===================
+Mod_PVSCacheSlots -- gl_pvscache as the cache is really sized, so a value out
+of range isn't taken for a change on every lookup
+===================
+*/
+static int Mod_PVSCacheSlots (void)
+{
+	return CLAMP (2, (int)gl_pvscache.value, 65536);
+}
+
+/*
+===================
+Mod_SizePVSCache -- makes room for rows of model, in as many slots as gl_pvscache asks for
+===================
+*/
+static void Mod_SizePVSCache (qmodel_t *model)
+{
+	int		i, numslots, rowbytes;
+
+	numslots = Mod_PVSCacheSlots ();
+	rowbytes = (model->numleafs+31)>>3;
+
+	if (numslots != pvscache_numslots || rowbytes != pvscache_rowbytes)
+	{
+		free (pvscache_slots);
+		free (pvscache_rows);
+		pvscache_slots = (pvsslot_t *) malloc (numslots * sizeof(pvsslot_t));
+		pvscache_rows = (byte *) calloc (numslots, rowbytes);
+		if (!pvscache_slots || !pvscache_rows)
+			Sys_Error ("Mod_SizePVSCache: out of memory for %i rows", numslots);
+		for (i=0 ; i<numslots ; i++)
+			pvscache_slots[i].row = pvscache_rows + i*rowbytes;
+		pvscache_numslots = numslots;
+		pvscache_rowbytes = rowbytes;
+	}
+
+	Mod_FlushPVSCache ();
+	pvscache_model = model;
+}
+
+/*
+===================
+Mod_TouchSlot -- moves a slot to the front of the lru list
+===================
+*/
+static void Mod_TouchSlot (int i)
+{
+	pvsslot_t	*s = &pvscache_slots[i];
+
+	if (pvscache_head == i)
+		return;
+
+	// unlink
+	pvscache_slots[s->prev].next = s->next;
+	if (s->next >= 0)
+		pvscache_slots[s->next].prev = s->prev;
+	else
+		pvscache_tail = s->prev;
+
+	// link at the front
+	s->prev = -1;
+	s->next = pvscache_head;
+	pvscache_slots[pvscache_head].prev = i;
+	pvscache_head = i;
+}
+
+/*
+===================
+Mod_LeafPVS
+===================
+*/
 byte *Mod_LeafPVS (mleaf_t *leaf, qmodel_t *model)
 {
+	pvsslot_t	*s;
+	int			i;
+
 	if (leaf == model->leafs)
 		return mod_novis;
-	return Mod_DecompressVis (leaf->compressed_vis, model);
+
+	if (model != pvscache_model || Mod_PVSCacheSlots () != pvscache_numslots)
+		Mod_SizePVSCache (model);
+
+	i = leaf->pvsslot - 1;
+	if (i >= 0 && i < pvscache_numslots && pvscache_slots[i].leaf == leaf)
+	{
+		pvscache_hits++;
+		Mod_TouchSlot (i);
+		return pvscache_slots[i].row;
+	}
+
+	// take over the least recently used slot
+	pvscache_misses++;
+	i = pvscache_tail;
+	s = &pvscache_slots[i];
+	s->leaf = leaf;
+	leaf->pvsslot = i + 1;
+	Mod_DecompressRow (leaf->compressed_vis, model, s->row);
+	Mod_TouchSlot (i);
+
+	return s->row;
+}
+
+/*
+===============================================================================
+
+FAT PVS TABLE
+
+for each leaf, the union of the pvs of every leaf that comes within 8 units
+of its bounds.  that covers whatever SV_FatPVS finds for any point inside
+the leaf, a little more at times, so it can stand in for the walk down the
+tree.  one row per leaf adds up quickly on big maps, so it's only made when
+it fits in gl_fatpvs megabytes.  it's calloc'd rather than taken from the
+hunk, so a big table can't fail a map load or crowd out the model cache;
+if there's no memory for it the tree walk carries on as before.
+
+===============================================================================
+*/
+
+typedef struct
+{
+	qmodel_t	*model;
+	int			rowbytes;
+} fatpvsjob_t;
+
+/*
+===================
+Mod_AddFatLeafs -- ors in the pvs of every leaf touching the box
+===================
+*/
+static void Mod_AddFatLeafs (qmodel_t *model, mnode_t *node, vec3_t mins, vec3_t maxs, byte *fat, byte *row, int rowbytes)
+{
+	int		i, side;
+
+	while (node->contents >= 0)
+	{
+		side = BoxOnPlaneSide (mins, maxs, node->plane);
+		if (side == 1)
+			node = node->children[0];
+		else if (side == 2)
+			node = node->children[1];
+		else
+		{	// go down both
+			Mod_AddFatLeafs (model, node->children[0], mins, maxs, fat, row, rowbytes);
+			node = node->children[1];
+		}
+	}
+
+	if (node->contents == CONTENTS_SOLID)
+		return;
+
+	Mod_DecompressRow (((mleaf_t *)node)->compressed_vis, model, row);
+	for (i=0 ; i<rowbytes ; i++)
+		fat[i] |= row[i];
+}
+
+/*
+===================
+Mod_BuildFatRows -- safe on any thread, each index fills the rows of 256 leafs
+===================
+*/
+static void Mod_BuildFatRows (void *data, int index)
+{
+	fatpvsjob_t	*job = (fatpvsjob_t *) data;
+	qmodel_t	*model = job->model;
+	byte		row[MAX_MAP_LEAFS/8 + 4];
+	vec3_t		mins, maxs;
+	mleaf_t		*leaf;
+	int			i, j, first, last;
+
+	first = index * 256;
+	last = q_min(first + 256, model->numleafs);
+	memset (row, 0, sizeof(row)); // the padding past the decompressed part stays zero
+
+	for (i=first ; i<last ; i++)
+	{
+		leaf = model->leafs + i + 1;
+		if (leaf->contents == CONTENTS_SOLID)
+			continue; // never looked up, SV_FatPVS walks the tree from solid
+		for (j=0 ; j<3 ; j++)
+		{
+			mins[j] = leaf->minmaxs[j] - 8;
+			maxs[j] = leaf->minmaxs[3+j] + 8;
+		}
+		Mod_AddFatLeafs (model, model->nodes, mins, maxs, model->fatpvs + i*job->rowbytes, row, job->rowbytes);
+	}
+}
+
+/*
+===================
+Mod_BuildFatPVS -- called at map load, for the world
+===================
+*/
+void Mod_BuildFatPVS (qmodel_t *model)
+{
+	fatpvsjob_t	job;
+	double		start;
+	int			size;
+
+	if (!model || model->type != mod_brush || model->fatpvs || !model->visdata || !model->numleafs)
+		return;
+
+	job.model = model;
+	job.rowbytes = (model->numleafs+31)>>3;
+	size = model->numleafs * job.rowbytes;
+	if ((double)size > gl_fatpvs.value * 1024 * 1024)
+	{
+		Con_DPrintf ("Fat PVS table for %s needs %i KB, over gl_fatpvs\n", model->name, size >> 10);
+		return;
+	}
+
+	start = Sys_DoubleTime ();
+	model->fatpvs = (byte *) calloc (1, size); // rows are or-ed into
+	if (!model->fatpvs)
+	{
+		Con_DPrintf ("Fat PVS table for %s needs %i KB, out of memory\n", model->name, size >> 10);
+		return;
+	}
+	Tasks_ParallelFor ((model->numleafs + 255) / 256, 0, Mod_BuildFatRows, &job);
+
+	Con_DPrintf ("Fat PVS table for %s: %i leafs, %i KB, %.1f ms\n", model->name,
+		model->numleafs, size >> 10, (Sys_DoubleTime () - start) * 1000.0);
+}
+
+/*
+===================
+Mod_LeafFatPVS -- the fat pvs row of a leaf, or NULL if there's no table or it's the solid leaf
+===================
+*/
+byte *Mod_LeafFatPVS (mleaf_t *leaf, qmodel_t *model)
+{
+	int		i;
+
+	if (!model->fatpvs || leaf->contents == CONTENTS_SOLID)
+		return NULL;
+
+	i = leaf - model->leafs - 1;
+	if (i < 0 || i >= model->numleafs)
+		return NULL;
+
+	return model->fatpvs + i * ((model->numleafs+31)>>3);
+}
+
+/*
+===================
+Mod_PVSInfo_f -- reports what the pvs caches hold
+===================
+*/
+static void Mod_PVSInfo_f (void)
+{
+	Con_Printf ("PVS cache: %i rows of %i bytes, %i KB, %u hits, %u misses\n", pvscache_numslots,
+		pvscache_rowbytes, (pvscache_numslots * pvscache_rowbytes) >> 10, pvscache_hits, pvscache_misses);
+
+	if (cl.worldmodel && cl.worldmodel->fatpvs)
+		Con_Printf ("Fat PVS table: %i rows, %i KB\n", cl.worldmodel->numleafs,
+			(cl.worldmodel->numleafs * ((cl.worldmodel->numleafs+31)>>3)) >> 10);
+	else if (sv.active && sv.worldmodel && sv.worldmodel->fatpvs)
+		Con_Printf ("Fat PVS table: %i rows, %i KB\n", sv.worldmodel->numleafs,
+			(sv.worldmodel->numleafs * ((sv.worldmodel->numleafs+31)>>3)) >> 10);
+	else
+		Con_Printf ("Fat PVS table: none\n");
+}
+
+/*
+===================
+Mod_SpriteAlloc -- sprite data goes in malloc'd blocks chained off the model
+instead of on the hunk, so a sprite can be kept from one level to the next
+===================
+*/
+static void *Mod_SpriteAlloc (int size)
+{
+	void	**block;
+
+	block = (void **) calloc (1, 2 * sizeof(void *) + size); // second slot keeps the data 8 byte aligned
+	if (!block)
+		Sys_Error ("Mod_SpriteAlloc: out of memory loading %s", loadmodel->name);
+
+	block[0] = loadmodel->spritemem;
+	loadmodel->spritemem = block;
+	return block + 2;
+}
+
+/*
+===================
+Mod_FreeSprite
+===================
+*/
+static void Mod_FreeSprite (qmodel_t *mod)
+{
+	void	**block;
+
+	if (!mod->spritemem)
+		return;
+
+	while (mod->spritemem)
+	{
+		block = (void **) mod->spritemem;
+		mod->spritemem = block[0];
+		free (block);
+	}
+	mod->cache.data = NULL;
 }
 
 /*
@@ -188,11 +542,22 @@ void Mod_ClearAll (void)
 	qmodel_t	*mod;
 
 	for (i=0 , mod=mod_known ; i<mod_numknown ; i++, mod++)
-		if (mod->type != mod_alias)
-		{
-			mod->needload = true;
-			TexMgr_FreeTexturesForOwner (mod); //johnfitz
-		}
+	{
+		mod->refcount = 0; // the precache tables are about to be cleared
+
+		if (mod->type == mod_alias)
+			continue;
+		if (mod->type == mod_sprite && !mod->needload && host_keepassets.value)
+			continue; // not on the hunk; Mod_ReleaseUnused decides once the next level has precached
+
+		Mod_FreeSprite (mod);
+		free (mod->fatpvs); // Mod_BuildFatPVS
+		mod->fatpvs = NULL;
+		mod->needload = true;
+		TexMgr_FreeTexturesForOwner (mod); //johnfitz
+	}
+	Mod_FlushPVSCache ();
+	Mod_ClearPrefetch ();
 }
 
 void Mod_ResetAll (void)
@@ -207,61 +572,431 @@ void Mod_ResetAll (void)
 	{
 		if (!mod->needload) //otherwise Mod_ClearAll() did it already
 			TexMgr_FreeTexturesForOwner (mod);
+		Mod_FreeSprite (mod);
+		free (mod->fatpvs);
 		memset(mod, 0, sizeof(qmodel_t));
 	}
 	mod_numknown = 0;
+
+	Mod_FlushPVSCache ();
+	Mod_ClearPrefetch ();
+}
+
+/*
+==================
+Mod_AddRef -- counts a precache table entry holding mod for this level.
+Mod_ClearAll drops every count, since the tables go with the level
+==================
+*/
+void Mod_AddRef (qmodel_t *mod)
+{
+	if (mod)
+		mod->refcount++;
+}
+
+/*
+==================
+Mod_ReleaseUnused
+
+With host_keepassets, alias models and sprites survive Mod_ClearAll.  Once a
+level has precached everything it needs, this frees those of them that no
+precache table took a reference to, along with their textures.
+==================
+*/
+void Mod_ReleaseUnused (void)
+{
+	int		i, released, kept;
+	qmodel_t	*mod;
+
+	if (!host_keepassets.value)
+		return;
+
+	released = kept = 0;
+	for (i=0 , mod=mod_known ; i<mod_numknown ; i++, mod++)
+	{
+		if (mod->needload || (mod->type != mod_alias && mod->type != mod_sprite))
+			continue;
+		if (mod->refcount)
+		{
+			kept++;
+			continue;
+		}
+
+		if (mod->type == mod_alias)
+		{
+			GLMesh_DeleteVertexBuffer (mod);
+			if (mod->cache.data)
+				Cache_Free (&mod->cache, false);
+		}
+		else
+		{
+			Mod_FreeSprite (mod);
+			mod->needload = true;
+		}
+		TexMgr_FreeTexturesForOwner (mod);
+		released++;
+	}
+
+	Con_DPrintf ("%i models kept, %i released\n", kept, released);
+}
+
+/*
+==================
+Mod_FindName
+
+==================
+*/
+qmodel_t *Mod_FindName (const char *name)
+{
+	int		i;
+	qmodel_t	*mod;
+
+	if (!name[0])
+		Sys_Error ("Mod_FindName: NULL name"); //johnfitz -- was "Mod_ForName"
+
+//
+// search the currently loaded models
+//
+	for (i=0 , mod=mod_known ; i<mod_numknown ; i++, mod++)
+		if (!strcmp (mod->name, name) )
+			break;
+
+	if (i == mod_numknown)
+	{
+		if (mod_numknown == MAX_MOD_KNOWN)
+			Sys_Error ("mod_numknown == MAX_MOD_KNOWN");
+		q_strlcpy (mod->name, name, MAX_QPATH);
+		mod->needload = true;
+		mod_numknown++;
+	}
+
+	return mod;
+}
+
+/*
+==================
+Mod_TouchModel
+
+==================
+*/
+void Mod_TouchModel (const char *name)
+{
+	qmodel_t	*mod;
+
+	mod = Mod_FindName (name);
+
+	if (!mod->needload)
+	{
+		if (mod->type == mod_alias)
+			Cache_Check (&mod->cache);
+	}
+}
+
+/*
+===============================================================================
+
+PREFETCH
+
+Reads the files of a whole precache list on the task threads, and builds the
+strips of alias models there, before the models are loaded one at a time on
+the main thread.  The client queues the list the server sent; the server,
+whose spawn functions precache one model at a time, queues the world and
+the models of the level before, most of which come back.
+
+===============================================================================
+*/
+
+typedef struct
+{
+	qmodel_t	*mod;			// NULL once consumed
+	char		*path;			// pak or loose file, on the zone
+	long		offset;
+	int		size;
+	unsigned int	path_id;
+	byte		*buf;			// file contents, malloc'd on the task threads
+	aliasbuild_t	*mesh;			// prebuilt strips for alias models
+} modprefetch_t;
+
+static modprefetch_t	mod_prefetch[MAX_MODELS];
+static int		mod_numprefetch;
+static qboolean		mod_prefetchrun;	// queued reads have been done
+static aliasbuild_t	*mod_prefetchmesh;	// for the alias model being loaded
+
+/*
+=================
+Mod_FindAliasMesh -- steps over an mdl's skins to its st verts, which its
+triangles follow.  returns NULL if the file is too short for what the header
+says.  safe to call from any thread
+=================
+*/
+static const stvert_t *Mod_FindAliasMesh (const byte *buf, int size)
+{
+	const mdl_t	*pinmodel;
+	const byte	*p, *end;
+	int		i, numskins, groupskins, skinsize;
+	int		skinwidth, skinheight, numverts, numtris;
+
+	if (size < (int)sizeof(mdl_t))
+		return NULL;
+
+	pinmodel = (const mdl_t *)buf;
+	end = buf + size;
+
+	numskins = LittleLong (pinmodel->numskins);
+	skinwidth = LittleLong (pinmodel->skinwidth);
+	skinheight = LittleLong (pinmodel->skinheight);
+	numverts = LittleLong (pinmodel->numverts);
+	numtris = LittleLong (pinmodel->numtris);
+
+	if (skinwidth <= 0 || skinheight <= 0 || skinwidth > size / skinheight ||
+		numverts <= 0 || numtris <= 0)
+		return NULL;
+
+	skinsize = skinwidth * skinheight;
+
+	p = (const byte *)(pinmodel + 1);
+	for (i=0 ; i<numskins ; i++)
+	{
+		if (end - p < (int)sizeof(daliasskintype_t))
+			return NULL;
+		if (LittleLong (((const daliasskintype_t *)p)->type) == ALIAS_SKIN_SINGLE)
+		{
+			if (end - p - (int)sizeof(daliasskintype_t) < skinsize)
+				return NULL;
+			p += sizeof(daliasskintype_t) + skinsize;
+		}
+		else
+		{
+			p += sizeof(daliasskintype_t);
+			if (end - p < (int)sizeof(daliasskingroup_t))
+				return NULL;
+			groupskins = LittleLong (((const daliasskingroup_t *)p)->numskins);
+			if (groupskins < 1 || groupskins > (end - p) / (int)(sizeof(daliasskininterval_t) + skinsize))
+				return NULL;
+			p += sizeof(daliasskingroup_t) + groupskins * (sizeof(daliasskininterval_t) + skinsize);
+			if (p > end)
+				return NULL;
+		}
+	}
+
+	if ((end - p) / (int)sizeof(stvert_t) < numverts ||
+		(end - p - numverts * (int)sizeof(stvert_t)) / (int)sizeof(dtriangle_t) < numtris)
+		return NULL;
+
+	return (const stvert_t *)p;
+}
+
+/*
+=================
+Mod_DecodeAliasMesh -- endian-adjusts the st verts found by
+Mod_FindAliasMesh and the triangles that follow them
+=================
+*/
+static void Mod_DecodeAliasMesh (const stvert_t *pinstverts, int numverts, int numtris, stvert_t *verts, mtriangle_t *tris)
+{
+	const dtriangle_t	*pintriangles;
+	int			i, j;
+
+	for (i=0 ; i<numverts ; i++)
+	{
+		verts[i].onseam = LittleLong (pinstverts[i].onseam);
+		verts[i].s = LittleLong (pinstverts[i].s);
+		verts[i].t = LittleLong (pinstverts[i].t);
+	}
+
+	pintriangles = (const dtriangle_t *)&pinstverts[numverts];
+	for (i=0 ; i<numtris ; i++)
+	{
+		tris[i].facesfront = LittleLong (pintriangles[i].facesfront);
+		for (j=0 ; j<3 ; j++)
+			tris[i].vertindex[j] = LittleLong (pintriangles[i].vertindex[j]);
+	}
+}
+
+/*
+=================
+Mod_PrebuildAliasMesh -- builds an mdl's strips ahead of Mod_LoadAliasModel.
+runs on the task threads, so it only returns NULL on anything unexpected and
+leaves the reporting to Mod_LoadAliasModel
+=================
+*/
+static aliasbuild_t *Mod_PrebuildAliasMesh (const byte *buf, int size)
+{
+	const mdl_t		*pinmodel;
+	const stvert_t		*pinstverts;
+	stvert_t		*verts;
+	mtriangle_t		*tris;
+	aliasbuild_t		*build;
+	int			i, j, numskins;
+	int			skinwidth, skinheight, numverts, numtris;
+
+	pinstverts = Mod_FindAliasMesh (buf, size);
+	if (!pinstverts)
+		return NULL;
+
+	pinmodel = (const mdl_t *)buf;
+	numskins = LittleLong (pinmodel->numskins);
+	skinwidth = LittleLong (pinmodel->skinwidth);
+	skinheight = LittleLong (pinmodel->skinheight);
+	numverts = LittleLong (pinmodel->numverts);
+	numtris = LittleLong (pinmodel->numtris);
+
+	if (LittleLong (pinmodel->version) != ALIAS_VERSION || numskins < 1 || numskins > MAX_SKINS ||
+		skinheight > MAX_LBM_HEIGHT || numverts > MAXALIASVERTS || numtris > MAXALIASTRIS)
+		return NULL;
+
+	verts = (stvert_t *) malloc (numverts * sizeof(stvert_t) + numtris * sizeof(mtriangle_t));
+	if (!verts)
+		return NULL;
+	tris = (mtriangle_t *)(verts + numverts);
+
+	Mod_DecodeAliasMesh (pinstverts, numverts, numtris, verts, tris);
+
+	for (i=0 ; i<numtris ; i++)
+	{
+		for (j=0 ; j<3 ; j++)
+		{
+			if (tris[i].vertindex[j] < 0 || tris[i].vertindex[j] >= numverts)
+			{
+				free (verts);
+				return NULL;
+			}
+		}
+	}
+
+	build = GLMesh_BuildMesh (tris, numtris, verts, numverts, skinwidth, skinheight);
+	free (verts);
+	return build;
+}
+
+/*
+=================
+Mod_PrefetchTask
+=================
+*/
+static void Mod_PrefetchTask (void *data, int index)
+{
+	modprefetch_t	*p = (modprefetch_t *)data + index;
+	byte		*buf;
+
+	buf = p->buf = COM_ReadFileAt (p->path, p->offset, p->size);
+	if (buf && p->size >= 4 && (buf[0] | (buf[1] << 8) | (buf[2] << 16) | (buf[3] << 24)) == IDPOLYHEADER)
+		p->mesh = Mod_PrebuildAliasMesh (buf, p->size);
+}
+
+/*
+=================
+Mod_FreePrefetch
+=================
+*/
+static void Mod_FreePrefetch (modprefetch_t *p)
+{
+	free (p->buf);
+	free (p->mesh);
+	Z_Free (p->path);
+	p->buf = NULL;
+	p->mesh = NULL;
+	p->path = NULL;
+	p->mod = NULL;
+}
+
+/*
+=================
+Mod_FindPrefetch -- the read file for mod, if one is waiting
+=================
+*/
+static modprefetch_t *Mod_FindPrefetch (qmodel_t *mod)
+{
+	int	i;
+
+	if (!mod_prefetchrun)
+		return NULL;
+
+	for (i=0 ; i<mod_numprefetch ; i++)
+		if (mod_prefetch[i].mod == mod && mod_prefetch[i].buf)
+			return &mod_prefetch[i];
+
+	return NULL;
 }
 
 /*
-==================
-Mod_FindName
-
-==================
+=================
+Mod_Prefetch -- queues a model file to be read by Mod_RunPrefetch.  models
+that are already loaded or that can't be found are left to Mod_ForName
+=================
 */
-qmodel_t *Mod_FindName (const char *name)
+void Mod_Prefetch (const char *name)
 {
-	int		i;
+	char		path[MAX_OSPATH];
+	modprefetch_t	*p;
 	qmodel_t	*mod;
+	int		i;
 
-	if (!name[0])
-		Sys_Error ("Mod_FindName: NULL name"); //johnfitz -- was "Mod_ForName"
+	if (Tasks_NumThreads () < 2 || mod_prefetchrun || mod_numprefetch == MAX_MODELS)
+		return;
 
-//
-// search the currently loaded models
-//
-	for (i=0 , mod=mod_known ; i<mod_numknown ; i++, mod++)
-		if (!strcmp (mod->name, name) )
-			break;
+	if (name[0] == '*')
+		return;		// submodels come with the world
 
-	if (i == mod_numknown)
-	{
-		if (mod_numknown == MAX_MOD_KNOWN)
-			Sys_Error ("mod_numknown == MAX_MOD_KNOWN");
-		q_strlcpy (mod->name, name, MAX_QPATH);
-		mod->needload = true;
-		mod_numknown++;
-	}
+	mod = Mod_FindName (name);
+	if (!mod->needload && (mod->type != mod_alias || Cache_Check (&mod->cache)))
+		return;
 
-	return mod;
+	for (i=0 ; i<mod_numprefetch ; i++)
+		if (mod_prefetch[i].mod == mod)
+			return;
+
+	p = &mod_prefetch[mod_numprefetch];
+	p->size = COM_LocateFile (name, path, sizeof(path), &p->offset, &p->path_id);
+	if (p->size < 0)
+		return;
+
+	p->mod = mod;
+	p->path = Z_Strdup (path);
+	p->buf = NULL;
+	p->mesh = NULL;
+	mod_numprefetch++;
 }
 
 /*
-==================
-Mod_TouchModel
+=================
+Mod_RunPrefetch -- reads every queued file, and meshes the alias models, on
+the task threads
+=================
+*/
+void Mod_RunPrefetch (void)
+{
+	double	time;
+	int	i, bytes;
 
-==================
+	if (mod_prefetchrun || !mod_numprefetch)
+		return;
+
+	time = Sys_DoubleTime ();
+	Tasks_ParallelFor (mod_numprefetch, 0, Mod_PrefetchTask, mod_prefetch);
+	mod_prefetchrun = true;
+
+	for (i=0, bytes=0 ; i<mod_numprefetch ; i++)
+		if (mod_prefetch[i].buf)
+			bytes += mod_prefetch[i].size;
+	Con_DPrintf ("prefetched %i models (%i KB) in %.1f ms\n", mod_numprefetch, bytes >> 10, (Sys_DoubleTime () - time) * 1000.0);
+}
+
+/*
+=================
+Mod_ClearPrefetch -- drops whatever Mod_ForName didn't pick up
+=================
 */
-void Mod_TouchModel (const char *name)
+void Mod_ClearPrefetch (void)
 {
-	qmodel_t	*mod;
+	int	i;
 
-	mod = Mod_FindName (name);
+	for (i=0 ; i<mod_numprefetch ; i++)
+		if (mod_prefetch[i].path)
+			Mod_FreePrefetch (&mod_prefetch[i]);
 
-	if (!mod->needload)
-	{
-		if (mod->type == mod_alias)
-			Cache_Check (&mod->cache);
-	}
+	mod_numprefetch = 0;
+	mod_prefetchrun = false;
 }
 
 /*
@@ -276,6 +1011,7 @@ qmodel_t *Mod_LoadModel (qmodel_t *mod, qboolean crash)
 	byte	*buf;
 	byte	stackbuf[1024];		// avoid dirtying the cache heap
 	int	mod_type;
+	modprefetch_t	*prefetch;
 
 	if (!mod->needload)
 	{
@@ -299,7 +1035,15 @@ qmodel_t *Mod_LoadModel (qmodel_t *mod, qboolean crash)
 //
 // load the file
 //
-	buf = COM_LoadStackFile (mod->name, stackbuf, sizeof(stackbuf), & mod->path_id);
+	prefetch = Mod_FindPrefetch (mod);
+	if (prefetch)
+	{
+		buf = prefetch->buf;
+		com_filesize = prefetch->size;
+		mod->path_id = prefetch->path_id;
+	}
+	else
+		buf = COM_LoadStackFile (mod->name, stackbuf, sizeof(stackbuf), & mod->path_id);
 	if (!buf)
 	{
 		if (crash)
@@ -321,11 +1065,16 @@ qmodel_t *Mod_LoadModel (qmodel_t *mod, qboolean crash)
 // call the apropriate loader
 	mod->needload = false;
 
+	// convert all of the model's textures at once, on the task threads
+	TexMgr_BeginBatch ();
+
 	mod_type = (buf[0] | (buf[1] << 8) | (buf[2] << 16) | (buf[3] << 24));
 	switch (mod_type)
 	{
 	case IDPOLYHEADER:
+		mod_prefetchmesh = prefetch ? prefetch->mesh : NULL;
 		Mod_LoadAliasModel (mod, buf);
+		mod_prefetchmesh = NULL;
 		break;
 
 	case IDSPRITEHEADER:
@@ -337,6 +1086,11 @@ qmodel_t *Mod_LoadModel (qmodel_t *mod, qboolean crash)
 		break;
 	}
 
+	TexMgr_EndBatch ();
+
+	if (prefetch)
+		Mod_FreePrefetch (prefetch);
+
 	return mod;
 }
 
@@ -366,6 +1120,41 @@ qmodel_t *Mod_ForName (const char *name, qboolean crash)
 */
 
 byte	*mod_base;
+static dheader_t	*mod_header;
+static int		mod_bsp2;		// 0 for bsp29, 1 for 2psb, 2 for bsp2
+static qboolean		mod_cachedfaces;	// surfaces come from the bsp cache
+
+#define	MODERR_PRINT	1	// Con_Printf and carry on
+#define	MODERR_HOST	2	// Host_Error
+#define	MODERR_SYS	3	// Sys_Error
+
+typedef struct
+{
+	int		stage;
+	int		first, count;	// items of the stage this job converts
+	int		found;		// whatever the stage counts, summed up for its end function
+	int		errortype;	// MODERR_*, reported from the main thread
+	char		error[128];
+	double		time;
+} modjob_t;
+
+/*
+=================
+Mod_JobError -- keeps the first problem a job runs into, or the first fatal one after a warning
+=================
+*/
+static void Mod_JobError (modjob_t *job, int type, const char *fmt, ...)
+{
+	va_list		argptr;
+
+	if (job->errortype >= type || job->errortype > MODERR_PRINT)
+		return;
+
+	va_start (argptr, fmt);
+	q_vsnprintf (job->error, sizeof(job->error), fmt, argptr);
+	va_end (argptr);
+	job->errortype = type;
+}
 
 /*
 =================
@@ -799,27 +1588,38 @@ _load_embedded:
 }
 
 
+/*
+=================
+Mod_AllocVertexes
+=================
+*/
+static int Mod_AllocVertexes (void)
+{
+	lump_t	*l = &mod_header->lumps[LUMP_VERTEXES];
+
+	if (l->filelen % sizeof(dvertex_t))
+		Sys_Error ("MOD_LoadBmodel: funny lump size in %s",loadmodel->name);
+	loadmodel->numvertexes = l->filelen / sizeof(dvertex_t);
+	loadmodel->vertexes = (mvertex_t *) Hunk_AllocName ( loadmodel->numvertexes*sizeof(mvertex_t), loadname);
+
+	return loadmodel->numvertexes;
+}
+
 /*
 =================
 Mod_LoadVertexes
 =================
 */
-void Mod_LoadVertexes (lump_t *l)
+static void Mod_LoadVertexes (modjob_t *job)
 {
 	dvertex_t	*in;
 	mvertex_t	*out;
-	int			i, count;
-
-	in = (dvertex_t *)(mod_base + l->fileofs);
-	if (l->filelen % sizeof(*in))
-		Sys_Error ("MOD_LoadBmodel: funny lump size in %s",loadmodel->name);
-	count = l->filelen / sizeof(*in);
-	out = (mvertex_t *) Hunk_AllocName ( count*sizeof(*out), loadname);
+	int			i;
 
-	loadmodel->vertexes = out;
-	loadmodel->numvertexes = count;
+	in = (dvertex_t *)(mod_base + mod_header->lumps[LUMP_VERTEXES].fileofs) + job->first;
+	out = loadmodel->vertexes + job->first;
 
-	for (i=0 ; i<count ; i++, in++, out++)
+	for (i=0 ; i<job->count ; i++, in++, out++)
 	{
 		out->position[0] = LittleFloat (in->point[0]);
 		out->position[1] = LittleFloat (in->point[1]);
@@ -829,28 +1629,39 @@ void Mod_LoadVertexes (lump_t *l)
 
 /*
 =================
-Mod_LoadEdges
+Mod_AllocEdges
 =================
 */
-void Mod_LoadEdges (lump_t *l, int bsp2)
+static int Mod_AllocEdges (void)
 {
-	medge_t *out;
-	int 	i, count;
+	lump_t	*l = &mod_header->lumps[LUMP_EDGES];
+	int		size = mod_bsp2 ? sizeof(dledge_t) : sizeof(dsedge_t);
 
-	if (bsp2)
-	{
-		dledge_t *in = (dledge_t *)(mod_base + l->fileofs);
+	if (l->filelen % size)
+		Sys_Error ("MOD_LoadBmodel: funny lump size in %s",loadmodel->name);
+	loadmodel->numedges = l->filelen / size;
+	loadmodel->edges = (medge_t *) Hunk_AllocName ( (loadmodel->numedges + 1) * sizeof(medge_t), loadname);
+
+	return loadmodel->numedges;
+}
 
-		if (l->filelen % sizeof(*in))
-			Sys_Error ("MOD_LoadBmodel: funny lump size in %s",loadmodel->name);
+/*
+=================
+Mod_LoadEdges
+=================
+*/
+static void Mod_LoadEdges (modjob_t *job)
+{
+	medge_t *out;
+	int 	i;
 
-		count = l->filelen / sizeof(*in);
-		out = (medge_t *) Hunk_AllocName ( (count + 1) * sizeof(*out), loadname);
+	out = loadmodel->edges + job->first;
 
-		loadmodel->edges = out;
-		loadmodel->numedges = count;
+	if (mod_bsp2)
+	{
+		dledge_t *in = (dledge_t *)(mod_base + mod_header->lumps[LUMP_EDGES].fileofs) + job->first;
 
-		for (i=0 ; i<count ; i++, in++, out++)
+		for (i=0 ; i<job->count ; i++, in++, out++)
 		{
 			out->v[0] = LittleLong(in->v[0]);
 			out->v[1] = LittleLong(in->v[1]);
@@ -858,18 +1669,9 @@ void Mod_LoadEdges (lump_t *l, int bsp2)
 	}
 	else
 	{
-		dsedge_t *in = (dsedge_t *)(mod_base + l->fileofs);
+		dsedge_t *in = (dsedge_t *)(mod_base + mod_header->lumps[LUMP_EDGES].fileofs) + job->first;
 
-		if (l->filelen % sizeof(*in))
-			Sys_Error ("MOD_LoadBmodel: funny lump size in %s",loadmodel->name);
-
-		count = l->filelen / sizeof(*in);
-		out = (medge_t *) Hunk_AllocName ( (count + 1) * sizeof(*out), loadname);
-
-		loadmodel->edges = out;
-		loadmodel->numedges = count;
-
-		for (i=0 ; i<count ; i++, in++, out++)
+		for (i=0 ; i<job->count ; i++, in++, out++)
 		{
 			out->v[0] = (unsigned short)LittleShort(in->v[0]);
 			out->v[1] = (unsigned short)LittleShort(in->v[1]);
@@ -877,29 +1679,39 @@ void Mod_LoadEdges (lump_t *l, int bsp2)
 	}
 }
 
+/*
+=================
+Mod_AllocTexinfo
+=================
+*/
+static int Mod_AllocTexinfo (void)
+{
+	lump_t	*l = &mod_header->lumps[LUMP_TEXINFO];
+
+	if (l->filelen % sizeof(texinfo_t))
+		Sys_Error ("MOD_LoadBmodel: funny lump size in %s",loadmodel->name);
+	loadmodel->numtexinfo = l->filelen / sizeof(texinfo_t);
+	loadmodel->texinfo = (mtexinfo_t *) Hunk_AllocName ( loadmodel->numtexinfo*sizeof(mtexinfo_t), loadname);
+
+	return loadmodel->numtexinfo;
+}
+
 /*
 =================
 Mod_LoadTexinfo
 =================
 */
-void Mod_LoadTexinfo (lump_t *l)
+static void Mod_LoadTexinfo (modjob_t *job)
 {
 	texinfo_t *in;
 	mtexinfo_t *out;
-	int	i, j, count, miptex;
+	int	i, j, miptex;
 	float	len1, len2;
-	int missing = 0; //johnfitz
-
-	in = (texinfo_t *)(mod_base + l->fileofs);
-	if (l->filelen % sizeof(*in))
-		Sys_Error ("MOD_LoadBmodel: funny lump size in %s",loadmodel->name);
-	count = l->filelen / sizeof(*in);
-	out = (mtexinfo_t *) Hunk_AllocName ( count*sizeof(*out), loadname);
 
-	loadmodel->texinfo = out;
-	loadmodel->numtexinfo = count;
+	in = (texinfo_t *)(mod_base + mod_header->lumps[LUMP_TEXINFO].fileofs) + job->first;
+	out = loadmodel->texinfo + job->first;
 
-	for (i=0 ; i<count ; i++, in++, out++)
+	for (i=0 ; i<job->count ; i++, in++, out++)
 	{
 		for (j=0 ; j<4 ; j++)
 		{
@@ -935,7 +1747,7 @@ void Mod_LoadTexinfo (lump_t *l)
 			else
 				out->texture = loadmodel->textures[loadmodel->numtextures-2];
 			out->flags |= TEX_MISSING;
-			missing++;
+			job->found++;
 		}
 		else
 		{
@@ -943,7 +1755,15 @@ void Mod_LoadTexinfo (lump_t *l)
 		}
 		//johnfitz
 	}
+}
 
+/*
+=================
+Mod_EndTexinfo
+=================
+*/
+static void Mod_EndTexinfo (int missing)
+{
 	//johnfitz: report missing textures
 	if (missing && loadmodel->numtextures > 1)
 		Con_Printf ("Mod_LoadTexinfo: %d texture(s) missing from BSP file\n", missing);
@@ -954,10 +1774,10 @@ void Mod_LoadTexinfo (lump_t *l)
 ================
 CalcSurfaceExtents
 
-Fills in s->texturemins[] and s->extents[]
+Fills in s->texturemins[] and s->extents[], false if they're too big
 ================
 */
-void CalcSurfaceExtents (msurface_t *s)
+static qboolean CalcSurfaceExtents (msurface_t *s)
 {
 	float	mins[2], maxs[2], val;
 	int		i,j, e;
@@ -1016,8 +1836,10 @@ void CalcSurfaceExtents (msurface_t *s)
 		s->extents[i] = (bmaxs[i] - bmins[i]) * 16;
 
 		if ( !(tex->flags & TEX_SPECIAL) && s->extents[i] > 2000) //johnfitz -- was 512 in glquake, 256 in winquake
-			Sys_Error ("Bad surface extents");
+			return false; //bad surface extents
 	}
+
+	return true;
 }
 
 /*
@@ -1104,48 +1926,61 @@ void Mod_CalcSurfaceBounds (msurface_t *s)
 	}
 }
 
+/*
+=================
+Mod_AllocFaces
+=================
+*/
+static int Mod_AllocFaces (void)
+{
+	lump_t	*l = &mod_header->lumps[LUMP_FACES];
+	int		size = mod_bsp2 ? sizeof(dlface_t) : sizeof(dsface_t);
+	int		count;
+
+	if (l->filelen % size)
+		Sys_Error ("MOD_LoadBmodel: funny lump size in %s",loadmodel->name);
+	count = l->filelen / size;
+	loadmodel->surfaces = (msurface_t *)Hunk_AllocName ( count*sizeof(msurface_t), loadname);
+	loadmodel->numsurfaces = count;
+
+	//johnfitz -- warn mappers about exceeding old limits
+	if (count > 32767 && !mod_bsp2)
+		Con_DWarning ("%i faces exceeds standard limit of 32767.\n", count);
+	//johnfitz
+
+	mod_cachedfaces = BSPCache_Surfaces (count);
+
+	return count;
+}
+
 /*
 =================
 Mod_LoadFaces
 =================
 */
-void Mod_LoadFaces (lump_t *l, qboolean bsp2)
+static void Mod_LoadFaces (modjob_t *job)
 {
 	dsface_t	*ins;
 	dlface_t	*inl;
 	msurface_t 	*out;
-	int			i, count, surfnum, lofs;
+	int			i, surfnum, lofs;
 	int			planenum, side, texinfon;
 
-	if (bsp2)
+	if (mod_bsp2)
 	{
 		ins = NULL;
-		inl = (dlface_t *)(mod_base + l->fileofs);
-		if (l->filelen % sizeof(*inl))
-			Sys_Error ("MOD_LoadBmodel: funny lump size in %s",loadmodel->name);
-		count = l->filelen / sizeof(*inl);
+		inl = (dlface_t *)(mod_base + mod_header->lumps[LUMP_FACES].fileofs) + job->first;
 	}
 	else
 	{
-		ins = (dsface_t *)(mod_base + l->fileofs);
+		ins = (dsface_t *)(mod_base + mod_header->lumps[LUMP_FACES].fileofs) + job->first;
 		inl = NULL;
-		if (l->filelen % sizeof(*ins))
-			Sys_Error ("MOD_LoadBmodel: funny lump size in %s",loadmodel->name);
-		count = l->filelen / sizeof(*ins);
 	}
-	out = (msurface_t *)Hunk_AllocName ( count*sizeof(*out), loadname);
-
-	//johnfitz -- warn mappers about exceeding old limits
-	if (count > 32767 && !bsp2)
-		Con_DWarning ("%i faces exceeds standard limit of 32767.\n", count);
-	//johnfitz
-
-	loadmodel->surfaces = out;
-	loadmodel->numsurfaces = count;
+	out = loadmodel->surfaces + job->first;
 
-	for (surfnum=0 ; surfnum<count ; surfnum++, out++)
+	for (surfnum=0 ; surfnum<job->count ; surfnum++, out++)
 	{
-		if (bsp2)
+		if (mod_bsp2)
 		{
 			out->firstedge = LittleLong(inl->firstedge);
 			out->numedges = LittleLong(inl->numedges);
@@ -1179,21 +2014,27 @@ void Mod_LoadFaces (lump_t *l, qboolean bsp2)
 
 		out->texinfo = loadmodel->texinfo + texinfon;
 
-		CalcSurfaceExtents (out);
-
-		Mod_CalcSurfaceBounds (out); //johnfitz -- for per-surface frustum culling
-
 	// lighting info
 		if (lofs == -1)
 			out->samples = NULL;
 		else
 			out->samples = loadmodel->lightdata + (lofs * 3); //johnfitz -- lit support via lordhavoc (was "+ i")
 
+		if (mod_cachedfaces)
+			continue; //extents, bounds, flags and polys are filled in by Mod_BuildFacePolys
+
+		if (!CalcSurfaceExtents (out))
+		{
+			Mod_JobError (job, MODERR_SYS, "Bad surface extents");
+			return;
+		}
+
+		Mod_CalcSurfaceBounds (out); //johnfitz -- for per-surface frustum culling
+
 		//johnfitz -- this section rewritten
 		if (!q_strncasecmp(out->texinfo->texture->name,"sky",3)) // sky surface //also note -- was Q_strncmp, changed to match qbsp
 		{
 			out->flags |= (SURF_DRAWSKY | SURF_DRAWTILED);
-			Mod_PolyForUnlitSurface (out); //no more subdivision
 		}
 		else if (out->texinfo->texture->name[0] == '*') // warp surface
 		{
@@ -1207,9 +2048,6 @@ void Mod_LoadFaces (lump_t *l, qboolean bsp2)
 			else if (!strncmp (out->texinfo->texture->name, "*tele", 5))
 				out->flags |= SURF_DRAWTELE;
 			else out->flags |= SURF_DRAWWATER;
-
-			Mod_PolyForUnlitSurface (out);
-			GL_SubdivideSurface (out);
 		}
 		else if (out->texinfo->texture->name[0] == '{') // ericw -- fence textures
 		{
@@ -1224,13 +2062,37 @@ void Mod_LoadFaces (lump_t *l, qboolean bsp2)
 			else // not lightmapped
 			{
 				out->flags |= (SURF_NOTEXTURE | SURF_DRAWTILED);
-				Mod_PolyForUnlitSurface (out);
 			}
 		}
 		//johnfitz
 	}
 }
 
+/*
+=================
+Mod_BuildFacePolys -- polys go on the hunk, so they're made one surface after another on the main thread
+=================
+*/
+static int Mod_BuildFacePolys (void)
+{
+	msurface_t	*s;
+	int			i;
+
+	for (i=0, s=loadmodel->surfaces ; i<loadmodel->numsurfaces ; i++, s++)
+	{
+		if (mod_cachedfaces)
+			BSPCache_LoadSurface (s, i);
+		else if (s->flags & SURF_DRAWTILED) //johnfitz -- sky, water and unlit missing textures
+		{
+			Mod_PolyForUnlitSurface (s); //no more subdivision for sky
+			if (s->flags & SURF_DRAWTURB)
+				GL_SubdivideSurface (s);
+		}
+	}
+
+	return 0;
+}
+
 
 /*
 =================
@@ -1248,30 +2110,51 @@ void Mod_SetParent (mnode_t *node, mnode_t *parent)
 
 /*
 =================
-Mod_LoadNodes
+Mod_AllocNodes
 =================
 */
-void Mod_LoadNodes_S (lump_t *l)
+static int Mod_AllocNodes (void)
 {
-	int			i, j, count, p;
-	dsnode_t	*in;
-	mnode_t		*out;
+	lump_t	*l = &mod_header->lumps[LUMP_NODES];
+	int		size, count;
 
-	in = (dsnode_t *)(mod_base + l->fileofs);
-	if (l->filelen % sizeof(*in))
-		Sys_Error ("MOD_LoadBmodel: funny lump size in %s",loadmodel->name);
-	count = l->filelen / sizeof(*in);
-	out = (mnode_t *) Hunk_AllocName ( count*sizeof(*out), loadname);
+	if (mod_bsp2 == 2)
+		size = sizeof(dl2node_t);
+	else if (mod_bsp2)
+		size = sizeof(dl1node_t);
+	else
+		size = sizeof(dsnode_t);
+
+	if (l->filelen % size)
+		Sys_Error ("%s: funny lump size in %s", mod_bsp2 ? "Mod_LoadNodes" : "MOD_LoadBmodel", loadmodel->name);
+	count = l->filelen / size;
+	loadmodel->nodes = (mnode_t *) Hunk_AllocName ( count*sizeof(mnode_t), loadname);
+	loadmodel->numnodes = count;
 
 	//johnfitz -- warn mappers about exceeding old limits
-	if (count > 32767)
+	if (count > 32767 && !mod_bsp2)
 		Con_DWarning ("%i nodes exceeds standard limit of 32767.\n", count);
 	//johnfitz
 
-	loadmodel->nodes = out;
-	loadmodel->numnodes = count;
+	return count;
+}
 
-	for (i=0 ; i<count ; i++, in++, out++)
+/*
+=================
+Mod_LoadNodes
+=================
+*/
+static void Mod_LoadNodes_S (modjob_t *job)
+{
+	int			i, j, count, p;
+	dsnode_t	*in;
+	mnode_t		*out;
+
+	in = (dsnode_t *)(mod_base + mod_header->lumps[LUMP_NODES].fileofs) + job->first;
+	out = loadmodel->nodes + job->first;
+	count = loadmodel->numnodes;
+
+	for (i=0 ; i<job->count ; i++, in++, out++)
 	{
 		for (j=0 ; j<3 ; j++)
 		{
@@ -1298,7 +2181,7 @@ void Mod_LoadNodes_S (lump_t *l)
 					out->children[j] = (mnode_t *)(loadmodel->leafs + p);
 				else
 				{
-					Con_Printf("Mod_LoadNodes: invalid leaf index %i (file has only %i leafs)\n", p, loadmodel->numleafs);
+					Mod_JobError (job, MODERR_PRINT, "Mod_LoadNodes: invalid leaf index %i (file has only %i leafs)\n", p, loadmodel->numleafs);
 					out->children[j] = (mnode_t *)(loadmodel->leafs); //map it to the solid leaf
 				}
 			}
@@ -1307,23 +2190,17 @@ void Mod_LoadNodes_S (lump_t *l)
 	}
 }
 
-void Mod_LoadNodes_L1 (lump_t *l)
+static void Mod_LoadNodes_L1 (modjob_t *job)
 {
 	int			i, j, count, p;
 	dl1node_t	*in;
 	mnode_t		*out;
 
-	in = (dl1node_t *)(mod_base + l->fileofs);
-	if (l->filelen % sizeof(*in))
-		Sys_Error ("Mod_LoadNodes: funny lump size in %s",loadmodel->name);
-
-	count = l->filelen / sizeof(*in);
-	out = (mnode_t *)Hunk_AllocName ( count*sizeof(*out), loadname);
-
-	loadmodel->nodes = out;
-	loadmodel->numnodes = count;
+	in = (dl1node_t *)(mod_base + mod_header->lumps[LUMP_NODES].fileofs) + job->first;
+	out = loadmodel->nodes + job->first;
+	count = loadmodel->numnodes;
 
-	for (i=0 ; i<count ; i++, in++, out++)
+	for (i=0 ; i<job->count ; i++, in++, out++)
 	{
 		for (j=0 ; j<3 ; j++)
 		{
@@ -1350,7 +2227,7 @@ void Mod_LoadNodes_L1 (lump_t *l)
 					out->children[j] = (mnode_t *)(loadmodel->leafs + p);
 				else
 				{
-					Con_Printf("Mod_LoadNodes: invalid leaf index %i (file has only %i leafs)\n", p, loadmodel->numleafs);
+					Mod_JobError (job, MODERR_PRINT, "Mod_LoadNodes: invalid leaf index %i (file has only %i leafs)\n", p, loadmodel->numleafs);
 					out->children[j] = (mnode_t *)(loadmodel->leafs); //map it to the solid leaf
 				}
 			}
@@ -1359,23 +2236,17 @@ void Mod_LoadNodes_L1 (lump_t *l)
 	}
 }
 
-void Mod_LoadNodes_L2 (lump_t *l)
+static void Mod_LoadNodes_L2 (modjob_t *job)
 {
 	int			i, j, count, p;
 	dl2node_t	*in;
 	mnode_t		*out;
 
-	in = (dl2node_t *)(mod_base + l->fileofs);
-	if (l->filelen % sizeof(*in))
-		Sys_Error ("Mod_LoadNodes: funny lump size in %s",loadmodel->name);
-
-	count = l->filelen / sizeof(*in);
-	out = (mnode_t *)Hunk_AllocName ( count*sizeof(*out), loadname);
-
-	loadmodel->nodes = out;
-	loadmodel->numnodes = count;
+	in = (dl2node_t *)(mod_base + mod_header->lumps[LUMP_NODES].fileofs) + job->first;
+	out = loadmodel->nodes + job->first;
+	count = loadmodel->numnodes;
 
-	for (i=0 ; i<count ; i++, in++, out++)
+	for (i=0 ; i<job->count ; i++, in++, out++)
 	{
 		for (j=0 ; j<3 ; j++)
 		{
@@ -1402,7 +2273,7 @@ void Mod_LoadNodes_L2 (lump_t *l)
 					out->children[j] = (mnode_t *)(loadmodel->leafs + p);
 				else
 				{
-					Con_Printf("Mod_LoadNodes: invalid leaf index %i (file has only %i leafs)\n", p, loadmodel->numleafs);
+					Mod_JobError (job, MODERR_PRINT, "Mod_LoadNodes: invalid leaf index %i (file has only %i leafs)\n", p, loadmodel->numleafs);
 					out->children[j] = (mnode_t *)(loadmodel->leafs); //map it to the solid leaf
 				}
 			}
@@ -1411,37 +2282,70 @@ void Mod_LoadNodes_L2 (lump_t *l)
 	}
 }
 
-void Mod_LoadNodes (lump_t *l, int bsp2)
+static void Mod_LoadNodes (modjob_t *job)
 {
-	if (bsp2 == 2)
-		Mod_LoadNodes_L2(l);
-	else if (bsp2)
-		Mod_LoadNodes_L1(l);
+	if (mod_bsp2 == 2)
+		Mod_LoadNodes_L2 (job);
+	else if (mod_bsp2)
+		Mod_LoadNodes_L1 (job);
 	else
-		Mod_LoadNodes_S(l);
+		Mod_LoadNodes_S (job);
+}
 
+/*
+=================
+Mod_EndNodes -- the parent links follow the tree, so they are set once every node is in
+=================
+*/
+static void Mod_EndNodes (int unused)
+{
 	Mod_SetParent (loadmodel->nodes, NULL);	// sets nodes and leafs
 }
 
-void Mod_ProcessLeafs_S (dsleaf_t *in, int filelen)
+/*
+=================
+Mod_AllocLeafs
+=================
+*/
+static int Mod_AllocLeafs (void)
 {
-	mleaf_t		*out;
-	int			i, j, count, p;
+	lump_t	*l = &mod_header->lumps[LUMP_LEAFS];
+	int		size, count;
+
+	if (mod_bsp2 == 2)
+		size = sizeof(dl2leaf_t);
+	else if (mod_bsp2)
+		size = sizeof(dl1leaf_t);
+	else
+		size = sizeof(dsleaf_t);
 
-	if (filelen % sizeof(*in))
+	if (l->filelen % size)
 		Sys_Error ("Mod_ProcessLeafs: funny lump size in %s", loadmodel->name);
-	count = filelen / sizeof(*in);
-	out = (mleaf_t *) Hunk_AllocName ( count*sizeof(*out), loadname);
+	count = l->filelen / size;
+	loadmodel->leafs = (mleaf_t *) Hunk_AllocName ( count*sizeof(mleaf_t), loadname);
 
 	//johnfitz
-	if (count > 32767)
+	if (!mod_bsp2 && count > 32767)
 		Host_Error ("Mod_LoadLeafs: %i leafs exceeds limit of 32767.\n", count);
 	//johnfitz
+	if (count > MAX_MAP_LEAFS)
+		Host_Error ("Mod_LoadLeafs: %i leafs exceeds limit of %i.\n", count, MAX_MAP_LEAFS);
 
-	loadmodel->leafs = out;
 	loadmodel->numleafs = count;
 
-	for (i=0 ; i<count ; i++, in++, out++)
+	return count;
+}
+
+static void Mod_ProcessLeafs_S (modjob_t *job)
+{
+	dsleaf_t	*in;
+	mleaf_t		*out;
+	int			i, j, p;
+
+	in = (dsleaf_t *)(mod_base + mod_header->lumps[LUMP_LEAFS].fileofs) + job->first;
+	out = loadmodel->leafs + job->first;
+
+	for (i=0 ; i<job->count ; i++, in++, out++)
 	{
 		for (j=0 ; j<3 ; j++)
 		{
@@ -1460,7 +2364,8 @@ void Mod_ProcessLeafs_S (dsleaf_t *in, int filelen)
 			out->compressed_vis = NULL;
 		else
 			out->compressed_vis = loadmodel->visdata + p;
-		out->efrags = NULL;
+		out->statics = NULL;
+		out->numstatics = 0;
 
 		for (j=0 ; j<4 ; j++)
 			out->ambient_sound_level[j] = in->ambient_level[j];
@@ -1469,26 +2374,16 @@ void Mod_ProcessLeafs_S (dsleaf_t *in, int filelen)
 	}
 }
 
-void Mod_ProcessLeafs_L1 (dl1leaf_t *in, int filelen)
+static void Mod_ProcessLeafs_L1 (modjob_t *job)
 {
+	dl1leaf_t	*in;
 	mleaf_t		*out;
-	int			i, j, count, p;
-
-	if (filelen % sizeof(*in))
-		Sys_Error ("Mod_ProcessLeafs: funny lump size in %s", loadmodel->name);
-
-	count = filelen / sizeof(*in);
-
-	out = (mleaf_t *) Hunk_AllocName (count * sizeof(*out), loadname);
-
+	int			i, j, p;
 
-	if (count > MAX_MAP_LEAFS)
-		Host_Error ("Mod_LoadLeafs: %i leafs exceeds limit of %i.\n", count, MAX_MAP_LEAFS);
-
-	loadmodel->leafs = out;
-	loadmodel->numleafs = count;
+	in = (dl1leaf_t *)(mod_base + mod_header->lumps[LUMP_LEAFS].fileofs) + job->first;
+	out = loadmodel->leafs + job->first;
 
-	for (i=0 ; i<count ; i++, in++, out++)
+	for (i=0 ; i<job->count ; i++, in++, out++)
 	{
 		for (j=0 ; j<3 ; j++)
 		{
@@ -1507,7 +2402,8 @@ void Mod_ProcessLeafs_L1 (dl1leaf_t *in, int filelen)
 			out->compressed_vis = NULL;
 		else
 			out->compressed_vis = loadmodel->visdata + p;
-		out->efrags = NULL;
+		out->statics = NULL;
+		out->numstatics = 0;
 
 		for (j=0 ; j<4 ; j++)
 			out->ambient_sound_level[j] = in->ambient_level[j];
@@ -1516,26 +2412,16 @@ void Mod_ProcessLeafs_L1 (dl1leaf_t *in, int filelen)
 	}
 }
 
-void Mod_ProcessLeafs_L2 (dl2leaf_t *in, int filelen)
+static void Mod_ProcessLeafs_L2 (modjob_t *job)
 {
+	dl2leaf_t	*in;
 	mleaf_t		*out;
-	int			i, j, count, p;
-
-	if (filelen % sizeof(*in))
-		Sys_Error ("Mod_ProcessLeafs: funny lump size in %s", loadmodel->name);
-
-	count = filelen / sizeof(*in);
-
-	out = (mleaf_t *) Hunk_AllocName (count * sizeof(*out), loadname);
-
-
-	if (count > MAX_MAP_LEAFS)
-		Host_Error ("Mod_LoadLeafs: %i leafs exceeds limit of %i.\n", count, MAX_MAP_LEAFS);
+	int			i, j, p;
 
-	loadmodel->leafs = out;
-	loadmodel->numleafs = count;
+	in = (dl2leaf_t *)(mod_base + mod_header->lumps[LUMP_LEAFS].fileofs) + job->first;
+	out = loadmodel->leafs + job->first;
 
-	for (i=0 ; i<count ; i++, in++, out++)
+	for (i=0 ; i<job->count ; i++, in++, out++)
 	{
 		for (j=0 ; j<3 ; j++)
 		{
@@ -1554,7 +2440,8 @@ void Mod_ProcessLeafs_L2 (dl2leaf_t *in, int filelen)
 			out->compressed_vis = NULL;
 		else
 			out->compressed_vis = loadmodel->visdata + p;
-		out->efrags = NULL;
+		out->statics = NULL;
+		out->numstatics = 0;
 
 		for (j=0 ; j<4 ; j++)
 			out->ambient_sound_level[j] = in->ambient_level[j];
@@ -1568,54 +2455,36 @@ void Mod_ProcessLeafs_L2 (dl2leaf_t *in, int filelen)
 Mod_LoadLeafs
 =================
 */
-void Mod_LoadLeafs (lump_t *l, int bsp2)
+static void Mod_LoadLeafs (modjob_t *job)
 {
-	void *in = (void *)(mod_base + l->fileofs);
-
-	if (bsp2 == 2)
-		Mod_ProcessLeafs_L2 ((dl2leaf_t *)in, l->filelen);
-	else if (bsp2)
-		Mod_ProcessLeafs_L1 ((dl1leaf_t *)in, l->filelen);
+	if (mod_bsp2 == 2)
+		Mod_ProcessLeafs_L2 (job);
+	else if (mod_bsp2)
+		Mod_ProcessLeafs_L1 (job);
 	else
-		Mod_ProcessLeafs_S  ((dsleaf_t *) in, l->filelen);
+		Mod_ProcessLeafs_S (job);
 }
 
 /*
 =================
-Mod_LoadClipnodes
+Mod_AllocClipnodes
 =================
 */
-void Mod_LoadClipnodes (lump_t *l, qboolean bsp2)
+static int Mod_AllocClipnodes (void)
 {
-	dsclipnode_t *ins;
-	dlclipnode_t *inl;
-
+	lump_t		*l = &mod_header->lumps[LUMP_CLIPNODES];
 	mclipnode_t *out; //johnfitz -- was dclipnode_t
-	int			i, count;
+	int			size, count;
 	hull_t		*hull;
 
-	if (bsp2)
-	{
-		ins = NULL;
-		inl = (dlclipnode_t *)(mod_base + l->fileofs);
-		if (l->filelen % sizeof(*inl))
-			Sys_Error ("Mod_LoadClipnodes: funny lump size in %s",loadmodel->name);
-
-		count = l->filelen / sizeof(*inl);
-	}
-	else
-	{
-		ins = (dsclipnode_t *)(mod_base + l->fileofs);
-		inl = NULL;
-		if (l->filelen % sizeof(*ins))
-			Sys_Error ("Mod_LoadClipnodes: funny lump size in %s",loadmodel->name);
-
-		count = l->filelen / sizeof(*ins);
-	}
+	size = mod_bsp2 ? sizeof(dlclipnode_t) : sizeof(dsclipnode_t);
+	if (l->filelen % size)
+		Sys_Error ("Mod_LoadClipnodes: funny lump size in %s",loadmodel->name);
+	count = l->filelen / size;
 	out = (mclipnode_t *) Hunk_AllocName ( count*sizeof(*out), loadname);
 
 	//johnfitz -- warn about exceeding old limits
-	if (count > 32767 && !bsp2)
+	if (count > 32767 && !mod_bsp2)
 		Con_DWarning ("%i clipnodes exceeds standard limit of 32767.\n", count);
 	//johnfitz
 
@@ -1646,15 +2515,38 @@ void Mod_LoadClipnodes (lump_t *l, qboolean bsp2)
 	hull->clip_maxs[1] = 32;
 	hull->clip_maxs[2] = 64;
 
-	if (bsp2)
+	return count;
+}
+
+/*
+=================
+Mod_LoadClipnodes
+=================
+*/
+static void Mod_LoadClipnodes (modjob_t *job)
+{
+	dsclipnode_t *ins;
+	dlclipnode_t *inl;
+	mclipnode_t *out; //johnfitz -- was dclipnode_t
+	int			i, count;
+
+	out = loadmodel->clipnodes + job->first;
+	count = loadmodel->numclipnodes;
+
+	if (mod_bsp2)
 	{
-		for (i=0 ; i<count ; i++, out++, inl++)
+		inl = (dlclipnode_t *)(mod_base + mod_header->lumps[LUMP_CLIPNODES].fileofs) + job->first;
+
+		for (i=0 ; i<job->count ; i++, out++, inl++)
 		{
 			out->planenum = LittleLong(inl->planenum);
 
 			//johnfitz -- bounds check
 			if (out->planenum < 0 || out->planenum >= loadmodel->numplanes)
-				Host_Error ("Mod_LoadClipnodes: planenum out of bounds");
+			{
+				Mod_JobError (job, MODERR_HOST, "Mod_LoadClipnodes: planenum out of bounds");
+				return;
+			}
 			//johnfitz
 
 			out->children[0] = LittleLong(inl->children[0]);
@@ -1664,14 +2556,19 @@ void Mod_LoadClipnodes (lump_t *l, qboolean bsp2)
 	}
 	else
 	{
-		for (i=0 ; i<count ; i++, out++, ins++)
+		ins = (dsclipnode_t *)(mod_base + mod_header->lumps[LUMP_CLIPNODES].fileofs) + job->first;
+
+		for (i=0 ; i<job->count ; i++, out++, ins++)
 		{
 			out->planenum = LittleLong(ins->planenum);
 
-		//johnfitz -- bounds check
-		if (out->planenum < 0 || out->planenum >= loadmodel->numplanes)
-			Host_Error ("Mod_LoadClipnodes: planenum out of bounds");
-		//johnfitz
+			//johnfitz -- bounds check
+			if (out->planenum < 0 || out->planenum >= loadmodel->numplanes)
+			{
+				Mod_JobError (job, MODERR_HOST, "Mod_LoadClipnodes: planenum out of bounds");
+				return;
+			}
+			//johnfitz
 
 			//johnfitz -- support clipnodes > 32k
 			out->children[0] = (unsigned short)LittleShort(ins->children[0]);
@@ -1686,6 +2583,24 @@ void Mod_LoadClipnodes (lump_t *l, qboolean bsp2)
 	}
 }
 
+/*
+=================
+Mod_AllocHull0
+=================
+*/
+static int Mod_AllocHull0 (void)
+{
+	hull_t		*hull;
+
+	hull = &loadmodel->hulls[0];
+	hull->clipnodes = (mclipnode_t *) Hunk_AllocName ( loadmodel->numnodes*sizeof(mclipnode_t), loadname);
+	hull->firstclipnode = 0;
+	hull->lastclipnode = loadmodel->numnodes-1;
+	hull->planes = loadmodel->planes;
+
+	return loadmodel->numnodes;
+}
+
 /*
 =================
 Mod_MakeHull0
@@ -1693,25 +2608,16 @@ Mod_MakeHull0
 Duplicate the drawing hull structure as a clipping hull
 =================
 */
-void Mod_MakeHull0 (void)
+static void Mod_MakeHull0 (modjob_t *job)
 {
 	mnode_t		*in, *child;
 	mclipnode_t *out; //johnfitz -- was dclipnode_t
-	int			i, j, count;
-	hull_t		*hull;
-
-	hull = &loadmodel->hulls[0];
-
-	in = loadmodel->nodes;
-	count = loadmodel->numnodes;
-	out = (mclipnode_t *) Hunk_AllocName ( count*sizeof(*out), loadname);
+	int			i, j;
 
-	hull->clipnodes = out;
-	hull->firstclipnode = 0;
-	hull->lastclipnode = count-1;
-	hull->planes = loadmodel->planes;
+	in = loadmodel->nodes + job->first;
+	out = loadmodel->hulls[0].clipnodes + job->first;
 
-	for (i=0 ; i<count ; i++, out++, in++)
+	for (i=0 ; i<job->count ; i++, out++, in++)
 	{
 		out->planenum = in->plane - loadmodel->planes;
 		for (j=0 ; j<2 ; j++)
@@ -1725,59 +2631,70 @@ void Mod_MakeHull0 (void)
 	}
 }
 
+/*
+=================
+Mod_AllocMarksurfaces
+=================
+*/
+static int Mod_AllocMarksurfaces (void)
+{
+	lump_t	*l = &mod_header->lumps[LUMP_MARKSURFACES];
+	int		size, count;
+
+	size = mod_bsp2 ? sizeof(unsigned int) : sizeof(short);
+	if (l->filelen % size)
+		Host_Error ("Mod_LoadMarksurfaces: funny lump size in %s",loadmodel->name);
+	count = l->filelen / size;
+	loadmodel->marksurfaces = (msurface_t **)Hunk_AllocName ( count*sizeof(msurface_t *), loadname);
+	loadmodel->nummarksurfaces = count;
+
+	//johnfitz -- warn mappers about exceeding old limits
+	if (count > 32767 && !mod_bsp2)
+		Con_DWarning ("%i marksurfaces exceeds standard limit of 32767.\n", count);
+	//johnfitz
+
+	return count;
+}
+
 /*
 =================
 Mod_LoadMarksurfaces
 =================
 */
-void Mod_LoadMarksurfaces (lump_t *l, int bsp2)
+static void Mod_LoadMarksurfaces (modjob_t *job)
 {
-	int		i, j, count;
+	int		i, j;
 	msurface_t **out;
-	if (bsp2)
-	{
-		unsigned int *in = (unsigned int *)(mod_base + l->fileofs);
-
-		if (l->filelen % sizeof(*in))
-			Host_Error ("Mod_LoadMarksurfaces: funny lump size in %s",loadmodel->name);
 
-		count = l->filelen / sizeof(*in);
-		out = (msurface_t **)Hunk_AllocName ( count*sizeof(*out), loadname);
+	out = loadmodel->marksurfaces;
 
-		loadmodel->marksurfaces = out;
-		loadmodel->nummarksurfaces = count;
+	if (mod_bsp2)
+	{
+		unsigned int *in = (unsigned int *)(mod_base + mod_header->lumps[LUMP_MARKSURFACES].fileofs);
 
-		for (i=0 ; i<count ; i++)
+		for (i=job->first ; i<job->first+job->count ; i++)
 		{
 			j = LittleLong(in[i]);
 			if (j >= loadmodel->numsurfaces)
-				Host_Error ("Mod_LoadMarksurfaces: bad surface number");
+			{
+				Mod_JobError (job, MODERR_HOST, "Mod_LoadMarksurfaces: bad surface number");
+				return;
+			}
 			out[i] = loadmodel->surfaces + j;
 		}
 	}
 	else
 	{
-		short *in = (short *)(mod_base + l->fileofs);
+		short *in = (short *)(mod_base + mod_header->lumps[LUMP_MARKSURFACES].fileofs);
 
-		if (l->filelen % sizeof(*in))
-			Host_Error ("Mod_LoadMarksurfaces: funny lump size in %s",loadmodel->name);
-
-		count = l->filelen / sizeof(*in);
-		out = (msurface_t **)Hunk_AllocName ( count*sizeof(*out), loadname);
-
-		loadmodel->marksurfaces = out;
-		loadmodel->nummarksurfaces = count;
-
-		//johnfitz -- warn mappers about exceeding old limits
-		if (count > 32767)
-			Con_DWarning ("%i marksurfaces exceeds standard limit of 32767.\n", count);
-		//johnfitz
-
-		for (i=0 ; i<count ; i++)
+		for (i=job->first ; i<job->first+job->count ; i++)
 		{
 			j = (unsigned short)LittleShort(in[i]); //johnfitz -- explicit cast as unsigned short
 			if (j >= loadmodel->numsurfaces)
-				Sys_Error ("Mod_LoadMarksurfaces: bad surface number");
+			{
+				Mod_JobError (job, MODERR_SYS, "Mod_LoadMarksurfaces: bad surface number");
+				return;
+			}
 			out[i] = loadmodel->surfaces + j;
 		}
 	}
@@ -1785,51 +2702,72 @@ void Mod_LoadMarksurfaces (lump_t *l, int bsp2)
 
 /*
 =================
-Mod_LoadSurfedges
+Mod_AllocSurfedges
 =================
 */
-void Mod_LoadSurfedges (lump_t *l)
+static int Mod_AllocSurfedges (void)
 {
-	int		i, count;
-	int		*in, *out;
+	lump_t	*l = &mod_header->lumps[LUMP_SURFEDGES];
 
-	in = (int *)(mod_base + l->fileofs);
-	if (l->filelen % sizeof(*in))
+	if (l->filelen % sizeof(int))
 		Sys_Error ("MOD_LoadBmodel: funny lump size in %s",loadmodel->name);
-	count = l->filelen / sizeof(*in);
-	out = (int *) Hunk_AllocName ( count*sizeof(*out), loadname);
+	loadmodel->numsurfedges = l->filelen / sizeof(int);
+	loadmodel->surfedges = (int *) Hunk_AllocName ( loadmodel->numsurfedges*sizeof(int), loadname);
+
+	return loadmodel->numsurfedges;
+}
+
+/*
+=================
+Mod_LoadSurfedges
+=================
+*/
+static void Mod_LoadSurfedges (modjob_t *job)
+{
+	int		i;
+	int		*in, *out;
 
-	loadmodel->surfedges = out;
-	loadmodel->numsurfedges = count;
+	in = (int *)(mod_base + mod_header->lumps[LUMP_SURFEDGES].fileofs);
+	out = loadmodel->surfedges;
 
-	for (i=0 ; i<count ; i++)
+	for (i=job->first ; i<job->first+job->count ; i++)
 		out[i] = LittleLong (in[i]);
 }
 
 
+/*
+=================
+Mod_AllocPlanes
+=================
+*/
+static int Mod_AllocPlanes (void)
+{
+	lump_t	*l = &mod_header->lumps[LUMP_PLANES];
+
+	if (l->filelen % sizeof(dplane_t))
+		Sys_Error ("MOD_LoadBmodel: funny lump size in %s",loadmodel->name);
+	loadmodel->numplanes = l->filelen / sizeof(dplane_t);
+	loadmodel->planes = (mplane_t *) Hunk_AllocName ( loadmodel->numplanes*2*sizeof(mplane_t), loadname);
+
+	return loadmodel->numplanes;
+}
+
 /*
 =================
 Mod_LoadPlanes
 =================
 */
-void Mod_LoadPlanes (lump_t *l)
+static void Mod_LoadPlanes (modjob_t *job)
 {
 	int			i, j;
 	mplane_t	*out;
 	dplane_t 	*in;
-	int			count;
 	int			bits;
 
-	in = (dplane_t *)(mod_base + l->fileofs);
-	if (l->filelen % sizeof(*in))
-		Sys_Error ("MOD_LoadBmodel: funny lump size in %s",loadmodel->name);
-	count = l->filelen / sizeof(*in);
-	out = (mplane_t *) Hunk_AllocName ( count*2*sizeof(*out), loadname);
-
-	loadmodel->planes = out;
-	loadmodel->numplanes = count;
+	in = (dplane_t *)(mod_base + mod_header->lumps[LUMP_PLANES].fileofs) + job->first;
+	out = loadmodel->planes + job->first;
 
-	for (i=0 ; i<count ; i++, in++, out++)
+	for (i=0 ; i<job->count ; i++, in++, out++)
 	{
 		bits = 0;
 		for (j=0 ; j<3 ; j++)
@@ -1961,6 +2899,273 @@ void Mod_BoundsFromClipNode (qmodel_t *mod, int hull, int nodenum)
 	Mod_BoundsFromClipNode (mod, hull, node->children[1]);
 }
 
+/*
+===============================================================================
+
+BRUSH MODEL LOAD STAGES
+
+===============================================================================
+*/
+
+/*
+a brush model is loaded in stages, one per lump and one for the face polys.
+each stage begins on the main thread, in table order, so the hunk is laid
+out exactly as it always was and the model comes out the same byte for byte
+however many threads there are.  a stage's per-item conversion is then split
+into chunks that run on the task threads, alongside the chunks of every other
+stage that could begin, and its end runs back on the main thread.  a stage
+begins once the stages in its deps have ended; the begin loop stops at the
+first one that can't, so later stages wait for it even if they don't need to.
+anything that reads files, talks to the texture manager or walks the tree
+stays in a begin or end function.  problems found in the workers are reported
+afterwards from the main thread, first chunk first.
+*/
+
+enum
+{
+	MS_VERTEXES,
+	MS_EDGES,
+	MS_SURFEDGES,
+	MS_TEXTURES,
+	MS_LIGHTING,
+	MS_PLANES,
+	MS_TEXINFO,
+	MS_FACES,
+	MS_POLYS,
+	MS_MARKSURFACES,
+	MS_VISIBILITY,
+	MS_LEAFS,
+	MS_NODES,
+	MS_CLIPNODES,
+	MS_ENTITIES,
+	MS_SUBMODELS,
+	MS_HULL0,
+	NUM_MODSTAGES
+};
+
+#define	MS(x)	(1 << MS_##x)
+
+typedef struct
+{
+	const char	*name;
+	int			deps;					// MS() bits of the stages that have to end before this one begins
+	int			chunk;					// fewest items worth a job of their own
+	int			(*begin) (void);		// main thread; hunk allocations, returns the number of items
+	void		(*work) (modjob_t *job);	// any thread
+	void		(*end) (int found);		// main thread, with the jobs' found counts summed up
+} modstage_t;
+
+static int Mod_BeginTextures (void)
+{
+	Mod_LoadTextures (&mod_header->lumps[LUMP_TEXTURES]);
+	return 0;
+}
+
+static int Mod_BeginLighting (void)
+{
+	Mod_LoadLighting (&mod_header->lumps[LUMP_LIGHTING]);
+	return 0;
+}
+
+static int Mod_BeginVisibility (void)
+{
+	Mod_LoadVisibility (&mod_header->lumps[LUMP_VISIBILITY]);
+	return 0;
+}
+
+static int Mod_BeginEntities (void)
+{
+	Mod_LoadEntities (&mod_header->lumps[LUMP_ENTITIES]);
+	return 0;
+}
+
+static int Mod_BeginSubmodels (void)
+{
+	Mod_LoadSubmodels (&mod_header->lumps[LUMP_MODELS]);
+	return 0;
+}
+
+static const modstage_t mod_stages[NUM_MODSTAGES] =
+{
+	{"vertexes",	0,	8192,	Mod_AllocVertexes,	Mod_LoadVertexes,	NULL},
+	{"edges",		0,	8192,	Mod_AllocEdges,		Mod_LoadEdges,		NULL},
+	{"surfedges",	0,	16384,	Mod_AllocSurfedges,	Mod_LoadSurfedges,	NULL},
+	{"textures",	0,	0,		Mod_BeginTextures,	NULL,				NULL},
+	{"lighting",	0,	0,		Mod_BeginLighting,	NULL,				NULL},
+	{"planes",		0,	4096,	Mod_AllocPlanes,	Mod_LoadPlanes,		NULL},
+	{"texinfo",		MS(TEXTURES),	2048,	Mod_AllocTexinfo,	Mod_LoadTexinfo,	Mod_EndTexinfo},
+	{"faces",		MS(VERTEXES)|MS(EDGES)|MS(SURFEDGES)|MS(TEXINFO),	512,	Mod_AllocFaces,	Mod_LoadFaces,	NULL},
+	{"polys",		MS(FACES),	0,	Mod_BuildFacePolys,	NULL,				NULL},
+	{"marksurfaces",	0,	16384,	Mod_AllocMarksurfaces,	Mod_LoadMarksurfaces,	NULL},
+	{"visibility",	0,	0,		Mod_BeginVisibility,	NULL,			NULL},
+	{"leafs",		0,	2048,	Mod_AllocLeafs,		Mod_LoadLeafs,		NULL},
+	{"nodes",		0,	2048,	Mod_AllocNodes,		Mod_LoadNodes,		Mod_EndNodes},	// ends after leafs, which Mod_SetParent reads
+	{"clipnodes",	0,	8192,	Mod_AllocClipnodes,	Mod_LoadClipnodes,	NULL},
+	{"entities",	0,	0,		Mod_BeginEntities,	NULL,				NULL},
+	{"submodels",	0,	0,		Mod_BeginSubmodels,	NULL,				NULL},
+	{"hull0",		MS(NODES)|MS(LEAFS),	8192,	Mod_AllocHull0,	Mod_MakeHull0,	NULL},
+};
+
+#define	MAX_STAGEJOBS	64
+#define	MAX_MODJOBS		(MAX_STAGEJOBS*NUM_MODSTAGES)
+
+static modjob_t	mod_jobs[MAX_MODJOBS];
+static double	mod_stagetime[NUM_MODSTAGES];	// main thread
+static double	mod_worktime[NUM_MODSTAGES];	// summed over every thread
+
+/*
+=================
+Mod_RunJob
+=================
+*/
+static void Mod_RunJob (void *unused, int index)
+{
+	modjob_t	*job = &mod_jobs[index];
+	double		start;
+
+	start = Sys_DoubleTime ();
+	mod_stages[job->stage].work (job);
+	job->time = Sys_DoubleTime () - start;
+}
+
+/*
+=================
+Mod_AddJobs -- splits a stage's items into jobs, returns the new number of jobs
+=================
+*/
+static int Mod_AddJobs (int stage, int items, int numjobs)
+{
+	modjob_t	*job;
+	int			i, count, per;
+
+	count = (items + mod_stages[stage].chunk - 1) / mod_stages[stage].chunk;
+	count = CLAMP (1, count, MAX_STAGEJOBS);
+	per = (items + count - 1) / count;
+
+	for (i=0 ; i<items ; i+=per, numjobs++)
+	{
+		job = &mod_jobs[numjobs];
+		memset (job, 0, sizeof(*job));
+		job->stage = stage;
+		job->first = i;
+		job->count = q_min(per, items - i);
+	}
+
+	return numjobs;
+}
+
+/*
+=================
+Mod_EndJobs -- reports what a stage's jobs found, in item order, then ends the stage
+=================
+*/
+static void Mod_EndJobs (int stage, int numjobs)
+{
+	modjob_t	*job;
+	int			i, found;
+	double		start;
+
+	found = 0;
+	for (i=0, job=mod_jobs ; i<numjobs ; i++, job++)
+	{
+		if (job->stage != stage)
+			continue;
+		mod_worktime[stage] += job->time;
+		found += job->found;
+
+		switch (job->errortype)
+		{
+		case MODERR_PRINT:
+			Con_Printf ("%s", job->error);
+			break;
+		case MODERR_HOST:
+			Host_Error ("%s", job->error);
+			break;
+		case MODERR_SYS:
+			Sys_Error ("%s", job->error);
+			break;
+		}
+	}
+
+	start = Sys_DoubleTime ();
+	if (mod_stages[stage].end)
+		mod_stages[stage].end (found);
+	mod_stagetime[stage] += Sys_DoubleTime () - start;
+}
+
+/*
+=================
+Mod_RunStages
+=================
+*/
+static void Mod_RunStages (void)
+{
+	const modstage_t	*s;
+	int			next, ended, wave, numjobs, items, i;
+	double		start, total;
+
+	memset (mod_stagetime, 0, sizeof(mod_stagetime));
+	memset (mod_worktime, 0, sizeof(mod_worktime));
+	total = Sys_DoubleTime ();
+
+	ended = 0;
+	for (next=0 ; next<NUM_MODSTAGES ; )
+	{
+		// begin everything that can, in order
+		wave = 0;
+		numjobs = 0;
+		for ( ; next<NUM_MODSTAGES ; next++)
+		{
+			s = &mod_stages[next];
+			if ((s->deps & ended) != s->deps)
+				break;
+
+			start = Sys_DoubleTime ();
+			items = s->begin ();
+			mod_stagetime[next] += Sys_DoubleTime () - start;
+
+			if (items > 0 && s->work)
+			{
+				numjobs = Mod_AddJobs (next, items, numjobs);
+				wave |= 1<<next;
+			}
+			else
+			{
+				Mod_EndJobs (next, 0);
+				ended |= 1<<next;
+			}
+		}
+
+		if (!wave)
+		{
+			if (next < NUM_MODSTAGES)
+				Sys_Error ("Mod_RunStages: %s waits for a stage that hasn't begun", mod_stages[next].name);
+			break;
+		}
+
+		Tasks_ParallelFor (numjobs, 0, Mod_RunJob, NULL);
+
+		for (i=0 ; i<NUM_MODSTAGES ; i++)
+		{
+			if (wave & (1<<i))
+			{
+				Mod_EndJobs (i, numjobs);
+				ended |= 1<<i;
+			}
+		}
+	}
+
+	total = Sys_DoubleTime () - total;
+
+	if (developer.value)
+	{
+		Con_DPrintf ("%s loaded in %.1f ms on %i threads:\n", loadmodel->name, total * 1000.0, Tasks_NumThreads ());
+		for (i=0 ; i<NUM_MODSTAGES ; i++)
+			Con_DPrintf ("  %-12s %7.2f ms main %7.2f ms work\n", mod_stages[i].name,
+				mod_stagetime[i] * 1000.0, mod_worktime[i] * 1000.0);
+	}
+}
+
 /*
 =================
 Mod_LoadBrushModel
@@ -1996,31 +3201,23 @@ void Mod_LoadBrushModel (qmodel_t *mod, void *buffer)
 		break;
 	}
 
+	BSPCache_BeginModel (mod, (byte *)buffer, com_filesize);
+
 // swap all the lumps
 	mod_base = (byte *)header;
 
 	for (i = 0; i < (int) sizeof(dheader_t) / 4; i++)
 		((int *)header)[i] = LittleLong ( ((int *)header)[i]);
 
+	mod->fatpvs = NULL; // Mod_BuildFatPVS, once it's known to be the world
+
 // load into heap
+	mod_header = header;
+	mod_bsp2 = bsp2;
 
-	Mod_LoadVertexes (&header->lumps[LUMP_VERTEXES]);
-	Mod_LoadEdges (&header->lumps[LUMP_EDGES], bsp2);
-	Mod_LoadSurfedges (&header->lumps[LUMP_SURFEDGES]);
-	Mod_LoadTextures (&header->lumps[LUMP_TEXTURES]);
-	Mod_LoadLighting (&header->lumps[LUMP_LIGHTING]);
-	Mod_LoadPlanes (&header->lumps[LUMP_PLANES]);
-	Mod_LoadTexinfo (&header->lumps[LUMP_TEXINFO]);
-	Mod_LoadFaces (&header->lumps[LUMP_FACES], bsp2);
-	Mod_LoadMarksurfaces (&header->lumps[LUMP_MARKSURFACES], bsp2);
-	Mod_LoadVisibility (&header->lumps[LUMP_VISIBILITY]);
-	Mod_LoadLeafs (&header->lumps[LUMP_LEAFS], bsp2);
-	Mod_LoadNodes (&header->lumps[LUMP_NODES], bsp2);
-	Mod_LoadClipnodes (&header->lumps[LUMP_CLIPNODES], bsp2);
-	Mod_LoadEntities (&header->lumps[LUMP_ENTITIES]);
-	Mod_LoadSubmodels (&header->lumps[LUMP_MODELS]);
-
-	Mod_MakeHull0 ();
+	Mod_RunStages ();
+
+	BSPCache_EndModel (mod);
 
 	mod->numframes = 2;		// regular and alternate animation
 
@@ -2492,7 +3689,7 @@ Mod_LoadAliasModel
 */
 void Mod_LoadAliasModel (qmodel_t *mod, void *buffer)
 {
-	int					i, j;
+	int					i;
 	mdl_t				*pinmodel;
 	stvert_t			*pinstverts;
 	dtriangle_t			*pintriangles;
@@ -2565,39 +3762,25 @@ void Mod_LoadAliasModel (qmodel_t *mod, void *buffer)
 
 
 //
-// load the skins
+// find the base s and t vertices past the skins, the same way
+// Mod_PrebuildAliasMesh does, before trusting the skin headers
 //
-	pskintype = (daliasskintype_t *)&pinmodel[1];
-	pskintype = (daliasskintype_t *) Mod_LoadAllSkins (pheader->numskins, pskintype);
+	pinstverts = (stvert_t *) Mod_FindAliasMesh ((byte *)buffer, com_filesize);
+	if (!pinstverts)
+		Sys_Error ("model %s is truncated", mod->name);
 
 //
-// load base s and t vertices
+// load the skins
 //
-	pinstverts = (stvert_t *)pskintype;
-
-	for (i=0 ; i<pheader->numverts ; i++)
-	{
-		stverts[i].onseam = LittleLong (pinstverts[i].onseam);
-		stverts[i].s = LittleLong (pinstverts[i].s);
-		stverts[i].t = LittleLong (pinstverts[i].t);
-	}
+	pskintype = (daliasskintype_t *)&pinmodel[1];
+	Mod_LoadAllSkins (pheader->numskins, pskintype);
 
 //
-// load triangle lists
+// load base s and t vertices and triangle lists
 //
+	Mod_DecodeAliasMesh (pinstverts, pheader->numverts, pheader->numtris, stverts, triangles);
 	pintriangles = (dtriangle_t *)&pinstverts[pheader->numverts];
 
-	for (i=0 ; i<pheader->numtris ; i++)
-	{
-		triangles[i].facesfront = LittleLong (pintriangles[i].facesfront);
-
-		for (j=0 ; j<3 ; j++)
-		{
-			triangles[i].vertindex[j] =
-					LittleLong (pintriangles[i].vertindex[j]);
-		}
-	}
-
 //
 // load the frames
 //
@@ -2625,7 +3808,7 @@ void Mod_LoadAliasModel (qmodel_t *mod, void *buffer)
 	//
 	// build the draw lists
 	//
-	GL_MakeAliasModelDisplayLists (mod, pheader);
+	GL_MakeAliasModelDisplayLists (mod, pheader, mod_prefetchmesh);
 
 //
 // move the complete, relocatable alias model to the cache
@@ -2662,7 +3845,7 @@ void * Mod_LoadSpriteFrame (void * pin, mspriteframe_t **ppframe, int framenum)
 	height = LittleLong (pinframe->height);
 	size = width * height;
 
-	pspriteframe = (mspriteframe_t *) Hunk_AllocName (sizeof (mspriteframe_t),loadname);
+	pspriteframe = (mspriteframe_t *) Mod_SpriteAlloc (sizeof (mspriteframe_t));
 	*ppframe = pspriteframe;
 
 	pspriteframe->width = width;
@@ -2709,8 +3892,8 @@ void * Mod_LoadSpriteGroup (void * pin, mspriteframe_t **ppframe, int framenum)
 
 	numframes = LittleLong (pingroup->numframes);
 
-	pspritegroup = (mspritegroup_t *) Hunk_AllocName (sizeof (mspritegroup_t) +
-				(numframes - 1) * sizeof (pspritegroup->frames[0]), loadname);
+	pspritegroup = (mspritegroup_t *) Mod_SpriteAlloc (sizeof (mspritegroup_t) +
+				(numframes - 1) * sizeof (pspritegroup->frames[0]));
 
 	pspritegroup->numframes = numframes;
 
@@ -2718,7 +3901,7 @@ void * Mod_LoadSpriteGroup (void * pin, mspriteframe_t **ppframe, int framenum)
 
 	pin_intervals = (dspriteinterval_t *)(pingroup + 1);
 
-	poutintervals = (float *) Hunk_AllocName (numframes * sizeof (float), loadname);
+	poutintervals = (float *) Mod_SpriteAlloc (numframes * sizeof (float));
 
 	pspritegroup->intervals = poutintervals;
 
@@ -2770,7 +3953,8 @@ void Mod_LoadSpriteModel (qmodel_t *mod, void *buffer)
 
 	size = sizeof (msprite_t) + (numframes - 1) * sizeof (psprite->frames);
 
-	psprite = (msprite_t *) Hunk_AllocName (size, loadname);
+	Mod_FreeSprite (mod); // from before a reload
+	psprite = (msprite_t *) Mod_SpriteAlloc (size);
 
 	mod->cache.data = psprite;
 
@@ -207,12 +207,14 @@ typedef struct mleaf_s
 
 // leaf specific
 	byte		*compressed_vis;
-	efrag_t		*efrags;
+	unsigned short	*statics;	// indexes into cl_static_entities
+	int			numstatics;
 
 	msurface_t	**firstmarksurface;
 	int			nummarksurfaces;
 	int			key;			// BSP sequence number for leaf's contents
 	byte		ambient_sound_level[NUM_AMBIENTS];
+	int			pvsslot;		// Mod_LeafPVS cache slot + 1 its row was last put in
 } mleaf_t;
 
 //johnfitz -- for clipnodes>32k
@@ -294,6 +296,24 @@ typedef struct aliasmesh_s
 	unsigned short vertindex;
 } aliasmesh_t;
 
+// strips, pose vertex order and VBO layout of an alias mesh, as built by
+// GLMesh_BuildMesh; one malloc'd block
+typedef struct aliasbuild_s
+{
+	int		numtris, numverts;		// what it was built from
+	int		skinwidth, skinheight;
+	int		numcommands;
+	int		numorder;
+	int		numverts_vbo;
+	int		numindexes;
+	int		*commands;		// gl command list, s/t not yet scaled for padded skins
+	int		*vertexorder;
+	aliasmesh_t	*meshdesc;		// NULL unless gl_glsl_alias_able
+	unsigned short	*indexes;
+	qboolean	cached;			// read from the mesh cache
+	unsigned int	srchash;		// of the triangles and st verts, see GLMesh_MatchesBuild
+} aliasbuild_t;
+
 typedef struct meshxyz_s
 {
 	byte xyz[4];
@@ -405,12 +425,22 @@ typedef enum {mod_brush, mod_sprite, mod_alias} modtype_t;
 #define	MOD_FBRIGHTHACK	1024	//when fullbrights are disabled, use a hack to render this model brighter
 //johnfitz
 
+typedef struct bspcache_s
+{
+	unsigned int	hash;			// of the bsp file
+	int		size;
+	qboolean	loaded;			// surfaces, polys and lightmap packing came from the cache
+	int		numlightmaps, lastlightmap;
+	int		*allocated;		// [numlightmaps][LMBLOCK_WIDTH], see AllocBlock
+} bspcache_t;
+
 typedef struct qmodel_s
 {
 	char		name[MAX_QPATH];
 	unsigned int	path_id;		// path id of the game directory
 							// that this model came from
 	qboolean	needload;		// bmodels and sprites don't cache normally
+	int		refcount;		// precache tables holding it this level, see Mod_ReleaseUnused
 
 	modtype_t	type;
 	int			numframes;
@@ -481,6 +511,14 @@ typedef struct qmodel_s
 
 	int			bspversion;
 
+	bspcache_t	*bspcache;		// NULL if the model can't be cached
+	byte		*fatpvs;		// numleafs rows of (numleafs+31)>>3 bytes, see Mod_BuildFatPVS
+
+//
+// sprite model
+//
+	void		*spritemem;		// malloc'd blocks the sprite lives in, so it can outlast the level hunk
+
 //
 // alias model
 //
@@ -506,10 +544,26 @@ void	Mod_ResetAll (void); // for gamedir changes (Host_Game_f)
 qmodel_t *Mod_ForName (const char *name, qboolean crash);
 void	*Mod_Extradata (qmodel_t *mod);	// handles caching
 void	Mod_TouchModel (const char *name);
+void	Mod_Prefetch (const char *name);
+void	Mod_RunPrefetch (void);
+void	Mod_ClearPrefetch (void);
+void	Mod_AddRef (qmodel_t *mod);
+void	Mod_ReleaseUnused (void);
 
 mleaf_t *Mod_PointInLeaf (float *p, qmodel_t *model);
 byte	*Mod_LeafPVS (mleaf_t *leaf, qmodel_t *model);
+byte	*Mod_LeafFatPVS (mleaf_t *leaf, qmodel_t *model);
+void	Mod_BuildFatPVS (qmodel_t *model);
 
 void Mod_SetExtraFlags (qmodel_t *mod);
 
+// gl_bspcache.c
+void BSPCache_Init (void);
+void BSPCache_BeginModel (qmodel_t *mod, const byte *buffer, int size);
+qboolean BSPCache_Surfaces (int count);
+void BSPCache_LoadSurface (msurface_t *s, int surfnum);
+void BSPCache_EndModel (qmodel_t *mod);
+qboolean BSPCache_RestoreLightmaps (qmodel_t *mod);
+void BSPCache_Write (qmodel_t *mod);
+
 #endif	// __MODEL__
@@ -31,57 +31,61 @@ mnode_t	*r_pefragtopnode;
 /*
 ===============================================================================
 
-					ENTITY FRAGMENT FUNCTIONS
+					STATIC ENTITY LEAF ARRAYS
+
+static entities never move, so instead of linking them into the leafs with
+efrags, each (leaf, entity) reference is recorded as it is parsed, and the
+references are sorted into one index array per leaf the first time they're
+drawn.  the static entities seen from the current leaf are cached as well.
 
 ===============================================================================
 */
 
-efrag_t		**lastlink;
+typedef struct
+{
+	int		leafnum;
+	int		entnum;
+} staticref_t;
+
+static staticref_t		r_staticrefs[MAX_EFRAGS]; //in the order they were added
+static int				r_numstaticrefs;
+
+static unsigned short	r_staticleafents[MAX_EFRAGS]; //entity indexes, grouped by leaf
+static int				r_staticleafs[MAX_EFRAGS]; //leafs that have any static entities
+static int				r_numstaticleafs;
+static qboolean			r_staticsdirty; //refs added since the leaf arrays were built
+
+static unsigned short	r_visstatics[MAX_STATIC_ENTITIES]; //static entities seen from the current leaf
+static int				r_numvisstatics;
+static int				r_staticmark[MAX_STATIC_ENTITIES];
+static int				r_staticmarkcount;
 
 vec3_t		r_emins, r_emaxs;
 
-entity_t	*r_addent;
+int			r_addentnum;
 
 
 /*
 ================
-R_RemoveEfrags
+R_ClearStatics
 
-Call when removing an object from the world or moving it to another position
+Call when a new map is loaded, before any static entities are parsed
 ================
 */
-void R_RemoveEfrags (entity_t *ent)
+void R_ClearStatics (void)
 {
-	efrag_t		*ef, *old, *walk, **prev;
-
-	ef = ent->efrag;
+	int		i;
 
-	while (ef)
+	for (i=0 ; i<=cl.worldmodel->numleafs ; i++)
 	{
-		prev = &ef->leaf->efrags;
-		while (1)
-		{
-			walk = *prev;
-			if (!walk)
-				break;
-			if (walk == ef)
-			{	// remove this fragment
-				*prev = ef->leafnext;
-				break;
-			}
-			else
-				prev = &walk->leafnext;
-		}
-
-		old = ef;
-		ef = ef->entnext;
-
-	// put it on the free list
-		old->entnext = cl.free_efrags;
-		cl.free_efrags = old;
+		cl.worldmodel->leafs[i].statics = NULL;
+		cl.worldmodel->leafs[i].numstatics = 0;
 	}
 
-	ent->efrag = NULL;
+	r_numstaticrefs = 0;
+	r_numstaticleafs = 0;
+	r_numvisstatics = 0;
+	r_staticsdirty = true;
 }
 
 /*
@@ -91,9 +95,7 @@ R_SplitEntityOnNode
 */
 void R_SplitEntityOnNode (mnode_t *node)
 {
-	efrag_t		*ef;
 	mplane_t	*splitplane;
-	mleaf_t		*leaf;
 	int			sides;
 
 	if (node->contents == CONTENTS_SOLID)
@@ -101,18 +103,14 @@ void R_SplitEntityOnNode (mnode_t *node)
 		return;
 	}
 
-// add an efrag if the node is a leaf
+// add a reference if the node is a leaf
 
 	if ( node->contents < 0)
 	{
 		if (!r_pefragtopnode)
 			r_pefragtopnode = node;
 
-		leaf = (mleaf_t *)node;
-
-// grab an efrag off the free list
-		ef = cl.free_efrags;
-		if (!ef)
+		if (r_numstaticrefs == MAX_EFRAGS)
 		{
 			//johnfitz -- less spammy overflow message
 			if (!dev_overflows.efrags || dev_overflows.efrags + CONSOLE_RESPAM_TIME < realtime )
@@ -123,20 +121,10 @@ void R_SplitEntityOnNode (mnode_t *node)
 			//johnfitz
 			return;		// no free fragments...
 		}
-		cl.free_efrags = cl.free_efrags->entnext;
-
-		ef->entity = r_addent;
-
-// add the entity link
-		*lastlink = ef;
-		lastlink = &ef->entnext;
-		ef->entnext = NULL;
-
-// set the leaf links
-		ef->leaf = leaf;
-		ef->leafnext = leaf->efrags;
-		leaf->efrags = ef;
 
+		r_staticrefs[r_numstaticrefs].leafnum = (mleaf_t *)node - cl.worldmodel->leafs;
+		r_staticrefs[r_numstaticrefs].entnum = r_addentnum;
+		r_numstaticrefs++;
 		return;
 	}
 
@@ -168,14 +156,12 @@ R_CheckEfrags -- johnfitz -- check for excessive efrag count
 */
 void R_CheckEfrags (void)
 {
-	efrag_t		*ef;
 	int			count;
 
 	if (cls.signon < 2)
 		return; //don't spam when still parsing signon packet full of static ents
 
-	for (count=MAX_EFRAGS, ef = cl.free_efrags; ef; count--, ef = ef->entnext)
-		;
+	count = r_numstaticrefs;
 
 	if (count > 640 && dev_peakstats.efrags <= 640)
 		Con_DWarning ("%i efrags exceeds standard limit of 640.\n", count);
@@ -186,20 +172,20 @@ void R_CheckEfrags (void)
 
 /*
 ===========
-R_AddEfrags
+R_AddStaticEntity -- records the leafs static entity number entnum touches
 ===========
 */
-void R_AddEfrags (entity_t *ent)
+void R_AddStaticEntity (int entnum)
 {
+	entity_t	*ent;
 	qmodel_t	*entmodel;
 	int			i;
 
+	ent = &cl_static_entities[entnum];
 	if (!ent->model)
 		return;
 
-	r_addent = ent;
-
-	lastlink = &ent->efrag;
+	r_addentnum = entnum;
 	r_pefragtopnode = NULL;
 
 	entmodel = ent->model;
@@ -213,32 +199,104 @@ void R_AddEfrags (entity_t *ent)
 	R_SplitEntityOnNode (cl.worldmodel->nodes);
 
 	ent->topnode = r_pefragtopnode;
+	r_staticsdirty = true;
 
 	R_CheckEfrags (); //johnfitz
 }
 
+/*
+================
+R_BuildStaticLeafs
+
+sorts the references into the per-leaf index arrays
+================
+*/
+static void R_BuildStaticLeafs (void)
+{
+	mleaf_t		*leaf;
+	int			i, ofs;
+
+	for (i=0 ; i<=cl.worldmodel->numleafs ; i++)
+		cl.worldmodel->leafs[i].numstatics = 0;
+
+	for (i=0 ; i<r_numstaticrefs ; i++)
+		cl.worldmodel->leafs[r_staticrefs[i].leafnum].numstatics++;
+
+	r_numstaticleafs = 0;
+	for (i=0, ofs=0, leaf=cl.worldmodel->leafs ; i<=cl.worldmodel->numleafs ; i++, leaf++)
+	{
+		if (!leaf->numstatics)
+		{
+			leaf->statics = NULL;
+			continue;
+		}
+		leaf->statics = &r_staticleafents[ofs];
+		ofs += leaf->numstatics;
+		leaf->numstatics = 0;
+		r_staticleafs[r_numstaticleafs++] = i;
+	}
+
+	for (i=0 ; i<r_numstaticrefs ; i++)
+	{
+		leaf = &cl.worldmodel->leafs[r_staticrefs[i].leafnum];
+		leaf->statics[leaf->numstatics++] = r_staticrefs[i].entnum;
+	}
+
+	r_staticsdirty = false;
+}
 
 /*
 ================
-R_StoreEfrags -- johnfitz -- pointless switch statement removed.
+R_StoreStatics
+
+adds the static entities in the leafs marked in vis to cl_visedicts.  the
+set is only worked out again if newvis is set or static entities have been
+added, otherwise the one from the last call is reused.
 ================
 */
-void R_StoreEfrags (efrag_t **ppefrag)
+void R_StoreStatics (byte *vis, qboolean newvis)
 {
 	entity_t	*pent;
-	efrag_t		*pefrag;
+	mleaf_t		*leaf;
+	int			i, j, leafnum, entnum;
+
+	if (r_staticsdirty)
+	{
+		R_BuildStaticLeafs ();
+		newvis = true;
+	}
+
+	if (newvis)
+	{
+		r_numvisstatics = 0;
+		r_staticmarkcount++;
+		for (i=0 ; i<r_numstaticleafs ; i++)
+		{
+			leafnum = r_staticleafs[i];
+			if (!(vis[(leafnum-1)>>3] & (1<<((leafnum-1)&7))))
+				continue;
+			leaf = &cl.worldmodel->leafs[leafnum];
+			for (j=0 ; j<leaf->numstatics ; j++)
+			{
+				entnum = leaf->statics[j];
+				if (r_staticmark[entnum] != r_staticmarkcount)
+				{
+					r_staticmark[entnum] = r_staticmarkcount;
+					r_visstatics[r_numvisstatics++] = entnum;
+				}
+			}
+		}
+	}
 
-	while ((pefrag = *ppefrag) != NULL)
+	for (i=0 ; i<r_numvisstatics ; i++)
 	{
-		pent = pefrag->entity;
+		pent = &cl_static_entities[r_visstatics[i]];
 
 		if ((pent->visframe != r_framecount) && (cl_numvisedicts < MAX_VISEDICTS))
 		{
 			cl_visedicts[cl_numvisedicts++] = pent;
 			pent->visframe = r_framecount;
 		}
-
-		ppefrag = &pefrag->leafnext;
 	}
 }
 
@@ -129,8 +129,6 @@ void R_RenderDlights (void)
 	if (!gl_flashblend.value)
 		return;
 
-	r_dlightframecount = r_framecount + 1;	// because the count hasn't
-											//  advanced yet for this frame
 	glDepthMask (0);
 	glDisable (GL_TEXTURE_2D);
 	glShadeModel (GL_SMOOTH);
@@ -161,77 +159,165 @@ DYNAMIC LIGHTS
 =============================================================================
 */
 
+/*
+=============================================================================
+
+DYNAMIC LIGHT CLUSTERS
+
+live lights are binned once per scene into a coarse world-space grid.  each
+cell holds a mask of the lights whose radius reaches it, in the same layout
+as msurface_t dlightbits, so a surface or model only tests the lights near
+it instead of walking the bsp once per light.
+
+=============================================================================
+*/
+
+#define DLIGHTGRID_CELL			256
+#define DLIGHTGRID_MAX_CELLS	(1<<16)
+#define DLIGHTGRID_MAX_QUERY	64	// boxes spanning more cells than this just take every live light
+
+typedef struct
+{
+	int				framecount;		// bits are stale unless this is r_dlightframecount
+	unsigned int	bits[DLIGHTBITS_WORDS];
+} dlightcell_t;
+
+static struct
+{
+	vec3_t			mins;
+	float			cellsize;
+	int				size[3];
+	dlightcell_t	*cells;
+	unsigned int	live[DLIGHTBITS_WORDS];	// every light binned this scene
+} dlightgrid;
+
+static unsigned int	r_surflightbits[DLIGHTBITS_WORDS];	// lights that may reach the current brush model
+static vec3_t		r_surflightorg[MAX_DLIGHTS];		// light origins in the current brush model's space
+static qboolean		r_surflightworld;					// current model is the world, so query per surface
+static qboolean		r_surflightactive;					// some light may reach the current model
+
 /*
 =============
-R_MarkLights -- johnfitz -- rewritten to use LordHavoc's lighting speedup
+R_InitDlightGrid -- called at map load
 =============
 */
-void R_MarkLights (dlight_t *light, int num, mnode_t *node)
+void R_InitDlightGrid (void)
 {
-	mplane_t	*splitplane;
-	msurface_t	*surf;
-	vec3_t		impact;
-	float		dist, l, maxdist;
-	int			i, j, s, t;
+	qmodel_t	*world = cl.worldmodel;
+	int			i, numcells;
 
-start:
+	dlightgrid.cellsize = DLIGHTGRID_CELL;
+	for (;;)
+	{
+		numcells = 1;
+		for (i=0 ; i<3 ; i++)
+		{
+			dlightgrid.mins[i] = world->mins[i];
+			dlightgrid.size[i] = (int)ceil ((world->maxs[i] - world->mins[i]) / dlightgrid.cellsize) + 1;
+			numcells *= dlightgrid.size[i];
+		}
+		if (numcells <= DLIGHTGRID_MAX_CELLS)
+			break;
+		dlightgrid.cellsize *= 2;
+	}
 
-	if (node->contents < 0)
-		return;
+	dlightgrid.cells = (dlightcell_t *) Hunk_AllocName (numcells * sizeof(dlightcell_t), "dlightgrid");
+	memset (dlightgrid.live, 0, sizeof(dlightgrid.live));
+}
 
-	splitplane = node->plane;
-	if (splitplane->type < 3)
-		dist = light->origin[splitplane->type] - splitplane->dist;
-	else
-		dist = DotProduct (light->origin, splitplane->normal) - splitplane->dist;
+/*
+=============
+R_DlightGridRange -- cell range covered by a box, clamped to the grid so that
+lights and boxes outside the world still meet in the border cells
+=============
+*/
+static int R_DlightGridRange (vec3_t mins, vec3_t maxs, int *lo, int *hi)
+{
+	int i, count;
 
-	if (dist > light->radius)
+	count = 1;
+	for (i=0 ; i<3 ; i++)
 	{
-		node = node->children[0];
-		goto start;
+		lo[i] = (int)floor ((mins[i] - dlightgrid.mins[i]) / dlightgrid.cellsize);
+		hi[i] = (int)floor ((maxs[i] - dlightgrid.mins[i]) / dlightgrid.cellsize);
+		lo[i] = CLAMP (0, lo[i], dlightgrid.size[i] - 1);
+		hi[i] = CLAMP (lo[i], hi[i], dlightgrid.size[i] - 1);
+		count *= hi[i] - lo[i] + 1;
 	}
-	if (dist < -light->radius)
+	return count;
+}
+
+/*
+=============
+R_DlightsForBox -- fills bits with every live light that may reach the box
+=============
+*/
+void R_DlightsForBox (vec3_t mins, vec3_t maxs, unsigned int *bits)
+{
+	dlightcell_t	*cell;
+	int				lo[3], hi[3], x, y, z, i;
+
+	if (!dlightgrid.cells || R_DlightGridRange (mins, maxs, lo, hi) > DLIGHTGRID_MAX_QUERY)
 	{
-		node = node->children[1];
-		goto start;
+		memcpy (bits, dlightgrid.live, sizeof(dlightgrid.live));
+		return;
 	}
 
-	maxdist = light->radius*light->radius;
-// mark the polygons
-	surf = cl.worldmodel->surfaces + node->firstsurface;
-	for (i=0 ; i<node->numsurfaces ; i++, surf++)
-	{
-		for (j=0 ; j<3 ; j++)
-			impact[j] = light->origin[j] - surf->plane->normal[j]*dist;
-		// clamp center of light to corner and check brightness
-		l = DotProduct (impact, surf->texinfo->vecs[0]) + surf->texinfo->vecs[0][3] - surf->texturemins[0];
-		s = l+0.5;if (s < 0) s = 0;else if (s > surf->extents[0]) s = surf->extents[0];
-		s = l - s;
-		l = DotProduct (impact, surf->texinfo->vecs[1]) + surf->texinfo->vecs[1][3] - surf->texturemins[1];
-		t = l+0.5;if (t < 0) t = 0;else if (t > surf->extents[1]) t = surf->extents[1];
-		t = l - t;
-		// compare to minimum light
-		if ((s*s+t*t+dist*dist) < maxdist)
+	memset (bits, 0, sizeof(dlightgrid.live));
+	for (z=lo[2] ; z<=hi[2] ; z++)
+		for (y=lo[1] ; y<=hi[1] ; y++)
+		{
+			cell = dlightgrid.cells + (z * dlightgrid.size[1] + y) * dlightgrid.size[0] + lo[0];
+			for (x=lo[0] ; x<=hi[0] ; x++, cell++)
+				if (cell->framecount == r_dlightframecount)
+					for (i=0 ; i<DLIGHTBITS_WORDS ; i++)
+						bits[i] |= cell->bits[i];
+		}
+}
+
+/*
+=============
+R_BinDlight
+=============
+*/
+static void R_BinDlight (dlight_t *light, int num)
+{
+	dlightcell_t	*cell;
+	vec3_t			mins, maxs;
+	int				lo[3], hi[3], x, y, z;
+
+	dlightgrid.live[num >> 5] |= 1U << (num & 31);
+
+	if (!dlightgrid.cells)
+		return;
+
+	mins[0] = light->origin[0] - light->radius;
+	mins[1] = light->origin[1] - light->radius;
+	mins[2] = light->origin[2] - light->radius;
+	maxs[0] = light->origin[0] + light->radius;
+	maxs[1] = light->origin[1] + light->radius;
+	maxs[2] = light->origin[2] + light->radius;
+	R_DlightGridRange (mins, maxs, lo, hi);
+
+	for (z=lo[2] ; z<=hi[2] ; z++)
+		for (y=lo[1] ; y<=hi[1] ; y++)
 		{
-			if (surf->dlightframe != r_dlightframecount) // not dynamic until now
+			cell = dlightgrid.cells + (z * dlightgrid.size[1] + y) * dlightgrid.size[0] + lo[0];
+			for (x=lo[0] ; x<=hi[0] ; x++, cell++)
 			{
-				surf->dlightbits[num >> 5] = 1U << (num & 31);
-				surf->dlightframe = r_dlightframecount;
+				if (cell->framecount != r_dlightframecount)
+				{
+					cell->framecount = r_dlightframecount;
+					memset (cell->bits, 0, sizeof(cell->bits));
+				}
+				cell->bits[num >> 5] |= 1U << (num & 31);
 			}
-			else // already dynamic
-				surf->dlightbits[num >> 5] |= 1U << (num & 31);
 		}
-	}
-
-	if (node->children[0]->contents >= 0)
-		R_MarkLights (light, num, node->children[0]);
-	if (node->children[1]->contents >= 0)
-		R_MarkLights (light, num, node->children[1]);
 }
 
 /*
 =============
-R_PushDlights
+R_PushDlights -- bin this scene's live lights into the cluster grid
 =============
 */
 void R_PushDlights (void)
@@ -239,18 +325,158 @@ void R_PushDlights (void)
 	int		i;
 	dlight_t	*l;
 
-	if (gl_flashblend.value)
-		return;
-
 	r_dlightframecount = r_framecount + 1;	// because the count hasn't
 											//  advanced yet for this frame
-	l = cl_dlights;
+	memset (dlightgrid.live, 0, sizeof(dlightgrid.live));
 
+	l = cl_dlights;
 	for (i=0 ; i<MAX_DLIGHTS ; i++, l++)
 	{
 		if (l->die < cl.time || !l->radius)
 			continue;
-		R_MarkLights (l, i, cl.worldmodel->nodes);
+		R_BinDlight (l, i);
+	}
+}
+
+/*
+=============
+R_SetupSurfaceLights -- find the lights that may touch the surfaces of a model
+about to be drawn.  ent is NULL for the world.
+=============
+*/
+void R_SetupSurfaceLights (qmodel_t *model, entity_t *ent)
+{
+	vec3_t	mins, maxs, temp, forward, right, up;
+	int		i;
+
+	r_surflightworld = false;
+	r_surflightactive = false;
+	memset (r_surflightbits, 0, sizeof(r_surflightbits));
+
+	if (gl_flashblend.value)
+		return;
+
+	// with nothing binned this scene, skip the per surface queries entirely
+	for (i=0 ; i<DLIGHTBITS_WORDS ; i++)
+		if (dlightgrid.live[i])
+			break;
+	if (i == DLIGHTBITS_WORDS)
+		return;
+
+	if (!ent)
+	{
+		r_surflightworld = true;
+		r_surflightactive = true;
+		for (i=0 ; i<MAX_DLIGHTS ; i++)
+			if (dlightgrid.live[i >> 5] & (1U << (i & 31)))
+				VectorCopy (cl_dlights[i].origin, r_surflightorg[i]);
+		return;
+	}
+
+	// instanced models don't get dynamic light
+	if (model->firstmodelsurface == 0)
+		return;
+
+	if (ent->angles[0] || ent->angles[2]) //pitch or roll
+	{
+		VectorAdd (ent->origin, model->rmins, mins);
+		VectorAdd (ent->origin, model->rmaxs, maxs);
+	}
+	else if (ent->angles[1]) //yaw
+	{
+		VectorAdd (ent->origin, model->ymins, mins);
+		VectorAdd (ent->origin, model->ymaxs, maxs);
+	}
+	else //no rotation
+	{
+		VectorAdd (ent->origin, model->mins, mins);
+		VectorAdd (ent->origin, model->maxs, maxs);
+	}
+	R_DlightsForBox (mins, maxs, r_surflightbits);
+	for (i=0 ; i<DLIGHTBITS_WORDS ; i++)
+		if (r_surflightbits[i])
+			r_surflightactive = true;
+
+	// bring the lights into model space, the same way R_DrawBrushModel does modelorg
+	if (ent->angles[0] || ent->angles[1] || ent->angles[2])
+		AngleVectors (ent->angles, forward, right, up);
+	for (i=0 ; i<MAX_DLIGHTS ; i++)
+	{
+		if (!(r_surflightbits[i >> 5] & (1U << (i & 31))))
+			continue;
+		VectorSubtract (cl_dlights[i].origin, ent->origin, r_surflightorg[i]);
+		if (ent->angles[0] || ent->angles[1] || ent->angles[2])
+		{
+			VectorCopy (r_surflightorg[i], temp);
+			r_surflightorg[i][0] = DotProduct (temp, forward);
+			r_surflightorg[i][1] = -DotProduct (temp, right);
+			r_surflightorg[i][2] = DotProduct (temp, up);
+		}
+	}
+}
+
+/*
+=============
+R_MarkSurfaceLights -- johnfitz's R_MarkLights test (LordHavoc's lighting speedup),
+run for one surface against the lights of its cluster
+=============
+*/
+void R_MarkSurfaceLights (msurface_t *surf)
+{
+	unsigned int	bits[DLIGHTBITS_WORDS];
+	dlight_t		*light;
+	float			*origin;
+	vec3_t			impact;
+	float			dist, l, maxdist;
+	int				i, j, num, s, t;
+
+	if (!r_surflightactive || (surf->flags & SURF_DRAWTILED))
+		return;
+
+	if (r_surflightworld)
+		R_DlightsForBox (surf->mins, surf->maxs, bits);
+	else
+		memcpy (bits, r_surflightbits, sizeof(bits));
+
+	for (i=0 ; i<DLIGHTBITS_WORDS ; i++)
+	{
+		if (!bits[i])
+			continue;
+		for (j=0 ; j<32 ; j++)
+		{
+			if (!(bits[i] & (1U << j)))
+				continue;
+
+			num = (i << 5) + j;
+			light = &cl_dlights[num];
+			origin = r_surflightorg[num];
+
+			dist = DotProduct (origin, surf->plane->normal) - surf->plane->dist;
+			if (dist > light->radius || dist < -light->radius)
+				continue;
+
+			maxdist = light->radius*light->radius;
+			impact[0] = origin[0] - surf->plane->normal[0]*dist;
+			impact[1] = origin[1] - surf->plane->normal[1]*dist;
+			impact[2] = origin[2] - surf->plane->normal[2]*dist;
+			// clamp center of light to corner and check brightness
+			l = DotProduct (impact, surf->texinfo->vecs[0]) + surf->texinfo->vecs[0][3] - surf->texturemins[0];
+			s = l+0.5;if (s < 0) s = 0;else if (s > surf->extents[0]) s = surf->extents[0];
+			s = l - s;
+			l = DotProduct (impact, surf->texinfo->vecs[1]) + surf->texinfo->vecs[1][3] - surf->texturemins[1];
+			t = l+0.5;if (t < 0) t = 0;else if (t > surf->extents[1]) t = surf->extents[1];
+			t = l - t;
+			// compare to minimum light
+			if ((s*s+t*t+dist*dist) < maxdist)
+			{
+				if (surf->dlightframe != r_dlightframecount) // not dynamic until now
+				{
+					memset (surf->dlightbits, 0, sizeof(surf->dlightbits));
+					surf->dlightframe = r_dlightframecount;
+				}
+				surf->dlightbits[i] |= 1U << j;
+			}
+		}
 	}
 }
 
@@ -269,17 +495,19 @@ vec3_t			lightcolor; //johnfitz -- lit support via lordhavoc
 
 /*
 =============
-RecursiveLightPoint -- johnfitz -- replaced entire function for lit support via lordhavoc
+RecursiveLightPointSurface -- returns the first surface hit on the way from start to end, and the
+lightmap coordinates of the impact.  The surface may have no samples.
 =============
 */
-int RecursiveLightPoint (vec3_t color, mnode_t *node, vec3_t start, vec3_t end)
+static msurface_t *RecursiveLightPointSurface (mnode_t *node, vec3_t start, vec3_t end, int *hitds, int *hitdt)
 {
 	float		front, back, frac;
 	vec3_t		mid;
+	msurface_t	*hit;
 
 loc0:
 	if (node->contents < 0)
-		return false;		// didn't hit anything
+		return NULL;		// didn't hit anything
 
 // calculate mid point
 	if (node->plane->type < 3)
@@ -295,7 +523,6 @@ loc0:
 
 	// LordHavoc: optimized recursion
 	if ((back < 0) == (front < 0))
-//		return RecursiveLightPoint (color, node->children[front < 0], start, end);
 	{
 		node = node->children[front < 0];
 		goto loc0;
@@ -307,8 +534,9 @@ loc0:
 	mid[2] = start[2] + (end[2] - start[2])*frac;
 
 // go down front side
-	if (RecursiveLightPoint (color, node->children[front < 0], start, mid))
-		return true;	// hit something
+	hit = RecursiveLightPointSurface (node->children[front < 0], start, mid, hitds, hitdt);
+	if (hit)
+		return hit;	// hit something
 	else
 	{
 		int i, ds, dt;
@@ -338,36 +566,55 @@ loc0:
 			if (ds > surf->extents[0] || dt > surf->extents[1])
 				continue;
 
-			if (surf->samples)
-			{
-				// LordHavoc: enhanced to interpolate lighting
-				byte *lightmap;
-				int maps, line3, dsfrac = ds & 15, dtfrac = dt & 15, r00 = 0, g00 = 0, b00 = 0, r01 = 0, g01 = 0, b01 = 0, r10 = 0, g10 = 0, b10 = 0, r11 = 0, g11 = 0, b11 = 0;
-				float scale;
-				line3 = ((surf->extents[0]>>4)+1)*3;
+			*hitds = ds;
+			*hitdt = dt;
+			return surf; // success
+		}
 
-				lightmap = surf->samples + ((dt>>4) * ((surf->extents[0]>>4)+1) + (ds>>4))*3; // LordHavoc: *3 for color
+	// go down back side
+		return RecursiveLightPointSurface (node->children[front >= 0], mid, end, hitds, hitdt);
+	}
+}
 
-				for (maps = 0;maps < MAXLIGHTMAPS && surf->styles[maps] != 255;maps++)
-				{
-					scale = (float) d_lightstylevalue[surf->styles[maps]] * 1.0 / 256.0;
-					r00 += (float) lightmap[      0] * scale;g00 += (float) lightmap[      1] * scale;b00 += (float) lightmap[2] * scale;
-					r01 += (float) lightmap[      3] * scale;g01 += (float) lightmap[      4] * scale;b01 += (float) lightmap[5] * scale;
-					r10 += (float) lightmap[line3+0] * scale;g10 += (float) lightmap[line3+1] * scale;b10 += (float) lightmap[line3+2] * scale;
-					r11 += (float) lightmap[line3+3] * scale;g11 += (float) lightmap[line3+4] * scale;b11 += (float) lightmap[line3+5] * scale;
-					lightmap += ((surf->extents[0]>>4)+1) * ((surf->extents[1]>>4)+1)*3; // LordHavoc: *3 for colored lighting
-				}
+/*
+=============
+RecursiveLightPoint -- johnfitz -- replaced entire function for lit support via lordhavoc
+=============
+*/
+int RecursiveLightPoint (vec3_t color, mnode_t *node, vec3_t start, vec3_t end)
+{
+	msurface_t	*surf;
+	int			ds, dt;
 
-				color[0] += (float) ((int) ((((((((r11-r10) * dsfrac) >> 4) + r10)-((((r01-r00) * dsfrac) >> 4) + r00)) * dtfrac) >> 4) + ((((r01-r00) * dsfrac) >> 4) + r00)));
-				color[1] += (float) ((int) ((((((((g11-g10) * dsfrac) >> 4) + g10)-((((g01-g00) * dsfrac) >> 4) + g00)) * dtfrac) >> 4) + ((((g01-g00) * dsfrac) >> 4) + g00)));
-				color[2] += (float) ((int) ((((((((b11-b10) * dsfrac) >> 4) + b10)-((((b01-b00) * dsfrac) >> 4) + b00)) * dtfrac) >> 4) + ((((b01-b00) * dsfrac) >> 4) + b00)));
-			}
-			return true; // success
+	surf = RecursiveLightPointSurface (node, start, end, &ds, &dt);
+	if (!surf)
+		return false;		// didn't hit anything
+
+	if (surf->samples)
+	{
+		// LordHavoc: enhanced to interpolate lighting
+		byte *lightmap;
+		int maps, line3, dsfrac = ds & 15, dtfrac = dt & 15, r00 = 0, g00 = 0, b00 = 0, r01 = 0, g01 = 0, b01 = 0, r10 = 0, g10 = 0, b10 = 0, r11 = 0, g11 = 0, b11 = 0;
+		float scale;
+		line3 = ((surf->extents[0]>>4)+1)*3;
+
+		lightmap = surf->samples + ((dt>>4) * ((surf->extents[0]>>4)+1) + (ds>>4))*3; // LordHavoc: *3 for color
+
+		for (maps = 0;maps < MAXLIGHTMAPS && surf->styles[maps] != 255;maps++)
+		{
+			scale = (float) d_lightstylevalue[surf->styles[maps]] * 1.0 / 256.0;
+			r00 += (float) lightmap[      0] * scale;g00 += (float) lightmap[      1] * scale;b00 += (float) lightmap[2] * scale;
+			r01 += (float) lightmap[      3] * scale;g01 += (float) lightmap[      4] * scale;b01 += (float) lightmap[5] * scale;
+			r10 += (float) lightmap[line3+0] * scale;g10 += (float) lightmap[line3+1] * scale;b10 += (float) lightmap[line3+2] * scale;
+			r11 += (float) lightmap[line3+3] * scale;g11 += (float) lightmap[line3+4] * scale;b11 += (float) lightmap[line3+5] * scale;
+			lightmap += ((surf->extents[0]>>4)+1) * ((surf->extents[1]>>4)+1)*3; // LordHavoc: *3 for colored lighting
 		}
 
-	// go down back side
-		return RecursiveLightPoint (color, node->children[front >= 0], mid, end);
+		color[0] += (float) ((int) ((((((((r11-r10) * dsfrac) >> 4) + r10)-((((r01-r00) * dsfrac) >> 4) + r00)) * dtfrac) >> 4) + ((((r01-r00) * dsfrac) >> 4) + r00)));
+		color[1] += (float) ((int) ((((((((g11-g10) * dsfrac) >> 4) + g10)-((((g01-g00) * dsfrac) >> 4) + g00)) * dtfrac) >> 4) + ((((g01-g00) * dsfrac) >> 4) + g00)));
+		color[2] += (float) ((int) ((((((((b11-b10) * dsfrac) >> 4) + b10)-((((b01-b00) * dsfrac) >> 4) + b00)) * dtfrac) >> 4) + ((((b01-b00) * dsfrac) >> 4) + b00)));
 	}
+	return true; // success
 }
 
 /*
@@ -393,3 +640,205 @@ int R_LightPoint (vec3_t p)
 	RecursiveLightPoint (lightcolor, cl.worldmodel->nodes, p, end);
 	return ((lightcolor[0] + lightcolor[1] + lightcolor[2]) * (1.0f / 3.0f));
 }
+
+
+/*
+=============================================================================
+
+LIGHT GRID
+
+a coarse volume of light probes covering the world, used instead of a BSP
+trace to light alias models.  each probe stores the raw lightmap sample of
+every style that reaches it, so animated styles are applied at lookup time
+and never invalidate the probe.  probes are traced the first time they are
+touched, so only the parts of the map that models visit are ever filled in.
+
+=============================================================================
+*/
+
+extern cvar_t r_lightgrid;
+
+#define LIGHTGRID_CELL_XY		32
+#define LIGHTGRID_CELL_Z		64
+#define LIGHTGRID_MAX_PROBES	(1<<19)
+
+#define LIGHTPROBE_EMPTY		0	// not traced yet
+#define LIGHTPROBE_LIT			1
+#define LIGHTPROBE_SOLID		2	// inside a wall, ignored when interpolating
+
+typedef struct
+{
+	byte	state;
+	byte	styles[MAXLIGHTMAPS];
+	byte	color[MAXLIGHTMAPS][3];	// unscaled lightmap sample for each style
+} lightprobe_t;
+
+static struct
+{
+	vec3_t			mins;
+	vec3_t			cellsize;
+	int				size[3];
+	lightprobe_t	*probes;
+} lightgrid;
+
+/*
+=============
+R_InitLightGrid -- called at map load
+=============
+*/
+void R_InitLightGrid (void)
+{
+	qmodel_t	*world = cl.worldmodel;
+	int			i, numprobes;
+
+	lightgrid.probes = NULL;
+	if (!world->lightdata)
+		return;
+
+	lightgrid.cellsize[0] = lightgrid.cellsize[1] = LIGHTGRID_CELL_XY;
+	lightgrid.cellsize[2] = LIGHTGRID_CELL_Z;
+
+	// grow the cells until the grid fits the budget; huge maps get a coarser grid
+	for (;;)
+	{
+		numprobes = 1;
+		for (i=0 ; i<3 ; i++)
+		{
+			lightgrid.mins[i] = lightgrid.cellsize[i] * floor (world->mins[i] / lightgrid.cellsize[i]);
+			lightgrid.size[i] = (int)ceil ((world->maxs[i] - lightgrid.mins[i]) / lightgrid.cellsize[i]) + 1;
+			numprobes *= lightgrid.size[i];
+		}
+		if (numprobes <= LIGHTGRID_MAX_PROBES)
+			break;
+		VectorScale (lightgrid.cellsize, 2, lightgrid.cellsize);
+	}
+
+	lightgrid.probes = (lightprobe_t *) Hunk_AllocName (numprobes * sizeof(lightprobe_t), "lightgrid");
+}
+
+/*
+=============
+R_LightGridProbe -- returns the probe at the given grid coordinates, tracing it if needed
+=============
+*/
+static lightprobe_t *R_LightGridProbe (int x, int y, int z)
+{
+	lightprobe_t	*probe;
+	msurface_t		*surf;
+	vec3_t			start, end;
+	byte			*lightmap;
+	int				maps, i, ds, dt, dsfrac, dtfrac, line3, size3;
+	int				c00, c01, c10, c11;
+
+	probe = lightgrid.probes + (z * lightgrid.size[1] + y) * lightgrid.size[0] + x;
+	if (probe->state != LIGHTPROBE_EMPTY)
+		return probe;
+
+	start[0] = lightgrid.mins[0] + x * lightgrid.cellsize[0];
+	start[1] = lightgrid.mins[1] + y * lightgrid.cellsize[1];
+	start[2] = lightgrid.mins[2] + z * lightgrid.cellsize[2];
+
+	memset (probe->styles, 255, sizeof(probe->styles));
+	if (Mod_PointInLeaf (start, cl.worldmodel)->contents == CONTENTS_SOLID)
+	{
+		probe->state = LIGHTPROBE_SOLID;
+		return probe;
+	}
+	probe->state = LIGHTPROBE_LIT;
+
+	VectorCopy (start, end);
+	end[2] -= 8192;
+
+	surf = RecursiveLightPointSurface (cl.worldmodel->nodes, start, end, &ds, &dt);
+	if (!surf || !surf->samples)
+		return probe;
+
+	// same bilinear filter as RecursiveLightPoint, one style at a time
+	dsfrac = ds & 15;
+	dtfrac = dt & 15;
+	line3 = ((surf->extents[0]>>4)+1)*3;
+	size3 = ((surf->extents[0]>>4)+1) * ((surf->extents[1]>>4)+1)*3;
+	lightmap = surf->samples + ((dt>>4) * ((surf->extents[0]>>4)+1) + (ds>>4))*3;
+
+	for (maps = 0;maps < MAXLIGHTMAPS && surf->styles[maps] != 255;maps++, lightmap += size3)
+	{
+		probe->styles[maps] = surf->styles[maps];
+		for (i=0 ; i<3 ; i++)
+		{
+			c00 = lightmap[i];
+			c01 = lightmap[3+i];
+			c10 = lightmap[line3+i];
+			c11 = lightmap[line3+3+i];
+			c00 += ((c01 - c00) * dsfrac) >> 4;
+			c10 += ((c11 - c10) * dsfrac) >> 4;
+			probe->color[maps][i] = c00 + (((c10 - c00) * dtfrac) >> 4);
+		}
+	}
+
+	return probe;
+}
+
+/*
+=============
+R_LightGridPoint -- trilinear lookup into the light grid.  returns false if the
+point is outside the grid or every surrounding probe is in a wall.
+=============
+*/
+static qboolean R_LightGridPoint (vec3_t p, vec3_t color)
+{
+	lightprobe_t	*probe;
+	float			frac[3], pos, w, total, scale;
+	int				base[3], i, corner, maps;
+
+	for (i=0 ; i<3 ; i++)
+	{
+		pos = (p[i] - lightgrid.mins[i]) / lightgrid.cellsize[i];
+		base[i] = (int)floor (pos);
+		if (base[i] < 0 || base[i] >= lightgrid.size[i] - 1)
+			return false;
+		frac[i] = pos - base[i];
+	}
+
+	color[0] = color[1] = color[2] = 0;
+	total = 0;
+	for (corner=0 ; corner<8 ; corner++)
+	{
+		w  = (corner & 1) ? frac[0] : 1 - frac[0];
+		w *= (corner & 2) ? frac[1] : 1 - frac[1];
+		w *= (corner & 4) ? frac[2] : 1 - frac[2];
+		if (w <= 0)
+			continue;
+
+		probe = R_LightGridProbe (base[0] + (corner & 1), base[1] + ((corner >> 1) & 1), base[2] + ((corner >> 2) & 1));
+		if (probe->state == LIGHTPROBE_SOLID)
+			continue;
+
+		for (maps = 0;maps < MAXLIGHTMAPS && probe->styles[maps] != 255;maps++)
+		{
+			scale = w * d_lightstylevalue[probe->styles[maps]] * (1.0f / 256.0f);
+			color[0] += probe->color[maps][0] * scale;
+			color[1] += probe->color[maps][1] * scale;
+			color[2] += probe->color[maps][2] * scale;
+		}
+		total += w;
+	}
+
+	if (total < 0.001f)
+		return false;
+
+	VectorScale (color, 1.0f / total, color);
+	return true;
+}
+
+/*
+=============
+R_LightPointForModel -- model lighting, from the light grid when possible
+=============
+*/
+void R_LightPointForModel (vec3_t p)
+{
+	if (r_lightgrid.value && lightgrid.probes && R_LightGridPoint (p, lightcolor))
+		return;
+
+	R_LightPoint (p);
+}
@@ -114,6 +114,8 @@ cvar_t	r_lavaalpha = {"r_lavaalpha","0",CVAR_NONE};
 cvar_t	r_telealpha = {"r_telealpha","0",CVAR_NONE};
 cvar_t	r_slimealpha = {"r_slimealpha","0",CVAR_NONE};
 
+cvar_t	r_lightgrid = {"r_lightgrid","1",CVAR_ARCHIVE};
+
 float	map_wateralpha, map_lavaalpha, map_telealpha, map_slimealpha;
 
 qboolean r_drawflat_cheatsafe, r_fullbright_cheatsafe, r_lightmap_cheatsafe, r_drawworld_cheatsafe; //johnfitz
@@ -320,13 +322,11 @@ qboolean R_CullBox (vec3_t emins, vec3_t emaxs)
 }
 /*
 ===============
-R_CullModelForEntity -- johnfitz -- uses correct bounds based on rotation
+R_EntityBounds -- johnfitz -- uses correct bounds based on rotation
 ===============
 */
-qboolean R_CullModelForEntity (entity_t *e)
+void R_EntityBounds (entity_t *e, vec3_t mins, vec3_t maxs)
 {
-	vec3_t mins, maxs;
-
 	if (e->angles[0] || e->angles[2]) //pitch or roll
 	{
 		VectorAdd (e->origin, e->model->rmins, mins);
@@ -342,8 +342,20 @@ qboolean R_CullModelForEntity (entity_t *e)
 		VectorAdd (e->origin, e->model->mins, mins);
 		VectorAdd (e->origin, e->model->maxs, maxs);
 	}
+}
 
-	return R_CullBox (mins, maxs);
+/*
+===============
+R_CullModelForEntity
+===============
+*/
+qboolean R_CullModelForEntity (entity_t *e)
+{
+	vec3_t mins, maxs;
+
+	R_EntityBounds (e, mins, maxs);
+
+	return R_CullBox (mins, maxs) || Occlusion_CullBox (mins, maxs);
 }
 
 /*
@@ -552,6 +564,7 @@ void R_SetupScene (void)
 	R_AnimateLight ();
 	r_framecount++;
 	R_SetupGL ();
+	Occlusion_SetupScene ();
 }
 
 /*
@@ -593,11 +606,15 @@ void R_SetupView (void)
 
 	R_SetFrustum (r_fovx, r_fovy); //johnfitz -- use r_fov* vars
 
+	CL_AddVisibleEntities (); //add dynamic entities before R_MarkSurfaces adds static ones
+
 	R_MarkSurfaces (); //johnfitz -- create texture chains from PVS
 
 	R_CullSurfaces (); //johnfitz -- do after R_SetFrustum and R_MarkSurfaces
 
+	gl_statphase = GLPHASE_WATER;
 	R_UpdateWarpTextures (); //johnfitz -- do this before R_Clear
+	gl_statphase = GLPHASE_OTHER;
 
 	R_Clear ();
 
@@ -932,28 +949,37 @@ void R_RenderScene (void)
 
 	Fog_EnableGFog (); //johnfitz
 
+	gl_statphase = GLPHASE_SKY;
 	Sky_DrawSky (); //johnfitz
 
+	gl_statphase = GLPHASE_WORLD;
 	R_DrawWorld ();
 
 	S_ExtraUpdate (); // don't let sound get messed up if going slow
 
+	gl_statphase = GLPHASE_ENTITIES;
 	R_DrawShadows (); //johnfitz -- render entity shadows
 
 	R_DrawEntitiesOnList (false); //johnfitz -- false means this is the pass for nonalpha entities
 
+	gl_statphase = GLPHASE_WATER;
 	R_DrawWorld_Water (); //johnfitz -- drawn here since they might have transparency
 
+	gl_statphase = GLPHASE_ENTITIES;
 	R_DrawEntitiesOnList (true); //johnfitz -- true means this is the pass for alpha entities
 
+	gl_statphase = GLPHASE_OTHER;
 	R_RenderDlights (); //triangle fan dlights -- johnfitz -- moved after water
 
+	gl_statphase = GLPHASE_PARTICLES;
 	R_DrawParticles ();
 
 	Fog_DisableGFog (); //johnfitz
 
+	gl_statphase = GLPHASE_ENTITIES;
 	R_DrawViewModel (); //johnfitz -- moved here from R_RenderView
 
+	gl_statphase = GLPHASE_OTHER;
 	R_ShowTris (); //johnfitz
 
 	R_ShowBoundingBoxes (); //johnfitz
@@ -429,6 +429,7 @@ void SCR_Init (void)
 	Cvar_RegisterVariable (&gl_triplebuffer);
 
 	Cmd_AddCommand ("screenshot",SCR_ScreenShot_f);
+	Capture_Init ();
 	Cmd_AddCommand ("sizeup",SCR_SizeUp_f);
 	Cmd_AddCommand ("sizedown",SCR_SizeDown_f);
 
@@ -770,16 +771,19 @@ SCR_ScreenShot_f -- johnfitz -- rewritten to use Image_WriteTGA
 */
 void SCR_ScreenShot_f (void)
 {
-	byte	*buffer;
-	char	tganame[16];  //johnfitz -- was [80]
+	static int	lastshot = -1; // files are written in the background, so don't hand out a name twice
+	char	basename[16];  //johnfitz -- was [80]
 	char	checkname[MAX_OSPATH];
 	int	i;
 
+	if (Capture_PendingName ())
+		return;	// already taking one this frame
+
 // find a file name to save it to
-	for (i=0; i<10000; i++)
+	for (i=lastshot+1; i<10000; i++)
 	{
-		q_snprintf (tganame, sizeof(tganame), "spasm%04i.tga", i);	// "fitz%04i.tga"
-		q_snprintf (checkname, sizeof(checkname), "%s/%s", com_gamedir, tganame);
+		q_snprintf (basename, sizeof(basename), "spasm%04i", i);	// "fitz%04i.tga"
+		q_snprintf (checkname, sizeof(checkname), "%s/%s.tga", com_gamedir, basename);
 		if (Sys_FileTime(checkname) == -1)
 			break;	// file doesn't exist
 	}
@@ -788,24 +792,10 @@ void SCR_ScreenShot_f (void)
 		Con_Printf ("SCR_ScreenShot_f: Couldn't find an unused filename\n");
 		return;
 	}
+	lastshot = i;
 
-//get data
-	if (!(buffer = (byte *) malloc(glwidth*glheight*3)))
-	{
-		Con_Printf ("SCR_ScreenShot_f: Couldn't allocate memory\n");
-		return;
-	}
-
-	glPixelStorei (GL_PACK_ALIGNMENT, 1);/* for widths that aren't a multiple of 4 */
-	glReadPixels (glx, gly, glwidth, glheight, GL_RGB, GL_UNSIGNED_BYTE, buffer);
-
-// now write the file
-	if (Image_WriteTGA (tganame, buffer, glwidth, glheight, 24, false))
-		Con_Printf ("Wrote %s\n", tganame);
-	else
-		Con_Printf ("SCR_ScreenShot_f: Couldn't create a TGA file\n");
-
-	free (buffer);
+// read back at the end of the next frame, and write once the pixels arrive
+	Capture_Request (basename);
 }
 
 
@@ -999,6 +989,8 @@ void SCR_UpdateScreenContent(void)
 {
 	V_RenderView();
 
+	gl_statphase = GLPHASE_2D;
+
 	if (vr_enabled.value && !con_forcedup)
 	{
 		VR_Draw2D();
@@ -1043,6 +1035,7 @@ void SCR_UpdateScreenContent(void)
 			SCR_CheckDrawCenterString();
 			Sbar_Draw();
 			SCR_DrawDevStats(); //johnfitz
+			GLStats_Draw ();
 			SCR_DrawFPS(); //johnfitz
 			SCR_DrawClock(); //johnfitz
 			SCR_DrawConsole();
@@ -1053,6 +1046,8 @@ void SCR_UpdateScreenContent(void)
 	V_UpdateBlend(); //johnfitz -- V_UpdatePalette cleaned up and renamed
 
 	GLSLGamma_GammaCorrect();
+
+	gl_statphase = GLPHASE_OTHER;
 }
 
 /*
@@ -1111,6 +1106,10 @@ void SCR_UpdateScreen (void)
 		SCR_UpdateScreenContent();
 	}
 
+	TexMgr_EnforceBudget ();
+	Capture_EndFrame ();
+	GLStats_EndFrame ();
+
 	GL_EndRendering ();
 }
 
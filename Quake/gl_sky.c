@@ -45,6 +45,7 @@ cvar_t r_fastsky = {"r_fastsky", "0", CVAR_NONE};
 cvar_t r_sky_quality = {"r_sky_quality", "12", CVAR_NONE};
 cvar_t r_skyalpha = {"r_skyalpha", "1", CVAR_NONE};
 cvar_t r_skyfog = {"r_skyfog","0.5",CVAR_NONE};
+cvar_t r_skyshader = {"r_skyshader", "1", CVAR_ARCHIVE};
 
 int		skytexorder[6] = {0,2,1,3,4,5}; //for skybox
 
@@ -79,6 +80,36 @@ int	vec_to_st[6][3] =
 
 float	skyfog; // ericw
 
+// world sky bounds, valid for as long as the surface chains and view leaf are
+typedef struct
+{
+	qmodel_t	*model;
+	mleaf_t		*leaf;
+	int			visframe;
+	float		mins[2][6], maxs[2][6];
+} skyboundscache_t;
+
+static skyboundscache_t	skycache;
+static qboolean	sky_clippolys; //false if the bounds aren't needed, or come from skycache
+
+static GLuint r_skybox_program;
+static GLuint r_skylayers_program;
+static GLuint sky_cubemap;
+
+// uniforms used in the sky shaders
+static GLuint skyboxEyePosLoc;
+static GLuint skyboxTexLoc;
+static GLuint skyboxFogColorLoc;
+static GLuint skyboxSkyFogLoc;
+static GLuint skylayersEyePosLoc;
+static GLuint skylayersSolidTexLoc;
+static GLuint skylayersAlphaTexLoc;
+static GLuint skylayersSolidScrollLoc;
+static GLuint skylayersAlphaScrollLoc;
+static GLuint skylayersLayerAlphaLoc;
+static GLuint skylayersFogColorLoc;
+static GLuint skylayersSkyFogLoc;
+
 //==============================================================================
 //
 //  INIT
@@ -159,6 +190,8 @@ void Sky_LoadSkyBox (const char *name)
 	if (strcmp(skybox_name, name) == 0)
 		return; //no change
 
+	Sky_DeleteCubeMap ();
+
 	//purge old textures
 	for (i=0; i<6; i++)
 	{
@@ -226,6 +259,8 @@ void Sky_NewMap (void)
 	for (i=0; i<6; i++)
 		skybox_textures[i] = NULL;
 	skyfog = r_skyfog.value;
+	Sky_DeleteCubeMap ();
+	skycache.model = NULL;
 
 	//
 	// read worldspawn (this is so ugly, and shouldn't it be done on the server?)
@@ -318,6 +353,7 @@ void Sky_Init (void)
 	Cvar_RegisterVariable (&r_skyalpha);
 	Cvar_RegisterVariable (&r_skyfog);
 	Cvar_SetCallback (&r_skyfog, R_SetSkyfog_f);
+	Cvar_RegisterVariable (&r_skyshader);
 
 	Cmd_AddCommand ("sky",Sky_SkyCommand_f);
 
@@ -509,7 +545,7 @@ void Sky_ClipPoly (int nump, vec3_t vecs, int stage)
 Sky_ProcessPoly
 ================
 */
-void Sky_ProcessPoly (glpoly_t	*p)
+void Sky_ProcessPoly (glpoly_t	*p, qboolean clip)
 {
 	int			i;
 	vec3_t		verts[MAX_CLIP_VERTS];
@@ -519,7 +555,7 @@ void Sky_ProcessPoly (glpoly_t	*p)
 	rs_brushpasses++;
 
 	//update sky bounds
-	if (!r_fastsky.value)
+	if (clip)
 	{
 		for (i=0 ; i<p->numverts ; i++)
 			VectorSubtract (p->verts[i], r_origin, verts[i]);
@@ -527,6 +563,113 @@ void Sky_ProcessPoly (glpoly_t	*p)
 	}
 }
 
+/*
+================
+Sky_ClipLeafBox
+
+adds the sky bounds of box mins/maxs as seen from anywhere in leaf, by
+clipping the sides of the box of all offsets between the two that face the
+origin.  returns false if the boxes touch, so every direction is possible.
+================
+*/
+static qboolean Sky_ClipLeafBox (float *mins, float *maxs, mleaf_t *leaf)
+{
+	vec3_t	dmins, dmaxs, verts[MAX_CLIP_VERTS];
+	float	d;
+	int		i, a, b;
+
+	for (i=0 ; i<3 ; i++)
+	{
+		dmins[i] = mins[i] - leaf->minmaxs[3+i];
+		dmaxs[i] = maxs[i] - leaf->minmaxs[i];
+	}
+
+	if (dmins[0] <= 0 && dmaxs[0] >= 0 &&
+		dmins[1] <= 0 && dmaxs[1] >= 0 &&
+		dmins[2] <= 0 && dmaxs[2] >= 0)
+		return false;
+
+	for (i=0 ; i<3 ; i++)
+	{
+		if (dmins[i] > 0)
+			d = dmins[i];
+		else if (dmaxs[i] < 0)
+			d = dmaxs[i];
+		else
+			continue;
+
+		a = (i+1)%3;
+		b = (i+2)%3;
+		verts[0][i] = verts[1][i] = verts[2][i] = verts[3][i] = d;
+		verts[0][a] = dmins[a];	verts[0][b] = dmins[b];
+		verts[1][a] = dmaxs[a];	verts[1][b] = dmins[b];
+		verts[2][a] = dmaxs[a];	verts[2][b] = dmaxs[b];
+		verts[3][a] = dmins[a];	verts[3][b] = dmaxs[b];
+		Sky_ClipPoly (4, verts[0], 0);
+	}
+
+	return true;
+}
+
+/*
+================
+Sky_CacheWorldBounds
+
+the bounds of every world sky surface in the chains, for any view origin in
+r_viewleaf.  only redone when R_MarkSurfaces rebuilds the chains or the leaf
+changes, instead of clipping each poly every frame.  returns false if the
+view leaf is no use, and the polys have to be clipped as before.
+================
+*/
+static qboolean Sky_CacheWorldBounds (void)
+{
+	int			i, j;
+	msurface_t	*s;
+	texture_t	*t;
+
+	if (!r_viewleaf || r_viewleaf == cl.worldmodel->leafs || r_viewleaf->contents == CONTENTS_SOLID)
+		return false;
+
+	if (skycache.model != cl.worldmodel || skycache.leaf != r_viewleaf || skycache.visframe != r_visframecount)
+	{
+		for (i=0 ; i<cl.worldmodel->numtextures ; i++)
+		{
+			t = cl.worldmodel->textures[i];
+
+			if (!t || !t->texturechains[chain_world] || !(t->texturechains[chain_world]->flags & SURF_DRAWSKY))
+				continue;
+
+			for (s = t->texturechains[chain_world]; s; s = s->texturechain)
+				if (!Sky_ClipLeafBox (s->mins, s->maxs, r_viewleaf))
+					break;
+			if (s)
+				break;
+		}
+
+		if (i < cl.worldmodel->numtextures) //can't narrow it down
+		{
+			for (j=0 ; j<6 ; j++)
+			{
+				skymins[0][j] = skymins[1][j] = -1;
+				skymaxs[0][j] = skymaxs[1][j] = 1;
+			}
+		}
+
+		memcpy (skycache.mins, skymins, sizeof(skycache.mins));
+		memcpy (skycache.maxs, skymaxs, sizeof(skycache.maxs));
+		skycache.model = cl.worldmodel;
+		skycache.leaf = r_viewleaf;
+		skycache.visframe = r_visframecount;
+	}
+	else
+	{
+		memcpy (skymins, skycache.mins, sizeof(skymins));
+		memcpy (skymaxs, skycache.maxs, sizeof(skymaxs));
+	}
+
+	return true;
+}
+
 /*
 ================
 Sky_ProcessTextureChains -- handles sky polys in world model
@@ -537,10 +680,13 @@ void Sky_ProcessTextureChains (void)
 	int			i;
 	msurface_t	*s;
 	texture_t	*t;
+	qboolean	clip;
 
 	if (!r_drawworld_cheatsafe)
 		return;
 
+	clip = sky_clippolys && !Sky_CacheWorldBounds ();
+
 	for (i=0 ; i<cl.worldmodel->numtextures ; i++)
 	{
 		t = cl.worldmodel->textures[i];
@@ -550,7 +696,7 @@ void Sky_ProcessTextureChains (void)
 
 		for (s = t->texturechains[chain_world]; s; s = s->texturechain)
 			if (!s->culled)
-				Sky_ProcessPoly (s->polys);
+				Sky_ProcessPoly (s->polys, clip);
 	}
 }
 
@@ -629,7 +775,7 @@ void Sky_ProcessEntities (void)
 						else
 							VectorAdd(s->polys->verts[k], e->origin, p->verts[k]);
 					}
-					Sky_ProcessPoly (p);
+					Sky_ProcessPoly (p, sky_clippolys);
 					Hunk_FreeToLowMark (mark);
 				}
 			}
@@ -970,6 +1116,284 @@ void Sky_DrawSkyLayers (void)
 		glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
 }
 
+//==============================================================================
+//
+//  GLSL SKY
+//
+//==============================================================================
+
+/*
+=============
+GLSky_CreateShaders
+
+both shaders work out the sky per pixel from the direction to the eye, so the
+sky polys can be drawn with them directly, with no bounds or GEQUAL pass.
+the cloud layers shader is Sky_GetTexCoord with a blend of the two layers.
+=============
+*/
+void GLSky_CreateShaders (void)
+{
+	const GLchar *vertSource = \
+		"#version 110\n"
+		"\n"
+		"uniform vec3 EyePos;\n"
+		"varying vec3 Dir;\n"
+		"void main()\n"
+		"{\n"
+		"	Dir = gl_Vertex.xyz - EyePos;\n"
+		"	gl_Position = ftransform();\n"
+		"}\n";
+
+	const GLchar *boxFragSource = \
+		"#version 110\n"
+		"\n"
+		"uniform samplerCube Tex;\n"
+		"uniform vec3 FogColor;\n"
+		"uniform float SkyFog;\n"
+		"varying vec3 Dir;\n"
+		"void main()\n"
+		"{\n"
+		"	vec3 result = textureCube(Tex, Dir).rgb;\n"
+		"	gl_FragColor = vec4(mix(result, FogColor, SkyFog), 1.0);\n"
+		"}\n";
+
+	const GLchar *layersFragSource = \
+		"#version 110\n"
+		"\n"
+		"uniform sampler2D SolidTex;\n"
+		"uniform sampler2D AlphaTex;\n"
+		"uniform float SolidScroll;\n"
+		"uniform float AlphaScroll;\n"
+		"uniform float LayerAlpha;\n"
+		"uniform vec3 FogColor;\n"
+		"uniform float SkyFog;\n"
+		"varying vec3 Dir;\n"
+		"void main()\n"
+		"{\n"
+		"	vec3 dir = vec3(Dir.xy, Dir.z * 3.0);\n"
+		"	vec2 st = dir.xy * ((6.0 * 63.0) / length(dir));\n"
+		"	vec3 solid = texture2D(SolidTex, (st + SolidScroll) * (1.0 / 128.0)).rgb;\n"
+		"	vec4 layer = texture2D(AlphaTex, (st + AlphaScroll) * (1.0 / 128.0));\n"
+		"	vec3 result = mix(solid, layer.rgb, layer.a * LayerAlpha);\n"
+		"	gl_FragColor = vec4(mix(result, FogColor, SkyFog), 1.0);\n"
+		"}\n";
+
+	if (!gl_glsl_able)
+		return;
+
+	r_skybox_program = GL_CreateProgram (vertSource, boxFragSource, 0, NULL);
+
+	if (r_skybox_program != 0)
+	{
+	// get uniform locations
+		skyboxEyePosLoc = GL_GetUniformLocation (&r_skybox_program, "EyePos");
+		skyboxTexLoc = GL_GetUniformLocation (&r_skybox_program, "Tex");
+		skyboxFogColorLoc = GL_GetUniformLocation (&r_skybox_program, "FogColor");
+		skyboxSkyFogLoc = GL_GetUniformLocation (&r_skybox_program, "SkyFog");
+	}
+
+	r_skylayers_program = GL_CreateProgram (vertSource, layersFragSource, 0, NULL);
+
+	if (r_skylayers_program != 0)
+	{
+	// get uniform locations
+		skylayersEyePosLoc = GL_GetUniformLocation (&r_skylayers_program, "EyePos");
+		skylayersSolidTexLoc = GL_GetUniformLocation (&r_skylayers_program, "SolidTex");
+		skylayersAlphaTexLoc = GL_GetUniformLocation (&r_skylayers_program, "AlphaTex");
+		skylayersSolidScrollLoc = GL_GetUniformLocation (&r_skylayers_program, "SolidScroll");
+		skylayersAlphaScrollLoc = GL_GetUniformLocation (&r_skylayers_program, "AlphaScroll");
+		skylayersLayerAlphaLoc = GL_GetUniformLocation (&r_skylayers_program, "LayerAlpha");
+		skylayersFogColorLoc = GL_GetUniformLocation (&r_skylayers_program, "FogColor");
+		skylayersSkyFogLoc = GL_GetUniformLocation (&r_skylayers_program, "SkyFog");
+	}
+}
+
+/*
+=============
+Sky_DeleteCubeMap
+=============
+*/
+void Sky_DeleteCubeMap (void)
+{
+	if (sky_cubemap)
+	{
+		glDeleteTextures (1, &sky_cubemap);
+		sky_cubemap = 0;
+	}
+}
+
+/*
+=============
+Sky_BuildCubeMap
+
+resamples the six skybox textures into a cube map.  each texel's direction
+is found from the GL cube map face layout, then looked up in the skybox the
+same way Sky_ProjectPoly and Sky_EmitSkyBoxVertex would.
+=============
+*/
+static void Sky_BuildCubeMap (void)
+{
+	byte	*faces[6], *out, *src;
+	int		size, maxsize, mark;
+	int		i, j, f, x, y, axis, w, h;
+	float	sc, tc, s, t, dv;
+	vec3_t	dir, av;
+
+	mark = Hunk_LowMark ();
+
+	size = 1;
+	for (i=0 ; i<6 ; i++)
+	{
+		GL_Bind (skybox_textures[i]);
+		faces[i] = (byte *) Hunk_Alloc (skybox_textures[i]->width * skybox_textures[i]->height * 4);
+		glGetTexImage (GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, faces[i]);
+		size = q_max(size, (int)q_max(skybox_textures[i]->width, skybox_textures[i]->height));
+	}
+	glGetIntegerv (GL_MAX_CUBE_MAP_TEXTURE_SIZE, &maxsize);
+	size = q_min(size, maxsize);
+
+	out = (byte *) Hunk_Alloc (size * size * 4);
+
+	glGenTextures (1, &sky_cubemap);
+	glBindTexture (GL_TEXTURE_CUBE_MAP, sky_cubemap);
+
+	for (f=0 ; f<6 ; f++)
+	{
+		for (y=0 ; y<size ; y++)
+		{
+			for (x=0 ; x<size ; x++)
+			{
+				sc = (x + 0.5) * 2 / size - 1;
+				tc = (y + 0.5) * 2 / size - 1;
+
+				switch (f)
+				{
+				case 0:	dir[0] = 1;		dir[1] = -tc;	dir[2] = -sc;	break; //+x
+				case 1:	dir[0] = -1;	dir[1] = -tc;	dir[2] = sc;	break; //-x
+				case 2:	dir[0] = sc;	dir[1] = 1;		dir[2] = tc;	break; //+y
+				case 3:	dir[0] = sc;	dir[1] = -1;	dir[2] = -tc;	break; //-y
+				case 4:	dir[0] = sc;	dir[1] = -tc;	dir[2] = 1;		break; //+z
+				default: dir[0] = -sc;	dir[1] = -tc;	dir[2] = -1;	break; //-z
+				}
+
+				av[0] = fabs(dir[0]);
+				av[1] = fabs(dir[1]);
+				av[2] = fabs(dir[2]);
+				if (av[0] > av[1] && av[0] > av[2])
+					axis = (dir[0] < 0) ? 1 : 0;
+				else if (av[1] > av[2] && av[1] > av[0])
+					axis = (dir[1] < 0) ? 3 : 2;
+				else
+					axis = (dir[2] < 0) ? 5 : 4;
+
+				j = vec_to_st[axis][2];
+				dv = (j > 0) ? dir[j - 1] : -dir[-j - 1];
+				j = vec_to_st[axis][0];
+				s = (j < 0) ? -dir[-j - 1] / dv : dir[j - 1] / dv;
+				j = vec_to_st[axis][1];
+				t = (j < 0) ? -dir[-j - 1] / dv : dir[j - 1] / dv;
+
+				// convert from range [-1,1] to texels
+				i = skytexorder[axis];
+				w = skybox_textures[i]->width;
+				h = skybox_textures[i]->height;
+				s = (s + 1) * 0.5 * w;
+				t = (1 - (t + 1) * 0.5) * h;
+				src = faces[i] + (CLAMP(0, (int)t, h - 1) * w + CLAMP(0, (int)s, w - 1)) * 4;
+				memcpy (out + (y * size + x) * 4, src, 4);
+			}
+		}
+		glTexImage2D (GL_TEXTURE_CUBE_MAP_POSITIVE_X + f, 0, GL_RGB, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, out);
+	}
+
+	glTexParameteri (GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri (GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri (GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri (GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri (GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glBindTexture (GL_TEXTURE_CUBE_MAP, 0);
+
+	Hunk_FreeToLowMark (mark);
+}
+
+/*
+=============
+Sky_BeginShader
+
+sets up the sky shader for the sky polys, if it can be used.  returns false
+to draw the sky the old way.
+=============
+*/
+static qboolean Sky_BeginShader (void)
+{
+	float	*c, fog, scroll;
+	int		i;
+
+	if (!r_skyshader.value || r_fastsky.value || (Fog_GetDensity() > 0 && skyfog >= 1))
+		return false;
+
+	c = Fog_GetColor ();
+	fog = (Fog_GetDensity() > 0) ? CLAMP(0.0, skyfog, 1.0) : 0;
+
+	if (skybox_name[0])
+	{
+		if (!r_skybox_program)
+			return false;
+		for (i=0 ; i<6 ; i++)
+			if (skybox_textures[i] == notexture)
+				return false;
+
+		GL_SelectTexture (GL_TEXTURE0);
+		if (!sky_cubemap)
+			Sky_BuildCubeMap ();
+
+		GL_UseProgramFunc (r_skybox_program);
+		GL_Uniform3fFunc (skyboxEyePosLoc, r_origin[0], r_origin[1], r_origin[2]);
+		GL_Uniform1iFunc (skyboxTexLoc, 0);
+		GL_Uniform3fFunc (skyboxFogColorLoc, c[0], c[1], c[2]);
+		GL_Uniform1fFunc (skyboxSkyFogLoc, fog);
+		glBindTexture (GL_TEXTURE_CUBE_MAP, sky_cubemap);
+	}
+	else
+	{
+		if (!r_skylayers_program || !solidskytexture || !alphaskytexture)
+			return false;
+
+		GL_UseProgramFunc (r_skylayers_program);
+		GL_Uniform3fFunc (skylayersEyePosLoc, r_origin[0], r_origin[1], r_origin[2]);
+		GL_Uniform1iFunc (skylayersSolidTexLoc, 0);
+		GL_Uniform1iFunc (skylayersAlphaTexLoc, 1);
+		scroll = cl.time*8;
+		scroll -= (int)scroll & ~127;
+		GL_Uniform1fFunc (skylayersSolidScrollLoc, scroll);
+		scroll = cl.time*16;
+		scroll -= (int)scroll & ~127;
+		GL_Uniform1fFunc (skylayersAlphaScrollLoc, scroll);
+		GL_Uniform1fFunc (skylayersLayerAlphaLoc, CLAMP(0.0, r_skyalpha.value, 1.0));
+		GL_Uniform3fFunc (skylayersFogColorLoc, c[0], c[1], c[2]);
+		GL_Uniform1fFunc (skylayersSkyFogLoc, fog);
+
+		GL_SelectTexture (GL_TEXTURE1);
+		GL_Bind (alphaskytexture);
+		GL_SelectTexture (GL_TEXTURE0);
+		GL_Bind (solidskytexture);
+	}
+
+	return true;
+}
+
+/*
+=============
+Sky_EndShader
+=============
+*/
+static void Sky_EndShader (void)
+{
+	GL_UseProgramFunc (0);
+	if (skybox_name[0])
+		glBindTexture (GL_TEXTURE_CUBE_MAP, 0);
+}
+
 /*
 ==============
 Sky_DrawSky
@@ -985,6 +1409,20 @@ void Sky_DrawSky (void)
 	if (r_drawflat_cheatsafe || r_lightmap_cheatsafe )
 		return;
 
+	//
+	// shader sky: draw the sky surfs with it, no bounds needed
+	//
+	Fog_DisableGFog ();
+	if (Sky_BeginShader ())
+	{
+		sky_clippolys = false;
+		Sky_ProcessTextureChains ();
+		Sky_ProcessEntities ();
+		Sky_EndShader ();
+		Fog_EnableGFog ();
+		return;
+	}
+
 	//
 	// reset sky bounds
 	//
@@ -997,7 +1435,7 @@ void Sky_DrawSky (void)
 	//
 	// process world and bmodels: draw flat-shaded sky surfs, and update skybounds
 	//
-	Fog_DisableGFog ();
+	sky_clippolys = !r_fastsky.value;
 	glDisable (GL_TEXTURE_2D);
 	if (Fog_GetDensity() > 0)
 		glColor3fv (Fog_GetColor());
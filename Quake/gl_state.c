@@ -0,0 +1,446 @@
+/*
+Copyright (C) 1996-2001 Id Software, Inc.
+Copyright (C) 2002-2009 John Fitzgibbons and others
+Copyright (C) 2010-2014 QuakeSpasm developers
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// gl_state.c -- shadow copy of GL state, so that calls which would not change anything are skipped
+
+#define GL_NO_STATS	// this file makes the real calls
+#include "quakedef.h"
+
+#define GLSTATE_TMUS		4
+#define GLSTATE_ATTRIBS		16
+
+static const GLenum glstate_caps[] =
+{
+	GL_BLEND,
+	GL_DEPTH_TEST,
+	GL_ALPHA_TEST,
+	GL_CULL_FACE,
+	GL_FOG,
+	GL_POLYGON_OFFSET_FILL,
+	GL_POLYGON_OFFSET_LINE,
+	GL_SCISSOR_TEST,
+	GL_STENCIL_TEST
+};
+#define NUM_GLSTATE_CAPS	(sizeof(glstate_caps) / sizeof(glstate_caps[0]))
+
+typedef struct
+{
+	GLint		size;
+	GLenum		type;
+	GLboolean	normalized;
+	GLsizei		stride;
+	const GLvoid	*pointer;
+	GLuint		buffer;		// array buffer bound when the pointer was set
+} glarray_t;
+
+// everything is reset to all ones bits, which no real value matches: enums and
+// names become 0xffffffff, flags become 0xff and floats become NaN
+static struct
+{
+	byte		caps[NUM_GLSTATE_CAPS];
+	byte		texture2d[GLSTATE_TMUS];
+	GLint		texenvmode[GLSTATE_TMUS];
+	int		tmu, clienttmu;		// -1 when unknown
+
+	GLenum		blendsrc, blenddst;
+	GLboolean	depthmask;
+	GLenum		depthfunc;
+	GLclampd	depthnear, depthfar;
+	GLenum		alphafunc;
+	GLclampf	alpharef;
+	GLenum		cullface;
+	GLenum		shademodel;
+
+	byte		vertexarray, colorarray;
+	byte		texcoordarray[GLSTATE_TMUS];
+	byte		attribarray[GLSTATE_ATTRIBS];
+	glarray_t	vertexpointer;
+	glarray_t	texcoordpointer[GLSTATE_TMUS];
+	glarray_t	attribpointer[GLSTATE_ATTRIBS];
+
+	GLuint		arraybuffer, elementbuffer;
+	GLuint		program;
+} glstate;
+
+cvar_t	gl_statecache = {"gl_statecache","1",CVAR_NONE};
+
+/*
+================
+GLState_Skip -- the shadow copy is always kept up to date; gl_statecache 0 only stops
+the redundant calls from being dropped
+================
+*/
+static qboolean GLState_Skip (qboolean same)
+{
+	if (same && gl_statecache.value)
+	{
+		GL_STAT(elided, 1);
+		return true;
+	}
+
+	GL_STAT(states, 1);
+	return false;
+}
+
+/*
+================
+GLState_Invalidate -- forget everything, for a new context or after GL state was changed behind our back
+================
+*/
+void GLState_Invalidate (void)
+{
+	memset (&glstate, 0xff, sizeof(glstate));
+}
+
+static byte *GLState_Cap (GLenum cap)
+{
+	int	i;
+
+	if (cap == GL_TEXTURE_2D)
+		return (glstate.tmu >= 0) ? &glstate.texture2d[glstate.tmu] : NULL;
+
+	for (i=0 ; i<(int)NUM_GLSTATE_CAPS ; i++)
+		if (glstate_caps[i] == cap)
+			return &glstate.caps[i];
+
+	return NULL;
+}
+
+void GLState_Enable (GLenum cap)
+{
+	byte	*s = GLState_Cap (cap);
+
+	if (GLState_Skip (s && *s == 1))
+		return;
+	if (s)
+		*s = 1;
+	glEnable (cap);
+}
+
+void GLState_Disable (GLenum cap)
+{
+	byte	*s = GLState_Cap (cap);
+
+	if (GLState_Skip (s && *s == 0))
+		return;
+	if (s)
+		*s = 0;
+	glDisable (cap);
+}
+
+void GLState_BlendFunc (GLenum src, GLenum dst)
+{
+	if (GLState_Skip (glstate.blendsrc == src && glstate.blenddst == dst))
+		return;
+	glstate.blendsrc = src;
+	glstate.blenddst = dst;
+	glBlendFunc (src, dst);
+}
+
+void GLState_DepthMask (GLboolean flag)
+{
+	flag = flag ? GL_TRUE : GL_FALSE;
+	if (GLState_Skip (glstate.depthmask == flag))
+		return;
+	glstate.depthmask = flag;
+	glDepthMask (flag);
+}
+
+void GLState_DepthFunc (GLenum func)
+{
+	if (GLState_Skip (glstate.depthfunc == func))
+		return;
+	glstate.depthfunc = func;
+	glDepthFunc (func);
+}
+
+void GLState_DepthRange (GLclampd znear, GLclampd zfar)
+{
+	if (GLState_Skip (glstate.depthnear == znear && glstate.depthfar == zfar))
+		return;
+	glstate.depthnear = znear;
+	glstate.depthfar = zfar;
+	glDepthRange (znear, zfar);
+}
+
+void GLState_AlphaFunc (GLenum func, GLclampf ref)
+{
+	if (GLState_Skip (glstate.alphafunc == func && glstate.alpharef == ref))
+		return;
+	glstate.alphafunc = func;
+	glstate.alpharef = ref;
+	glAlphaFunc (func, ref);
+}
+
+void GLState_CullFace (GLenum mode)
+{
+	if (GLState_Skip (glstate.cullface == mode))
+		return;
+	glstate.cullface = mode;
+	glCullFace (mode);
+}
+
+void GLState_ShadeModel (GLenum mode)
+{
+	if (GLState_Skip (glstate.shademodel == mode))
+		return;
+	glstate.shademodel = mode;
+	glShadeModel (mode);
+}
+
+/*
+================
+GLState_TexEnvi -- only the per-TMU texture env mode is tracked, combiner setup always goes through
+================
+*/
+void GLState_TexEnvi (GLenum target, GLenum pname, GLint param)
+{
+	GLint	*s = NULL;
+
+	if (target == GL_TEXTURE_ENV && pname == GL_TEXTURE_ENV_MODE && glstate.tmu >= 0)
+		s = &glstate.texenvmode[glstate.tmu];
+
+	if (GLState_Skip (s && *s == param))
+		return;
+	if (s)
+		*s = param;
+	glTexEnvi (target, pname, param);
+}
+
+void GLState_TexEnvf (GLenum target, GLenum pname, GLfloat param)
+{
+	if (target == GL_TEXTURE_ENV && pname == GL_TEXTURE_ENV_MODE)
+		GLState_TexEnvi (target, pname, (GLint)param);
+	else
+	{
+		GL_STAT(states, 1);
+		glTexEnvf (target, pname, param);
+	}
+}
+
+void GLState_ActiveTexture (GLenum unit)
+{
+	int	tmu = unit - GL_TEXTURE0_ARB;
+
+	if (GLState_Skip (glstate.tmu == tmu))
+		return;
+	glstate.tmu = (tmu >= 0 && tmu < GLSTATE_TMUS) ? tmu : -1;
+	GL_SelectTextureFunc (unit);
+}
+
+void GLState_ClientActiveTexture (GLenum unit)
+{
+	int	tmu = unit - GL_TEXTURE0_ARB;
+
+	if (GLState_Skip (glstate.clienttmu == tmu))
+		return;
+	glstate.clienttmu = (tmu >= 0 && tmu < GLSTATE_TMUS) ? tmu : -1;
+	GL_ClientActiveTextureFunc (unit);
+}
+
+static byte *GLState_ClientArray (GLenum array)
+{
+	switch (array)
+	{
+	case GL_VERTEX_ARRAY:
+		return &glstate.vertexarray;
+	case GL_COLOR_ARRAY:
+		return &glstate.colorarray;
+	case GL_TEXTURE_COORD_ARRAY:
+		return (glstate.clienttmu >= 0) ? &glstate.texcoordarray[glstate.clienttmu] : NULL;
+	default:
+		return NULL;
+	}
+}
+
+void GLState_EnableClientState (GLenum array)
+{
+	byte	*s = GLState_ClientArray (array);
+
+	if (GLState_Skip (s && *s == 1))
+		return;
+	if (s)
+		*s = 1;
+	glEnableClientState (array);
+}
+
+void GLState_DisableClientState (GLenum array)
+{
+	byte	*s = GLState_ClientArray (array);
+
+	if (GLState_Skip (s && *s == 0))
+		return;
+	if (s)
+		*s = 0;
+	glDisableClientState (array);
+}
+
+/*
+================
+GLState_SetArray -- returns true if the pointer state is unchanged; a pointer is an offset
+into whatever array buffer is bound, so the binding is part of the key
+================
+*/
+static qboolean GLState_SetArray (glarray_t *a, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const GLvoid *pointer)
+{
+	if (a->size == size && a->type == type && a->normalized == normalized && a->stride == stride &&
+		a->pointer == pointer && a->buffer == glstate.arraybuffer && glstate.arraybuffer != (GLuint)-1)
+		return true;
+
+	a->size = size;
+	a->type = type;
+	a->normalized = normalized;
+	a->stride = stride;
+	a->pointer = pointer;
+	a->buffer = glstate.arraybuffer;
+	return false;
+}
+
+void GLState_VertexPointer (GLint size, GLenum type, GLsizei stride, const GLvoid *pointer)
+{
+	if (GLState_Skip (GLState_SetArray (&glstate.vertexpointer, size, type, GL_FALSE, stride, pointer)))
+		return;
+	glVertexPointer (size, type, stride, pointer);
+}
+
+void GLState_TexCoordPointer (GLint size, GLenum type, GLsizei stride, const GLvoid *pointer)
+{
+	qboolean	same = false;
+
+	if (glstate.clienttmu >= 0)
+		same = GLState_SetArray (&glstate.texcoordpointer[glstate.clienttmu], size, type, GL_FALSE, stride, pointer);
+	if (GLState_Skip (same))
+		return;
+	glTexCoordPointer (size, type, stride, pointer);
+}
+
+void GLState_VertexAttribPointer (GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const GLvoid *pointer)
+{
+	qboolean	same = false;
+
+	if (index < GLSTATE_ATTRIBS)
+		same = GLState_SetArray (&glstate.attribpointer[index], size, type, normalized, stride, pointer);
+	if (GLState_Skip (same))
+		return;
+	GL_VertexAttribPointerFunc (index, size, type, normalized, stride, pointer);
+}
+
+void GLState_EnableVertexAttribArray (GLuint index)
+{
+	byte	*s = (index < GLSTATE_ATTRIBS) ? &glstate.attribarray[index] : NULL;
+
+	if (GLState_Skip (s && *s == 1))
+		return;
+	if (s)
+		*s = 1;
+	GL_EnableVertexAttribArrayFunc (index);
+}
+
+void GLState_DisableVertexAttribArray (GLuint index)
+{
+	byte	*s = (index < GLSTATE_ATTRIBS) ? &glstate.attribarray[index] : NULL;
+
+	if (GLState_Skip (s && *s == 0))
+		return;
+	if (s)
+		*s = 0;
+	GL_DisableVertexAttribArrayFunc (index);
+}
+
+void GLState_BindBuffer (GLenum target, GLuint buffer)
+{
+	GLuint	*s;
+
+	switch (target)
+	{
+	case GL_ARRAY_BUFFER:
+		s = &glstate.arraybuffer;
+		break;
+	case GL_ELEMENT_ARRAY_BUFFER:
+		s = &glstate.elementbuffer;
+		break;
+	default:
+		s = NULL;
+		break;
+	}
+
+	if (GLState_Skip (s && *s == buffer))
+		return;
+	if (s)
+		*s = buffer;
+	GL_BindBufferFunc (target, buffer);
+}
+
+/*
+================
+GLState_DeleteBuffers -- deleting a bound buffer unbinds it, and the name may come straight back from glGenBuffers
+================
+*/
+void GLState_DeleteBuffers (GLsizei n, const GLuint *buffers)
+{
+	int	i, j;
+
+	for (i=0 ; i<n ; i++)
+	{
+		if (!buffers[i])
+			continue;
+		if (buffers[i] == glstate.arraybuffer)
+			glstate.arraybuffer = 0;
+		if (buffers[i] == glstate.elementbuffer)
+			glstate.elementbuffer = 0;
+
+		// a pointer set from the recycled name at the same offset must not be skipped
+		if (glstate.vertexpointer.buffer == buffers[i])
+			glstate.vertexpointer.buffer = (GLuint)-1;
+		for (j=0 ; j<GLSTATE_TMUS ; j++)
+			if (glstate.texcoordpointer[j].buffer == buffers[i])
+				glstate.texcoordpointer[j].buffer = (GLuint)-1;
+		for (j=0 ; j<GLSTATE_ATTRIBS ; j++)
+			if (glstate.attribpointer[j].buffer == buffers[i])
+				glstate.attribpointer[j].buffer = (GLuint)-1;
+	}
+	GL_DeleteBuffersFunc (n, buffers);
+}
+
+void GLState_UseProgram (GLuint program)
+{
+	if (GLState_Skip (glstate.program == program))
+		return;
+	glstate.program = program;
+	GL_UseProgramFunc (program);
+}
+
+void GLState_DeleteProgram (GLuint program)
+{
+	if (program == glstate.program)
+		glstate.program = (GLuint)-1;
+	GL_DeleteProgramFunc (program);
+}
+
+/*
+================
+GLState_Init
+================
+*/
+void GLState_Init (void)
+{
+	Cvar_RegisterVariable (&gl_statecache);
+}
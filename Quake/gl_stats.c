@@ -0,0 +1,261 @@
+/*
+Copyright (C) 1996-2001 Id Software, Inc.
+Copyright (C) 2002-2009 John Fitzgibbons and others
+Copyright (C) 2010-2014 QuakeSpasm developers
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// gl_stats.c -- per-frame accounting of GL calls, broken down by render phase
+
+#include "quakedef.h"
+
+glstats_t	gl_stats[NUM_GLPHASES];	// frame being rendered
+glphase_t	gl_statphase;
+
+static glstats_t	gl_laststats[NUM_GLPHASES];	// last completed frame
+static int		gl_statframes;			// frames completed since the log was opened
+static FILE		*gl_statlog;
+
+cvar_t	r_glstats = {"r_glstats","0",CVAR_NONE};
+
+static const char *gl_phasenames[NUM_GLPHASES] =
+{
+	"other",
+	"sky",
+	"world",
+	"ents",
+	"water",
+	"parts",
+	"2d"
+};
+
+/*
+================
+GLStats_TexUpload -- counts an image upload, with the size of the client data that was sent
+================
+*/
+void GLStats_TexUpload (int width, int height, unsigned int format, unsigned int type, const void *pixels)
+{
+	int	components, bytes;
+
+	GL_STAT(uploads, 1);
+
+	if (!pixels) //storage allocation only, nothing crosses the bus
+		return;
+
+	switch (format)
+	{
+	case GL_RGBA:
+	case GL_BGRA:	components = 4; break;
+	case GL_RGB:
+	case GL_BGR:	components = 3; break;
+	case GL_LUMINANCE_ALPHA:	components = 2; break;
+	default:	components = 1; break;
+	}
+
+	switch (type)
+	{
+	case GL_UNSIGNED_INT_8_8_8_8:
+	case GL_UNSIGNED_INT_8_8_8_8_REV:	bytes = 4; break; //packed, one int per pixel
+	case GL_UNSIGNED_INT:
+	case GL_INT:
+	case GL_FLOAT:	bytes = components * 4; break;
+	case GL_UNSIGNED_SHORT:
+	case GL_SHORT:	bytes = components * 2; break;
+	default:	bytes = components; break;
+	}
+
+	GL_STAT(uploadbytes, width * height * bytes);
+}
+
+/*
+================
+GLStats_Total
+================
+*/
+static void GLStats_Total (const glstats_t *phases, glstats_t *total)
+{
+	int	i;
+
+	memset (total, 0, sizeof(*total));
+	for (i=0 ; i<NUM_GLPHASES ; i++)
+	{
+		total->drawcalls += phases[i].drawcalls;
+		total->vertices += phases[i].vertices;
+		total->binds += phases[i].binds;
+		total->fbobinds += phases[i].fbobinds;
+		total->states += phases[i].states;
+		total->elided += phases[i].elided;
+		total->uploads += phases[i].uploads;
+		total->uploadbytes += phases[i].uploadbytes;
+	}
+}
+
+/*
+================
+GLStats_CloseLog
+================
+*/
+static void GLStats_CloseLog (void)
+{
+	if (!gl_statlog)
+		return;
+
+	fclose (gl_statlog);
+	gl_statlog = NULL;
+	Con_Printf ("glstats_log: closed after %i frames\n", gl_statframes);
+}
+
+/*
+================
+GLStats_EndFrame -- called once per presented frame, just before the buffer swap
+================
+*/
+void GLStats_EndFrame (void)
+{
+	glstats_t	*s;
+	int		i;
+
+	memcpy (gl_laststats, gl_stats, sizeof(gl_stats));
+	memset (gl_stats, 0, sizeof(gl_stats));
+	gl_statphase = GLPHASE_OTHER;
+	gl_statframes++;
+
+	if (!gl_statlog)
+		return;
+
+	fprintf (gl_statlog, "%i,%.4f", gl_statframes, realtime);
+	for (i=0 ; i<NUM_GLPHASES ; i++)
+	{
+		s = &gl_laststats[i];
+		fprintf (gl_statlog, ",%u,%u,%u,%u,%u,%u,%u,%u", s->drawcalls, s->vertices, s->binds,
+			s->fbobinds, s->states, s->elided, s->uploads, s->uploadbytes);
+	}
+	fputc ('\n', gl_statlog);
+}
+
+/*
+================
+GLStats_Print_f -- prints the counters of the last completed frame
+================
+*/
+static void GLStats_Print_f (void)
+{
+	glstats_t	total, *s;
+	int		i;
+
+	GLStats_Total (gl_laststats, &total);
+
+	Con_Printf ("phase   draws  verts binds  fbos states elided uploads     KB\n");
+	for (i=0 ; i<=NUM_GLPHASES ; i++)
+	{
+		s = (i < NUM_GLPHASES) ? &gl_laststats[i] : &total;
+		Con_Printf ("%-6s %6u %6u %5u %5u %6u %6u %7u %6u\n", (i < NUM_GLPHASES) ? gl_phasenames[i] : "total",
+			s->drawcalls, s->vertices, s->binds, s->fbobinds, s->states, s->elided, s->uploads, s->uploadbytes >> 10);
+	}
+}
+
+/*
+================
+GLStats_Log_f -- "glstats_log <file>" writes one CSV line per frame; no argument stops logging
+================
+*/
+static void GLStats_Log_f (void)
+{
+	char	name[MAX_OSPATH];
+	int	i;
+
+	GLStats_CloseLog ();
+
+	if (Cmd_Argc() < 2)
+		return;
+
+	q_snprintf (name, sizeof(name), "%s/%s", com_gamedir, Cmd_Argv(1));
+	COM_AddExtension (name, ".csv", sizeof(name));
+	COM_CreatePath (name);
+	gl_statlog = fopen (name, "w");
+	if (!gl_statlog)
+	{
+		Con_Printf ("ERROR: couldn't open file %s.\n", name);
+		return;
+	}
+
+	fprintf (gl_statlog, "frame,time");
+	for (i=0 ; i<NUM_GLPHASES ; i++)
+		fprintf (gl_statlog, ",%s_draws,%s_verts,%s_binds,%s_fbos,%s_states,%s_elided,%s_uploads,%s_bytes",
+			gl_phasenames[i], gl_phasenames[i], gl_phasenames[i], gl_phasenames[i],
+			gl_phasenames[i], gl_phasenames[i], gl_phasenames[i], gl_phasenames[i]);
+	fputc ('\n', gl_statlog);
+
+	gl_statframes = 0;
+	Con_Printf ("glstats_log: writing %s\n", name);
+}
+
+/*
+================
+GLStats_Draw -- r_glstats overlay, drawn next to the devstats box
+================
+*/
+void GLStats_Draw (void)
+{
+	char		str[48];
+	glstats_t	total, *s;
+	int		i, y;
+
+	if (!r_glstats.value)
+		return;
+
+	GLStats_Total (gl_laststats, &total);
+
+	GL_SetCanvas (CANVAS_TOPRIGHT);
+
+	y = 0;
+	Draw_Fill (0, y, 320, (NUM_GLPHASES+2)*8, 0, 0.5); //dark rectangle
+
+	Draw_String (0, y, "phase draw  vert bind fbo stat skip   KB");
+	y += 8;
+
+	for (i=0 ; i<=NUM_GLPHASES ; i++, y += 8)
+	{
+		s = (i < NUM_GLPHASES) ? &gl_laststats[i] : &total;
+		q_snprintf (str, sizeof(str), "%-5s%5u%6u%5u%4u%5u%5u%5u", (i < NUM_GLPHASES) ? gl_phasenames[i] : "total",
+			s->drawcalls, s->vertices, s->binds, s->fbobinds, s->states, s->elided, s->uploadbytes >> 10);
+		Draw_String (0, y, str);
+	}
+}
+
+/*
+================
+GLStats_Init
+================
+*/
+void GLStats_Init (void)
+{
+	Cvar_RegisterVariable (&r_glstats);
+	Cmd_AddCommand ("glstats", GLStats_Print_f);
+	Cmd_AddCommand ("glstats_log", GLStats_Log_f);
+}
+
+/*
+================
+GLStats_Shutdown
+================
+*/
+void GLStats_Shutdown (void)
+{
+	GLStats_CloseLog ();
+}
@@ -24,6 +24,18 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "quakedef.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TEX_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define TEX_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(TEX_SSE2) || defined(TEX_NEON)
+static qboolean texmgr_usesimd = true;	// cleared by timetextures for the scalar pass
+#endif
+
 const int	gl_solid_format = 3;
 const int	gl_alpha_format = 4;
 
@@ -31,11 +43,18 @@ static cvar_t	gl_texturemode = {"gl_texturemode", "", CVAR_ARCHIVE};
 static cvar_t	gl_texture_anisotropy = {"gl_texture_anisotropy", "1", CVAR_ARCHIVE};
 static cvar_t	gl_max_size = {"gl_max_size", "0", CVAR_NONE};
 static cvar_t	gl_picmip = {"gl_picmip", "0", CVAR_NONE};
+static cvar_t	gl_mipmap_gamma = {"gl_mipmap_gamma", "0", CVAR_ARCHIVE};	// applies to textures loaded afterwards
 static GLint	gl_hardware_maxsize;
 
 #define	MAX_GLTEXTURES	2048
 static int numgltextures;
 static gltexture_t	*active_gltextures, *free_gltextures;
+
+#define	TEXHASH_SIZE	1024	//buckets for TexMgr_FindTexture, a power of two
+static gltexture_t	*texmgr_hash[TEXHASH_SIZE];
+
+#define	BUDGET_MINAGE	60	//frames a texture has to go unbound before it can be evicted
+static cvar_t	gl_texture_budget = {"gl_texture_budget", "0", CVAR_ARCHIVE};	//megabytes, 0 for no limit
 gltexture_t		*notexture, *nulltexture;
 
 unsigned int d_8to24table[256];
@@ -137,7 +156,8 @@ static void TexMgr_TextureMode_f (cvar_t *var)
 			{
 				glmode_idx = i;
 				for (glt = active_gltextures; glt; glt = glt->next)
-					TexMgr_SetFilterModes (glt);
+					if (!glt->evicted) //gets them when it's reloaded
+						TexMgr_SetFilterModes (glt);
 				Sbar_Changed (); //sbar graphics need to be redrawn with new filter mode
 				//FIXME: warpimages need to be redrawn, too.
 			}
@@ -186,7 +206,7 @@ static void TexMgr_Anisotropy_f (cvar_t *var)
 		for (glt = active_gltextures; glt; glt = glt->next)
 		{
 		/*  TexMgr_SetFilterModes (glt);*/
-		    if (glt->flags & TEXPREF_MIPMAP) {
+		    if ((glt->flags & TEXPREF_MIPMAP) && !glt->evicted) {
 			GL_Bind (glt);
 			glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, glmodes[glmode_idx].magfilter);
 			glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, glmodes[glmode_idx].minfilter);
@@ -209,7 +229,7 @@ static void TexMgr_Imagelist_f (void)
 
 	for (glt = active_gltextures; glt; glt = glt->next)
 	{
-		Con_SafePrintf ("   %4i x%4i %s\n", glt->width, glt->height, glt->name);
+		Con_SafePrintf (" %c %4i x%4i %s\n", glt->evicted ? '-' : ' ', glt->width, glt->height, glt->name);
 		if (glt->flags & TEXPREF_MIPMAP)
 			texels += glt->width * glt->height * 4.0f / 3.0f;
 		else
@@ -298,6 +318,53 @@ float TexMgr_FrameUsage (void)
 ================================================================================
 */
 
+/*
+================
+TexMgr_HashName
+================
+*/
+static int TexMgr_HashName (qmodel_t *owner, const char *name)
+{
+	unsigned int	hash;
+
+	hash = COM_HashBytes (COM_HASH_INIT, &owner, sizeof(owner));
+	hash = COM_HashBytes (hash, name, strlen (name));
+	return hash & (TEXHASH_SIZE - 1);
+}
+
+/*
+================
+TexMgr_LinkHash -- once the owner and name are set; they don't change after that
+================
+*/
+static void TexMgr_LinkHash (gltexture_t *glt)
+{
+	int	i = TexMgr_HashName (glt->owner, glt->name);
+
+	glt->hashnext = texmgr_hash[i];
+	texmgr_hash[i] = glt;
+}
+
+/*
+================
+TexMgr_UnlinkHash
+================
+*/
+static void TexMgr_UnlinkHash (gltexture_t *glt)
+{
+	gltexture_t	**link;
+
+	for (link = &texmgr_hash[TexMgr_HashName (glt->owner, glt->name)]; *link; link = &(*link)->hashnext)
+	{
+		if (*link == glt)
+		{
+			*link = glt->hashnext;
+			break;
+		}
+	}
+	glt->hashnext = NULL;
+}
+
 /*
 ================
 TexMgr_FindTexture
@@ -309,7 +376,7 @@ gltexture_t *TexMgr_FindTexture (qmodel_t *owner, const char *name)
 
 	if (name)
 	{
-		for (glt = active_gltextures; glt; glt = glt->next)
+		for (glt = texmgr_hash[TexMgr_HashName (owner, name)]; glt; glt = glt->hashnext)
 		{
 			if (glt->owner == owner && !strcmp (glt->name, name))
 				return glt;
@@ -337,11 +404,17 @@ gltexture_t *TexMgr_NewTexture (void)
 	active_gltextures = glt;
 
 	glGenTextures(1, &glt->texnum);
+	glt->hashnext = NULL;
+	glt->evicted = false;
 	numgltextures++;
 	return glt;
 }
 
 static void GL_DeleteTexture (gltexture_t *texture);
+static void TexMgr_InitGammaTables (void);
+static void TexMgr_TimeTextures_f (void);
+static void TexMgr_InitCache (void);
+static unsigned int texmgr_palettehash;
 
 //ericw -- workaround for preventing TexMgr_FreeTexture during TexMgr_ReloadImages
 static qboolean in_reload_images;
@@ -364,6 +437,11 @@ void TexMgr_FreeTexture (gltexture_t *kill)
 		return;
 	}
 
+	// don't leave a queued image pointing at it
+	TexMgr_FlushBatch ();
+
+	TexMgr_UnlinkHash (kill);
+
 	if (active_gltextures == kill)
 	{
 		active_gltextures = kill->next;
@@ -443,6 +521,92 @@ void TexMgr_DeleteTextureObjects (void)
 	}
 }
 
+/*
+================================================================================
+
+	RESIDENCY
+
+================================================================================
+*/
+
+/*
+================
+TexMgr_TextureBytes -- roughly what a texture takes up on the card
+================
+*/
+static int TexMgr_TextureBytes (gltexture_t *glt)
+{
+	int	bytes;
+
+	bytes = glt->width * glt->height * ((glt->source_format == SRC_LIGHTMAP) ? lightmap_bytes : 4);
+	if (glt->flags & TEXPREF_MIPMAP)
+		bytes += bytes / 3;
+	return bytes;
+}
+
+/*
+================
+TexMgr_Evictable -- only textures that TexMgr_ReloadImage can read back from a file, and not the world's
+================
+*/
+static qboolean TexMgr_Evictable (gltexture_t *glt)
+{
+	if (glt->evicted || glt->flags & (TEXPREF_PERSIST | TEXPREF_WARPIMAGE))
+		return false;
+	if (glt->source_format == SRC_LIGHTMAP || !glt->source_file[0])
+		return false;
+	if (cl.worldmodel && glt->owner == cl.worldmodel)
+		return false;
+	return glt->visframe < r_framecount - BUDGET_MINAGE;
+}
+
+static int TexMgr_CompareVisframe (const void *a, const void *b)
+{
+	return (*(gltexture_t **)a)->visframe - (*(gltexture_t **)b)->visframe;
+}
+
+/*
+================
+TexMgr_EnforceBudget -- called once a frame; deletes the least recently bound textures while over gl_texture_budget
+================
+*/
+void TexMgr_EnforceBudget (void)
+{
+	static gltexture_t	*candidates[MAX_GLTEXTURES];
+	gltexture_t	*glt;
+	double		budget, total;
+	int		i, count, evicted;
+
+	budget = gl_texture_budget.value * 1024 * 1024;
+	if (budget <= 0)
+		return;
+
+	total = 0;
+	for (glt = active_gltextures; glt; glt = glt->next)
+		if (!glt->evicted)
+			total += TexMgr_TextureBytes (glt);
+	if (total <= budget)
+		return;
+
+	count = 0;
+	for (glt = active_gltextures; glt; glt = glt->next)
+		if (TexMgr_Evictable (glt))
+			candidates[count++] = glt;
+	qsort (candidates, count, sizeof(candidates[0]), TexMgr_CompareVisframe);
+
+	for (i = 0, evicted = 0; i < count && total > budget; i++)
+	{
+		glt = candidates[i];
+		total -= TexMgr_TextureBytes (glt);
+		GL_DeleteTexture (glt);
+		glt->evicted = true;
+		evicted++;
+	}
+
+	if (evicted)
+		Con_DPrintf ("gl_texture_budget: evicted %i textures, %.1f MB resident\n", evicted, total / (1024 * 1024));
+}
+
 /*
 ================================================================================
 
@@ -529,6 +693,9 @@ void TexMgr_LoadPalette (void)
 	memcpy(d_8to24table_conchars, d_8to24table, 256*4);
 	((byte *) &d_8to24table_conchars[0]) [3] = 0;
 
+	//the other palettes follow from this one, so it's all the texture cache needs to know
+	texmgr_palettehash = COM_HashBytes (COM_HASH_INIT, d_8to24table, sizeof(d_8to24table));
+
 	Hunk_FreeToLowMark (mark);
 }
 
@@ -616,9 +783,13 @@ void TexMgr_Init (void)
 
 	// palette
 	TexMgr_LoadPalette ();
+	TexMgr_InitGammaTables ();
 
 	Cvar_RegisterVariable (&gl_max_size);
 	Cvar_RegisterVariable (&gl_picmip);
+	Cvar_RegisterVariable (&gl_mipmap_gamma);
+	Cvar_RegisterVariable (&gl_texture_budget);
+	TexMgr_InitCache ();
 	Cvar_RegisterVariable (&gl_texture_anisotropy);
 	Cvar_SetCallback (&gl_texture_anisotropy, &TexMgr_Anisotropy_f);
 	gl_texturemode.string = glmodes[glmode_idx].name;
@@ -627,6 +798,7 @@ void TexMgr_Init (void)
 	Cmd_AddCommand ("gl_describetexturemodes", &TexMgr_DescribeTextureModes_f);
 	Cmd_AddCommand ("imagelist", &TexMgr_Imagelist_f);
 	Cmd_AddCommand ("imagedump", &TexMgr_Imagedump_f);
+	Cmd_AddCommand ("timetextures", &TexMgr_TimeTextures_f);
 
 	// poll max size from hardware
 	glGetIntegerv (GL_MAX_TEXTURE_SIZE, &gl_hardware_maxsize);
@@ -692,6 +864,127 @@ int TexMgr_PadConditional (int s)
 		return s;
 }
 
+/*
+a texture is loaded in two stages.  TexMgr_PrepareImage does the cpu work
+(palette conversion, padding, resampling, picmip and the mipmap chain) into
+buffers of its own, and may run on any thread.  TexMgr_UploadImage hands the
+result to GL, and only runs on the main thread.
+
+between TexMgr_BeginBatch and TexMgr_EndBatch, images are queued with a
+private copy of their pixels instead of being loaded.  each flush prepares
+the whole queue on the task threads, then uploads it in the order it was
+queued.  nothing outside the texture manager looks at a gltexture's size or
+pixels before it has been uploaded, so the deferral can't be seen.
+*/
+
+#define MAX_IMAGEALLOCS		8
+#define MAX_BATCHIMAGES		1024
+#define MAX_BATCHBYTES		(64*1024*1024)	// estimated working memory of a batch before it's flushed
+
+typedef struct
+{
+	gltexture_t	*glt;
+	char		name[64];
+	enum srcformat	format;
+	unsigned int	width, height;			// size of the prepared image
+	unsigned int	flags;					// with TEXPREF_ALPHA dropped if no pixel needs it
+	unsigned int	source_width, source_height;
+	byte		*data;					// source pixels; once prepared, RGBA levels back to back
+	qboolean	cached;					// prepared from the texture cache
+	void		*allocs[MAX_IMAGEALLOCS];	// freed after the upload
+	int		numallocs;
+} teximage_t;
+
+static teximage_t	texmgr_batch[MAX_BATCHIMAGES];
+static int		texmgr_numbatch;
+static int		texmgr_batchbytes;
+static qboolean		texmgr_batching;
+
+/*
+================
+TexMgr_ImageAlloc -- scratch memory for preparing an image; the hunk isn't safe to use off the main thread
+================
+*/
+static void *TexMgr_ImageAlloc (teximage_t *img, int size)
+{
+	void	*p;
+
+	if (img->numallocs == MAX_IMAGEALLOCS)
+		Sys_Error ("TexMgr_ImageAlloc: too many allocations for %s", img->name);
+
+	p = malloc (size + 4); // the resampler reads, with zero weight, one texel past the last row
+	if (!p)
+		Sys_Error ("TexMgr_ImageAlloc: failed on %i bytes for %s", size, img->name);
+
+	img->allocs[img->numallocs++] = p;
+	return p;
+}
+
+/*
+================
+TexMgr_FreeImage
+================
+*/
+static void TexMgr_FreeImage (teximage_t *img)
+{
+	while (img->numallocs)
+		free (img->allocs[--img->numallocs]);
+	img->data = NULL;
+}
+
+/*
+the mipmap and resample kernels have scalar and (when built in) SSE2 or NEON
+versions, which give the same bytes for the same input; timetextures checks
+that.  averages truncate, as the scalar code always has.  the resampler's
+weighted sums stay below 2^24, so they are exact in single precision floats.
+
+with gl_mipmap_gamma, mipmaps and picmip average the colour in linear light
+and convert back, which keeps bright detail from darkening as it shrinks.
+that goes through lookup tables, so it's scalar only.
+*/
+
+static unsigned short	texmgr_tolinear[256];		// sRGB byte to 16 bit linear
+static byte		texmgr_fromlinear[65536];	// and back
+
+/*
+================
+TexMgr_InitGammaTables
+================
+*/
+static void TexMgr_InitGammaTables (void)
+{
+	double	c;
+	int	i;
+
+	for (i = 0; i < 256; i++)
+	{
+		c = i / 255.0;
+		c = (c <= 0.04045) ? c / 12.92 : pow ((c + 0.055) / 1.055, 2.4);
+		texmgr_tolinear[i] = (unsigned short)(c * 65535.0 + 0.5);
+	}
+
+	for (i = 0; i < 65536; i++)
+	{
+		c = i / 65535.0;
+		c = (c <= 0.0031308) ? c * 12.92 : 1.055 * pow (c, 1.0 / 2.4) - 0.055;
+		texmgr_fromlinear[i] = (byte)(c * 255.0 + 0.5);
+	}
+}
+
+#ifdef TEX_SSE2
+/*
+================
+TexMgr_Average16 -- (a + b) >> 1 for sixteen bytes; _mm_avg_epu8 would round up
+================
+*/
+static inline __m128i TexMgr_Average16 (__m128i a, __m128i b)
+{
+	__m128i	half = _mm_and_si128 (_mm_srli_epi16 (_mm_xor_si128 (a, b), 1), _mm_set1_epi8 (0x7f));
+
+	return _mm_add_epi8 (_mm_and_si128 (a, b), half);
+}
+#endif
+
 /*
 ================
 TexMgr_MipMapW
@@ -704,8 +997,49 @@ static unsigned *TexMgr_MipMapW (unsigned *data, int width, int height)
 
 	out = in = (byte *)data;
 	size = (width*height)>>1;
+	i = 0;
+
+	if (gl_mipmap_gamma.value)
+	{
+		for ( ; i < size; i++, out += 4, in += 8)
+		{
+			out[0] = texmgr_fromlinear[(texmgr_tolinear[in[0]] + texmgr_tolinear[in[4]])>>1];
+			out[1] = texmgr_fromlinear[(texmgr_tolinear[in[1]] + texmgr_tolinear[in[5]])>>1];
+			out[2] = texmgr_fromlinear[(texmgr_tolinear[in[2]] + texmgr_tolinear[in[6]])>>1];
+			out[3] = (in[3] + in[7])>>1;
+		}
+		return data;
+	}
+
+#ifdef TEX_SSE2
+	if (texmgr_usesimd)
+	{
+		__m128	a, b;
 
-	for (i = 0; i < size; i++, out += 4, in += 8)
+		// four texels out from eight in; writes never pass the reads still to come
+		for ( ; i + 4 <= size; i += 4, out += 16, in += 32)
+		{
+			a = _mm_castsi128_ps (_mm_loadu_si128 ((const __m128i *)in));
+			b = _mm_castsi128_ps (_mm_loadu_si128 ((const __m128i *)(in + 16)));
+			_mm_storeu_si128 ((__m128i *)out, TexMgr_Average16 (
+				_mm_castps_si128 (_mm_shuffle_ps (a, b, _MM_SHUFFLE(2,0,2,0))),
+				_mm_castps_si128 (_mm_shuffle_ps (a, b, _MM_SHUFFLE(3,1,3,1)))));
+		}
+	}
+#elif defined(TEX_NEON)
+	if (texmgr_usesimd)
+	{
+		uint32x4x2_t	pairs;
+
+		for ( ; i + 4 <= size; i += 4, out += 16, in += 32)
+		{
+			pairs = vld2q_u32 ((const uint32_t *)in);
+			vst1q_u8 (out, vhaddq_u8 (vreinterpretq_u8_u32 (pairs.val[0]), vreinterpretq_u8_u32 (pairs.val[1])));
+		}
+	}
+#endif
+
+	for ( ; i < size; i++, out += 4, in += 8)
 	{
 		out[0] = (in[0] + in[4])>>1;
 		out[1] = (in[1] + in[5])>>1;
@@ -732,7 +1066,36 @@ static unsigned *TexMgr_MipMapH (unsigned *data, int width, int height)
 
 	for (i = 0; i < height; i++, in += width)
 	{
-		for (j = 0; j < width; j += 4, out += 4, in += 4)
+		j = 0;
+
+		if (gl_mipmap_gamma.value)
+		{
+			for ( ; j < width; j += 4, out += 4, in += 4)
+			{
+				out[0] = texmgr_fromlinear[(texmgr_tolinear[in[0]] + texmgr_tolinear[in[width+0]])>>1];
+				out[1] = texmgr_fromlinear[(texmgr_tolinear[in[1]] + texmgr_tolinear[in[width+1]])>>1];
+				out[2] = texmgr_fromlinear[(texmgr_tolinear[in[2]] + texmgr_tolinear[in[width+2]])>>1];
+				out[3] = (in[3] + in[width+3])>>1;
+			}
+			continue;
+		}
+
+#ifdef TEX_SSE2
+		if (texmgr_usesimd)
+		{
+			for ( ; j + 16 <= width; j += 16, out += 16, in += 16)
+				_mm_storeu_si128 ((__m128i *)out, TexMgr_Average16 (
+					_mm_loadu_si128 ((const __m128i *)in), _mm_loadu_si128 ((const __m128i *)(in + width))));
+		}
+#elif defined(TEX_NEON)
+		if (texmgr_usesimd)
+		{
+			for ( ; j + 16 <= width; j += 16, out += 16, in += 16)
+				vst1q_u8 (out, vhaddq_u8 (vld1q_u8 (in), vld1q_u8 (in + width)));
+		}
+#endif
+
+		for ( ; j < width; j += 4, out += 4, in += 4)
 		{
 			out[0] = (in[0] + in[width+0])>>1;
 			out[1] = (in[1] + in[width+1])>>1;
@@ -744,12 +1107,39 @@ static unsigned *TexMgr_MipMapH (unsigned *data, int width, int height)
 	return data;
 }
 
+#ifdef TEX_SSE2
+/*
+================
+TexMgr_TexelSSE2 -- one texel's four channels as floats
+================
+*/
+static inline __m128 TexMgr_TexelSSE2 (const byte *p)
+{
+	__m128i	zero = _mm_setzero_si128 ();
+	__m128i	v = _mm_cvtsi32_si128 (*(const int *)p);
+
+	return _mm_cvtepi32_ps (_mm_unpacklo_epi16 (_mm_unpacklo_epi8 (v, zero), zero));
+}
+#elif defined(TEX_NEON)
+/*
+================
+TexMgr_TexelNEON -- one texel's four channels as floats
+================
+*/
+static inline float32x4_t TexMgr_TexelNEON (const byte *p)
+{
+	uint8x8_t	v = vreinterpret_u8_u32 (vdup_n_u32 (*(const uint32_t *)p));
+
+	return vcvtq_f32_u32 (vmovl_u16 (vget_low_u16 (vmovl_u8 (v))));
+}
+#endif
+
 /*
 ================
 TexMgr_ResampleTexture -- bilinear resample
 ================
 */
-static unsigned *TexMgr_ResampleTexture (unsigned *in, int inwidth, int inheight, qboolean alpha)
+static unsigned *TexMgr_ResampleTexture (teximage_t *img, unsigned *in, int inwidth, int inheight, qboolean alpha)
 {
 	byte *nwpx, *nepx, *swpx, *sepx, *dest;
 	unsigned xfrac, yfrac, x, y, modx, mody, imodx, imody, injump, outjump;
@@ -761,7 +1151,7 @@ static unsigned *TexMgr_ResampleTexture (unsigned *in, int inwidth, int inheight
 
 	outwidth = TexMgr_Pad(inwidth);
 	outheight = TexMgr_Pad(inheight);
-	out = (unsigned *) Hunk_Alloc(outwidth*outheight*4);
+	out = (unsigned *) TexMgr_ImageAlloc(img, outwidth*outheight*4);
 
 	xfrac = ((inwidth-1) << 16) / (outwidth-1);
 	yfrac = ((inheight-1) << 16) / (outheight-1);
@@ -786,6 +1176,43 @@ static unsigned *TexMgr_ResampleTexture (unsigned *in, int inwidth, int inheight
 
 			dest = (byte *)(out + outjump + j);
 
+#ifdef TEX_SSE2
+			if (texmgr_usesimd)
+			{
+				__m128	sum;
+				__m128i	v;
+
+				sum = _mm_mul_ps (TexMgr_TexelSSE2 (nwpx), _mm_set1_ps ((float)(imodx*imody)));
+				sum = _mm_add_ps (sum, _mm_mul_ps (TexMgr_TexelSSE2 (nepx), _mm_set1_ps ((float)(modx*imody))));
+				sum = _mm_add_ps (sum, _mm_mul_ps (TexMgr_TexelSSE2 (swpx), _mm_set1_ps ((float)(imodx*mody))));
+				sum = _mm_add_ps (sum, _mm_mul_ps (TexMgr_TexelSSE2 (sepx), _mm_set1_ps ((float)(modx*mody))));
+				v = _mm_srli_epi32 (_mm_cvttps_epi32 (sum), 16);
+				v = _mm_packs_epi32 (v, v);
+				*(int *)dest = _mm_cvtsi128_si32 (_mm_packus_epi16 (v, v));
+				if (!alpha)
+					dest[3] = 255;
+				x += xfrac;
+				continue;
+			}
+#elif defined(TEX_NEON)
+			if (texmgr_usesimd)
+			{
+				float32x4_t	sum;
+				uint16x4_t	v;
+
+				sum = vmulq_n_f32 (TexMgr_TexelNEON (nwpx), (float)(imodx*imody));
+				sum = vaddq_f32 (sum, vmulq_n_f32 (TexMgr_TexelNEON (nepx), (float)(modx*imody)));
+				sum = vaddq_f32 (sum, vmulq_n_f32 (TexMgr_TexelNEON (swpx), (float)(imodx*mody)));
+				sum = vaddq_f32 (sum, vmulq_n_f32 (TexMgr_TexelNEON (sepx), (float)(modx*mody)));
+				v = vmovn_u32 (vshrq_n_u32 (vcvtq_u32_f32 (sum), 16));
+				vst1_lane_u32 ((uint32_t *)dest, vreinterpret_u32_u8 (vmovn_u16 (vcombine_u16 (v, v))), 0);
+				if (!alpha)
+					dest[3] = 255;
+				x += xfrac;
+				continue;
+			}
+#endif
+
 			dest[0] = (nwpx[0]*imodx*imody + nepx[0]*modx*imody + swpx[0]*imodx*mody + sepx[0]*modx*mody)>>16;
 			dest[1] = (nwpx[1]*imodx*imody + nepx[1]*modx*imody + swpx[1]*imodx*mody + sepx[1]*modx*mody)>>16;
 			dest[2] = (nwpx[2]*imodx*imody + nepx[2]*modx*imody + swpx[2]*imodx*mody + sepx[2]*modx*mody)>>16;
@@ -933,17 +1360,18 @@ static void TexMgr_PadEdgeFixH (byte *data, int width, int height)
 	}
 }
 
+
 /*
 ================
 TexMgr_8to32
 ================
 */
-static unsigned *TexMgr_8to32 (byte *in, int pixels, unsigned int *usepal)
+static unsigned *TexMgr_8to32 (teximage_t *img, byte *in, int pixels, unsigned int *usepal)
 {
 	int i;
 	unsigned *out, *data;
 
-	out = data = (unsigned *) Hunk_Alloc(pixels*4);
+	out = data = (unsigned *) TexMgr_ImageAlloc(img, pixels*4);
 
 	for (i = 0; i < pixels; i++)
 		*out++ = usepal[*in++];
@@ -956,7 +1384,7 @@ static unsigned *TexMgr_8to32 (byte *in, int pixels, unsigned int *usepal)
 TexMgr_PadImageW -- return image with width padded up to power-of-two dimentions
 ================
 */
-static byte *TexMgr_PadImageW (byte *in, int width, int height, byte padbyte)
+static byte *TexMgr_PadImageW (teximage_t *img, byte *in, int width, int height, byte padbyte)
 {
 	int i, j, outwidth;
 	byte *out, *data;
@@ -966,7 +1394,7 @@ static byte *TexMgr_PadImageW (byte *in, int width, int height, byte padbyte)
 
 	outwidth = TexMgr_Pad(width);
 
-	out = data = (byte *) Hunk_Alloc(outwidth*height);
+	out = data = (byte *) TexMgr_ImageAlloc(img, outwidth*height);
 
 	for (i = 0; i < height; i++)
 	{
@@ -984,7 +1412,7 @@ static byte *TexMgr_PadImageW (byte *in, int width, int height, byte padbyte)
 TexMgr_PadImageH -- return image with height padded up to power-of-two dimentions
 ================
 */
-static byte *TexMgr_PadImageH (byte *in, int width, int height, byte padbyte)
+static byte *TexMgr_PadImageH (teximage_t *img, byte *in, int width, int height, byte padbyte)
 {
 	int i, srcpix, dstpix;
 	byte *data, *out;
@@ -995,7 +1423,7 @@ static byte *TexMgr_PadImageH (byte *in, int width, int height, byte padbyte)
 	srcpix = width * height;
 	dstpix = width * TexMgr_Pad(height);
 
-	out = data = (byte *) Hunk_Alloc(dstpix);
+	out = data = (byte *) TexMgr_ImageAlloc(img, dstpix);
 
 	for (i = 0; i < srcpix; i++)
 		*out++ = *in++;
@@ -1007,77 +1435,102 @@ static byte *TexMgr_PadImageH (byte *in, int width, int height, byte padbyte)
 
 /*
 ================
-TexMgr_LoadImage32 -- handles 32bit source data
+TexMgr_ImageSize -- bytes in a prepared image, counting its mipmaps
+================
+*/
+static int TexMgr_ImageSize (teximage_t *img)
+{
+	int	size, mipwidth, mipheight;
+
+	size = 0;
+	mipwidth = img->width;
+	mipheight = img->height;
+	for (;;)
+	{
+		size += mipwidth * mipheight * 4;
+		if (!(img->flags & TEXPREF_MIPMAP) || (mipwidth == 1 && mipheight == 1))
+			break;
+		mipwidth = q_max(mipwidth >> 1, 1);
+		mipheight = q_max(mipheight >> 1, 1);
+	}
+
+	return size;
+}
+
+/*
+================
+TexMgr_PrepareImage32 -- handles 32bit source data
 ================
 */
-static void TexMgr_LoadImage32 (gltexture_t *glt, unsigned *data)
+static void TexMgr_PrepareImage32 (teximage_t *img, unsigned *data)
 {
-	int	internalformat,	miplevel, mipwidth, mipheight, picmip;
+	int	picmip, mipwidth, mipheight;
+	byte	*chain, *level, *next;
 
 	if (!gl_texture_NPOT)
 	{
 		// resample up
-		data = TexMgr_ResampleTexture (data, glt->width, glt->height, glt->flags & TEXPREF_ALPHA);
-		glt->width = TexMgr_Pad(glt->width);
-		glt->height = TexMgr_Pad(glt->height);
+		data = TexMgr_ResampleTexture (img, data, img->width, img->height, img->flags & TEXPREF_ALPHA);
+		img->width = TexMgr_Pad(img->width);
+		img->height = TexMgr_Pad(img->height);
 	}
 
 	// mipmap down
-	picmip = (glt->flags & TEXPREF_NOPICMIP) ? 0 : q_max((int)gl_picmip.value, 0);
-	mipwidth = TexMgr_SafeTextureSize (glt->width >> picmip);
-	mipheight = TexMgr_SafeTextureSize (glt->height >> picmip);
-	while ((int) glt->width > mipwidth)
+	picmip = (img->flags & TEXPREF_NOPICMIP) ? 0 : q_max((int)gl_picmip.value, 0);
+	mipwidth = TexMgr_SafeTextureSize (img->width >> picmip);
+	mipheight = TexMgr_SafeTextureSize (img->height >> picmip);
+	while ((int) img->width > mipwidth)
 	{
-		TexMgr_MipMapW (data, glt->width, glt->height);
-		glt->width >>= 1;
-		if (glt->flags & TEXPREF_ALPHA)
-			TexMgr_AlphaEdgeFix ((byte *)data, glt->width, glt->height);
+		TexMgr_MipMapW (data, img->width, img->height);
+		img->width >>= 1;
+		if (img->flags & TEXPREF_ALPHA)
+			TexMgr_AlphaEdgeFix ((byte *)data, img->width, img->height);
 	}
-	while ((int) glt->height > mipheight)
+	while ((int) img->height > mipheight)
 	{
-		TexMgr_MipMapH (data, glt->width, glt->height);
-		glt->height >>= 1;
-		if (glt->flags & TEXPREF_ALPHA)
-			TexMgr_AlphaEdgeFix ((byte *)data, glt->width, glt->height);
+		TexMgr_MipMapH (data, img->width, img->height);
+		img->height >>= 1;
+		if (img->flags & TEXPREF_ALPHA)
+			TexMgr_AlphaEdgeFix ((byte *)data, img->width, img->height);
 	}
 
-	// upload
-	GL_Bind (glt);
-	internalformat = (glt->flags & TEXPREF_ALPHA) ? gl_alpha_format : gl_solid_format;
-	glTexImage2D (GL_TEXTURE_2D, 0, internalformat, glt->width, glt->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+	img->data = (byte *)data;
+	if (!(img->flags & TEXPREF_MIPMAP))
+		return;
 
-	// upload mipmaps
-	if (glt->flags & TEXPREF_MIPMAP)
-	{
-		mipwidth = glt->width;
-		mipheight = glt->height;
+	// build the mipmaps, each level right after the one it was made from
+	chain = (byte *) TexMgr_ImageAlloc (img, TexMgr_ImageSize (img));
+	memcpy (chain, data, img->width * img->height * 4);
 
-		for (miplevel=1; mipwidth > 1 || mipheight > 1; miplevel++)
+	level = chain;
+	mipwidth = img->width;
+	mipheight = img->height;
+	while (mipwidth > 1 || mipheight > 1)
+	{
+		next = level + mipwidth * mipheight * 4;
+		memcpy (next, level, mipwidth * mipheight * 4);
+		if (mipwidth > 1)
 		{
-			if (mipwidth > 1)
-			{
-				TexMgr_MipMapW (data, mipwidth, mipheight);
-				mipwidth >>= 1;
-			}
-			if (mipheight > 1)
-			{
-				TexMgr_MipMapH (data, mipwidth, mipheight);
-				mipheight >>= 1;
-			}
-			glTexImage2D (GL_TEXTURE_2D, miplevel, internalformat, mipwidth, mipheight, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+			TexMgr_MipMapW ((unsigned *)next, mipwidth, mipheight);
+			mipwidth >>= 1;
 		}
+		if (mipheight > 1)
+		{
+			TexMgr_MipMapH ((unsigned *)next, mipwidth, mipheight);
+			mipheight >>= 1;
+		}
+		level = next;
 	}
 
-	// set filter modes
-	TexMgr_SetFilterModes (glt);
+	img->data = chain;
 }
 
 /*
 ================
-TexMgr_LoadImage8 -- handles 8bit source data, then passes it to LoadImage32
+TexMgr_PrepareImage8 -- handles 8bit source data, then passes it to PrepareImage32
 ================
 */
-static void TexMgr_LoadImage8 (gltexture_t *glt, byte *data)
+static void TexMgr_PrepareImage8 (teximage_t *img, byte *data)
 {
 	extern cvar_t gl_fullbrights;
 	qboolean padw = false, padh = false;
@@ -1086,8 +1539,8 @@ static void TexMgr_LoadImage8 (gltexture_t *glt, byte *data)
 	int i;
 
 	// HACK HACK HACK -- taken from tomazquake
-	if (strstr(glt->name, "shot1sid") &&
-	    glt->width == 32 && glt->height == 32 &&
+	if (strstr(img->name, "shot1sid") &&
+	    img->width == 32 && img->height == 32 &&
 	    CRC_Block(data, 1024) == 65393)
 	{
 		// This texture in b_shell1.bsp has some of the first 32 pixels painted white.
@@ -1097,33 +1550,33 @@ static void TexMgr_LoadImage8 (gltexture_t *glt, byte *data)
 	}
 
 	// detect false alpha cases
-	if (glt->flags & TEXPREF_ALPHA && !(glt->flags & TEXPREF_CONCHARS))
+	if (img->flags & TEXPREF_ALPHA && !(img->flags & TEXPREF_CONCHARS))
 	{
-		for (i = 0; i < (int) (glt->width * glt->height); i++)
+		for (i = 0; i < (int) (img->width * img->height); i++)
 			if (data[i] == 255) //transparent index
 				break;
-		if (i == (int) (glt->width * glt->height))
-			glt->flags -= TEXPREF_ALPHA;
+		if (i == (int) (img->width * img->height))
+			img->flags -= TEXPREF_ALPHA;
 	}
 
 	// choose palette and padbyte
-	if (glt->flags & TEXPREF_FULLBRIGHT)
+	if (img->flags & TEXPREF_FULLBRIGHT)
 	{
-		if (glt->flags & TEXPREF_ALPHA)
+		if (img->flags & TEXPREF_ALPHA)
 			usepal = d_8to24table_fbright_fence;
 		else
 			usepal = d_8to24table_fbright;
 		padbyte = 0;
 	}
-	else if (glt->flags & TEXPREF_NOBRIGHT && gl_fullbrights.value)
+	else if (img->flags & TEXPREF_NOBRIGHT && gl_fullbrights.value)
 	{
-		if (glt->flags & TEXPREF_ALPHA)
+		if (img->flags & TEXPREF_ALPHA)
 			usepal = d_8to24table_nobright_fence;
 		else
 			usepal = d_8to24table_nobright;
 		padbyte = 0;
 	}
-	else if (glt->flags & TEXPREF_CONCHARS)
+	else if (img->flags & TEXPREF_CONCHARS)
 	{
 		usepal = d_8to24table_conchars;
 		padbyte = 0;
@@ -1135,38 +1588,393 @@ static void TexMgr_LoadImage8 (gltexture_t *glt, byte *data)
 	}
 
 	// pad each dimention, but only if it's not going to be downsampled later
-	if (glt->flags & TEXPREF_PAD)
+	if (img->flags & TEXPREF_PAD)
 	{
-		if ((int) glt->width < TexMgr_SafeTextureSize(glt->width))
+		if ((int) img->width < TexMgr_SafeTextureSize(img->width))
 		{
-			data = TexMgr_PadImageW (data, glt->width, glt->height, padbyte);
-			glt->width = TexMgr_Pad(glt->width);
+			data = TexMgr_PadImageW (img, data, img->width, img->height, padbyte);
+			img->width = TexMgr_Pad(img->width);
 			padw = true;
 		}
-		if ((int) glt->height < TexMgr_SafeTextureSize(glt->height))
+		if ((int) img->height < TexMgr_SafeTextureSize(img->height))
 		{
-			data = TexMgr_PadImageH (data, glt->width, glt->height, padbyte);
-			glt->height = TexMgr_Pad(glt->height);
+			data = TexMgr_PadImageH (img, data, img->width, img->height, padbyte);
+			img->height = TexMgr_Pad(img->height);
 			padh = true;
 		}
 	}
 
 	// convert to 32bit
-	data = (byte *)TexMgr_8to32(data, glt->width * glt->height, usepal);
+	data = (byte *)TexMgr_8to32(img, data, img->width * img->height, usepal);
 
 	// fix edges
-	if (glt->flags & TEXPREF_ALPHA)
-		TexMgr_AlphaEdgeFix (data, glt->width, glt->height);
+	if (img->flags & TEXPREF_ALPHA)
+		TexMgr_AlphaEdgeFix (data, img->width, img->height);
 	else
 	{
 		if (padw)
-			TexMgr_PadEdgeFixW (data, glt->source_width, glt->source_height);
+			TexMgr_PadEdgeFixW (data, img->source_width, img->source_height);
 		if (padh)
-			TexMgr_PadEdgeFixH (data, glt->source_width, glt->source_height);
+			TexMgr_PadEdgeFixH (data, img->source_width, img->source_height);
 	}
 
-	// upload it
-	TexMgr_LoadImage32 (glt, (unsigned *)data);
+	TexMgr_PrepareImage32 (img, (unsigned *)data);
+}
+
+/*
+================================================================================
+
+	PROCESSED TEXTURE CACHE
+
+================================================================================
+*/
+
+/*
+prepared images are kept in <userdir>/texcache, one file per image, named
+after a hash of the source pixels and of everything else that decides the
+result: size, format, flags, palette and the texture settings.  the header
+repeats the whole key and a checksum of the pixels, and a file that doesn't
+match in every respect is ignored and written again.  files are written
+under a temporary name and renamed, so two threads preparing the same image
+never see half of one.  the cache is never trimmed; delete the directory to
+empty it.
+*/
+
+#define TEXCACHE_VERSION	1
+#define TEXCACHE_MINPIXELS	(64*64)	// below this, opening a file costs more than it saves
+
+typedef struct
+{
+	unsigned int	datahash;		// source pixels
+	unsigned int	palettehash;
+	unsigned int	width, height, format, flags;
+	int		picmip, maxsize, npot, gamma, fullbrights, shot1sid;
+} texcachekey_t;
+
+typedef struct
+{
+	char		magic[4];		// "QTEX"
+	int		version;
+	texcachekey_t	key;
+	unsigned int	width, height, flags;	// of the prepared image
+	int		size;
+	unsigned int	checksum;		// of the prepared pixels
+} texcacheheader_t;
+
+static cvar_t		gl_texturecache = {"gl_texturecache", "1", CVAR_ARCHIVE};
+static char		texcache_dir[MAX_OSPATH];
+
+/*
+================
+TexMgr_CacheKey -- false if the image shouldn't be cached
+================
+*/
+static qboolean TexMgr_CacheKey (teximage_t *img, texcachekey_t *key, char *path, size_t pathsize)
+{
+	extern cvar_t gl_fullbrights;
+	int	size;
+
+	if (!gl_texturecache.value || !texcache_dir[0])
+		return false;
+	if (img->flags & TEXPREF_WARPIMAGE) // placeholder pixels, and redrawn every frame
+		return false;
+	if (img->source_width * img->source_height < TEXCACHE_MINPIXELS)
+		return false;
+
+	size = img->source_width * img->source_height * ((img->format == SRC_RGBA) ? 4 : 1);
+
+	memset (key, 0, sizeof(*key));
+	key->datahash = COM_HashBytes (COM_HASH_INIT, img->data, size);
+	key->palettehash = (img->format == SRC_INDEXED) ? texmgr_palettehash : 0;
+	key->width = img->source_width;
+	key->height = img->source_height;
+	key->format = img->format;
+	key->flags = img->flags;
+	key->picmip = (img->flags & TEXPREF_NOPICMIP) ? 0 : q_max((int)gl_picmip.value, 0);
+	key->maxsize = TexMgr_SafeTextureSize (0x10000);
+	key->npot = gl_texture_NPOT;
+	key->gamma = (gl_mipmap_gamma.value != 0);
+	key->fullbrights = (img->flags & TEXPREF_NOBRIGHT) && gl_fullbrights.value;
+	key->shot1sid = (strstr (img->name, "shot1sid") != NULL);
+
+	q_snprintf (path, pathsize, "%s/%08x%08x.tex", texcache_dir, key->datahash,
+		COM_HashBytes (COM_HASH_INIT, key, sizeof(*key)));
+	return true;
+}
+
+/*
+================
+TexMgr_CacheRead -- fills in a prepared image from the cache, if it's there and sound
+================
+*/
+static qboolean TexMgr_CacheRead (teximage_t *img, const texcachekey_t *key, const char *path)
+{
+	texcacheheader_t	header;
+	teximage_t		check;
+	byte			*data;
+	FILE			*f;
+
+	f = fopen (path, "rb");
+	if (!f)
+		return false;
+
+	if (fread (&header, 1, sizeof(header), f) != sizeof(header) ||
+		memcmp (header.magic, "QTEX", 4) || header.version != TEXCACHE_VERSION ||
+		memcmp (&header.key, key, sizeof(*key)))
+	{
+		fclose (f);
+		return false;
+	}
+
+	// the size has to be the one the header's dimensions call for
+	memset (&check, 0, sizeof(check));
+	check.width = header.width;
+	check.height = header.height;
+	check.flags = header.flags;
+	if (!header.width || !header.height || header.width > 0x10000 || header.height > 0x10000 ||
+		header.size != TexMgr_ImageSize (&check))
+	{
+		fclose (f);
+		return false;
+	}
+
+	data = (byte *) TexMgr_ImageAlloc (img, header.size);
+	if (fread (data, 1, header.size, f) != (size_t)header.size ||
+		COM_HashBytes (COM_HASH_INIT, data, header.size) != header.checksum)
+	{
+		fclose (f);
+		return false; // the buffer goes with the image
+	}
+	fclose (f);
+
+	img->width = header.width;
+	img->height = header.height;
+	img->flags = header.flags;
+	img->data = data;
+	img->cached = true;
+	return true;
+}
+
+/*
+================
+TexMgr_CacheWrite
+================
+*/
+static void TexMgr_CacheWrite (teximage_t *img, const texcachekey_t *key, const char *path)
+{
+	texcacheheader_t	header;
+	char			temp[MAX_OSPATH];
+	FILE			*f;
+	qboolean		ok;
+
+	memset (&header, 0, sizeof(header));
+	memcpy (header.magic, "QTEX", 4);
+	header.version = TEXCACHE_VERSION;
+	header.key = *key;
+	header.width = img->width;
+	header.height = img->height;
+	header.flags = img->flags;
+	header.size = TexMgr_ImageSize (img);
+	header.checksum = COM_HashBytes (COM_HASH_INIT, img->data, header.size);
+
+	f = COM_OpenTempFile (path, img, temp, sizeof(temp));
+	if (!f)
+		return;
+	ok = fwrite (&header, 1, sizeof(header), f) == sizeof(header) &&
+		fwrite (img->data, 1, header.size, f) == (size_t)header.size;
+	COM_ReplaceFile (f, temp, path, ok);
+}
+
+/*
+================
+TexMgr_InitCache
+================
+*/
+static void TexMgr_InitCache (void)
+{
+	Cvar_RegisterVariable (&gl_texturecache);
+
+	if (!COM_CheckParm ("-notexcache"))
+		COM_UserCacheDir ("texcache", texcache_dir, sizeof(texcache_dir));
+}
+
+/*
+================
+TexMgr_PrepareImage -- safe to call from any thread
+================
+*/
+static void TexMgr_PrepareImage (teximage_t *img)
+{
+	texcachekey_t	key;
+	char		path[MAX_OSPATH];
+	qboolean	cache;
+
+	cache = TexMgr_CacheKey (img, &key, path, sizeof(path));
+	if (cache && TexMgr_CacheRead (img, &key, path))
+		return;
+
+	if (img->format == SRC_INDEXED)
+		TexMgr_PrepareImage8 (img, img->data);
+	else
+		TexMgr_PrepareImage32 (img, (unsigned *)img->data);
+
+	if (cache)
+		TexMgr_CacheWrite (img, &key, path);
+}
+
+/*
+================
+TexMgr_UploadImage -- sends a prepared image to GL and frees it
+================
+*/
+static void TexMgr_UploadImage (teximage_t *img)
+{
+	gltexture_t	*glt = img->glt;
+	int		internalformat, miplevel, mipwidth, mipheight;
+	byte		*data;
+
+	glt->width = img->width;
+	glt->height = img->height;
+	glt->flags = img->flags;
+
+	// upload
+	GL_Bind (glt);
+	internalformat = (glt->flags & TEXPREF_ALPHA) ? gl_alpha_format : gl_solid_format;
+	data = img->data;
+	glTexImage2D (GL_TEXTURE_2D, 0, internalformat, glt->width, glt->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+
+	// upload mipmaps
+	if (glt->flags & TEXPREF_MIPMAP)
+	{
+		mipwidth = glt->width;
+		mipheight = glt->height;
+
+		for (miplevel=1; mipwidth > 1 || mipheight > 1; miplevel++)
+		{
+			data += mipwidth * mipheight * 4;
+			if (mipwidth > 1)
+				mipwidth >>= 1;
+			if (mipheight > 1)
+				mipheight >>= 1;
+			glTexImage2D (GL_TEXTURE_2D, miplevel, internalformat, mipwidth, mipheight, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+		}
+	}
+
+	// set filter modes
+	TexMgr_SetFilterModes (glt);
+
+	TexMgr_FreeImage (img);
+}
+
+/*
+================
+TexMgr_InitImage
+================
+*/
+static void TexMgr_InitImage (teximage_t *img, gltexture_t *glt, byte *data)
+{
+	img->glt = glt;
+	q_strlcpy (img->name, glt->name, sizeof(img->name));
+	img->format = glt->source_format;
+	img->width = glt->width;
+	img->height = glt->height;
+	img->flags = glt->flags;
+	img->source_width = glt->source_width;
+	img->source_height = glt->source_height;
+	img->data = data;
+	img->cached = false;
+	img->numallocs = 0;
+}
+
+/*
+================
+TexMgr_LoadImageData -- prepares and uploads now, or queues a copy of the pixels while batching
+================
+*/
+static void TexMgr_LoadImageData (gltexture_t *glt, byte *data)
+{
+	teximage_t	image, *img;
+	int		size;
+
+	if (!texmgr_batching)
+	{
+		TexMgr_InitImage (&image, glt, data);
+		TexMgr_PrepareImage (&image);
+		TexMgr_UploadImage (&image);
+		return;
+	}
+
+	if (texmgr_numbatch == MAX_BATCHIMAGES)
+		TexMgr_FlushBatch ();
+
+	img = &texmgr_batch[texmgr_numbatch++];
+	TexMgr_InitImage (img, glt, NULL);
+
+	// the caller's buffer is usually on the hunk, and gone by the time the batch runs
+	size = glt->width * glt->height * ((glt->source_format == SRC_RGBA) ? 4 : 1);
+	img->data = (byte *) TexMgr_ImageAlloc (img, size);
+	memcpy (img->data, data, size);
+
+	// padded or resampled, with the mipmaps and the conversion buffer
+	texmgr_batchbytes += size + TexMgr_Pad(glt->width) * TexMgr_Pad(glt->height) * 4 * 2;
+	if (texmgr_batchbytes > MAX_BATCHBYTES)
+		TexMgr_FlushBatch ();
+}
+
+/*
+================
+TexMgr_PrepareTask
+================
+*/
+static void TexMgr_PrepareTask (void *data, int index)
+{
+	TexMgr_PrepareImage (&((teximage_t *)data)[index]);
+}
+
+/*
+================
+TexMgr_FlushBatch -- prepares every queued image on the task threads, then uploads them in order
+================
+*/
+void TexMgr_FlushBatch (void)
+{
+	int	i, cached;
+
+	if (!texmgr_numbatch)
+		return;
+
+	Tasks_ParallelFor (texmgr_numbatch, 0, TexMgr_PrepareTask, texmgr_batch);
+
+	for (i = 0, cached = 0; i < texmgr_numbatch; i++)
+	{
+		cached += texmgr_batch[i].cached;
+		TexMgr_UploadImage (&texmgr_batch[i]);
+	}
+	Con_DPrintf ("%i images prepared, %i from the texture cache\n", texmgr_numbatch, cached);
+
+	texmgr_numbatch = 0;
+	texmgr_batchbytes = 0;
+}
+
+/*
+================
+TexMgr_BeginBatch -- defer image loading until TexMgr_EndBatch; used around map loads
+================
+*/
+void TexMgr_BeginBatch (void)
+{
+	texmgr_batching = true;
+}
+
+/*
+================
+TexMgr_EndBatch
+================
+*/
+void TexMgr_EndBatch (void)
+{
+	TexMgr_FlushBatch ();
+	texmgr_batching = false;
 }
 
 /*
@@ -1194,7 +2002,6 @@ gltexture_t *TexMgr_LoadImage (qmodel_t *owner, const char *name, int width, int
 {
 	unsigned short crc;
 	gltexture_t *glt;
-	int mark;
 
 	if (isDedicated)
 		return NULL;
@@ -1218,9 +2025,19 @@ gltexture_t *TexMgr_LoadImage (qmodel_t *owner, const char *name, int width, int
 	{
 		if (glt->source_crc == crc)
 			return glt;
+		if (glt->evicted || !glt->texnum)
+		{
+			glt->evicted = false;
+			glGenTextures (1, &glt->texnum);
+		}
 	}
 	else
+	{
 		glt = TexMgr_NewTexture ();
+		glt->owner = owner;
+		q_strlcpy (glt->name, name, sizeof(glt->name));
+		TexMgr_LinkHash (glt);
+	}
 
 	// copy data
 	glt->owner = owner;
@@ -1238,24 +2055,102 @@ gltexture_t *TexMgr_LoadImage (qmodel_t *owner, const char *name, int width, int
 	glt->source_crc = crc;
 
 	//upload it
-	mark = Hunk_LowMark();
+	if (glt->source_format == SRC_LIGHTMAP)
+		TexMgr_LoadLightmap (glt, data);
+	else
+		TexMgr_LoadImageData (glt, data);
+
+	return glt;
+}
+
+/*
+================
+TexMgr_TimeTextures_f
 
-	switch (glt->source_format)
+For program optimization -- prepares power-of-two and non-power-of-two
+images the way a non-NPOT card gets them (resampled up, then the whole
+mipmap chain), with the scalar and (if built in) SIMD kernels.  both have
+to produce the same bytes.
+================
+*/
+static void TexMgr_TimeTextures_f (void)
+{
+	static const int sizes[][2] = {{256,256}, {1024,1024}, {2048,1024}, {320,200}, {640,480}, {1000,600}};
+	teximage_t	img, ref;
+	qboolean	npot, mismatch;
+	unsigned	*src;
+	double		start, time;
+	int		i, j, n, pass, passes, reps, size;
+
+	reps = (Cmd_Argc() > 1) ? Q_atoi (Cmd_Argv(1)) : 4;
+	if (reps < 1)
+		reps = 1;
+
+#if defined(TEX_SSE2) || defined(TEX_NEON)
+	passes = 2;
+#else
+	passes = 1;
+#endif
+
+	npot = gl_texture_NPOT;
+	gl_texture_NPOT = false;
+	memset (&ref, 0, sizeof(ref));
+	q_strlcpy (ref.name, "timetextures", sizeof(ref.name));
+
+	Con_Printf ("%s mipmaps\n", gl_mipmap_gamma.value ? "gamma-correct" : "plain");
+	for (i = 0; i < (int)(sizeof(sizes)/sizeof(sizes[0])); i++)
 	{
-	case SRC_INDEXED:
-		TexMgr_LoadImage8 (glt, data);
-		break;
-	case SRC_LIGHTMAP:
-		TexMgr_LoadLightmap (glt, data);
-		break;
-	case SRC_RGBA:
-		TexMgr_LoadImage32 (glt, (unsigned *)data);
-		break;
-	}
+		n = sizes[i][0] * sizes[i][1];
+		src = (unsigned *) malloc (n * 4);
+		if (!src)
+			break;
+		srand (i);
+		for (j = 0; j < n; j++)
+			src[j] = (rand() & 0xffff) | ((rand() & 0xffff) << 16);
+
+		for (pass = 0; pass < passes; pass++)
+		{
+#if defined(TEX_SSE2) || defined(TEX_NEON)
+			texmgr_usesimd = (pass == 1);
+#endif
+			start = Sys_DoubleTime ();
+			for (j = 0; j < reps; j++)
+			{
+				memset (&img, 0, sizeof(img));
+				q_strlcpy (img.name, "timetextures", sizeof(img.name));
+				img.width = img.source_width = sizes[i][0];
+				img.height = img.source_height = sizes[i][1];
+				img.flags = TEXPREF_MIPMAP | TEXPREF_ALPHA | TEXPREF_NOPICMIP;
+				img.data = (byte *) TexMgr_ImageAlloc (&img, n * 4);
+				memcpy (img.data, src, n * 4);
+				TexMgr_PrepareImage32 (&img, (unsigned *)img.data);
+				if (j < reps - 1)
+					TexMgr_FreeImage (&img);
+			}
+			time = Sys_DoubleTime () - start;
 
-	Hunk_FreeToLowMark(mark);
+			size = TexMgr_ImageSize (&img);
+			mismatch = false;
+			if (pass == 0)
+				ref = img;
+			else
+			{
+				mismatch = memcmp (ref.data, img.data, size) != 0;
+				TexMgr_FreeImage (&img);
+			}
 
-	return glt;
+			Con_Printf ("%4ix%-4i -> %4ix%-4i %s: %7.2f ms%s\n", sizes[i][0], sizes[i][1], img.width, img.height,
+				(pass == 1) ? "simd  " : "scalar", time * 1000 / reps, mismatch ? " MISMATCH" : "");
+		}
+
+		TexMgr_FreeImage (&ref);
+		free (src);
+	}
+
+#if defined(TEX_SSE2) || defined(TEX_NEON)
+	texmgr_usesimd = true;
+#endif
+	gl_texture_NPOT = npot;
 }
 
 /*
@@ -1268,14 +2163,24 @@ gltexture_t *TexMgr_LoadImage (qmodel_t *owner, const char *name, int width, int
 
 /*
 ================
-TexMgr_ReloadImage -- reloads a texture, and colormaps it if needed
+TexMgr_ReloadImage -- reloads a texture, and colormaps it if needed.
+returns false if the source data couldn't be found
 ================
 */
-void TexMgr_ReloadImage (gltexture_t *glt, int shirt, int pants)
+qboolean TexMgr_ReloadImage (gltexture_t *glt, int shirt, int pants)
 {
 	byte	translation[256];
 	byte	*src, *dst, *data = NULL, *translated;
 	int	mark, size, i;
+
+	// a queued load of the same texture would land on top of this one
+	TexMgr_FlushBatch ();
+
+	if (glt->evicted || !glt->texnum) //evicted, or a reload that failed
+	{
+		glt->evicted = false;
+		glGenTextures (1, &glt->texnum);
+	}
 //
 // get source data
 //
@@ -1310,7 +2215,7 @@ void TexMgr_ReloadImage (gltexture_t *glt, int shirt, int pants)
 invalid:
 		Con_Printf ("TexMgr_ReloadImage: invalid source for %s\n", glt->name);
 		Hunk_FreeToLowMark(mark);
-		return;
+		return false;
 	}
 
 	glt->width = glt->source_width;
@@ -1373,20 +2278,37 @@ invalid:
 //
 // upload it
 //
-	switch (glt->source_format)
-	{
-	case SRC_INDEXED:
-		TexMgr_LoadImage8 (glt, data);
-		break;
-	case SRC_LIGHTMAP:
+	if (glt->source_format == SRC_LIGHTMAP)
 		TexMgr_LoadLightmap (glt, data);
-		break;
-	case SRC_RGBA:
-		TexMgr_LoadImage32 (glt, (unsigned *)data);
-		break;
-	}
+	else
+		TexMgr_LoadImageData (glt, data);
 
 	Hunk_FreeToLowMark(mark);
+	return true;
+}
+
+/*
+================
+TexMgr_ReloadEvicted -- GL_Bind is about to draw with it, so upload it now
+instead of queueing it on an open batch.  if the source is gone, give up on
+it for good and let it draw as notexture rather than hitting the disk on
+every bind
+================
+*/
+static void TexMgr_ReloadEvicted (gltexture_t *glt)
+{
+	qboolean	batching = texmgr_batching;
+	qboolean	ok;
+
+	texmgr_batching = false;
+	ok = TexMgr_ReloadImage (glt, -1, -1);
+	texmgr_batching = batching;
+
+	if (!ok)
+	{
+		glt->evicted = false;
+		GL_DeleteTexture (glt); //texnum 0 binds notexture
+	}
 }
 
 /*
@@ -1411,6 +2333,7 @@ void TexMgr_ReloadImages (void)
 	for (glt = active_gltextures; glt; glt = glt->next)
 	{
 		glGenTextures(1, &glt->texnum);
+		glt->evicted = false;
 		TexMgr_ReloadImage (glt, -1, -1);
 	}
 	
@@ -1427,7 +2350,7 @@ void TexMgr_ReloadNobrightImages (void)
 	gltexture_t *glt;
 
 	for (glt = active_gltextures; glt; glt = glt->next)
-		if (glt->flags & TEXPREF_NOBRIGHT)
+		if ((glt->flags & TEXPREF_NOBRIGHT) && !glt->evicted) //the reload will pick up the change
 			TexMgr_ReloadImage(glt, -1, -1);
 }
 
@@ -1497,11 +2420,16 @@ void GL_Bind (gltexture_t *texture)
 	if (!texture)
 		texture = nulltexture;
 
+	if (texture->evicted)
+		TexMgr_ReloadEvicted (texture); //leaves it bound
+
+	texture->visframe = r_framecount; //even if it's still bound, for gl_texture_budget
+	if (!texture->texnum)
+		texture = notexture;
 	if (texture->texnum != currenttexture[currenttarget - GL_TEXTURE0_ARB])
 	{
 		currenttexture[currenttarget - GL_TEXTURE0_ARB] = texture->texnum;
 		glBindTexture (GL_TEXTURE_2D, texture->texnum);
-		texture->visframe = r_framecount;
 	}
 }
 
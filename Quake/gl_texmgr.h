@@ -47,6 +47,7 @@ typedef struct gltexture_s {
 //managed by texture manager
 	GLuint			texnum;
 	struct gltexture_s	*next;
+	struct gltexture_s	*hashnext; //next in the same TexMgr_FindTexture bucket
 	qmodel_t		*owner;
 //managed by image loading
 	char			name[64];
@@ -63,6 +64,7 @@ typedef struct gltexture_s {
 	char				pants; //0-13 pants color, or -1 if never colormapped
 //used for rendering
 	int			visframe; //matches r_framecount if texture was bound this frame
+	qboolean		evicted; //texture object deleted to keep under gl_texture_budget; GL_Bind reloads it
 } gltexture_t;
 
 extern gltexture_t *notexture;
@@ -86,13 +88,17 @@ void TexMgr_FreeTexturesForOwner (qmodel_t *owner);
 void TexMgr_NewGame (void);
 void TexMgr_Init (void);
 void TexMgr_DeleteTextureObjects (void);
+void TexMgr_EnforceBudget (void);
 
 // IMAGE LOADING
 gltexture_t *TexMgr_LoadImage (qmodel_t *owner, const char *name, int width, int height, enum srcformat format,
 			       byte *data, const char *source_file, src_offset_t source_offset, unsigned flags);
-void TexMgr_ReloadImage (gltexture_t *glt, int shirt, int pants);
+qboolean TexMgr_ReloadImage (gltexture_t *glt, int shirt, int pants);
 void TexMgr_ReloadImages (void);
 void TexMgr_ReloadNobrightImages (void);
+void TexMgr_BeginBatch (void);
+void TexMgr_EndBatch (void);
+void TexMgr_FlushBatch (void);
 
 int TexMgr_Pad(int s);
 int TexMgr_SafeTextureSize (int s);
@@ -101,10 +101,12 @@ qboolean gl_anisotropy_able = false; //johnfitz
 float gl_max_anisotropy; //johnfitz
 qboolean gl_texture_NPOT = false; //ericw
 qboolean gl_vbo_able = false; //ericw
+qboolean gl_pbo_able = false;
 qboolean gl_glsl_able = false; //ericw
 GLint gl_max_texture_units = 0; //ericw
 qboolean gl_glsl_gamma_able = false; //ericw
 qboolean gl_glsl_alias_able = false; //ericw
+qboolean gl_glsl_particle_able = false;
 int gl_stencilbits;
 
 PFNGLMULTITEXCOORD2FARBPROC GL_MTexCoord2fFunc = NULL; //johnfitz
@@ -115,6 +117,8 @@ PFNGLBUFFERDATAARBPROC GL_BufferDataFunc = NULL; //ericw
 PFNGLBUFFERSUBDATAARBPROC GL_BufferSubDataFunc = NULL; //ericw
 PFNGLDELETEBUFFERSARBPROC GL_DeleteBuffersFunc = NULL; //ericw
 PFNGLGENBUFFERSARBPROC GL_GenBuffersFunc = NULL; //ericw
+PFNGLMAPBUFFERARBPROC GL_MapBufferFunc = NULL;
+PFNGLUNMAPBUFFERARBPROC GL_UnmapBufferFunc = NULL;
 
 QS_PFNGLCREATESHADERPROC GL_CreateShaderFunc = NULL; //ericw
 QS_PFNGLDELETESHADERPROC GL_DeleteShaderFunc = NULL; //ericw
@@ -139,6 +143,8 @@ QS_PFNGLUNIFORM1IPROC GL_Uniform1iFunc = NULL; //ericw
 QS_PFNGLUNIFORM1FPROC GL_Uniform1fFunc = NULL; //ericw
 QS_PFNGLUNIFORM3FPROC GL_Uniform3fFunc = NULL; //ericw
 QS_PFNGLUNIFORM4FPROC GL_Uniform4fFunc = NULL; //ericw
+QS_PFNGLVERTEXATTRIBDIVISORPROC GL_VertexAttribDivisorFunc = NULL;
+QS_PFNGLDRAWARRAYSINSTANCEDPROC GL_DrawArraysInstancedFunc = NULL;
 
 //====================================
 
@@ -151,6 +157,7 @@ static cvar_t	vid_vsync = {"vid_vsync", "0", CVAR_ARCHIVE};
 static cvar_t	vid_fsaa = {"vid_fsaa", "0", CVAR_ARCHIVE}; // QuakeSpasm
 static cvar_t	vid_desktopfullscreen = {"vid_desktopfullscreen", "0", CVAR_ARCHIVE}; // QuakeSpasm
 static cvar_t	vid_borderless = {"vid_borderless", "0", CVAR_ARCHIVE}; // QuakeSpasm
+static cvar_t	vid_dumpframes = {"vid_dumpframes", "0", CVAR_NONE};	// write every Nth presented frame to frames/
 //johnfitz
 
 cvar_t		vid_gamma = {"gamma", "1", CVAR_ARCHIVE}; //johnfitz -- moved here from view.c
@@ -179,6 +186,8 @@ static unsigned short vid_sysgamma_blue[256];
 static qboolean	gammaworks = false;	// whether hw-gamma works
 static int fsaa;
 
+qboolean	vid_headless;	// -headless: offscreen context at a fixed size, nothing on screen
+
 void VID_Refocus() {
 #if SDL_MAJOR_VERSION >= 2
 	SDL_SetRelativeMouseMode(SDL_FALSE);
@@ -443,6 +452,8 @@ VID_HasMouseOrInputFocus
 */
 qboolean VID_HasMouseOrInputFocus (void)
 {
+	if (vid_headless)
+		return true;	// there is no window to focus, and the main loop must not throttle benchmarks
 #if defined(USE_SDL2)
 	return (SDL_GetWindowFlags(draw_context) & (SDL_WINDOW_MOUSE_FOCUS | SDL_WINDOW_INPUT_FOCUS)) != 0;
 #else
@@ -457,6 +468,8 @@ VID_IsMinimized
 */
 qboolean VID_IsMinimized (void)
 {
+	if (vid_headless)
+		return false;
 #if defined(USE_SDL2)
 	return !(SDL_GetWindowFlags(draw_context) & SDL_WINDOW_SHOWN);
 #else
@@ -742,6 +755,13 @@ static void VID_Restart (void)
 	if (vid_locked || !vid_changed)
 		return;
 
+	if (vid_headless)
+	{
+		Con_Printf ("vid_restart: the mode is fixed when running headless\n");
+		vid_changed = false;
+		return;
+	}
+
 	if (vr_enabled.value)
 		VID_VR_Disable();
 
@@ -769,9 +789,12 @@ static void VID_Restart (void)
 
 	TexMgr_DeleteTextureObjects ();
 	GLSLGamma_DeleteTexture ();
+	Sky_DeleteCubeMap ();
 	R_DeleteShaders ();
 	GL_DeleteBModelVertexBuffer ();
 	GLMesh_DeleteVertexBuffers ();
+	GLParticle_DeleteBuffers ();
+	Capture_DeleteBuffers ();
 
 //
 // set new mode
@@ -965,6 +988,29 @@ static void GL_CheckExtensions (void)
 		}
 	}
 
+	// ARB_pixel_buffer_object
+	//
+	if (COM_CheckParm("-nopbo"))
+		Con_Warning ("Pixel buffer objects disabled at command line\n");
+	else if (gl_vbo_able && GL_ParseExtensionList(gl_extensions, "GL_ARB_pixel_buffer_object"))
+	{
+		GL_MapBufferFunc = (PFNGLMAPBUFFERARBPROC) SDL_GL_GetProcAddress("glMapBufferARB");
+		GL_UnmapBufferFunc = (PFNGLUNMAPBUFFERARBPROC) SDL_GL_GetProcAddress("glUnmapBufferARB");
+		if (GL_MapBufferFunc && GL_UnmapBufferFunc)
+		{
+			Con_Printf("FOUND: ARB_pixel_buffer_object\n");
+			gl_pbo_able = true;
+		}
+		else
+		{
+			Con_Warning ("ARB_pixel_buffer_object not available\n");
+		}
+	}
+	else
+	{
+		Con_Warning ("ARB_pixel_buffer_object not supported\n");
+	}
+
 	// multitexture
 	//
 	if (COM_CheckParm("-nomtex"))
@@ -1215,6 +1261,29 @@ static void GL_CheckExtensions (void)
 	{
 		Con_Warning ("GLSL alias model rendering not available, using Fitz renderer\n");
 	}
+
+	// GLSL particle rendering
+	//
+	if (COM_CheckParm("-noglslparticles"))
+		Con_Warning ("GLSL particle rendering disabled at command line\n");
+	else if (gl_glsl_able && gl_vbo_able && gl_max_texture_units >= 2 && GL_ParseExtensionList(gl_extensions, "GL_ARB_instanced_arrays"))
+	{
+		GL_VertexAttribDivisorFunc = (QS_PFNGLVERTEXATTRIBDIVISORPROC) SDL_GL_GetProcAddress("glVertexAttribDivisorARB");
+		GL_DrawArraysInstancedFunc = (QS_PFNGLDRAWARRAYSINSTANCEDPROC) SDL_GL_GetProcAddress("glDrawArraysInstancedARB");
+		if (GL_VertexAttribDivisorFunc && GL_DrawArraysInstancedFunc)
+		{
+			Con_Printf("FOUND: ARB_instanced_arrays\n");
+			gl_glsl_particle_able = true;
+		}
+		else
+		{
+			Con_Warning ("Couldn't link to instanced arrays functions\n");
+		}
+	}
+	else
+	{
+		Con_Warning ("GLSL particle rendering not available, using Fitz renderer\n");
+	}
 }
 
 /*
@@ -1252,6 +1321,8 @@ GL_Init
 */
 static void GL_Init (void)
 {
+	GLState_Invalidate (); //new context, nothing we remember about the old one holds
+
 	gl_vendor = (const char *) glGetString (GL_VENDOR);
 	gl_renderer = (const char *) glGetString (GL_RENDERER);
 	gl_version = (const char *) glGetString (GL_VERSION);
@@ -1292,6 +1363,9 @@ static void GL_Init (void)
 	//johnfitz
 
 	GLAlias_CreateShaders ();
+	GLParticle_CreateShaders ();
+	GLWater_CreateShaders ();
+	GLSky_CreateShaders ();
 	GL_ClearBufferBindings ();	
 }
 
@@ -1307,6 +1381,23 @@ void GL_BeginRendering (int *x, int *y, int *width, int *height)
 	*height = vid.height;
 }
 
+/*
+=================
+VID_DumpFrame -- vid_dumpframes N writes every Nth presented frame as a TGA, for checking headless runs
+=================
+*/
+static void VID_DumpFrame (void)
+{
+	static int	framenum;
+	char		name[MAX_QPATH];
+
+	if (vid_dumpframes.value < 1 || framenum++ % (int)vid_dumpframes.value)
+		return;
+
+	q_snprintf (name, sizeof(name), "frames/frame%06i.tga", framenum - 1);
+	Capture_ReadPixels (name, glx, gly, glwidth, glheight, false);
+}
+
 /*
 =================
 GL_EndRendering
@@ -1316,6 +1407,7 @@ void GL_EndRendering (void)
 {
 	if (!scr_skipupdate)
 	{
+		VID_DumpFrame ();
 #if defined(USE_SDL2)
 		SDL_GL_SwapWindow(draw_context);
 #else
@@ -1544,6 +1636,7 @@ void	VID_Init (void)
 	Cvar_SetCallback (&vid_fsaa, VID_FSAA_f);
 	Cvar_SetCallback (&vid_desktopfullscreen, VID_Changed_f);
 	Cvar_SetCallback (&vid_borderless, VID_Changed_f);
+	Cvar_RegisterVariable (&vid_dumpframes);
 	
 	Cmd_AddCommand ("vid_unlock", VID_Unlock); //johnfitz
 	Cmd_AddCommand ("vid_restart", VID_Restart); //johnfitz
@@ -1553,6 +1646,22 @@ void	VID_Init (void)
 
 	putenv (vid_center);	/* SDL_putenv is problematic in versions <= 1.2.9 */
 
+	vid_headless = COM_CheckParm("-headless") != 0;
+	if (vid_headless)
+	{
+#if defined(USE_SDL2)
+		/* SDL's offscreen driver renders into an EGL pbuffer, which Mesa's software
+		   rasterizer provides without a GPU or a display server. an explicit
+		   SDL_VIDEODRIVER in the environment still wins. */
+		static char vid_offscreen[] = "SDL_VIDEODRIVER=offscreen";
+
+		if (!getenv("SDL_VIDEODRIVER"))
+			putenv (vid_offscreen);
+#else
+		Sys_Error ("-headless needs an SDL2 build");
+#endif
+	}
+
 	if (SDL_InitSubSystem(SDL_INIT_VIDEO) < 0)
 		Sys_Error("Couldn't init SDL video: %s", SDL_GetError());
 
@@ -1633,7 +1742,23 @@ void	VID_Init (void)
 	if (p && p < com_argc-1)
 		fsaa = atoi(com_argv[p+1]);
 
-	if (!VID_ValidMode(width, height, bpp, fullscreen))
+	if (vid_headless)
+	{
+	// a fixed size, independent of config.cfg and of whatever modes the offscreen driver reports
+		width = 640;
+		height = 480;
+		p = COM_CheckParm("-width");
+		if (p && p < com_argc-1)
+			width = Q_atoi(com_argv[p+1]);
+		p = COM_CheckParm("-height");
+		if (p && p < com_argc-1)
+			height = Q_atoi(com_argv[p+1]);
+		bpp = 32;
+		fullscreen = false;
+		fsaa = 0;
+		Cvar_SetValueQuick (&vid_vsync, 0);
+	}
+	else if (!VID_ValidMode(width, height, bpp, fullscreen))
 	{
 		width = (int)vid_width.value;
 		height = (int)vid_height.value;
@@ -1641,7 +1766,7 @@ void	VID_Init (void)
 		fullscreen = (int)vid_fullscreen.value;
 	}
 
-	if (!VID_ValidMode(width, height, bpp, fullscreen))
+	if (!vid_headless && !VID_ValidMode(width, height, bpp, fullscreen))
 	{
 		width = 640;
 		height = 480;
@@ -206,6 +206,110 @@ void DrawWaterPoly (glpoly_t *p)
 	}
 }
 
+//==============================================================================
+//
+//  GLSL WATER
+//
+//==============================================================================
+
+static GLuint r_water_program;
+
+// uniforms used in frag shader
+static GLuint waterTexLoc;
+static GLuint waterTimeLoc;
+static GLuint waterAlphaLoc;
+
+/*
+=============
+GLWater_CreateShaders
+
+the fragment shader does WARPCALC per pixel, straight from the original
+texture.  surface texcoords repeat every 128 texels, the same space the
+warpimage covers, and turbsin[i] is 8*sin(i*2pi/256).
+=============
+*/
+void GLWater_CreateShaders (void)
+{
+	const GLchar *vertSource = \
+		"#version 110\n"
+		"\n"
+		"void main()\n"
+		"{\n"
+		"	gl_TexCoord[0] = gl_MultiTexCoord0;\n"
+		"	gl_Position = ftransform();\n"
+		"	// fog\n"
+		"	vec3 ecPosition = vec3(gl_ModelViewMatrix * gl_Vertex);\n"
+		"	gl_FogFragCoord = abs(ecPosition.z);\n"
+		"}\n";
+
+	const GLchar *fragSource = \
+		"#version 110\n"
+		"\n"
+		"uniform sampler2D Tex;\n"
+		"uniform float Time;\n"
+		"uniform float Alpha;\n"
+		"void main()\n"
+		"{\n"
+		"	vec2 st = gl_TexCoord[0].xy * 128.0;\n"
+		"	vec2 warp = (st + 8.0 * sin(st.yx * (3.14159265 / 64.0) + Time)) * (1.0 / 64.0);\n"
+		"	vec4 result = texture2D(Tex, warp);\n"
+		"	// apply GL_EXP2 fog (from the orange book)\n"
+		"	float fog = exp(-gl_Fog.density * gl_Fog.density * gl_FogFragCoord * gl_FogFragCoord);\n"
+		"	fog = clamp(fog, 0.0, 1.0);\n"
+		"	result.rgb = mix(gl_Fog.color.rgb, result.rgb, fog);\n"
+		"	result.a *= Alpha;\n"
+		"	gl_FragColor = result;\n"
+		"}\n";
+
+	if (!gl_glsl_able)
+		return;
+
+	r_water_program = GL_CreateProgram (vertSource, fragSource, 0, NULL);
+
+	if (r_water_program != 0)
+	{
+	// get uniform locations
+		waterTexLoc = GL_GetUniformLocation (&r_water_program, "Tex");
+		waterTimeLoc = GL_GetUniformLocation (&r_water_program, "Time");
+		waterAlphaLoc = GL_GetUniformLocation (&r_water_program, "Alpha");
+	}
+}
+
+/*
+=============
+GLWater_Begin
+
+sets up drawing of water surfaces with texture tx: the warp shader over the
+original texture if we have it, else the warpimage from R_UpdateWarpTextures.
+=============
+*/
+void GLWater_Begin (texture_t *tx, float alpha)
+{
+	if (!r_water_program)
+	{
+		GL_Bind (tx->warpimage);
+		tx->update_warp = true;
+		return;
+	}
+
+	GL_UseProgramFunc (r_water_program);
+	GL_Uniform1iFunc (waterTexLoc, 0);
+	GL_Uniform1fFunc (waterTimeLoc, fmod (cl.time, 2 * M_PI));
+	GL_Uniform1fFunc (waterAlphaLoc, alpha);
+	GL_Bind (tx->gltexture);
+}
+
+/*
+=============
+GLWater_End
+=============
+*/
+void GLWater_End (void)
+{
+	if (r_water_program)
+		GL_UseProgramFunc (0);
+}
+
 //==============================================================================
 //
 //  RENDER-TO-FRAMEBUFFER WATER
@@ -226,6 +330,9 @@ void R_UpdateWarpTextures (void)
 	if (r_oldwater.value || cl.paused || r_drawflat_cheatsafe || r_lightmap_cheatsafe)
 		return;
 
+	if (r_water_program) //the shader warps on the fly, see GLWater_CreateShaders
+		return;
+
 	warptess = 128.0/CLAMP (3.0, floor(r_waterquality.value), 64.0);
 
 	for (i=0; i<cl.worldmodel->numtextures; i++)
@@ -82,23 +82,10 @@ typedef struct
 
 
 typedef enum {
-	pt_static, pt_grav, pt_slowgrav, pt_fire, pt_explode, pt_explode2, pt_blob, pt_blob2
+	pt_static, pt_grav, pt_slowgrav, pt_fire, pt_explode, pt_explode2, pt_blob, pt_blob2,
+	pt_numtypes
 } ptype_t;
 
-// !!! if this is changed, it must be changed in d_ifacea.h too !!!
-typedef struct particle_s
-{
-// driver-usable fields
-	vec3_t		org;
-	float		color;
-// drivers never touch the following fields
-	struct particle_s	*next;
-	vec3_t		vel;
-	float		ramp;
-	float		die;
-	ptype_t		type;
-} particle_t;
-
 
 //====================================================
 
@@ -177,6 +164,9 @@ extern PFNGLBUFFERSUBDATAARBPROC  GL_BufferSubDataFunc;
 extern PFNGLDELETEBUFFERSARBPROC  GL_DeleteBuffersFunc;
 extern PFNGLGENBUFFERSARBPROC  GL_GenBuffersFunc;
 extern	qboolean	gl_vbo_able;
+extern PFNGLMAPBUFFERARBPROC  GL_MapBufferFunc;
+extern PFNGLUNMAPBUFFERARBPROC  GL_UnmapBufferFunc;
+extern	qboolean	gl_pbo_able;
 //ericw
 
 //ericw -- GLSL
@@ -205,6 +195,8 @@ typedef void (APIENTRYP QS_PFNGLUNIFORM1IPROC) (GLint location, GLint v0);
 typedef void (APIENTRYP QS_PFNGLUNIFORM1FPROC) (GLint location, GLfloat v0);
 typedef void (APIENTRYP QS_PFNGLUNIFORM3FPROC) (GLint location, GLfloat v0, GLfloat v1, GLfloat v2);
 typedef void (APIENTRYP QS_PFNGLUNIFORM4FPROC) (GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3);
+typedef void (APIENTRYP QS_PFNGLVERTEXATTRIBDIVISORPROC) (GLuint index, GLuint divisor);
+typedef void (APIENTRYP QS_PFNGLDRAWARRAYSINSTANCEDPROC) (GLenum mode, GLint first, GLsizei count, GLsizei primcount);
 
 extern QS_PFNGLCREATESHADERPROC GL_CreateShaderFunc;
 extern QS_PFNGLDELETESHADERPROC GL_DeleteShaderFunc;
@@ -229,9 +221,12 @@ extern QS_PFNGLUNIFORM1IPROC GL_Uniform1iFunc;
 extern QS_PFNGLUNIFORM1FPROC GL_Uniform1fFunc;
 extern QS_PFNGLUNIFORM3FPROC GL_Uniform3fFunc;
 extern QS_PFNGLUNIFORM4FPROC GL_Uniform4fFunc;
+extern QS_PFNGLVERTEXATTRIBDIVISORPROC GL_VertexAttribDivisorFunc;
+extern QS_PFNGLDRAWARRAYSINSTANCEDPROC GL_DrawArraysInstancedFunc;
 extern	qboolean	gl_glsl_able;
 extern	qboolean	gl_glsl_gamma_able;
 extern	qboolean	gl_glsl_alias_able;
+extern	qboolean	gl_glsl_particle_able;
 // ericw --
 
 //ericw -- NPOT texture support
@@ -291,6 +286,10 @@ extern overflowtimes_t dev_overflows; //this stores the last time overflow messa
 //johnfitz -- moved here from r_brush.c
 extern int gl_lightmap_format, lightmap_bytes;
 #define MAX_LIGHTMAPS 256 //johnfitz -- was 64
+#define LMBLOCK_WIDTH 128
+#define LMBLOCK_HEIGHT 128
+extern int allocated[MAX_LIGHTMAPS][LMBLOCK_WIDTH];
+extern int last_lightmap_allocated;
 extern gltexture_t *lightmap_textures[MAX_LIGHTMAPS]; //johnfitz -- changed to an array
 
 extern int gl_warpimagesize; //johnfitz -- for water warp
@@ -323,10 +322,25 @@ void R_AnimateLight (void);
 void R_MarkSurfaces (void);
 void R_CullSurfaces (void);
 qboolean R_CullBox (vec3_t emins, vec3_t emaxs);
-void R_StoreEfrags (efrag_t **ppefrag);
+void R_StoreStatics (byte *vis, qboolean newvis);
+void R_EntityBounds (entity_t *e, vec3_t mins, vec3_t maxs);
 qboolean R_CullModelForEntity (entity_t *e);
 void R_RotateForEntity (vec3_t origin, vec3_t angles);
-void R_MarkLights (dlight_t *light, int num, mnode_t *node);
+#define DLIGHTBITS_WORDS ((MAX_DLIGHTS + 31) >> 5)
+void R_InitDlightGrid (void);
+void R_DlightsForBox (vec3_t mins, vec3_t maxs, unsigned int *bits);
+void R_SetupSurfaceLights (qmodel_t *model, entity_t *ent);
+void R_MarkSurfaceLights (msurface_t *surf);
+
+void Occlusion_Init (void);
+void Occlusion_NewMap (void);
+void Occlusion_SetupScene (void);
+qboolean Occlusion_CullBox (vec3_t mins, vec3_t maxs);
+void Occlusion_SetMatrix (const float *projection, const float *modelview);
+void Occlusion_Clear (void);
+void Occlusion_DrawPoly (int numverts, const float *verts, int stride);
+void Occlusion_BuildHiZ (void);
+qboolean Occlusion_TestBox (const vec3_t mins, const vec3_t maxs);
 
 void R_InitParticles (void);
 void R_DrawParticles (void);
@@ -348,11 +362,15 @@ void R_RenderDlights (void);
 void GL_BuildLightmaps (void);
 void GL_DeleteBModelVertexBuffer (void);
 void GL_BuildBModelVertexBuffer (void);
+void GLMesh_Init (void);
 void GLMesh_LoadVertexBuffers (void);
 void GLMesh_DeleteVertexBuffers (void);
+void GLMesh_DeleteVertexBuffer (qmodel_t *m);
 void R_RebuildAllLightmaps (void);
 
 int R_LightPoint (vec3_t p);
+void R_InitLightGrid (void);
+void R_LightPointForModel (vec3_t p);
 
 void GL_SubdivideSurface (msurface_t *fa);
 void R_BuildLightMap (msurface_t *surf, byte *dest, int stride);
@@ -369,17 +387,25 @@ GLuint GL_CreateProgram (const GLchar *vertSource, const GLchar *fragSource, int
 void R_DeleteShaders (void);
 
 void GLAlias_CreateShaders (void);
+void GLParticle_CreateShaders (void);
+void GLParticle_DeleteBuffers (void);
 void GL_DrawAliasShadow (entity_t *e);
 void DrawGLTriangleFan (glpoly_t *p);
 void DrawGLPoly (glpoly_t *p);
 void DrawWaterPoly (glpoly_t *p);
-void GL_MakeAliasModelDisplayLists (qmodel_t *m, aliashdr_t *hdr);
+void GLWater_CreateShaders (void);
+void GLWater_Begin (texture_t *tx, float alpha);
+void GLWater_End (void);
+aliasbuild_t *GLMesh_BuildMesh (const mtriangle_t *tris, int numtris, const stvert_t *verts, int numverts, int skinwidth, int skinheight);
+void GL_MakeAliasModelDisplayLists (qmodel_t *m, aliashdr_t *hdr, const aliasbuild_t *prebuilt);
 
 void Sky_Init (void);
 void Sky_DrawSky (void);
 void Sky_NewMap (void);
 void Sky_LoadTexture (texture_t *mt);
 void Sky_LoadSkyBox (const char *name);
+void Sky_DeleteCubeMap (void);
+void GLSky_CreateShaders (void);
 
 void TexMgr_RecalcWarpImageSize (void);
 
@@ -396,5 +422,128 @@ void GLSLGamma_GammaCorrect (void);
 
 float GL_WaterAlphaForSurface (msurface_t *fa);
 
+//gl_stats.c -- per-frame GL call accounting
+typedef enum
+{
+	GLPHASE_OTHER,		// view setup, clears, dlights, debug drawing, eye blits
+	GLPHASE_SKY,
+	GLPHASE_WORLD,
+	GLPHASE_ENTITIES,	// shadows, both entity passes and the viewmodel
+	GLPHASE_WATER,		// warp texture updates and water surfaces
+	GLPHASE_PARTICLES,
+	GLPHASE_2D,
+	NUM_GLPHASES
+} glphase_t;
+
+typedef struct
+{
+	unsigned int	drawcalls, vertices, binds, fbobinds, states, elided, uploads, uploadbytes;
+} glstats_t;
+
+extern glstats_t gl_stats[NUM_GLPHASES];
+extern glphase_t gl_statphase;
+extern cvar_t r_glstats;
+
+#define GL_STAT(field, n)	(gl_stats[gl_statphase].field += (n))
+
+void GLStats_Init (void);
+void GLStats_Shutdown (void);
+void GLStats_EndFrame (void);
+void GLStats_Draw (void);
+void GLStats_TexUpload (int width, int height, unsigned int format, unsigned int type, const void *pixels);
+
+//gl_capture.c -- asynchronous framebuffer readback
+void Capture_Init (void);
+void Capture_Shutdown (void);
+void Capture_DeleteBuffers (void);
+void Capture_Request (const char *basename);
+const char *Capture_PendingName (void);
+void Capture_ReadPixels (const char *name, int x, int y, int width, int height, qboolean report);
+void Capture_EndFrame (void);
+qboolean Capture_BeginVideo (const char *name, float fps, qboolean y4m);
+void Capture_EndVideo (void);
+void Capture_VideoTick (void);
+
+//gl_state.c -- redundant state change elimination
+extern cvar_t gl_statecache;
+
+void GLState_Init (void);
+void GLState_Invalidate (void);
+void GLState_Enable (GLenum cap);
+void GLState_Disable (GLenum cap);
+void GLState_BlendFunc (GLenum src, GLenum dst);
+void GLState_DepthMask (GLboolean flag);
+void GLState_DepthFunc (GLenum func);
+void GLState_DepthRange (GLclampd znear, GLclampd zfar);
+void GLState_AlphaFunc (GLenum func, GLclampf ref);
+void GLState_CullFace (GLenum mode);
+void GLState_ShadeModel (GLenum mode);
+void GLState_TexEnvi (GLenum target, GLenum pname, GLint param);
+void GLState_TexEnvf (GLenum target, GLenum pname, GLfloat param);
+void GLState_ActiveTexture (GLenum unit);
+void GLState_ClientActiveTexture (GLenum unit);
+void GLState_EnableClientState (GLenum array);
+void GLState_DisableClientState (GLenum array);
+void GLState_VertexPointer (GLint size, GLenum type, GLsizei stride, const GLvoid *pointer);
+void GLState_TexCoordPointer (GLint size, GLenum type, GLsizei stride, const GLvoid *pointer);
+void GLState_VertexAttribPointer (GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const GLvoid *pointer);
+void GLState_EnableVertexAttribArray (GLuint index);
+void GLState_DisableVertexAttribArray (GLuint index);
+void GLState_BindBuffer (GLenum target, GLuint buffer);
+void GLState_DeleteBuffers (GLsizei n, const GLuint *buffers);
+void GLState_UseProgram (GLuint program);
+void GLState_DeleteProgram (GLuint program);
+
+// every GL call the renderer makes through these names is counted against the
+// current phase. the real entry points are still reached because a function-like
+// macro is not expanded again inside its own replacement. tracked state goes
+// through gl_state.c instead, which drops calls that would change nothing.
+#ifndef GL_NO_STATS
+#define glBegin(mode)					(GL_STAT(drawcalls, 1), glBegin (mode))
+#define glDrawElements(mode, count, type, ind)		(GL_STAT(drawcalls, 1), GL_STAT(vertices, (count)), glDrawElements (mode, count, type, ind))
+#define GL_DrawArraysInstancedFunc(mode, first, count, num)	(GL_STAT(drawcalls, 1), GL_STAT(vertices, (count) * (num)), GL_DrawArraysInstancedFunc (mode, first, count, num))
+#define glVertex2f(x, y)				(GL_STAT(vertices, 1), glVertex2f (x, y))
+#define glVertex3f(x, y, z)				(GL_STAT(vertices, 1), glVertex3f (x, y, z))
+#define glVertex3fv(v)					(GL_STAT(vertices, 1), glVertex3fv (v))
+#define glBindTexture(target, tex)			(GL_STAT(binds, 1), glBindTexture (target, tex))
+#define glBindFramebufferEXT(target, fbo)		(GL_STAT(fbobinds, 1), glBindFramebufferEXT (target, fbo))
+#define glPolygonOffset(factor, units)			(GL_STAT(states, 1), glPolygonOffset (factor, units))
+#define glPolygonMode(face, mode)			(GL_STAT(states, 1), glPolygonMode (face, mode))
+#define glColorMask(r, g, b, a)				(GL_STAT(states, 1), glColorMask (r, g, b, a))
+#define glTexParameterf(target, pname, param)		(GL_STAT(states, 1), glTexParameterf (target, pname, param))
+#define glTexParameteri(target, pname, param)		(GL_STAT(states, 1), glTexParameteri (target, pname, param))
+#define glFogi(pname, param)				(GL_STAT(states, 1), glFogi (pname, param))
+#define glFogf(pname, param)				(GL_STAT(states, 1), glFogf (pname, param))
+#define glFogfv(pname, params)				(GL_STAT(states, 1), glFogfv (pname, params))
+#define glEnable(cap)					GLState_Enable (cap)
+#define glDisable(cap)					GLState_Disable (cap)
+#define glBlendFunc(src, dst)				GLState_BlendFunc (src, dst)
+#define glDepthMask(flag)				GLState_DepthMask (flag)
+#define glDepthFunc(func)				GLState_DepthFunc (func)
+#define glDepthRange(n, f)				GLState_DepthRange (n, f)
+#define glAlphaFunc(func, ref)				GLState_AlphaFunc (func, ref)
+#define glCullFace(mode)				GLState_CullFace (mode)
+#define glShadeModel(mode)				GLState_ShadeModel (mode)
+#define glTexEnvf(target, pname, param)			GLState_TexEnvf (target, pname, param)
+#define glTexEnvi(target, pname, param)			GLState_TexEnvi (target, pname, param)
+#define GL_SelectTextureFunc(unit)			GLState_ActiveTexture (unit)
+#define GL_ClientActiveTextureFunc(unit)		GLState_ClientActiveTexture (unit)
+#define glEnableClientState(array)			GLState_EnableClientState (array)
+#define glDisableClientState(array)			GLState_DisableClientState (array)
+#define glVertexPointer(size, type, stride, p)		GLState_VertexPointer (size, type, stride, p)
+#define glTexCoordPointer(size, type, stride, p)	GLState_TexCoordPointer (size, type, stride, p)
+#define GL_VertexAttribPointerFunc(i, size, type, n, stride, p)	GLState_VertexAttribPointer (i, size, type, n, stride, p)
+#define GL_EnableVertexAttribArrayFunc(i)		GLState_EnableVertexAttribArray (i)
+#define GL_DisableVertexAttribArrayFunc(i)		GLState_DisableVertexAttribArray (i)
+#define GL_BindBufferFunc(target, buf)			GLState_BindBuffer (target, buf)
+#define GL_DeleteBuffersFunc(n, bufs)			GLState_DeleteBuffers (n, bufs)
+#define GL_UseProgramFunc(prog)				GLState_UseProgram (prog)
+#define GL_DeleteProgramFunc(prog)			GLState_DeleteProgram (prog)
+#define glTexImage2D(t, l, ifmt, w, h, b, fmt, type, p)	(GLStats_TexUpload (w, h, fmt, type, p), glTexImage2D (t, l, ifmt, w, h, b, fmt, type, p))
+#define glTexSubImage2D(t, l, x, y, w, h, fmt, type, p)	(GLStats_TexUpload (w, h, fmt, type, p), glTexSubImage2D (t, l, x, y, w, h, fmt, type, p))
+#define GL_BufferDataFunc(target, size, data, usage)	(GL_STAT(uploads, 1), GL_STAT(uploadbytes, (data) ? (size) : 0), GL_BufferDataFunc (target, size, data, usage))
+#define GL_BufferSubDataFunc(target, ofs, size, data)	(GL_STAT(uploads, 1), GL_STAT(uploadbytes, (size)), GL_BufferSubDataFunc (target, ofs, size, data))
+#endif
+
 #endif	/* __GLQUAKE_H */
 
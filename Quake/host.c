@@ -62,6 +62,7 @@ cvar_t	host_framerate = {"host_framerate","0",CVAR_NONE};	// set for slow motion
 cvar_t	host_speeds = {"host_speeds","0",CVAR_NONE};			// set for running times
 cvar_t	host_maxfps = {"host_maxfps", "72", CVAR_ARCHIVE}; //johnfitz
 cvar_t	host_timescale = {"host_timescale", "0", CVAR_NONE}; //johnfitz
+cvar_t	host_keepassets = {"host_keepassets", "1", CVAR_ARCHIVE};	// keep models the next level precaches too
 cvar_t	max_edicts = {"max_edicts", "8192", CVAR_NONE}; //johnfitz //ericw -- changed from 2048 to 8192, removed CVAR_ARCHIVE
 
 cvar_t	sys_ticrate = {"sys_ticrate","0.05",CVAR_NONE}; // dedicated server
@@ -148,6 +149,8 @@ void Host_Error (const char *error, ...)
 	inerror = true;
 
 	SCR_EndLoadingPlaque ();		// reenable screen updates
+	TexMgr_EndBatch ();			// a model load may have been cut short
+	S_AbortBatch ();			// and so may the sound precache
 
 	va_start (argptr,error);
 	q_vsnprintf (string, sizeof(string), error, argptr);
@@ -249,6 +252,7 @@ void Host_InitLocal (void)
 	Cvar_RegisterVariable (&host_speeds);
 	Cvar_RegisterVariable (&host_maxfps); //johnfitz
 	Cvar_RegisterVariable (&host_timescale); //johnfitz
+	Cvar_RegisterVariable (&host_keepassets);
 
 	Cvar_RegisterVariable (&max_edicts); //johnfitz
 	Cvar_SetCallback (&max_edicts, Max_Edicts_f);
@@ -577,6 +581,14 @@ qboolean Host_FilterTime (float time)
 
 	realtime += time;
 
+	// capturedemo runs every frame, at exactly the video frame length
+	host_frametime = CL_CaptureDemoFrame ();
+	if (host_frametime > 0)
+	{
+		oldrealtime = realtime;
+		return true;
+	}
+
 	//johnfitz -- max fps cvar
 	maxfps = CLAMP (10.0, host_maxfps.value, 1000.0);
 	if (!cls.timedemo && realtime - oldrealtime < 1.0/maxfps && !vr_enabled.value)
@@ -835,6 +847,7 @@ void Host_Init (void)
 	LOG_Init (host_parms);
 	Cvar_Init (); //johnfitz
 	COM_Init ();
+	Tasks_Init ();
 	COM_InitFilesystem ();
 	Host_InitLocal ();
 	W_LoadWadFile (); //johnfitz -- filename is now hard-coded for honesty
@@ -935,10 +948,14 @@ void Host_Shutdown(void)
 		CDAudio_Shutdown ();
 		S_Shutdown ();
 		IN_Shutdown ();
+		GLStats_Shutdown ();
+		Capture_Shutdown ();
         VID_VR_Shutdown();
 		VID_Shutdown();
 	}
 
+	Tasks_Shutdown ();
+
 	LOG_Close ();
 }
 
@@ -1101,6 +1101,7 @@ static void PF_precache_model (void)
 		{
 			sv.model_precache[i] = s;
 			sv.models[i] = Mod_ForName (s, true);
+			Mod_AddRef (sv.models[i]);
 			return;
 		}
 		if (!strcmp(sv.model_precache[i], s))
@@ -99,6 +99,9 @@ void S_StopAllSounds(qboolean clear);
 void S_ClearBuffer (void);
 void S_Update (vec3_t origin, vec3_t forward, vec3_t right, vec3_t up);
 void S_ExtraUpdate (void);
+void S_BeginCapture (float fps);
+void S_EndCapture (void);
+void Capture_AudioSamples (const portable_samplepair_t *samples, int count);	// gl_capture.c
 
 void S_BlockSound (void);
 void S_UnblockSound (void);
@@ -184,6 +187,13 @@ extern	cvar_t		bgmvolume;
 void S_LocalSound (const char *name);
 sfxcache_t *S_LoadSound (sfx_t *s);
 
+/* batched loading between S_BeginPrecaching and S_EndPrecaching: the files
+ * are read, parsed and resampled on the task threads */
+void S_BeginBatch (void);
+qboolean S_BatchSound (sfx_t *s);
+void S_EndBatch (void);
+void S_AbortBatch (void);
+
 wavinfo_t GetWavinfo (const char *name, byte *wav, int wavlength);
 
 void SND_InitScaletable (void);
@@ -208,6 +208,7 @@ typedef struct
 
 #include "cmd.h"
 #include "crc.h"
+#include "tasks.h"
 
 #include "progs.h"
 #include "server.h"
@@ -270,6 +271,7 @@ extern	cvar_t		sys_throttle;
 extern	cvar_t		sys_nostdout;
 extern	cvar_t		developer;
 extern	cvar_t		max_edicts; //johnfitz
+extern	cvar_t		host_keepassets;
 
 extern	qboolean	host_initialized;	// true if into command execution
 extern	double		host_frametime;
@@ -537,15 +537,17 @@ void R_SetupAliasLighting (entity_t	*e)
 	vec3_t		dist;
 	float		add;
 	int			i;
+	unsigned int	dlightbits[DLIGHTBITS_WORDS];
 	int		quantizedangle;
 	float		radiansangle;
 
-	R_LightPoint (e->origin);
+	R_LightPointForModel (e->origin);
 
-	//add dlights
+	//add dlights from this model's cluster
+	R_DlightsForBox (e->origin, e->origin, dlightbits);
 	for (i=0 ; i<MAX_DLIGHTS ; i++)
 	{
-		if (cl_dlights[i].die >= cl.time)
+		if (dlightbits[i >> 5] & (1U << (i & 31)))
 		{
 			VectorSubtract (currententity->origin, cl_dlights[i].origin, dist);
 			add = cl_dlights[i].radius - VectorLength(dist);
@@ -0,0 +1,591 @@
+/*
+Copyright (C) 1996-2001 Id Software, Inc.
+Copyright (C) 2002-2009 John Fitzgibbons and others
+Copyright (C) 2010-2014 QuakeSpasm developers
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+//r_occlude.c -- software occlusion culling for entities
+
+#include "quakedef.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OCC_SSE2
+#include <emmintrin.h>
+#endif
+
+#define OCC_WIDTH		256
+#define OCC_HEIGHT		128
+#define OCC_LEVELS		8			// 256x128 down to 2x1
+#define OCC_MAX_VERTS	64
+#define OCC_GUARDBAND	4.0			// occluders are clipped this many screens out
+#define OCC_DEPTH_BIAS	1.01		// a box has to be this much farther than the occluder to be hidden
+#define OCC_MIN_AREA	(64*64)		// smallest world surface that is drawn as an occluder
+
+cvar_t r_occlusioncull = {"r_occlusioncull", "0", CVAR_ARCHIVE};
+
+// the depth buffer holds 1/w, which is linear in screen space and bigger
+// nearer, with 0 where nothing was drawn.  each level of the pyramid above it
+// holds the farthest depth of the 2x2 texels under it.
+static float	occ_depth[OCC_WIDTH*OCC_HEIGHT];
+static float	occ_hiz[OCC_WIDTH*OCC_HEIGHT/3];
+static float	*occ_levels[OCC_LEVELS];
+static int		occ_levelwidth[OCC_LEVELS];
+static int		occ_levelheight[OCC_LEVELS];
+
+static float	occ_matrix[16];		// model-view-projection, column major like GL
+static qboolean	occ_valid;			// buffer drawn for the current scene
+static qboolean	occ_usesimd = true;	// cleared by timeocclusion for the scalar pass
+
+static byte		*occ_occluders;		// for each world surface, true if it is big enough to draw
+
+static const float occ_clipplanes[5][4] =
+{
+	{0, 0, 1, 1},					// near
+	{1, 0, 0, OCC_GUARDBAND},		// left
+	{-1, 0, 0, OCC_GUARDBAND},		// right
+	{0, 1, 0, OCC_GUARDBAND},		// bottom
+	{0, -1, 0, OCC_GUARDBAND}		// top
+};
+
+//==============================================================================
+//
+//  RASTERIZER
+//
+//==============================================================================
+
+/*
+=============
+Occlusion_SetMatrix -- sets the transform used to draw occluders and test boxes
+=============
+*/
+void Occlusion_SetMatrix (const float *projection, const float *modelview)
+{
+	int		i, j, k;
+	float	sum;
+
+	for (i=0 ; i<4 ; i++)
+	{
+		for (j=0 ; j<4 ; j++)
+		{
+			sum = 0;
+			for (k=0 ; k<4 ; k++)
+				sum += projection[k*4+i] * modelview[j*4+k];
+			occ_matrix[j*4+i] = sum;
+		}
+	}
+}
+
+/*
+=============
+Occlusion_Clear
+=============
+*/
+void Occlusion_Clear (void)
+{
+	int		i, ofs, w, h;
+
+	memset (occ_depth, 0, sizeof(occ_depth));
+
+	occ_levels[0] = occ_depth;
+	occ_levelwidth[0] = OCC_WIDTH;
+	occ_levelheight[0] = OCC_HEIGHT;
+	for (i=1, ofs=0, w=OCC_WIDTH/2, h=OCC_HEIGHT/2 ; i<OCC_LEVELS ; i++, w/=2, h/=2)
+	{
+		occ_levels[i] = &occ_hiz[ofs];
+		occ_levelwidth[i] = w;
+		occ_levelheight[i] = h;
+		ofs += w*h;
+	}
+}
+
+/*
+=============
+OCC_Transform
+=============
+*/
+static void OCC_Transform (const float *v, float *out)
+{
+	int		i;
+
+	for (i=0 ; i<4 ; i++)
+		out[i] = occ_matrix[i] * v[0] + occ_matrix[4+i] * v[1] + occ_matrix[8+i] * v[2] + occ_matrix[12+i];
+}
+
+/*
+=============
+OCC_ClipPoly -- clips a polygon in clip space to the inside of plane
+=============
+*/
+static int OCC_ClipPoly (int numverts, float (*in)[4], float (*out)[4], const float *plane)
+{
+	float	dists[OCC_MAX_VERTS], frac;
+	int		i, j, k, numout;
+
+	for (i=0 ; i<numverts ; i++)
+		dists[i] = in[i][0]*plane[0] + in[i][1]*plane[1] + in[i][2]*plane[2] + in[i][3]*plane[3];
+
+	numout = 0;
+	for (i=0 ; i<numverts ; i++)
+	{
+		j = (i+1) % numverts;
+		if (dists[i] >= 0)
+		{
+			memcpy (out[numout], in[i], sizeof(out[0]));
+			numout++;
+		}
+		if ((dists[i] >= 0) != (dists[j] >= 0))
+		{
+			frac = dists[i] / (dists[i] - dists[j]);
+			for (k=0 ; k<4 ; k++)
+				out[numout][k] = in[i][k] + frac * (in[j][k] - in[i][k]);
+			numout++;
+		}
+	}
+
+	return numout;
+}
+
+/*
+=============
+OCC_DrawSpan
+
+keeps the nearest depth of the pixels in a row that are inside all the
+edges.  x0 is a multiple of 4, and pixels are done in groups of four up to
+the one containing x1, so the scalar and SSE2 versions touch the same pixels
+and work out every value the same way.
+=============
+*/
+static void OCC_DrawSpan (float *row, int x0, int x1, int numedges, const float *e, const float *de, float z, float dz)
+{
+	int		i, x;
+	float	k;
+
+#ifdef OCC_SSE2
+	if (occ_usesimd)
+	{
+		__m128	zv, dzv, kv, steps, zero, mask, old, cur;
+
+		zv = _mm_set1_ps (z);
+		dzv = _mm_set1_ps (dz);
+		steps = _mm_set_ps (3, 2, 1, 0);
+		zero = _mm_setzero_ps ();
+
+		for (x=x0 ; x<=x1 ; x+=4)
+		{
+			kv = _mm_add_ps (_mm_set1_ps ((float)(x - x0)), steps);
+			mask = _mm_cmpeq_ps (zero, zero);
+			for (i=0 ; i<numedges ; i++)
+				mask = _mm_and_ps (mask, _mm_cmpge_ps (_mm_add_ps (_mm_set1_ps (e[i]), _mm_mul_ps (kv, _mm_set1_ps (de[i]))), zero));
+			if (!_mm_movemask_ps (mask))
+				continue;
+			old = _mm_loadu_ps (row + x);
+			cur = _mm_max_ps (old, _mm_add_ps (zv, _mm_mul_ps (kv, dzv)));
+			_mm_storeu_ps (row + x, _mm_or_ps (_mm_and_ps (mask, cur), _mm_andnot_ps (mask, old)));
+		}
+		return;
+	}
+#endif
+
+	x1 |= 3;
+	for (x=x0 ; x<=x1 ; x++)
+	{
+		k = (float)(x - x0);
+		for (i=0 ; i<numedges ; i++)
+			if (!(e[i] + k * de[i] >= 0))
+				break;
+		if (i == numedges)
+		{
+			if (z + k * dz > row[x])
+				row[x] = z + k * dz;
+		}
+	}
+}
+
+/*
+=============
+OCC_DrawPolygon
+
+each vertex is screen x, screen y, 1/w.  draws the convex polygon
+conservatively: a pixel is only written if its whole cell is inside, and
+gets the depth of its farthest corner, so nothing that shows through a gap
+or past an edge narrower than a pixel is hidden.
+=============
+*/
+static void OCC_DrawPolygon (int numverts, float (*v)[3])
+{
+	float	ea[OCC_MAX_VERTS], eb[OCC_MAX_VERTS], ec[OCC_MAX_VERTS], e[OCC_MAX_VERTS];
+	float	area, best, sign, za, zb, zc, px, py;
+	float	minx, maxx, miny, maxy;
+	const float	*a, *b, *c;
+	int		i, j, x0, x1, y, y0, y1;
+
+	// the polygon is flat, so any triangle of it gives the depth plane; the
+	// biggest one gives the most accurate one
+	area = best = 0;
+	a = b = c = v[0];
+	for (i=2 ; i<numverts ; i++)
+	{
+		sign = (v[i-1][0] - v[0][0]) * (v[i][1] - v[0][1]) - (v[i-1][1] - v[0][1]) * (v[i][0] - v[0][0]);
+		area += sign;
+		if (fabs (sign) > fabs (best))
+		{
+			best = sign;
+			b = v[i-1];
+			c = v[i];
+		}
+	}
+	if (area == 0 || best == 0)
+		return;
+	sign = (area < 0) ? -1 : 1;
+
+	// edge functions, positive inside, moved in by half a pixel's extent
+	// along each so that they test the pixel's worst corner
+	for (i=0 ; i<numverts ; i++)
+	{
+		j = (i+1) % numverts;
+		ea[i] = sign * (v[i][1] - v[j][1]);
+		eb[i] = sign * (v[j][0] - v[i][0]);
+		ec[i] = -(ea[i] * v[i][0] + eb[i] * v[i][1]) - 0.5f * (fabs (ea[i]) + fabs (eb[i]));
+	}
+
+	// depth plane, taken at the farthest corner of each pixel
+	za = ((b[2] - a[2]) * (c[1] - a[1]) - (c[2] - a[2]) * (b[1] - a[1])) / best;
+	zb = ((c[2] - a[2]) * (b[0] - a[0]) - (b[2] - a[2]) * (c[0] - a[0])) / best;
+	zc = a[2] - za * a[0] - zb * a[1] - 0.5f * (fabs (za) + fabs (zb));
+
+	minx = maxx = v[0][0];
+	miny = maxy = v[0][1];
+	for (i=1 ; i<numverts ; i++)
+	{
+		minx = q_min (minx, v[i][0]);
+		maxx = q_max (maxx, v[i][0]);
+		miny = q_min (miny, v[i][1]);
+		maxy = q_max (maxy, v[i][1]);
+	}
+	if (maxx < 0 || maxy < 0 || minx > OCC_WIDTH || miny > OCC_HEIGHT)
+		return;
+
+	x0 = q_max (0, (int)minx) & ~3;
+	x1 = q_min (OCC_WIDTH - 1, (int)maxx);
+	y0 = q_max (0, (int)miny);
+	y1 = q_min (OCC_HEIGHT - 1, (int)maxy);
+
+	px = x0 + 0.5f;
+	for (y=y0 ; y<=y1 ; y++)
+	{
+		py = y + 0.5f;
+		for (i=0 ; i<numverts ; i++)
+			e[i] = ea[i] * px + eb[i] * py + ec[i];
+		OCC_DrawSpan (occ_depth + y * OCC_WIDTH, x0, x1, numverts, e, ea, za * px + zb * py + zc, za);
+	}
+}
+
+/*
+=============
+Occlusion_DrawPoly -- draws a convex world space polygon into the depth buffer
+=============
+*/
+void Occlusion_DrawPoly (int numverts, const float *verts, int stride)
+{
+	float	clip[2][OCC_MAX_VERTS][4];
+	float	screen[OCC_MAX_VERTS][3];
+	int		i, cur;
+
+	if (numverts < 3 || numverts > OCC_MAX_VERTS - 5)
+		return; //each plane can add a vertex
+
+	for (i=0 ; i<numverts ; i++, verts+=stride)
+		OCC_Transform (verts, clip[0][i]);
+
+	for (i=0, cur=0 ; i<5 ; i++, cur^=1)
+	{
+		numverts = OCC_ClipPoly (numverts, clip[cur], clip[cur^1], occ_clipplanes[i]);
+		if (numverts < 3)
+			return;
+	}
+
+	for (i=0 ; i<numverts ; i++)
+	{
+		screen[i][2] = 1.0f / clip[cur][i][3];
+		screen[i][0] = (clip[cur][i][0] * screen[i][2] * 0.5f + 0.5f) * OCC_WIDTH;
+		screen[i][1] = (clip[cur][i][1] * screen[i][2] * 0.5f + 0.5f) * OCC_HEIGHT;
+	}
+
+	OCC_DrawPolygon (numverts, screen);
+}
+
+/*
+=============
+Occlusion_BuildHiZ -- call after drawing all the occluders
+=============
+*/
+void Occlusion_BuildHiZ (void)
+{
+	float	*src, *dst;
+	int		i, x, y, w, h, sw;
+
+	for (i=1 ; i<OCC_LEVELS ; i++)
+	{
+		src = occ_levels[i-1];
+		sw = occ_levelwidth[i-1];
+		dst = occ_levels[i];
+		w = occ_levelwidth[i];
+		h = occ_levelheight[i];
+		for (y=0 ; y<h ; y++, src+=sw*2)
+			for (x=0 ; x<w ; x++)
+				*dst++ = q_min (q_min (src[x*2], src[x*2+1]), q_min (src[sw+x*2], src[sw+x*2+1]));
+	}
+}
+
+/*
+=============
+Occlusion_TestBox -- returns true if the box is hidden by the occluders
+=============
+*/
+qboolean Occlusion_TestBox (const vec3_t mins, const vec3_t maxs)
+{
+	float	*level;
+	float	v[3], c[4], iw, sx, sy, minx, maxx, miny, maxy, maxiw;
+	int		i, l, w, x, y, x0, x1, y0, y1;
+
+	minx = miny = 99999;
+	maxx = maxy = -99999;
+	maxiw = 0;
+	for (i=0 ; i<8 ; i++)
+	{
+		v[0] = (i & 1) ? maxs[0] : mins[0];
+		v[1] = (i & 2) ? maxs[1] : mins[1];
+		v[2] = (i & 4) ? maxs[2] : mins[2];
+		OCC_Transform (v, c);
+		if (c[3] <= 0 || c[2] + c[3] < 0)
+			return false; //crosses the near plane
+		iw = 1.0f / c[3];
+		sx = (c[0] * iw * 0.5f + 0.5f) * OCC_WIDTH;
+		sy = (c[1] * iw * 0.5f + 0.5f) * OCC_HEIGHT;
+		minx = q_min (minx, sx);
+		maxx = q_max (maxx, sx);
+		miny = q_min (miny, sy);
+		maxy = q_max (maxy, sy);
+		maxiw = q_max (maxiw, iw);
+	}
+
+	if (maxx < 0 || maxy < 0 || minx >= OCC_WIDTH || miny >= OCC_HEIGHT)
+		return false; //leave it to the frustum
+	x0 = q_max (0, (int)minx);
+	x1 = q_min (OCC_WIDTH - 1, (int)maxx);
+	y0 = q_max (0, (int)miny);
+	y1 = q_min (OCC_HEIGHT - 1, (int)maxy);
+
+	// pick a level where the box covers no more than 3x3 texels
+	for (l=0 ; l<OCC_LEVELS-1 ; l++)
+		if ((x1 >> l) - (x0 >> l) < 3 && (y1 >> l) - (y0 >> l) < 3)
+			break;
+
+	level = occ_levels[l];
+	w = occ_levelwidth[l];
+	maxiw *= OCC_DEPTH_BIAS;
+	for (y = y0 >> l ; y <= y1 >> l ; y++)
+		for (x = x0 >> l ; x <= x1 >> l ; x++)
+			if (level[y * w + x] <= maxiw)
+				return false;
+
+	return true;
+}
+
+//==============================================================================
+//
+//  WORLD OCCLUDERS
+//
+//==============================================================================
+
+/*
+=============
+Occlusion_NewMap -- picks the world surfaces to draw as occluders
+=============
+*/
+void Occlusion_NewMap (void)
+{
+	msurface_t	*s;
+	glpoly_t	*p;
+	vec3_t		v1, v2, cross;
+	float		area;
+	int			i, j;
+
+	occ_valid = false;
+	occ_occluders = (byte *) Hunk_AllocName (cl.worldmodel->numsurfaces, "occluders");
+
+	for (i=0, s=cl.worldmodel->surfaces ; i<cl.worldmodel->numsurfaces ; i++, s++)
+	{
+		// anything that can be seen through, or is drawn over everything else
+		if (s->flags & (SURF_DRAWSKY | SURF_DRAWTURB | SURF_DRAWFENCE))
+			continue;
+
+		p = s->polys;
+		if (!p)
+			continue;
+
+		area = 0;
+		for (j=2 ; j<p->numverts ; j++)
+		{
+			VectorSubtract (p->verts[j-1], p->verts[0], v1);
+			VectorSubtract (p->verts[j], p->verts[0], v2);
+			CrossProduct (v1, v2, cross);
+			area += VectorLength (cross) * 0.5;
+		}
+		occ_occluders[i] = (area >= OCC_MIN_AREA);
+	}
+}
+
+/*
+=============
+OCC_DrawWorld -- draws the big visible world surfaces into a cleared buffer
+=============
+*/
+static int OCC_DrawWorld (void)
+{
+	msurface_t	*s;
+	texture_t	*t;
+	int			i, count;
+
+	count = 0;
+	for (i=0 ; i<cl.worldmodel->numtextures ; i++)
+	{
+		t = cl.worldmodel->textures[i];
+		if (!t)
+			continue;
+
+		for (s = t->texturechains[chain_world]; s; s = s->texturechain)
+		{
+			if (!s->culled && occ_occluders[s - cl.worldmodel->surfaces])
+			{
+				Occlusion_DrawPoly (s->polys->numverts, s->polys->verts[0], VERTEXSIZE);
+				count++;
+			}
+		}
+	}
+
+	Occlusion_BuildHiZ ();
+	return count;
+}
+
+/*
+=============
+Occlusion_SetupScene
+
+draws the occluders for this eye's view, with the matrices R_SetupGL has
+just loaded.  call once per R_RenderScene.
+=============
+*/
+void Occlusion_SetupScene (void)
+{
+	float	projection[16], modelview[16];
+
+	occ_valid = false;
+	if (!r_occlusioncull.value || !r_drawworld_cheatsafe || !occ_occluders)
+		return;
+
+	glGetFloatv (GL_PROJECTION_MATRIX, projection);
+	glGetFloatv (GL_MODELVIEW_MATRIX, modelview);
+	Occlusion_SetMatrix (projection, modelview);
+	Occlusion_Clear ();
+	OCC_DrawWorld ();
+	occ_valid = true;
+}
+
+/*
+=============
+Occlusion_CullBox -- returns true if the box is hidden behind the world
+=============
+*/
+qboolean Occlusion_CullBox (vec3_t mins, vec3_t maxs)
+{
+	if (!occ_valid)
+		return false;
+
+	return Occlusion_TestBox (mins, maxs);
+}
+
+/*
+====================
+Occlusion_Time_f
+
+For program optimization -- draws the occluders for the last view and tests
+every visible entity against them, with the scalar and (if built in) SSE2
+rasterizer.  both have to end with the same depth buffer.
+====================
+*/
+static void Occlusion_Time_f (void)
+{
+	static float	saved[OCC_WIDTH*OCC_HEIGHT];
+	double	start, time;
+	int		frames, pass, passes, i, j, occluders, culled;
+	qboolean	mismatch;
+
+	if (!occ_valid)
+	{
+		Con_Printf ("timeocclusion: needs a map running with r_occlusioncull 1\n");
+		return;
+	}
+
+	frames = (Cmd_Argc() > 1) ? Q_atoi (Cmd_Argv(1)) : 100;
+	if (frames < 1)
+		frames = 1;
+
+#ifdef OCC_SSE2
+	passes = 2;
+#else
+	passes = 1;
+#endif
+	for (pass=0 ; pass<passes ; pass++)
+	{
+		occ_usesimd = (pass == 1);
+		occluders = culled = 0;
+		start = Sys_DoubleTime ();
+		for (i=0 ; i<frames ; i++)
+		{
+			Occlusion_Clear ();
+			occluders = OCC_DrawWorld ();
+			for (j=0, culled=0 ; j<cl_numvisedicts ; j++)
+				if (cl_visedicts[j]->model && R_CullModelForEntity (cl_visedicts[j]))
+					culled++;
+		}
+		time = Sys_DoubleTime () - start;
+
+		mismatch = false;
+		if (pass == 0)
+			memcpy (saved, occ_depth, sizeof(saved));
+		else
+			mismatch = memcmp (saved, occ_depth, sizeof(saved)) != 0;
+
+		Con_Printf ("%s: %i occluders, %i of %i entities culled: %f ms/frame%s\n",
+			(pass == 1) ? "sse2" : "scalar", occluders, culled, cl_numvisedicts,
+			time * 1000 / frames, mismatch ? " MISMATCH" : "");
+	}
+	occ_usesimd = true;
+}
+
+/*
+=============
+Occlusion_Init
+=============
+*/
+void Occlusion_Init (void)
+{
+	Cvar_RegisterVariable (&r_occlusioncull);
+	Cmd_AddCommand ("timeocclusion", Occlusion_Time_f);
+}
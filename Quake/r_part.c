@@ -32,7 +32,65 @@ int		ramp1[8] = {0x6f, 0x6d, 0x6b, 0x69, 0x67, 0x65, 0x63, 0x61};
 int		ramp2[8] = {0x6f, 0x6e, 0x6d, 0x6c, 0x6b, 0x6a, 0x68, 0x66};
 int		ramp3[8] = {0x6d, 0x6b, 6, 5, 4, 3};
 
-particle_t	*active_particles, *free_particles, *particles;
+/*
+particles are stored structure-of-arrays, in fixed size blocks.  each type
+has its own list of blocks, all full except the last, so the update for a
+type is one straight loop per block with no per-particle switch.  dead
+particles are swap-removed with the last particle of their type, and empty
+blocks go back to a shared free list.
+*/
+#define PARTICLE_BLOCK_SIZE		256
+
+typedef struct particleblock_s
+{
+	float	org[3][PARTICLE_BLOCK_SIZE];
+	float	vel[3][PARTICLE_BLOCK_SIZE];
+	float	ramp[PARTICLE_BLOCK_SIZE];
+	float	die[PARTICLE_BLOCK_SIZE];
+	byte	color[PARTICLE_BLOCK_SIZE];
+	struct particleblock_s	*next;	// free list
+} particleblock_t;
+
+typedef struct
+{
+	particleblock_t	**blocks;
+	int				numparticles;
+} particlepool_t;
+
+typedef struct
+{
+	float	frametime, grav, dvel, time1, time2, time3;
+} particlestep_t;
+
+typedef void (*particlekernel_t) (particleblock_t *b, int n, const particlestep_t *step);
+
+typedef struct
+{
+	particlekernel_t	kernel;
+	particleblock_t		*block;
+	int					count;
+} particlechunk_t;
+
+typedef struct
+{
+	particlechunk_t			*chunks;
+	const particlestep_t	*step;
+} particlejob_t;
+
+static particlepool_t	particlepools[pt_numtypes];
+static particleblock_t	*particleblocks, *free_particleblocks;
+static int				r_numparticleblocks;
+static int				r_numactiveparticles;
+
+/*
+the per-block updates are handed to the task threads once there are enough
+blocks to pay for waking them up.  r_particlethreads caps the threads used,
+0 meaning all of them; timeparticles changes it to measure the scaling.
+*/
+#define PARTICLE_MIN_PARALLEL_CHUNKS	16
+
+static particlechunk_t	*particlechunks;	// rebuilt every frame, one per block in use
+static int				r_particlethreads;
 
 vec3_t			r_pright, r_pup, r_ppn;
 
@@ -44,6 +102,42 @@ float texturescalefactor; //johnfitz -- compensate for apparent size of differen
 cvar_t	r_particles = {"r_particles","1", CVAR_ARCHIVE}; //johnfitz
 cvar_t	r_quadparticles = {"r_quadparticles","1", CVAR_ARCHIVE}; //johnfitz
 
+/*
+the GLSL path streams each block's origins and color indices into one VBO,
+once per frame no matter how many eyes are drawn, and expands them into
+billboards in the vertex shader with one instanced draw per block.  the
+corner table goes at the start of the buffer: a triangle, then a quad.
+*/
+#define PARTICLE_VBO_BLOCK_SIZE	(PARTICLE_BLOCK_SIZE * (3 * sizeof(float) + 1))
+
+static const float particlecorners[7][2] = {
+	{0, 0}, {1, 0}, {0, 1},
+	{0, 0}, {0.5, 0}, {0.5, 0.5}, {0, 0.5}
+};
+
+static gltexture_t	*particlepalette;
+static qboolean		r_particlesdirty;
+
+static GLuint r_particle_program;
+static GLuint r_particle_vbo;
+
+// uniforms used in vert shader
+static GLuint upLoc;
+static GLuint rightLoc;
+static GLuint viewOriginLoc;
+static GLuint viewForwardLoc;
+static GLuint textureScaleLoc;
+
+// uniforms used in frag shader
+static GLuint particleTexLoc;
+static GLuint paletteTexLoc;
+
+static const GLint cornerAttrIndex = 0;
+static const GLint originXAttrIndex = 1;
+static const GLint originYAttrIndex = 2;
+static const GLint originZAttrIndex = 3;
+static const GLint colorIndexAttrIndex = 4;
+
 /*
 ===============
 R_ParticleTextureLookup -- johnfitz -- generate nice antialiased 32x32 circle for particles
@@ -74,6 +168,7 @@ void R_InitParticleTextures (void)
 	static byte	particle1_data[64*64*4];
 	static byte	particle2_data[2*2*4];
 	static byte	particle3_data[64*64*4];
+	static byte	palette_data[256*4];
 	byte		*dst;
 
 	// particle texture 1 -- circle
@@ -112,6 +207,16 @@ void R_InitParticleTextures (void)
 		}
 	particletexture3 = TexMgr_LoadImage (NULL, "particle3", 64, 64, SRC_RGBA, particle3_data, "", (src_offset_t)particle3_data, TEXPREF_PERSIST | TEXPREF_ALPHA | TEXPREF_LINEAR);
 
+	// palette lookup for the GLSL path, which only sends color indices
+	dst = palette_data;
+	for (x=0 ; x<256 ; x++)
+	{
+		memcpy (dst, &d_8to24table[x], 3);
+		dst[3] = 255;
+		dst += 4;
+	}
+	particlepalette = TexMgr_LoadImage (NULL, "particlepalette", 256, 1, SRC_RGBA, palette_data, "", (src_offset_t)palette_data, TEXPREF_PERSIST | TEXPREF_NEAREST | TEXPREF_NOPICMIP);
+
 	//set default
 	particletexture = particletexture1;
 	texturescalefactor = 1.27;
@@ -141,6 +246,8 @@ static void R_SetParticleTexture_f (cvar_t *var)
 	}
 }
 
+static void R_TimeParticles_f (void);
+
 /*
 ===============
 R_InitParticles
@@ -163,14 +270,67 @@ void R_InitParticles (void)
 		r_numparticles = MAX_PARTICLES;
 	}
 
-	particles = (particle_t *)
-			Hunk_AllocName (r_numparticles * sizeof(particle_t), "particles");
+	// every type can have one partly filled block on top of the full ones
+	r_numparticleblocks = (r_numparticles + PARTICLE_BLOCK_SIZE - 1) / PARTICLE_BLOCK_SIZE + pt_numtypes;
+	particleblocks = (particleblock_t *)
+			Hunk_AllocName (r_numparticleblocks * sizeof(particleblock_t), "particles");
+	for (i=0 ; i<pt_numtypes ; i++)
+		particlepools[i].blocks = (particleblock_t **)
+				Hunk_AllocName (r_numparticleblocks * sizeof(particleblock_t *), "particles");
+	particlechunks = (particlechunk_t *)
+			Hunk_AllocName (r_numparticleblocks * sizeof(particlechunk_t), "particles");
 
 	Cvar_RegisterVariable (&r_particles); //johnfitz
 	Cvar_SetCallback (&r_particles, R_SetParticleTexture_f);
 	Cvar_RegisterVariable (&r_quadparticles); //johnfitz
 
+	Cmd_AddCommand ("timeparticles", R_TimeParticles_f);
+
 	R_InitParticleTextures (); //johnfitz
+	R_ClearParticles ();
+}
+
+/*
+===============
+R_NewParticle
+
+returns false when the particle budget is used up
+===============
+*/
+static qboolean R_NewParticle (ptype_t type, const vec3_t org, const vec3_t vel, int color, float ramp, float die)
+{
+	particlepool_t	*pool;
+	particleblock_t	*b;
+	int				slot;
+
+	if (r_numactiveparticles >= r_numparticles)
+		return false;
+
+	pool = &particlepools[type];
+	slot = pool->numparticles % PARTICLE_BLOCK_SIZE;
+	if (!slot)
+	{
+		b = free_particleblocks;
+		free_particleblocks = b->next;
+		pool->blocks[pool->numparticles / PARTICLE_BLOCK_SIZE] = b;
+	}
+	else
+		b = pool->blocks[pool->numparticles / PARTICLE_BLOCK_SIZE];
+
+	b->org[0][slot] = org[0];
+	b->org[1][slot] = org[1];
+	b->org[2][slot] = org[2];
+	b->vel[0][slot] = vel[0];
+	b->vel[1][slot] = vel[1];
+	b->vel[2][slot] = vel[2];
+	b->color[slot] = color;
+	b->ramp[slot] = ramp;
+	b->die[slot] = die;
+
+	pool->numparticles++;
+	r_numactiveparticles++;
+	r_particlesdirty = true;
+	return true;
 }
 
 /*
@@ -189,12 +349,11 @@ float	timescale = 0.01;
 void R_EntityParticles (entity_t *ent)
 {
 	int		i;
-	particle_t	*p;
 	float		angle;
 	float		sp, sy, cp, cy;
 //	float		sr, cr;
 //	int		count;
-	vec3_t		forward;
+	vec3_t		forward, org;
 	float		dist;
 
 	dist = 64;
@@ -226,20 +385,12 @@ void R_EntityParticles (entity_t *ent)
 		forward[1] = cp*sy;
 		forward[2] = -sp;
 
-		if (!free_particles)
+		org[0] = ent->origin[0] + r_avertexnormals[i][0]*dist + forward[0]*beamlength;
+		org[1] = ent->origin[1] + r_avertexnormals[i][1]*dist + forward[1]*beamlength;
+		org[2] = ent->origin[2] + r_avertexnormals[i][2]*dist + forward[2]*beamlength;
+
+		if (!R_NewParticle (pt_explode, org, vec3_origin, 0x6f, 0, cl.time + 0.01))
 			return;
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
-
-		p->die = cl.time + 0.01;
-		p->color = 0x6f;
-		p->type = pt_explode;
-
-		p->org[0] = ent->origin[0] + r_avertexnormals[i][0]*dist + forward[0]*beamlength;
-		p->org[1] = ent->origin[1] + r_avertexnormals[i][1]*dist + forward[1]*beamlength;
-		p->org[2] = ent->origin[2] + r_avertexnormals[i][2]*dist + forward[2]*beamlength;
 	}
 }
 
@@ -252,12 +403,17 @@ void R_ClearParticles (void)
 {
 	int		i;
 
-	free_particles = &particles[0];
-	active_particles = NULL;
+	free_particleblocks = NULL;
+	for (i=r_numparticleblocks-1 ; i>=0 ; i--)
+	{
+		particleblocks[i].next = free_particleblocks;
+		free_particleblocks = &particleblocks[i];
+	}
 
-	for (i=0 ;i<r_numparticles ; i++)
-		particles[i].next = &particles[i+1];
-	particles[r_numparticles-1].next = NULL;
+	for (i=0 ; i<pt_numtypes ; i++)
+		particlepools[i].numparticles = 0;
+	r_numactiveparticles = 0;
+	r_particlesdirty = true;
 }
 
 /*
@@ -271,7 +427,6 @@ void R_ReadPointFile_f (void)
 	vec3_t	org;
 	int		r;
 	int		c;
-	particle_t	*p;
 	char	name[MAX_QPATH];
 
 	if (cls.state != ca_connected)
@@ -295,21 +450,11 @@ void R_ReadPointFile_f (void)
 			break;
 		c++;
 
-		if (!free_particles)
+		if (!R_NewParticle (pt_static, org, vec3_origin, (-c)&15, 0, 99999))
 		{
 			Con_Printf ("Not enough free particles\n");
 			break;
 		}
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
-
-		p->die = 99999;
-		p->color = (-c)&15;
-		p->type = pt_static;
-		VectorCopy (vec3_origin, p->vel);
-		VectorCopy (org, p->org);
 	}
 
 	fclose (f);
@@ -351,38 +496,20 @@ R_ParticleExplosion
 void R_ParticleExplosion (vec3_t org)
 {
 	int			i, j;
-	particle_t	*p;
+	float		ramp;
+	vec3_t		porg, pvel;
 
 	for (i=0 ; i<1024 ; i++)
 	{
-		if (!free_particles)
-			return;
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
-
-		p->die = cl.time + 5;
-		p->color = ramp1[0];
-		p->ramp = rand()&3;
-		if (i & 1)
-		{
-			p->type = pt_explode;
-			for (j=0 ; j<3 ; j++)
-			{
-				p->org[j] = org[j] + ((rand()%32)-16);
-				p->vel[j] = (rand()%512)-256;
-			}
-		}
-		else
+		ramp = rand()&3;
+		for (j=0 ; j<3 ; j++)
 		{
-			p->type = pt_explode2;
-			for (j=0 ; j<3 ; j++)
-			{
-				p->org[j] = org[j] + ((rand()%32)-16);
-				p->vel[j] = (rand()%512)-256;
-			}
+			porg[j] = org[j] + ((rand()%32)-16);
+			pvel[j] = (rand()%512)-256;
 		}
+
+		if (!R_NewParticle ((i & 1) ? pt_explode : pt_explode2, porg, pvel, ramp1[0], ramp, cl.time + 5))
+			return;
 	}
 }
 
@@ -394,28 +521,20 @@ R_ParticleExplosion2
 void R_ParticleExplosion2 (vec3_t org, int colorStart, int colorLength)
 {
 	int			i, j;
-	particle_t	*p;
 	int			colorMod = 0;
+	vec3_t		porg, pvel;
 
 	for (i=0; i<512; i++)
 	{
-		if (!free_particles)
-			return;
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
-
-		p->die = cl.time + 0.3;
-		p->color = colorStart + (colorMod % colorLength);
-		colorMod++;
-
-		p->type = pt_blob;
 		for (j=0 ; j<3 ; j++)
 		{
-			p->org[j] = org[j] + ((rand()%32)-16);
-			p->vel[j] = (rand()%512)-256;
+			porg[j] = org[j] + ((rand()%32)-16);
+			pvel[j] = (rand()%512)-256;
 		}
+
+		if (!R_NewParticle (pt_blob, porg, pvel, colorStart + (colorMod % colorLength), 0, cl.time + 0.3))
+			return;
+		colorMod++;
 	}
 }
 
@@ -426,40 +545,27 @@ R_BlobExplosion
 */
 void R_BlobExplosion (vec3_t org)
 {
-	int			i, j;
-	particle_t	*p;
+	int			i, j, color;
+	float		die;
+	vec3_t		porg, pvel;
 
 	for (i=0 ; i<1024 ; i++)
 	{
-		if (!free_particles)
-			return;
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
-
-		p->die = cl.time + 1 + (rand()&8)*0.05;
+		die = cl.time + 1 + (rand()&8)*0.05;
 
 		if (i & 1)
-		{
-			p->type = pt_blob;
-			p->color = 66 + rand()%6;
-			for (j=0 ; j<3 ; j++)
-			{
-				p->org[j] = org[j] + ((rand()%32)-16);
-				p->vel[j] = (rand()%512)-256;
-			}
-		}
+			color = 66 + rand()%6;
 		else
+			color = 150 + rand()%6;
+
+		for (j=0 ; j<3 ; j++)
 		{
-			p->type = pt_blob2;
-			p->color = 150 + rand()%6;
-			for (j=0 ; j<3 ; j++)
-			{
-				p->org[j] = org[j] + ((rand()%32)-16);
-				p->vel[j] = (rand()%512)-256;
-			}
+			porg[j] = org[j] + ((rand()%32)-16);
+			pvel[j] = (rand()%512)-256;
 		}
+
+		if (!R_NewParticle ((i & 1) ? pt_blob : pt_blob2, porg, pvel, color, 0, die))
+			return;
 	}
 }
 
@@ -470,53 +576,28 @@ R_RunParticleEffect
 */
 void R_RunParticleEffect (vec3_t org, vec3_t dir, int color, int count)
 {
-	int			i, j;
-	particle_t	*p;
+	int			i, j, pcolor;
+	float		die;
+	vec3_t		porg, pvel;
+
+	if (count == 1024)
+	{	// rocket explosion
+		R_ParticleExplosion (org);
+		return;
+	}
 
 	for (i=0 ; i<count ; i++)
 	{
-		if (!free_particles)
-			return;
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
-
-		if (count == 1024)
-		{	// rocket explosion
-			p->die = cl.time + 5;
-			p->color = ramp1[0];
-			p->ramp = rand()&3;
-			if (i & 1)
-			{
-				p->type = pt_explode;
-				for (j=0 ; j<3 ; j++)
-				{
-					p->org[j] = org[j] + ((rand()%32)-16);
-					p->vel[j] = (rand()%512)-256;
-				}
-			}
-			else
-			{
-				p->type = pt_explode2;
-				for (j=0 ; j<3 ; j++)
-				{
-					p->org[j] = org[j] + ((rand()%32)-16);
-					p->vel[j] = (rand()%512)-256;
-				}
-			}
-		}
-		else
+		die = cl.time + 0.1*(rand()%5);
+		pcolor = (color&~7) + (rand()&7);
+		for (j=0 ; j<3 ; j++)
 		{
-			p->die = cl.time + 0.1*(rand()%5);
-			p->color = (color&~7) + (rand()&7);
-			p->type = pt_slowgrav;
-			for (j=0 ; j<3 ; j++)
-			{
-				p->org[j] = org[j] + ((rand()&15)-8);
-				p->vel[j] = dir[j]*15;// + (rand()%300)-150;
-			}
+			porg[j] = org[j] + ((rand()&15)-8);
+			pvel[j] = dir[j]*15;// + (rand()%300)-150;
 		}
+
+		if (!R_NewParticle (pt_slowgrav, porg, pvel, pcolor, 0, die))
+			return;
 	}
 }
 
@@ -527,37 +608,31 @@ R_LavaSplash
 */
 void R_LavaSplash (vec3_t org)
 {
-	int			i, j, k;
-	particle_t	*p;
-	float		vel;
-	vec3_t		dir;
+	int			i, j, k, color;
+	float		vel, die;
+	vec3_t		dir, porg, pvel;
 
 	for (i=-16 ; i<16 ; i++)
 		for (j=-16 ; j<16 ; j++)
 			for (k=0 ; k<1 ; k++)
 			{
-				if (!free_particles)
-					return;
-				p = free_particles;
-				free_particles = p->next;
-				p->next = active_particles;
-				active_particles = p;
-
-				p->die = cl.time + 2 + (rand()&31) * 0.02;
-				p->color = 224 + (rand()&7);
-				p->type = pt_slowgrav;
+				die = cl.time + 2 + (rand()&31) * 0.02;
+				color = 224 + (rand()&7);
 
 				dir[0] = j*8 + (rand()&7);
 				dir[1] = i*8 + (rand()&7);
 				dir[2] = 256;
 
-				p->org[0] = org[0] + dir[0];
-				p->org[1] = org[1] + dir[1];
-				p->org[2] = org[2] + (rand()&63);
+				porg[0] = org[0] + dir[0];
+				porg[1] = org[1] + dir[1];
+				porg[2] = org[2] + (rand()&63);
 
 				VectorNormalize (dir);
 				vel = 50 + (rand()&63);
-				VectorScale (dir, vel, p->vel);
+				VectorScale (dir, vel, pvel);
+
+				if (!R_NewParticle (pt_slowgrav, porg, pvel, color, 0, die))
+					return;
 			}
 }
 
@@ -568,37 +643,31 @@ R_TeleportSplash
 */
 void R_TeleportSplash (vec3_t org)
 {
-	int			i, j, k;
-	particle_t	*p;
-	float		vel;
-	vec3_t		dir;
+	int			i, j, k, color;
+	float		vel, die;
+	vec3_t		dir, porg, pvel;
 
 	for (i=-16 ; i<16 ; i+=4)
 		for (j=-16 ; j<16 ; j+=4)
 			for (k=-24 ; k<32 ; k+=4)
 			{
-				if (!free_particles)
-					return;
-				p = free_particles;
-				free_particles = p->next;
-				p->next = active_particles;
-				active_particles = p;
-
-				p->die = cl.time + 0.2 + (rand()&7) * 0.02;
-				p->color = 7 + (rand()&7);
-				p->type = pt_slowgrav;
+				die = cl.time + 0.2 + (rand()&7) * 0.02;
+				color = 7 + (rand()&7);
 
 				dir[0] = j*8;
 				dir[1] = i*8;
 				dir[2] = k*8;
 
-				p->org[0] = org[0] + i + (rand()&3);
-				p->org[1] = org[1] + j + (rand()&3);
-				p->org[2] = org[2] + k + (rand()&3);
+				porg[0] = org[0] + i + (rand()&3);
+				porg[1] = org[1] + j + (rand()&3);
+				porg[2] = org[2] + k + (rand()&3);
 
 				VectorNormalize (dir);
 				vel = 50 + (rand()&63);
-				VectorScale (dir, vel, p->vel);
+				VectorScale (dir, vel, pvel);
+
+				if (!R_NewParticle (pt_slowgrav, porg, pvel, color, 0, die))
+					return;
 			}
 }
 
@@ -611,10 +680,10 @@ FIXME -- rename function and use #defined types instead of numbers
 */
 void R_RocketTrail (vec3_t start, vec3_t end, int type)
 {
-	vec3_t		vec;
-	float		len;
-	int			j;
-	particle_t	*p;
+	vec3_t		vec, porg, pvel;
+	float		len, ramp, die;
+	int			j, color;
+	ptype_t		ptype;
 	int			dec;
 	static int	tracercount;
 
@@ -632,86 +701,287 @@ void R_RocketTrail (vec3_t start, vec3_t end, int type)
 	{
 		len -= dec;
 
-		if (!free_particles)
-			return;
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
-
-		VectorCopy (vec3_origin, p->vel);
-		p->die = cl.time + 2;
+		VectorCopy (vec3_origin, pvel);
+		die = cl.time + 2;
+		ramp = 0;
+		color = 0;
+		ptype = pt_static;
 
 		switch (type)
 		{
 			case 0:	// rocket trail
-				p->ramp = (rand()&3);
-				p->color = ramp3[(int)p->ramp];
-				p->type = pt_fire;
+				ramp = (rand()&3);
+				color = ramp3[(int)ramp];
+				ptype = pt_fire;
 				for (j=0 ; j<3 ; j++)
-					p->org[j] = start[j] + ((rand()%6)-3);
+					porg[j] = start[j] + ((rand()%6)-3);
 				break;
 
 			case 1:	// smoke smoke
-				p->ramp = (rand()&3) + 2;
-				p->color = ramp3[(int)p->ramp];
-				p->type = pt_fire;
+				ramp = (rand()&3) + 2;
+				color = ramp3[(int)ramp];
+				ptype = pt_fire;
 				for (j=0 ; j<3 ; j++)
-					p->org[j] = start[j] + ((rand()%6)-3);
+					porg[j] = start[j] + ((rand()%6)-3);
 				break;
 
 			case 2:	// blood
-				p->type = pt_grav;
-				p->color = 67 + (rand()&3);
+				ptype = pt_grav;
+				color = 67 + (rand()&3);
 				for (j=0 ; j<3 ; j++)
-					p->org[j] = start[j] + ((rand()%6)-3);
+					porg[j] = start[j] + ((rand()%6)-3);
 				break;
 
 			case 3:
 			case 5:	// tracer
-				p->die = cl.time + 0.5;
-				p->type = pt_static;
+				die = cl.time + 0.5;
+				ptype = pt_static;
 				if (type == 3)
-					p->color = 52 + ((tracercount&4)<<1);
+					color = 52 + ((tracercount&4)<<1);
 				else
-					p->color = 230 + ((tracercount&4)<<1);
+					color = 230 + ((tracercount&4)<<1);
 
 				tracercount++;
 
-				VectorCopy (start, p->org);
+				VectorCopy (start, porg);
 				if (tracercount & 1)
 				{
-					p->vel[0] = 30*vec[1];
-					p->vel[1] = 30*-vec[0];
+					pvel[0] = 30*vec[1];
+					pvel[1] = 30*-vec[0];
 				}
 				else
 				{
-					p->vel[0] = 30*-vec[1];
-					p->vel[1] = 30*vec[0];
+					pvel[0] = 30*-vec[1];
+					pvel[1] = 30*vec[0];
 				}
 				break;
 
 			case 4:	// slight blood
-				p->type = pt_grav;
-				p->color = 67 + (rand()&3);
+				ptype = pt_grav;
+				color = 67 + (rand()&3);
 				for (j=0 ; j<3 ; j++)
-					p->org[j] = start[j] + ((rand()%6)-3);
+					porg[j] = start[j] + ((rand()%6)-3);
 				len -= 3;
 				break;
 
 			case 6:	// voor trail
-				p->color = 9*16 + 8 + (rand()&3);
-				p->type = pt_static;
-				p->die = cl.time + 0.3;
+				color = 9*16 + 8 + (rand()&3);
+				ptype = pt_static;
+				die = cl.time + 0.3;
 				for (j=0 ; j<3 ; j++)
-					p->org[j] = start[j] + ((rand()&15)-8);
+					porg[j] = start[j] + ((rand()&15)-8);
+				break;
+
+			default:
+				VectorCopy (start, porg);
 				break;
 		}
 
+		if (!R_NewParticle (ptype, porg, pvel, color, ramp, die))
+			return;
+
 		VectorAdd (start, vec, start);
 	}
 }
 
+/*
+===============
+particle update kernels -- one per type, run over a whole block at a time.
+the loops have no branches between particles so the compiler can vectorize
+them.
+===============
+*/
+static void R_MoveParticles (particleblock_t *b, int n, const particlestep_t *step)
+{
+	int i;
+
+	for (i=0 ; i<n ; i++)
+	{
+		b->org[0][i] += b->vel[0][i] * step->frametime;
+		b->org[1][i] += b->vel[1][i] * step->frametime;
+		b->org[2][i] += b->vel[2][i] * step->frametime;
+	}
+}
+
+static void R_UpdateParticles_Static (particleblock_t *b, int n, const particlestep_t *step)
+{
+	R_MoveParticles (b, n, step);
+}
+
+static void R_UpdateParticles_Grav (particleblock_t *b, int n, const particlestep_t *step)
+{
+	int i;
+
+	R_MoveParticles (b, n, step);
+	for (i=0 ; i<n ; i++)
+		b->vel[2][i] -= step->grav;
+}
+
+static void R_UpdateParticles_Fire (particleblock_t *b, int n, const particlestep_t *step)
+{
+	int i;
+
+	R_MoveParticles (b, n, step);
+	for (i=0 ; i<n ; i++)
+	{
+		b->ramp[i] += step->time1;
+		b->vel[2][i] += step->grav;
+	}
+	for (i=0 ; i<n ; i++)
+	{
+		if (b->ramp[i] >= 6)
+			b->die[i] = -1;
+		else
+			b->color[i] = ramp3[(int)b->ramp[i]];
+	}
+}
+
+static void R_UpdateParticles_Explode (particleblock_t *b, int n, const particlestep_t *step)
+{
+	int i;
+
+	R_MoveParticles (b, n, step);
+	for (i=0 ; i<n ; i++)
+	{
+		b->ramp[i] += step->time2;
+		b->vel[0][i] += b->vel[0][i] * step->dvel;
+		b->vel[1][i] += b->vel[1][i] * step->dvel;
+		b->vel[2][i] += b->vel[2][i] * step->dvel;
+		b->vel[2][i] -= step->grav;
+	}
+	for (i=0 ; i<n ; i++)
+	{
+		if (b->ramp[i] >= 8)
+			b->die[i] = -1;
+		else
+			b->color[i] = ramp1[(int)b->ramp[i]];
+	}
+}
+
+static void R_UpdateParticles_Explode2 (particleblock_t *b, int n, const particlestep_t *step)
+{
+	int i;
+
+	R_MoveParticles (b, n, step);
+	for (i=0 ; i<n ; i++)
+	{
+		b->ramp[i] += step->time3;
+		b->vel[0][i] -= b->vel[0][i] * step->frametime;
+		b->vel[1][i] -= b->vel[1][i] * step->frametime;
+		b->vel[2][i] -= b->vel[2][i] * step->frametime;
+		b->vel[2][i] -= step->grav;
+	}
+	for (i=0 ; i<n ; i++)
+	{
+		if (b->ramp[i] >= 8)
+			b->die[i] = -1;
+		else
+			b->color[i] = ramp2[(int)b->ramp[i]];
+	}
+}
+
+static void R_UpdateParticles_Blob (particleblock_t *b, int n, const particlestep_t *step)
+{
+	int i;
+
+	R_MoveParticles (b, n, step);
+	for (i=0 ; i<n ; i++)
+	{
+		b->vel[0][i] += b->vel[0][i] * step->dvel;
+		b->vel[1][i] += b->vel[1][i] * step->dvel;
+		b->vel[2][i] += b->vel[2][i] * step->dvel;
+		b->vel[2][i] -= step->grav;
+	}
+}
+
+static void R_UpdateParticles_Blob2 (particleblock_t *b, int n, const particlestep_t *step)
+{
+	int i;
+
+	R_MoveParticles (b, n, step);
+	for (i=0 ; i<n ; i++)
+	{
+		b->vel[0][i] -= b->vel[0][i] * step->dvel;
+		b->vel[1][i] -= b->vel[1][i] * step->dvel;
+		b->vel[2][i] -= step->grav;
+	}
+}
+
+static const particlekernel_t particlekernels[pt_numtypes] =
+{
+	R_UpdateParticles_Static,	// pt_static
+	R_UpdateParticles_Grav,		// pt_grav
+	R_UpdateParticles_Grav,		// pt_slowgrav
+	R_UpdateParticles_Fire,		// pt_fire
+	R_UpdateParticles_Explode,	// pt_explode
+	R_UpdateParticles_Explode2,	// pt_explode2
+	R_UpdateParticles_Blob,		// pt_blob
+	R_UpdateParticles_Blob2		// pt_blob2
+};
+
+/*
+===============
+R_CompactParticles -- swap-remove every particle of a pool that has died
+===============
+*/
+static void R_CompactParticles (particlepool_t *pool)
+{
+	particleblock_t	*b, *last;
+	int				i, n, slot, lastslot, usedblocks, oldblocks;
+
+	n = pool->numparticles;
+	oldblocks = (n + PARTICLE_BLOCK_SIZE - 1) / PARTICLE_BLOCK_SIZE;
+
+	for (i=0 ; i<n ; )
+	{
+		b = pool->blocks[i / PARTICLE_BLOCK_SIZE];
+		slot = i % PARTICLE_BLOCK_SIZE;
+		if (b->die[slot] >= cl.time)
+		{
+			i++;
+			continue;
+		}
+
+		// move the last particle into the hole, and look at this slot again
+		n--;
+		last = pool->blocks[n / PARTICLE_BLOCK_SIZE];
+		lastslot = n % PARTICLE_BLOCK_SIZE;
+		b->org[0][slot] = last->org[0][lastslot];
+		b->org[1][slot] = last->org[1][lastslot];
+		b->org[2][slot] = last->org[2][lastslot];
+		b->vel[0][slot] = last->vel[0][lastslot];
+		b->vel[1][slot] = last->vel[1][lastslot];
+		b->vel[2][slot] = last->vel[2][lastslot];
+		b->ramp[slot] = last->ramp[lastslot];
+		b->die[slot] = last->die[lastslot];
+		b->color[slot] = last->color[lastslot];
+	}
+
+	r_numactiveparticles -= pool->numparticles - n;
+	pool->numparticles = n;
+
+	// give back the blocks that emptied
+	usedblocks = (n + PARTICLE_BLOCK_SIZE - 1) / PARTICLE_BLOCK_SIZE;
+	for (i=usedblocks ; i<oldblocks ; i++)
+	{
+		pool->blocks[i]->next = free_particleblocks;
+		free_particleblocks = pool->blocks[i];
+	}
+}
+
+/*
+===============
+R_UpdateParticleChunk -- runs on the task threads; chunks never share a block
+===============
+*/
+static void R_UpdateParticleChunk (void *data, int index)
+{
+	particlejob_t	*job = (particlejob_t *) data;
+	particlechunk_t	*chunk = &job->chunks[index];
+
+	chunk->kernel (chunk->block, chunk->count, job->step);
+}
+
 /*
 ===============
 CL_RunParticles -- johnfitz -- all the particle behavior, separated from R_DrawParticles
@@ -719,103 +989,440 @@ CL_RunParticles -- johnfitz -- all the particle behavior, separated from R_DrawP
 */
 void CL_RunParticles (void)
 {
-	particle_t		*p, *kill;
-	int				i;
-	float			time1, time2, time3, dvel, frametime, grav;
+	particlestep_t	step;
+	particlejob_t	job;
+	particlepool_t	*pool;
+	int				type, i, numchunks;
 	extern	cvar_t	sv_gravity;
 
-	frametime = cl.time - cl.oldtime;
-	time3 = frametime * 15;
-	time2 = frametime * 10;
-	time1 = frametime * 5;
-	grav = frametime * sv_gravity.value * 0.05;
-	dvel = 4*frametime;
+	step.frametime = cl.time - cl.oldtime;
+	step.time3 = step.frametime * 15;
+	step.time2 = step.frametime * 10;
+	step.time1 = step.frametime * 5;
+	step.grav = step.frametime * sv_gravity.value * 0.05;
+	step.dvel = 4*step.frametime;
+	r_particlesdirty = true;
+
+	// compaction moves particles between blocks, so it stays serial
+	numchunks = 0;
+	for (type=0, pool=particlepools ; type<pt_numtypes ; type++, pool++)
+	{
+		R_CompactParticles (pool);
+		for (i=0 ; i<pool->numparticles ; i+=PARTICLE_BLOCK_SIZE, numchunks++)
+		{
+			particlechunks[numchunks].kernel = particlekernels[type];
+			particlechunks[numchunks].block = pool->blocks[i / PARTICLE_BLOCK_SIZE];
+			particlechunks[numchunks].count = q_min (pool->numparticles - i, PARTICLE_BLOCK_SIZE);
+		}
+	}
+
+	// every particle only ever reads its own slots and the step, so the
+	// result is the same however the chunks are spread over threads
+	job.chunks = particlechunks;
+	job.step = &step;
+	Tasks_ParallelFor (numchunks, (numchunks < PARTICLE_MIN_PARALLEL_CHUNKS) ? 1 : r_particlethreads, R_UpdateParticleChunk, &job);
+}
 
-	for ( ;; )
+/*
+====================
+R_ParticleChecksum -- FNV-1a hash of every live particle, in storage order
+====================
+*/
+static unsigned R_ParticleChecksum (void)
+{
+	particlepool_t	*pool;
+	particleblock_t	*b;
+	unsigned		hash;
+	int				type, i, n;
+
+	hash = COM_HASH_INIT;
+	for (type=0, pool=particlepools ; type<pt_numtypes ; type++, pool++)
 	{
-		kill = active_particles;
-		if (kill && kill->die < cl.time)
+		for (i=0 ; i<pool->numparticles ; i+=PARTICLE_BLOCK_SIZE)
 		{
-			active_particles = kill->next;
-			kill->next = free_particles;
-			free_particles = kill;
-			continue;
+			b = pool->blocks[i / PARTICLE_BLOCK_SIZE];
+			n = q_min (pool->numparticles - i, PARTICLE_BLOCK_SIZE);
+			hash = COM_HashBytes (hash, b->org[0], n * sizeof(float));
+			hash = COM_HashBytes (hash, b->org[1], n * sizeof(float));
+			hash = COM_HashBytes (hash, b->org[2], n * sizeof(float));
+			hash = COM_HashBytes (hash, b->vel[0], n * sizeof(float));
+			hash = COM_HashBytes (hash, b->vel[1], n * sizeof(float));
+			hash = COM_HashBytes (hash, b->vel[2], n * sizeof(float));
+			hash = COM_HashBytes (hash, b->ramp, n * sizeof(float));
+			hash = COM_HashBytes (hash, b->color, n);
 		}
-		break;
 	}
+	return hash;
+}
+
+/*
+====================
+R_TimeParticlesRun -- one pass of timeparticles, returns the seconds taken
+====================
+*/
+static double R_TimeParticlesRun (int frames, int *peak, int *updates, unsigned *checksum)
+{
+	double	start, stop;
+	int		i, j, bursts;
+	vec3_t	org, end;
+
+	// scale the load with -particles, so a bigger pool is worth timing
+	bursts = q_max (1, r_numparticles / MAX_PARTICLES);
+
+	R_ClearParticles ();
+	srand (0);
 
-	for (p=active_particles ; p ; p=p->next)
+	*peak = *updates = 0;
+	cl.time = 0;
+	start = Sys_DoubleTime ();
+	for (i=0 ; i<frames ; i++)
 	{
-		for ( ;; )
+		cl.oldtime = cl.time;
+		cl.time += 1.0 / 72;
+
+		if (!(i % 18))
 		{
-			kill = p->next;
-			if (kill && kill->die < cl.time)
+			for (j=0 ; j<bursts ; j++)
 			{
-				p->next = kill->next;
-				kill->next = free_particles;
-				free_particles = kill;
-				continue;
+				org[0] = (rand() & 1023) - 512;
+				org[1] = (rand() & 1023) - 512;
+				org[2] = rand() & 255;
+				R_ParticleExplosion (org);
 			}
-			break;
 		}
+		for (j=0 ; j<8*bursts ; j++)
+		{
+			org[0] = (rand() & 1023) - 512;
+			org[1] = (rand() & 1023) - 512;
+			org[2] = rand() & 255;
+			VectorCopy (org, end);
+			end[0] += 14;	// about one frame of rocket flight
+			R_RocketTrail (org, end, j & 1);
+		}
+
+		CL_RunParticles ();
+		*updates += r_numactiveparticles;
+		*peak = q_max (*peak, r_numactiveparticles);
+	}
+	stop = Sys_DoubleTime ();
 
-		p->org[0] += p->vel[0]*frametime;
-		p->org[1] += p->vel[1]*frametime;
-		p->org[2] += p->vel[2]*frametime;
+	*checksum = R_ParticleChecksum ();
+	R_ClearParticles ();
 
-		switch (p->type)
+	return stop - start;
+}
+
+/*
+====================
+R_TimeParticles_f
+
+For program optimization -- runs rocket explosions and trails through the
+particle system with a fixed timestep, without drawing them, once for each
+thread count from 1 up to the second argument (default all task threads).
+every run has to end in the same state.  clears any particles already in
+flight.
+====================
+*/
+static void R_TimeParticles_f (void)
+{
+	double		oldtime, oldoldtime, time, basetime;
+	int			frames, maxthreads, threads, peak, updates;
+	unsigned	checksum, basechecksum;
+
+	frames = (Cmd_Argc() > 1) ? Q_atoi (Cmd_Argv(1)) : 1000;
+	if (frames < 1)
+		frames = 1;
+	maxthreads = (Cmd_Argc() > 2) ? Q_atoi (Cmd_Argv(2)) : Tasks_NumThreads ();
+	maxthreads = CLAMP (1, maxthreads, Tasks_NumThreads ());
+
+	oldtime = cl.time;
+	oldoldtime = cl.oldtime;
+
+	basetime = 0;
+	basechecksum = 0;
+	for (threads=1 ; threads<=maxthreads ; threads++)
+	{
+		r_particlethreads = threads;
+		time = R_TimeParticlesRun (frames, &peak, &updates, &checksum);
+		if (threads == 1)
 		{
-		case pt_static:
-			break;
-		case pt_fire:
-			p->ramp += time1;
-			if (p->ramp >= 6)
-				p->die = -1;
-			else
-				p->color = ramp3[(int)p->ramp];
-			p->vel[2] += grav;
-			break;
+			basetime = time;
+			basechecksum = checksum;
+		}
 
-		case pt_explode:
-			p->ramp += time2;
-			if (p->ramp >=8)
-				p->die = -1;
-			else
-				p->color = ramp1[(int)p->ramp];
-			for (i=0 ; i<3 ; i++)
-				p->vel[i] += p->vel[i]*dvel;
-			p->vel[2] -= grav;
-			break;
+		Con_Printf ("%i thread%s: %i frames, %i peak particles: %f seconds (%f ms/frame, %.1f ns/particle, %.2fx)%s\n",
+			threads, (threads == 1) ? "" : "s", frames, peak, time, time * 1000 / frames,
+			updates ? time * 1e9 / updates : 0, time ? basetime / time : 0,
+			(checksum != basechecksum) ? " MISMATCH" : "");
+	}
+	r_particlethreads = 0;
 
-		case pt_explode2:
-			p->ramp += time3;
-			if (p->ramp >=8)
-				p->die = -1;
-			else
-				p->color = ramp2[(int)p->ramp];
-			for (i=0 ; i<3 ; i++)
-				p->vel[i] -= p->vel[i]*frametime;
-			p->vel[2] -= grav;
-			break;
+	cl.time = oldtime;
+	cl.oldtime = oldoldtime;
+}
 
-		case pt_blob:
-			for (i=0 ; i<3 ; i++)
-				p->vel[i] += p->vel[i]*dvel;
-			p->vel[2] -= grav;
-			break;
+/*
+===============
+R_ParticleScale -- johnfitz -- hack a scale up to keep particles from disapearing
+===============
+*/
+static float R_ParticleScale (const particleblock_t *b, int slot)
+{
+	float scale;
 
-		case pt_blob2:
-			for (i=0 ; i<2 ; i++)
-				p->vel[i] -= p->vel[i]*dvel;
-			p->vel[2] -= grav;
-			break;
+	scale = (b->org[0][slot] - r_origin[0]) * vpn[0]
+		  + (b->org[1][slot] - r_origin[1]) * vpn[1]
+		  + (b->org[2][slot] - r_origin[2]) * vpn[2];
+	if (scale < 20)
+		scale = 1 + 0.08; //johnfitz -- added .08 to be consistent
+	else
+		scale = 1 + scale * 0.004;
 
-		case pt_grav:
-		case pt_slowgrav:
-			p->vel[2] -= grav;
-			break;
+	return scale * texturescalefactor; //johnfitz -- compensate for apparent size of different particle textures
+}
+
+/*
+=============
+GLParticle_CreateShaders
+=============
+*/
+void GLParticle_CreateShaders (void)
+{
+	const glsl_attrib_binding_t bindings[] = {
+		{ "Corner", cornerAttrIndex },
+		{ "OriginX", originXAttrIndex },
+		{ "OriginY", originYAttrIndex },
+		{ "OriginZ", originZAttrIndex },
+		{ "ColorIndex", colorIndexAttrIndex }
+	};
+
+	const GLchar *vertSource = \
+		"#version 110\n"
+		"\n"
+		"uniform vec3 Up;\n"
+		"uniform vec3 Right;\n"
+		"uniform vec3 ViewOrigin;\n"
+		"uniform vec3 ViewForward;\n"
+		"uniform float TextureScale;\n"
+		"attribute vec2 Corner;\n"
+		"attribute float OriginX;\n"
+		"attribute float OriginY;\n"
+		"attribute float OriginZ;\n"
+		"attribute float ColorIndex;\n"
+		"varying float PaletteCoord;\n"
+		"void main()\n"
+		"{\n"
+		"	vec3 org = vec3(OriginX, OriginY, OriginZ);\n"
+		"	// hack a scale up to keep particles from disapearing, same as R_ParticleScale\n"
+		"	float scale = dot(org - ViewOrigin, ViewForward);\n"
+		"	if (scale < 20.0)\n"
+		"		scale = 1.08;\n"
+		"	else\n"
+		"		scale = 1.0 + scale * 0.004;\n"
+		"	vec4 vert = vec4(org + (Corner.x * Up + Corner.y * Right) * (scale * TextureScale), 1.0);\n"
+		"	gl_Position = gl_ModelViewProjectionMatrix * vert;\n"
+		"	gl_TexCoord[0] = vec4(Corner, 0.0, 0.0);\n"
+		"	PaletteCoord = (ColorIndex + 0.5) / 256.0;\n"
+		"	// fog\n"
+		"	vec3 ecPosition = vec3(gl_ModelViewMatrix * vert);\n"
+		"	gl_FogFragCoord = abs(ecPosition.z);\n"
+		"}\n";
+
+	const GLchar *fragSource = \
+		"#version 110\n"
+		"\n"
+		"uniform sampler2D Tex;\n"
+		"uniform sampler2D Palette;\n"
+		"varying float PaletteCoord;\n"
+		"void main()\n"
+		"{\n"
+		"	vec4 result = texture2D(Tex, gl_TexCoord[0].xy);\n"
+		"	result.rgb *= texture2D(Palette, vec2(PaletteCoord, 0.5)).rgb;\n"
+		"	// apply GL_EXP2 fog (from the orange book)\n"
+		"	float fog = exp(-gl_Fog.density * gl_Fog.density * gl_FogFragCoord * gl_FogFragCoord);\n"
+		"	fog = clamp(fog, 0.0, 1.0);\n"
+		"	result.rgb = mix(gl_Fog.color.rgb, result.rgb, fog);\n"
+		"	gl_FragColor = result;\n"
+		"}\n";
+
+	if (!gl_glsl_particle_able)
+		return;
+
+	r_particle_program = GL_CreateProgram (vertSource, fragSource, sizeof(bindings)/sizeof(bindings[0]), bindings);
+
+	if (r_particle_program != 0)
+	{
+	// get uniform locations
+		upLoc = GL_GetUniformLocation (&r_particle_program, "Up");
+		rightLoc = GL_GetUniformLocation (&r_particle_program, "Right");
+		viewOriginLoc = GL_GetUniformLocation (&r_particle_program, "ViewOrigin");
+		viewForwardLoc = GL_GetUniformLocation (&r_particle_program, "ViewForward");
+		textureScaleLoc = GL_GetUniformLocation (&r_particle_program, "TextureScale");
+		particleTexLoc = GL_GetUniformLocation (&r_particle_program, "Tex");
+		paletteTexLoc = GL_GetUniformLocation (&r_particle_program, "Palette");
+	}
+}
+
+/*
+=============
+GLParticle_DeleteBuffers
+=============
+*/
+void GLParticle_DeleteBuffers (void)
+{
+	if (!gl_vbo_able)
+		return;
+
+	GL_DeleteBuffersFunc (1, &r_particle_vbo);
+	r_particle_vbo = 0;
+
+	GL_ClearBufferBindings ();
+}
+
+/*
+=============
+GLParticle_UploadBuffer
+
+Binds the particle VBO, refilling it only if the particles changed since the
+last upload, so the second eye reuses what the first one sent.
+=============
+*/
+static void GLParticle_UploadBuffer (void)
+{
+	particlepool_t	*pool;
+	particleblock_t	*b;
+	int				type, i, ofs;
+
+	if (!r_particle_vbo)
+	{
+		GL_GenBuffersFunc (1, &r_particle_vbo);
+		r_particlesdirty = true;
+	}
+
+	GL_BindBuffer (GL_ARRAY_BUFFER, r_particle_vbo);
+
+	if (!r_particlesdirty)
+		return;
+	r_particlesdirty = false;
+
+	// orphan last frame's storage rather than waiting for the GPU to finish with it
+	GL_BufferDataFunc (GL_ARRAY_BUFFER, sizeof(particlecorners) + r_numparticleblocks * PARTICLE_VBO_BLOCK_SIZE, NULL, GL_STREAM_DRAW);
+	GL_BufferSubDataFunc (GL_ARRAY_BUFFER, 0, sizeof(particlecorners), particlecorners);
+
+	ofs = sizeof(particlecorners);
+	for (type=0, pool=particlepools ; type<pt_numtypes ; type++, pool++)
+	{
+		for (i=0 ; i<pool->numparticles ; i+=PARTICLE_BLOCK_SIZE)
+		{
+			b = pool->blocks[i / PARTICLE_BLOCK_SIZE];
+			GL_BufferSubDataFunc (GL_ARRAY_BUFFER, ofs, sizeof(b->org), b->org);
+			GL_BufferSubDataFunc (GL_ARRAY_BUFFER, ofs + sizeof(b->org), sizeof(b->color), b->color);
+			ofs += PARTICLE_VBO_BLOCK_SIZE;
+		}
+	}
+}
+
+/*
+=============
+R_DrawParticles_GLSL
+
+Counterpart of the immediate mode loop in R_DrawParticles: one instanced
+draw per block, with no per-particle work on the CPU beyond the upload.
+=============
+*/
+static void R_DrawParticles_GLSL (void)
+{
+	particlepool_t	*pool;
+	int				type, i, ofs, count;
+	int				first, numverts;
+	GLenum			mode;
+
+	GLParticle_UploadBuffer ();
+
+	GL_UseProgramFunc (r_particle_program);
+
+// set uniforms
+	GL_Uniform3fFunc (upLoc, vup[0] * 1.5, vup[1] * 1.5, vup[2] * 1.5);
+	GL_Uniform3fFunc (rightLoc, vright[0] * 1.5, vright[1] * 1.5, vright[2] * 1.5);
+	GL_Uniform3fFunc (viewOriginLoc, r_origin[0], r_origin[1], r_origin[2]);
+	GL_Uniform3fFunc (viewForwardLoc, vpn[0], vpn[1], vpn[2]);
+	GL_Uniform1fFunc (textureScaleLoc, texturescalefactor);
+	GL_Uniform1iFunc (particleTexLoc, 0);
+	GL_Uniform1iFunc (paletteTexLoc, 1);
+
+// set textures
+	GL_SelectTexture (GL_TEXTURE0);
+	GL_Bind (particletexture);
+	GL_SelectTexture (GL_TEXTURE1);
+	GL_Bind (particlepalette);
+
+	glEnable (GL_BLEND);
+	glDepthMask (GL_FALSE); //johnfitz -- fix for particle z-buffer bug
+
+	if (r_quadparticles.value) //johnfitz -- quads save fillrate, triangles save verts
+	{
+		mode = GL_TRIANGLE_FAN;
+		first = 3;
+		numverts = 4;
+	}
+	else
+	{
+		mode = GL_TRIANGLES;
+		first = 0;
+		numverts = 3;
+	}
+
+	GL_EnableVertexAttribArrayFunc (cornerAttrIndex);
+	GL_EnableVertexAttribArrayFunc (originXAttrIndex);
+	GL_EnableVertexAttribArrayFunc (originYAttrIndex);
+	GL_EnableVertexAttribArrayFunc (originZAttrIndex);
+	GL_EnableVertexAttribArrayFunc (colorIndexAttrIndex);
+
+	GL_VertexAttribDivisorFunc (originXAttrIndex, 1);
+	GL_VertexAttribDivisorFunc (originYAttrIndex, 1);
+	GL_VertexAttribDivisorFunc (originZAttrIndex, 1);
+	GL_VertexAttribDivisorFunc (colorIndexAttrIndex, 1);
+
+	GL_VertexAttribPointerFunc (cornerAttrIndex, 2, GL_FLOAT, GL_FALSE, 0, (void *)0);
+
+// draw, walking the blocks in the same order GLParticle_UploadBuffer stored them
+	ofs = sizeof(particlecorners);
+	for (type=0, pool=particlepools ; type<pt_numtypes ; type++, pool++)
+	{
+		for (i=0 ; i<pool->numparticles ; i+=PARTICLE_BLOCK_SIZE)
+		{
+			count = q_min(pool->numparticles - i, PARTICLE_BLOCK_SIZE);
+
+			GL_VertexAttribPointerFunc (originXAttrIndex, 1, GL_FLOAT, GL_FALSE, 0, (void *)(intptr_t)ofs);
+			GL_VertexAttribPointerFunc (originYAttrIndex, 1, GL_FLOAT, GL_FALSE, 0, (void *)(intptr_t)(ofs + PARTICLE_BLOCK_SIZE * sizeof(float)));
+			GL_VertexAttribPointerFunc (originZAttrIndex, 1, GL_FLOAT, GL_FALSE, 0, (void *)(intptr_t)(ofs + 2 * PARTICLE_BLOCK_SIZE * sizeof(float)));
+			GL_VertexAttribPointerFunc (colorIndexAttrIndex, 1, GL_UNSIGNED_BYTE, GL_FALSE, 0, (void *)(intptr_t)(ofs + 3 * PARTICLE_BLOCK_SIZE * sizeof(float)));
+
+			GL_DrawArraysInstancedFunc (mode, first, numverts, count);
+
+			ofs += PARTICLE_VBO_BLOCK_SIZE;
 		}
 	}
+
+// clean up -- divisors are not part of the vertex array enables, so reset them too
+	GL_VertexAttribDivisorFunc (originXAttrIndex, 0);
+	GL_VertexAttribDivisorFunc (originYAttrIndex, 0);
+	GL_VertexAttribDivisorFunc (originZAttrIndex, 0);
+	GL_VertexAttribDivisorFunc (colorIndexAttrIndex, 0);
+
+	GL_DisableVertexAttribArrayFunc (cornerAttrIndex);
+	GL_DisableVertexAttribArrayFunc (originXAttrIndex);
+	GL_DisableVertexAttribArrayFunc (originYAttrIndex);
+	GL_DisableVertexAttribArrayFunc (originZAttrIndex);
+	GL_DisableVertexAttribArrayFunc (colorIndexAttrIndex);
+
+	GL_UseProgramFunc (0);
+	GL_SelectTexture (GL_TEXTURE0);
+
+	rs_particles += r_numactiveparticles; //johnfitz
+
+	glDepthMask (GL_TRUE); //johnfitz -- fix for particle z-buffer bug
+	glDisable (GL_BLEND);
 }
 
 /*
@@ -825,10 +1432,12 @@ R_DrawParticles -- johnfitz -- moved all non-drawing code to CL_RunParticles
 */
 void R_DrawParticles (void)
 {
-	particle_t		*p;
+	particlepool_t	*pool;
+	particleblock_t	*b;
 	float			scale;
-	vec3_t			up, right, p_up, p_right, p_upright; //johnfitz -- p_ vectors
+	vec3_t			org, up, right, p_up, p_right, p_upright; //johnfitz -- p_ vectors
 	GLubyte			color[4], *c; //johnfitz -- particle transparency
+	int				type, i, slot;
 	extern	cvar_t	r_particles; //johnfitz
 	//float			alpha; //johnfitz -- particle transparency
 
@@ -836,9 +1445,15 @@ void R_DrawParticles (void)
 		return;
 
 	//ericw -- avoid empty glBegin(),glEnd() pair below; causes issues on AMD
-	if (!active_particles)
+	if (!r_numactiveparticles)
 		return;
 
+	if (r_particle_program != 0)
+	{
+		R_DrawParticles_GLSL ();
+		return;
+	}
+
 	VectorScale (vup, 1.5, up);
 	VectorScale (vright, 1.5, right);
 
@@ -847,26 +1462,20 @@ void R_DrawParticles (void)
 	glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
 	glDepthMask (GL_FALSE); //johnfitz -- fix for particle z-buffer bug
 
-	if (r_quadparticles.value) //johnitz -- quads save fillrate
+	glBegin (r_quadparticles.value ? GL_QUADS : GL_TRIANGLES); //johnfitz -- quads save fillrate, triangles save verts
+	for (type=0, pool=particlepools ; type<pt_numtypes ; type++, pool++)
 	{
-		glBegin (GL_QUADS);
-		for (p=active_particles ; p ; p=p->next)
+		for (i=0 ; i<pool->numparticles ; i++)
 		{
-			// hack a scale up to keep particles from disapearing
-			scale = (p->org[0] - r_origin[0]) * vpn[0]
-				  + (p->org[1] - r_origin[1]) * vpn[1]
-				  + (p->org[2] - r_origin[2]) * vpn[2];
-			if (scale < 20)
-				scale = 1 + 0.08; //johnfitz -- added .08 to be consistent
-			else
-				scale = 1 + scale * 0.004;
-
-			scale /= 2.0; //quad is half the size of triangle
-
-			scale *= texturescalefactor; //johnfitz -- compensate for apparent size of different particle textures
+			b = pool->blocks[i / PARTICLE_BLOCK_SIZE];
+			slot = i % PARTICLE_BLOCK_SIZE;
+			org[0] = b->org[0][slot];
+			org[1] = b->org[1][slot];
+			org[2] = b->org[2][slot];
+			scale = R_ParticleScale (b, slot);
 
 			//johnfitz -- particle transparency and fade out
-			c = (GLubyte *) &d_8to24table[(int)p->color];
+			c = (GLubyte *) &d_8to24table[b->color[slot]];
 			color[0] = c[0];
 			color[1] = c[1];
 			color[2] = c[2];
@@ -875,66 +1484,43 @@ void R_DrawParticles (void)
 			glColor4ubv(color);
 			//johnfitz
 
-			glTexCoord2f (0,0);
-			glVertex3fv (p->org);
+			if (r_quadparticles.value)
+			{
+				scale /= 2.0; //quad is half the size of triangle
 
-			glTexCoord2f (0.5,0);
-			VectorMA (p->org, scale, up, p_up);
-			glVertex3fv (p_up);
+				glTexCoord2f (0,0);
+				glVertex3fv (org);
 
-			glTexCoord2f (0.5,0.5);
-			VectorMA (p_up, scale, right, p_upright);
-			glVertex3fv (p_upright);
+				glTexCoord2f (0.5,0);
+				VectorMA (org, scale, up, p_up);
+				glVertex3fv (p_up);
 
-			glTexCoord2f (0,0.5);
-			VectorMA (p->org, scale, right, p_right);
-			glVertex3fv (p_right);
+				glTexCoord2f (0.5,0.5);
+				VectorMA (p_up, scale, right, p_upright);
+				glVertex3fv (p_upright);
 
-			rs_particles++; //johnfitz //FIXME: just use r_numparticles
-		}
-		glEnd ();
-	}
-	else //johnitz --  triangles save verts
-	{
-		glBegin (GL_TRIANGLES);
-		for (p=active_particles ; p ; p=p->next)
-		{
-			// hack a scale up to keep particles from disapearing
-			scale = (p->org[0] - r_origin[0]) * vpn[0]
-				  + (p->org[1] - r_origin[1]) * vpn[1]
-				  + (p->org[2] - r_origin[2]) * vpn[2];
-			if (scale < 20)
-				scale = 1 + 0.08; //johnfitz -- added .08 to be consistent
+				glTexCoord2f (0,0.5);
+				VectorMA (org, scale, right, p_right);
+				glVertex3fv (p_right);
+			}
 			else
-				scale = 1 + scale * 0.004;
-
-			scale *= texturescalefactor; //johnfitz -- compensate for apparent size of different particle textures
-
-			//johnfitz -- particle transparency and fade out
-			c = (GLubyte *) &d_8to24table[(int)p->color];
-			color[0] = c[0];
-			color[1] = c[1];
-			color[2] = c[2];
-			//alpha = CLAMP(0, p->die + 0.5 - cl.time, 1);
-			color[3] = 255; //(int)(alpha * 255);
-			glColor4ubv(color);
-			//johnfitz
-
-			glTexCoord2f (0,0);
-			glVertex3fv (p->org);
-
-			glTexCoord2f (1,0);
-			VectorMA (p->org, scale, up, p_up);
-			glVertex3fv (p_up);
+			{
+				glTexCoord2f (0,0);
+				glVertex3fv (org);
 
-			glTexCoord2f (0,1);
-			VectorMA (p->org, scale, right, p_right);
-			glVertex3fv (p_right);
+				glTexCoord2f (1,0);
+				VectorMA (org, scale, up, p_up);
+				glVertex3fv (p_up);
 
-			rs_particles++; //johnfitz //FIXME: just use r_numparticles
+				glTexCoord2f (0,1);
+				VectorMA (org, scale, right, p_right);
+				glVertex3fv (p_right);
+			}
 		}
-		glEnd ();
 	}
+	glEnd ();
+
+	rs_particles += r_numactiveparticles; //johnfitz
 
 	glDepthMask (GL_TRUE); //johnfitz -- fix for particle z-buffer bug
 	glDisable (GL_BLEND);
@@ -950,9 +1536,11 @@ R_DrawParticles_ShowTris -- johnfitz
 */
 void R_DrawParticles_ShowTris (void)
 {
-	particle_t		*p;
+	particlepool_t	*pool;
+	particleblock_t	*b;
 	float			scale;
-	vec3_t			up, right, p_up, p_right, p_upright;
+	vec3_t			org, up, right, p_up, p_right, p_upright;
+	int				type, i, slot;
 	extern	cvar_t	r_particles;
 
 	if (!r_particles.value)
@@ -961,64 +1549,50 @@ void R_DrawParticles_ShowTris (void)
 	VectorScale (vup, 1.5, up);
 	VectorScale (vright, 1.5, right);
 
-	if (r_quadparticles.value)
+	if (!r_quadparticles.value)
+		glBegin (GL_TRIANGLES);
+
+	for (type=0, pool=particlepools ; type<pt_numtypes ; type++, pool++)
 	{
-		for (p=active_particles ; p ; p=p->next)
+		for (i=0 ; i<pool->numparticles ; i++)
 		{
-			glBegin (GL_TRIANGLE_FAN);
-
-			// hack a scale up to keep particles from disapearing
-			scale = (p->org[0] - r_origin[0]) * vpn[0]
-				  + (p->org[1] - r_origin[1]) * vpn[1]
-				  + (p->org[2] - r_origin[2]) * vpn[2];
-			if (scale < 20)
-				scale = 1 + 0.08; //johnfitz -- added .08 to be consistent
-			else
-				scale = 1 + scale * 0.004;
-
-			scale /= 2.0; //quad is half the size of triangle
+			b = pool->blocks[i / PARTICLE_BLOCK_SIZE];
+			slot = i % PARTICLE_BLOCK_SIZE;
+			org[0] = b->org[0][slot];
+			org[1] = b->org[1][slot];
+			org[2] = b->org[2][slot];
+			scale = R_ParticleScale (b, slot);
+
+			if (r_quadparticles.value)
+			{
+				scale /= 2.0; //quad is half the size of triangle
 
-			scale *= texturescalefactor; //compensate for apparent size of different particle textures
+				glBegin (GL_TRIANGLE_FAN);
+				glVertex3fv (org);
 
-			glVertex3fv (p->org);
+				VectorMA (org, scale, up, p_up);
+				glVertex3fv (p_up);
 
-			VectorMA (p->org, scale, up, p_up);
-			glVertex3fv (p_up);
+				VectorMA (p_up, scale, right, p_upright);
+				glVertex3fv (p_upright);
 
-			VectorMA (p_up, scale, right, p_upright);
-			glVertex3fv (p_upright);
+				VectorMA (org, scale, right, p_right);
+				glVertex3fv (p_right);
+				glEnd ();
+			}
+			else
+			{
+				glVertex3fv (org);
 
-			VectorMA (p->org, scale, right, p_right);
-			glVertex3fv (p_right);
+				VectorMA (org, scale, up, p_up);
+				glVertex3fv (p_up);
 
-			glEnd ();
+				VectorMA (org, scale, right, p_right);
+				glVertex3fv (p_right);
+			}
 		}
 	}
-	else
-	{
-		glBegin (GL_TRIANGLES);
-		for (p=active_particles ; p ; p=p->next)
-		{
-			// hack a scale up to keep particles from disapearing
-			scale = (p->org[0] - r_origin[0]) * vpn[0]
-				  + (p->org[1] - r_origin[1]) * vpn[1]
-				  + (p->org[2] - r_origin[2]) * vpn[2];
-			if (scale < 20)
-				scale = 1 + 0.08; //johnfitz -- added .08 to be consistent
-			else
-				scale = 1 + scale * 0.004;
-
-			scale *= texturescalefactor; //compensate for apparent size of different particle textures
 
-			glVertex3fv (p->org);
-
-			VectorMA (p->org, scale, up, p_up);
-			glVertex3fv (p_up);
-
-			VectorMA (p->org, scale, right, p_right);
-			glVertex3fv (p_right);
-		}
+	if (!r_quadparticles.value)
 		glEnd ();
-	}
 }
-
@@ -105,11 +105,7 @@ void R_MarkSurfaces (void)
 	// if surface chains don't need regenerating, just add static entities and return
 	if (r_oldviewleaf == r_viewleaf && !vis_changed && !nearwaterportal)
 	{
-		leaf = &cl.worldmodel->leafs[1];
-		for (i=0 ; i<cl.worldmodel->numleafs ; i++, leaf++)
-			if (vis[i>>3] & (1<<(i&7)))
-				if (leaf->efrags)
-					R_StoreEfrags (&leaf->efrags);
+		R_StoreStatics (vis, false);
 		return;
 	}
 
@@ -126,13 +122,12 @@ void R_MarkSurfaces (void)
 			if (r_oldskyleaf.value || leaf->contents != CONTENTS_SKY)
 				for (j=0, mark = leaf->firstmarksurface; j<leaf->nummarksurfaces; j++, mark++)
 					(*mark)->visframe = r_visframecount;
-
-			// add static models
-			if (leaf->efrags)
-				R_StoreEfrags (&leaf->efrags);
 		}
 	}
 
+	// add static models
+	R_StoreStatics (vis, true);
+
 	// set all chains to null
 	for (i=0 ; i<cl.worldmodel->numtextures ; i++)
 		if (cl.worldmodel->textures[i])
@@ -241,7 +236,7 @@ ericw -- now always used at the start of R_DrawTextureChains for the
 mh dynamic lighting speedup
 ================
 */
-void R_BuildLightmapChains (qmodel_t *model, texchain_t chain)
+void R_BuildLightmapChains (qmodel_t *model, entity_t *ent, texchain_t chain)
 {
 	texture_t *t;
 	msurface_t *s;
@@ -250,6 +245,9 @@ void R_BuildLightmapChains (qmodel_t *model, texchain_t chain)
 	// clear lightmap chains (already done in r_marksurfaces, but clearing them here to be safe becuase of r_stereo)
 	memset (lightmap_polys, 0, sizeof(lightmap_polys));
 
+	// find the dynamic lights near this model
+	R_SetupSurfaceLights (model, ent);
+
 	// now rebuild them
 	for (i=0 ; i<model->numtextures ; i++)
 	{
@@ -260,7 +258,10 @@ void R_BuildLightmapChains (qmodel_t *model, texchain_t chain)
 
 		for (s = t->texturechains[chain]; s; s = s->texturechain)
 			if (!s->culled)
+			{
+				R_MarkSurfaceLights (s);
 				R_RenderDynamicLightmaps (s);
+			}
 	}
 }
 
@@ -714,21 +715,14 @@ void R_DrawTextureChains_Water (qmodel_t *model, entity_t *ent, texchain_t chain
 					{
 						entalpha = GL_WaterAlphaForEntitySurface (ent, s);
 						R_BeginTransparentDrawing (entalpha);
-						GL_Bind (t->warpimage);
-
-						if (model != cl.worldmodel)
-						{
-							// ericw -- this is copied from R_DrawSequentialPoly.
-							// If the poly is not part of the world we have to
-							// set this flag
-							t->update_warp = true; // FIXME: one frame too late!
-						}
-
+						GLWater_Begin (t, entalpha); // FIXME: warpimage update is one frame too late for brush models!
 						bound = true;
 					}
 					DrawGLPoly (s->polys);
 					rs_brushpasses++;
 				}
+			if (bound)
+				GLWater_End ();
 			R_EndTransparentDrawing (entalpha);
 		}
 	}
@@ -945,7 +939,7 @@ void R_DrawTextureChains (qmodel_t *model, entity_t *ent, texchain_t chain)
 // this also chains surfaces by lightmap which is used by r_lightmap 1.
 // the previous implementation of the speedup uploaded lightmaps one frame
 // late which was visible under some conditions, this method avoids that.
-	R_BuildLightmapChains (model, chain);
+	R_BuildLightmapChains (model, ent, chain);
 	R_UploadLightmaps ();
 
 	if (r_drawflat_cheatsafe)
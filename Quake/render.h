@@ -32,14 +32,6 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 //=============================================================================
 
-typedef struct efrag_s
-{
-	struct mleaf_s		*leaf;
-	struct efrag_s		*leafnext;
-	struct entity_s		*entity;
-	struct efrag_s		*entnext;
-} efrag_t;
-
 //johnfitz -- for lerping
 #define LERP_MOVESTEP	(1<<0) //this is a MOVETYPE_STEP entity, enable movement lerp
 #define LERP_RESETANIM	(1<<1) //disable anim lerping until next anim frame
@@ -62,7 +54,6 @@ typedef struct entity_s
 	vec3_t					msg_angles[2];	// last two updates (0 is newest)
 	vec3_t					angles;
 	struct qmodel_s			*model;			// NULL = no model
-	struct efrag_s			*efrag;			// linked list of efrags
 	int						frame;
 	float					syncbase;		// for client-side animations
 	byte					*colormap;
@@ -147,8 +138,8 @@ void R_ViewChanged (vrect_t *pvrect, int lineadj, float aspect);
 //void R_InitSky (struct texture_s *mt);	// called at level load
 
 void R_CheckEfrags (void); //johnfitz
-void R_AddEfrags (entity_t *ent);
-void R_RemoveEfrags (entity_t *ent);
+void R_ClearStatics (void);
+void R_AddStaticEntity (int entnum);
 
 void R_NewMap (void);
 
@@ -58,6 +58,12 @@ vec3_t		listener_up;
 int		soundtime;	// sample PAIRS
 int		paintedtime;	// sample PAIRS
 
+// while a demo is being captured the mixer follows the host frames
+// instead of the device, so the sound stays in step with the video
+static float	snd_capturefps;
+static int	snd_captureframes;
+static int	snd_capturestart;	// paintedtime when the capture began
+
 int		s_rawend;
 portable_samplepair_t	s_rawsamples[MAX_RAW_SAMPLES];
 
@@ -347,7 +353,7 @@ sfx_t *S_PrecacheSound (const char *name)
 	sfx = S_FindName (name);
 
 // cache it in
-	if (precache.value)
+	if (precache.value && !S_BatchSound (sfx))
 		S_LoadSound (sfx);
 
 	return sfx;
@@ -792,6 +798,9 @@ void S_Update (vec3_t origin, vec3_t forward, vec3_t right, vec3_t up)
 	channel_t	*ch;
 	channel_t	*combine;
 
+	if (snd_capturefps)
+		snd_captureframes++;
+
 	if (!sound_started || (snd_blocked > 0))
 		return;
 
@@ -912,9 +921,40 @@ void S_ExtraUpdate (void)
 {
 	if (snd_noextraupdate.value)
 		return;		// don't pollute timings
+	if (snd_capturefps)
+		return;		// only whole host frames are mixed
 	S_Update_();
 }
 
+/*
+============
+S_BeginCapture -- mix exactly 1/fps seconds of sound per host frame until S_EndCapture
+============
+*/
+void S_BeginCapture (float fps)
+{
+	snd_capturefps = fps;
+	snd_captureframes = 0;
+	snd_capturestart = paintedtime;
+}
+
+/*
+============
+S_EndCapture -- capture mixed ahead of the device, so drop that and start again at the device's position
+============
+*/
+void S_EndCapture (void)
+{
+	snd_capturefps = 0;
+
+	if (!sound_started || !shm)
+		return;
+
+	S_ClearBuffer ();
+	GetSoundtime ();
+	paintedtime = soundtime;
+}
+
 static void S_Update_ (void)
 {
 	unsigned int	endtime;
@@ -930,6 +970,16 @@ static void S_Update_ (void)
 // Updates DMA time
 	GetSoundtime();
 
+	if (snd_capturefps)
+	{
+	// the device clock is ignored; the device hears whatever lands in its buffer
+		endtime = snd_capturestart + (unsigned int)((double)snd_captureframes * shm->speed / snd_capturefps);
+		if (endtime > (unsigned int)paintedtime)
+			S_PaintChannels (endtime);
+		SNDDMA_Submit ();
+		return;
+	}
+
 // check to make sure that we haven't overshot
 	if (paintedtime < soundtime)
 	{
@@ -1076,10 +1126,12 @@ void S_ClearPrecache (void)
 
 void S_BeginPrecaching (void)
 {
+	S_BeginBatch ();
 }
 
 
 void S_EndPrecaching (void)
 {
+	S_EndBatch ();
 }
 
@@ -24,28 +24,28 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 /*
 ================
-ResampleSfx
+ResampleSfx -- fills in sc from the wav data, converted to the output rate
+and width.  sc must have room for the length S_SoundLength returned
 ================
 */
-static void ResampleSfx (sfx_t *sfx, int inrate, int inwidth, byte *data)
+static void ResampleSfx (sfxcache_t *sc, const wavinfo_t *info, const byte *data)
 {
 	int		outcount;
 	int		srcsample;
 	float	stepscale;
 	int		i;
 	int		sample, samplefrac, fracstep;
-	sfxcache_t	*sc;
-
-	sc = (sfxcache_t *) Cache_Check (&sfx->cache);
-	if (!sc)
-		return;
+	int		inwidth;
 
-	stepscale = (float)inrate / shm->speed;	// this is usually 0.5, 1, or 2
+	inwidth = info->width;
+	stepscale = (float)info->rate / shm->speed;	// this is usually 0.5, 1, or 2
 
-	outcount = sc->length / stepscale;
+	outcount = info->samples / stepscale;
 	sc->length = outcount;
-	if (sc->loopstart != -1)
-		sc->loopstart = sc->loopstart / stepscale;
+	if (info->loopstart != -1)
+		sc->loopstart = info->loopstart / stepscale;
+	else
+		sc->loopstart = -1;
 
 	sc->speed = shm->speed;
 	if (loadas8bit.value)
@@ -72,7 +72,7 @@ static void ResampleSfx (sfx_t *sfx, int inrate, int inwidth, byte *data)
 			srcsample = samplefrac >> 8;
 			samplefrac += fracstep;
 			if (inwidth == 2)
-				sample = LittleShort ( ((short *)data)[srcsample] );
+				sample = LittleShort ( ((const short *)data)[srcsample] );
 			else
 				sample = (int)( (unsigned char)(data[srcsample]) - 128) << 8;
 			if (sc->width == 2)
@@ -83,84 +83,44 @@ static void ResampleSfx (sfx_t *sfx, int inrate, int inwidth, byte *data)
 	}
 }
 
-//=============================================================================
-
 /*
-==============
-S_LoadSound
-==============
+================
+S_SoundLength -- size of the sample data once resampled, or 0 with the
+reason appended to error
+================
 */
-sfxcache_t *S_LoadSound (sfx_t *s)
+static int S_SoundLength (const char *name, const wavinfo_t *info, char *error, size_t errorsize)
 {
-	char	namebuffer[256];
-	byte	*data;
-	wavinfo_t	info;
-	int		len;
 	float	stepscale;
-	sfxcache_t	*sc;
-	byte	stackbuf[1*1024];		// avoid dirtying the cache heap
-
-// see if still in memory
-	sc = (sfxcache_t *) Cache_Check (&s->cache);
-	if (sc)
-		return sc;
+	int	len;
+	char	msg[MAX_QPATH + 64];
 
-//	Con_Printf ("S_LoadSound: %x\n", (int)stackbuf);
+	msg[0] = 0;
+	len = 0;
 
-// load it in
-	q_strlcpy(namebuffer, "sound/", sizeof(namebuffer));
-	q_strlcat(namebuffer, s->name, sizeof(namebuffer));
-
-//	Con_Printf ("loading %s\n",namebuffer);
-
-	data = COM_LoadStackFile(namebuffer, stackbuf, sizeof(stackbuf), NULL);
-
-	if (!data)
-	{
-		Con_Printf ("Couldn't load %s\n", namebuffer);
-		return NULL;
-	}
-
-	info = GetWavinfo (s->name, data, com_filesize);
-	if (info.channels != 1)
-	{
-		Con_Printf ("%s is a stereo sample\n",s->name);
-		return NULL;
-	}
-
-	if (info.width != 1 && info.width != 2)
+	if (info->channels != 1)
+		q_snprintf (msg, sizeof(msg), "%s is a stereo sample\n", name);
+	else if (info->width != 1 && info->width != 2)
+		q_snprintf (msg, sizeof(msg), "%s is not 8 or 16 bit\n", name);
+	else
 	{
-		Con_Printf("%s is not 8 or 16 bit\n", s->name);
-		return NULL;
-	}
-
-	stepscale = (float)info.rate / shm->speed;
-	len = info.samples / stepscale;
+		stepscale = (float)info->rate / shm->speed;
+		len = info->samples / stepscale;
 
-	len = len * info.width * info.channels;
+		len = len * info->width * info->channels;
 
-	if (info.samples == 0 || len == 0)
-	{
-		Con_Printf("%s has zero samples\n", s->name);
-		return NULL;
+		if (info->samples == 0 || len == 0)
+		{
+			q_snprintf (msg, sizeof(msg), "%s has zero samples\n", name);
+			len = 0;
+		}
 	}
 
-	sc = (sfxcache_t *) Cache_Alloc ( &s->cache, len + sizeof(sfxcache_t), s->name);
-	if (!sc)
-		return NULL;
-
-	sc->length = info.samples;
-	sc->loopstart = info.loopstart;
-	sc->speed = info.rate;
-	sc->width = info.width;
-	sc->stereo = info.channels;
-
-	ResampleSfx (s, sc->speed, sc->width, data + info.dataofs);
-
-	return sc;
+	q_strlcat (error, msg, errorsize);
+	return len;
 }
 
-
+//=============================================================================
 
 /*
 ===============================================================================
@@ -170,88 +130,91 @@ WAV loading
 ===============================================================================
 */
 
-static byte	*data_p;
-static byte	*iff_end;
-static byte	*last_chunk;
-static byte	*iff_data;
-static int	iff_chunk_len;
+// parsing state, per call so sounds can be parsed on the task threads
+typedef struct
+{
+	byte	*data_p;
+	byte	*iff_end;
+	byte	*last_chunk;
+	byte	*iff_data;
+	int	iff_chunk_len;
+	char	*error;		// messages are appended here for the caller to print
+	size_t	errorsize;
+	qboolean	fatal;		// the caller should Sys_Error with the message
+} wavparse_t;
+
+static void WavError (wavparse_t *w, const char *fmt, ...) __attribute__((__format__(__printf__,2,3)));
+static void WavError (wavparse_t *w, const char *fmt, ...)
+{
+	va_list	argptr;
+	char	msg[MAX_QPATH + 64];
+
+	va_start (argptr, fmt);
+	q_vsnprintf (msg, sizeof(msg), fmt, argptr);
+	va_end (argptr);
+
+	q_strlcat (w->error, msg, w->errorsize);
+}
 
-static short GetLittleShort (void)
+static short GetLittleShort (wavparse_t *w)
 {
 	short val = 0;
-	val = *data_p;
-	val = val + (*(data_p+1)<<8);
-	data_p += 2;
+	val = *w->data_p;
+	val = val + (*(w->data_p+1)<<8);
+	w->data_p += 2;
 	return val;
 }
 
-static int GetLittleLong (void)
+static int GetLittleLong (wavparse_t *w)
 {
 	int val = 0;
-	val = *data_p;
-	val = val + (*(data_p+1)<<8);
-	val = val + (*(data_p+2)<<16);
-	val = val + (*(data_p+3)<<24);
-	data_p += 4;
+	val = *w->data_p;
+	val = val + (*(w->data_p+1)<<8);
+	val = val + (*(w->data_p+2)<<16);
+	val = val + (*(w->data_p+3)<<24);
+	w->data_p += 4;
 	return val;
 }
 
-static void FindNextChunk (const char *name)
+static void FindNextChunk (wavparse_t *w, const char *name)
 {
 	while (1)
 	{
 	// Need at least 8 bytes for a chunk
-		if (last_chunk + 8 >= iff_end)
+		if (w->last_chunk + 8 >= w->iff_end)
 		{
-			data_p = NULL;
+			w->data_p = NULL;
 			return;
 		}
 
-		data_p = last_chunk + 4;
-		iff_chunk_len = GetLittleLong();
-		if (iff_chunk_len < 0 || iff_chunk_len > iff_end - data_p)
+		w->data_p = w->last_chunk + 4;
+		w->iff_chunk_len = GetLittleLong(w);
+		if (w->iff_chunk_len < 0 || w->iff_chunk_len > w->iff_end - w->data_p)
 		{
-			data_p = NULL;
-			Con_DPrintf2("bad \"%s\" chunk length (%d)\n", name, iff_chunk_len);
+			w->data_p = NULL;
+			if (developer.value >= 2)
+				WavError (w, "bad \"%s\" chunk length (%d)\n", name, w->iff_chunk_len);
 			return;
 		}
-		last_chunk = data_p + ((iff_chunk_len + 1) & ~1);
-		data_p -= 8;
-		if (!Q_strncmp((char *)data_p, name, 4))
+		w->last_chunk = w->data_p + ((w->iff_chunk_len + 1) & ~1);
+		w->data_p -= 8;
+		if (!Q_strncmp((char *)w->data_p, name, 4))
 			return;
 	}
 }
 
-static void FindChunk (const char *name)
+static void FindChunk (wavparse_t *w, const char *name)
 {
-	last_chunk = iff_data;
-	FindNextChunk (name);
+	w->last_chunk = w->iff_data;
+	FindNextChunk (w, name);
 }
 
-#if 0
-static void DumpChunks (void)
-{
-	char	str[5];
-
-	str[4] = 0;
-	data_p = iff_data;
-	do
-	{
-		memcpy (str, data_p, 4);
-		data_p += 4;
-		iff_chunk_len = GetLittleLong();
-		Con_Printf ("0x%x : %s (%d)\n", (int)(data_p - 4), str, iff_chunk_len);
-		data_p += (iff_chunk_len + 1) & ~1;
-	} while (data_p < iff_end);
-}
-#endif
-
 /*
 ============
-GetWavinfo
+ParseWav
 ============
 */
-wavinfo_t GetWavinfo (const char *name, byte *wav, int wavlength)
+static wavinfo_t ParseWav (wavparse_t *w, const char *name, byte *wav, int wavlength)
 {
 	wavinfo_t	info;
 	int	i;
@@ -263,61 +226,58 @@ wavinfo_t GetWavinfo (const char *name, byte *wav, int wavlength)
 	if (!wav)
 		return info;
 
-	iff_data = wav;
-	iff_end = wav + wavlength;
+	w->iff_data = wav;
+	w->iff_end = wav + wavlength;
 
 // find "RIFF" chunk
-	FindChunk("RIFF");
-	if (!(data_p && !Q_strncmp((char *)data_p + 8, "WAVE", 4)))
+	FindChunk(w, "RIFF");
+	if (!(w->data_p && !Q_strncmp((char *)w->data_p + 8, "WAVE", 4)))
 	{
-		Con_Printf("%s missing RIFF/WAVE chunks\n", name);
+		WavError (w, "%s missing RIFF/WAVE chunks\n", name);
 		return info;
 	}
 
 // get "fmt " chunk
-	iff_data = data_p + 12;
-#if 0
-	DumpChunks ();
-#endif
+	w->iff_data = w->data_p + 12;
 
-	FindChunk("fmt ");
-	if (!data_p)
+	FindChunk(w, "fmt ");
+	if (!w->data_p)
 	{
-		Con_Printf("%s is missing fmt chunk\n", name);
+		WavError (w, "%s is missing fmt chunk\n", name);
 		return info;
 	}
-	data_p += 8;
-	format = GetLittleShort();
+	w->data_p += 8;
+	format = GetLittleShort(w);
 	if (format != WAV_FORMAT_PCM)
 	{
-		Con_Printf("%s is not Microsoft PCM format\n", name);
+		WavError (w, "%s is not Microsoft PCM format\n", name);
 		return info;
 	}
 
-	info.channels = GetLittleShort();
-	info.rate = GetLittleLong();
-	data_p += 4 + 2;
-	i = GetLittleShort();
+	info.channels = GetLittleShort(w);
+	info.rate = GetLittleLong(w);
+	w->data_p += 4 + 2;
+	i = GetLittleShort(w);
 	if (i != 8 && i != 16)
 		return info;
 	info.width = i / 8;
 
 // get cue chunk
-	FindChunk("cue ");
-	if (data_p)
+	FindChunk(w, "cue ");
+	if (w->data_p)
 	{
-		data_p += 32;
-		info.loopstart = GetLittleLong();
+		w->data_p += 32;
+		info.loopstart = GetLittleLong(w);
 	//	Con_Printf("loopstart=%d\n", sfx->loopstart);
 
 	// if the next chunk is a LIST chunk, look for a cue length marker
-		FindNextChunk ("LIST");
-		if (data_p)
+		FindNextChunk (w, "LIST");
+		if (w->data_p)
 		{
-			if (!strncmp((char *)data_p + 28, "mark", 4))
+			if (!strncmp((char *)w->data_p + 28, "mark", 4))
 			{	// this is not a proper parse, but it works with cooledit...
-				data_p += 24;
-				i = GetLittleLong();	// samples in loop
+				w->data_p += 24;
+				i = GetLittleLong(w);	// samples in loop
 				info.samples = info.loopstart + i;
 		//		Con_Printf("looped length: %i\n", i);
 			}
@@ -327,26 +287,290 @@ wavinfo_t GetWavinfo (const char *name, byte *wav, int wavlength)
 		info.loopstart = -1;
 
 // find data chunk
-	FindChunk("data");
-	if (!data_p)
+	FindChunk(w, "data");
+	if (!w->data_p)
 	{
-		Con_Printf("%s is missing data chunk\n", name);
+		WavError (w, "%s is missing data chunk\n", name);
 		return info;
 	}
 
-	data_p += 4;
-	samples = GetLittleLong() / info.width;
+	w->data_p += 4;
+	samples = GetLittleLong(w) / info.width;
 
 	if (info.samples)
 	{
 		if (samples < info.samples)
-			Sys_Error ("%s has a bad loop length", name);
+		{
+			w->error[0] = 0;
+			WavError (w, "%s has a bad loop length", name);
+			w->fatal = true;
+			return info;
+		}
 	}
 	else
 		info.samples = samples;
 
-	info.dataofs = data_p - wav;
+	info.dataofs = w->data_p - wav;
+
+	return info;
+}
+
+/*
+============
+GetWavinfo
+============
+*/
+wavinfo_t GetWavinfo (const char *name, byte *wav, int wavlength)
+{
+	wavparse_t	w;
+	wavinfo_t	info;
+	char		error[256];
+
+	memset (&w, 0, sizeof(w));
+	error[0] = 0;
+	w.error = error;
+	w.errorsize = sizeof(error);
+
+	info = ParseWav (&w, name, wav, wavlength);
+	if (w.fatal)
+		Sys_Error ("%s", error);
+	if (error[0])
+		Con_Printf ("%s", error);
 
 	return info;
 }
 
+//=============================================================================
+
+/*
+==============
+S_LoadSound
+==============
+*/
+sfxcache_t *S_LoadSound (sfx_t *s)
+{
+	char	namebuffer[256];
+	byte	*data;
+	wavinfo_t	info;
+	int		len;
+	sfxcache_t	*sc;
+	byte	stackbuf[1*1024];		// avoid dirtying the cache heap
+	char	error[256];
+
+// see if still in memory
+	sc = (sfxcache_t *) Cache_Check (&s->cache);
+	if (sc)
+		return sc;
+
+//	Con_Printf ("S_LoadSound: %x\n", (int)stackbuf);
+
+// load it in
+	q_strlcpy(namebuffer, "sound/", sizeof(namebuffer));
+	q_strlcat(namebuffer, s->name, sizeof(namebuffer));
+
+//	Con_Printf ("loading %s\n",namebuffer);
+
+	data = COM_LoadStackFile(namebuffer, stackbuf, sizeof(stackbuf), NULL);
+
+	if (!data)
+	{
+		Con_Printf ("Couldn't load %s\n", namebuffer);
+		return NULL;
+	}
+
+	info = GetWavinfo (s->name, data, com_filesize);
+
+	error[0] = 0;
+	len = S_SoundLength (s->name, &info, error, sizeof(error));
+	if (!len)
+	{
+		Con_Printf ("%s", error);
+		return NULL;
+	}
+
+	sc = (sfxcache_t *) Cache_Alloc ( &s->cache, len + sizeof(sfxcache_t), s->name);
+	if (!sc)
+		return NULL;
+
+	ResampleSfx (sc, &info, data + info.dataofs);
+
+	return sc;
+}
+
+/*
+===============================================================================
+
+BATCHED LOADING
+
+Between S_BeginPrecaching and S_EndPrecaching, sounds are only queued; the
+files are then read, parsed and resampled on the task threads all at once,
+and moved into the cache on the main thread.
+
+===============================================================================
+*/
+
+typedef struct
+{
+	sfx_t		*sfx;
+	char		*path;		// pak or loose file, on the zone
+	long		offset;
+	int		size;
+	sfxcache_t	*sc;		// resampled sound, malloc'd on the task threads
+	int		scsize;
+	char		error[256];	// reported on the main thread
+	qboolean	fatal;
+} sndload_t;
+
+static sndload_t	snd_batch[MAX_SOUNDS];
+static int		snd_numbatch;
+static qboolean		snd_batching;
+
+/*
+==============
+S_LoadTask
+==============
+*/
+static void S_LoadTask (void *data, int index)
+{
+	sndload_t	*l = (sndload_t *)data + index;
+	wavparse_t	w;
+	wavinfo_t	info;
+	byte		*buf;
+	int		len;
+
+	buf = COM_ReadFileAt (l->path, l->offset, l->size);
+	if (!buf)
+	{
+		q_snprintf (l->error, sizeof(l->error), "Couldn't load sound/%s\n", l->sfx->name);
+		return;
+	}
+
+	memset (&w, 0, sizeof(w));
+	w.error = l->error;
+	w.errorsize = sizeof(l->error);
+	info = ParseWav (&w, l->sfx->name, buf, l->size);
+	if (w.fatal)
+		l->fatal = true;
+	else if ((len = S_SoundLength (l->sfx->name, &info, l->error, sizeof(l->error))) != 0)
+	{
+		l->scsize = len + sizeof(sfxcache_t);
+		l->sc = (sfxcache_t *) malloc (l->scsize);
+		if (l->sc)
+			ResampleSfx (l->sc, &info, buf + info.dataofs);
+	}
+
+	free (buf);
+}
+
+/*
+==============
+S_AbortBatch -- drops whatever is queued without loading it, e.g. when an
+error cuts the precache short
+==============
+*/
+void S_AbortBatch (void)
+{
+	int		i;
+
+	for (i = 0; i < snd_numbatch; i++)
+	{
+		free (snd_batch[i].sc);
+		Z_Free (snd_batch[i].path);
+	}
+	snd_numbatch = 0;
+	snd_batching = false;
+}
+
+/*
+==============
+S_BeginBatch
+==============
+*/
+void S_BeginBatch (void)
+{
+	S_AbortBatch (); // left over if the last batch never reached S_EndBatch
+	snd_batching = Tasks_NumThreads () > 1;
+}
+
+/*
+==============
+S_BatchSound -- queues s to be loaded by S_EndBatch.  returns false if it
+has to be loaded right away instead
+==============
+*/
+qboolean S_BatchSound (sfx_t *s)
+{
+	char		namebuffer[MAX_QPATH + 8];
+	char		path[MAX_OSPATH];
+	sndload_t	*l;
+	int		i;
+
+	if (!snd_batching || snd_numbatch == MAX_SOUNDS)
+		return false;
+
+	if (Cache_Check (&s->cache))
+		return true;
+
+	for (i = 0; i < snd_numbatch; i++)
+		if (snd_batch[i].sfx == s)
+			return true;
+
+	l = &snd_batch[snd_numbatch];
+	q_snprintf (namebuffer, sizeof(namebuffer), "sound/%s", s->name);
+	l->size = COM_LocateFile (namebuffer, path, sizeof(path), &l->offset, NULL);
+	if (l->size < 0)
+		return false;	// let S_LoadSound report it
+
+	l->sfx = s;
+	l->path = Z_Strdup (path);
+	l->sc = NULL;
+	l->scsize = 0;
+	l->error[0] = 0;
+	l->fatal = false;
+	snd_numbatch++;
+
+	return true;
+}
+
+/*
+==============
+S_EndBatch
+==============
+*/
+void S_EndBatch (void)
+{
+	sndload_t	*l;
+	sfxcache_t	*sc;
+	double		time;
+	int		i, loaded;
+
+	snd_batching = false;
+	if (!snd_numbatch)
+		return;
+
+	time = Sys_DoubleTime ();
+	Tasks_ParallelFor (snd_numbatch, 0, S_LoadTask, snd_batch);
+
+	for (i = 0, loaded = 0, l = snd_batch; i < snd_numbatch; i++, l++)
+	{
+		if (l->fatal)
+			Sys_Error ("%s", l->error);
+		if (l->error[0])
+			Con_Printf ("%s", l->error);
+
+		if (l->sc)
+		{
+			sc = (sfxcache_t *) Cache_Alloc (&l->sfx->cache, l->scsize, l->sfx->name);
+			if (sc)
+			{
+				memcpy (sc, l->sc, l->scsize);
+				loaded++;
+			}
+			free (l->sc);
+		}
+		Z_Free (l->path);
+	}
+
+	Con_DPrintf ("%i sounds loaded in %.1f ms\n", loaded, (Sys_DoubleTime () - time) * 1000.0);
+	snd_numbatch = 0;
+}
@@ -440,7 +440,8 @@ void S_PaintChannels (int endtime)
 			//		Con_Printf ("full stream\n");
 		}
 
-	// transfer out according to DMA format
+	// hand a copy to capturedemo, then transfer out according to DMA format
+		Capture_AudioSamples (paintbuffer, end - paintedtime);
 		S_TransferPaintBuffer(end);
 		paintedtime = end;
 	}
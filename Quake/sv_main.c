@@ -477,6 +477,13 @@ given point.
 */
 byte *SV_FatPVS (vec3_t org, qmodel_t *worldmodel) //johnfitz -- added worldmodel as a parameter
 {
+	byte	*pvs;
+
+	// the table made at map load covers every point of a leaf
+	pvs = Mod_LeafFatPVS (Mod_PointInLeaf (org, worldmodel), worldmodel);
+	if (pvs)
+		return pvs;
+
 	fatbytes = (worldmodel->numleafs+31)>>3;
 	Q_memset (fatpvs, 0, fatbytes);
 	SV_AddToFatPVS (org, worldmodel->nodes, worldmodel); //johnfitz -- worldmodel as a parameter
@@ -1284,8 +1291,9 @@ extern float		scr_centertime_off;
 void SV_SpawnServer (const char *server)
 {
 	static char	dummy[8] = { 0,0,0,0,0,0,0,0 };
+	static char	lastmodels[MAX_MODELS][MAX_QPATH];
 	edict_t		*ent;
-	int			i;
+	int			i, numlastmodels;
 
 	// let's not have any servers with no name
 	if (hostname.string[0] == 0)
@@ -1316,6 +1324,18 @@ void SV_SpawnServer (const char *server)
 
 	Cvar_SetValue ("skill", (float)current_skill);
 
+// remember the last level's models, most of which the next one will want
+// too; the precache strings go with the progs
+	numlastmodels = 0;
+	if (sv.active)
+	{
+		for (i=2 ; i<MAX_MODELS && sv.model_precache[i] ; i++)
+		{
+			if (sv.model_precache[i][0] != '*')
+				q_strlcpy (lastmodels[numlastmodels++], sv.model_precache[i], MAX_QPATH);
+		}
+	}
+
 //
 // set up the new server
 //
@@ -1362,14 +1382,25 @@ void SV_SpawnServer (const char *server)
 
 	q_strlcpy (sv.name, server, sizeof(sv.name));
 	q_snprintf (sv.modelname, sizeof(sv.modelname), "maps/%s.bsp", server);
+
+// read the world, which holds the submodels, and the last level's models on
+// the task threads, so the spawn functions' precaches find them waiting
+	Mod_Prefetch (sv.modelname);
+	for (i=0 ; i<numlastmodels ; i++)
+		Mod_Prefetch (lastmodels[i]);
+	Mod_RunPrefetch ();
+
 	sv.worldmodel = Mod_ForName (sv.modelname, false);
 	if (!sv.worldmodel)
 	{
 		Con_Printf ("Couldn't spawn server %s\n", sv.modelname);
+		Mod_ClearPrefetch ();
 		sv.active = false;
 		return;
 	}
 	sv.models[1] = sv.worldmodel;
+	Mod_AddRef (sv.worldmodel);
+	Mod_BuildFatPVS (sv.worldmodel);
 
 //
 // clear world interaction links
@@ -1383,6 +1414,7 @@ void SV_SpawnServer (const char *server)
 	{
 		sv.model_precache[1+i] = localmodels[i];
 		sv.models[i+1] = Mod_ForName (localmodels[i], false);
+		Mod_AddRef (sv.models[i+1]);
 	}
 
 //
@@ -1408,6 +1440,10 @@ void SV_SpawnServer (const char *server)
 
 	ED_LoadFromFile (sv.worldmodel->entities);
 
+// the model precache list is complete, drop what the last level left behind
+	Mod_ClearPrefetch ();
+	Mod_ReleaseUnused ();
+
 	sv.active = true;
 
 // all setup is completed, any further precache statements are errors
@@ -0,0 +1,225 @@
+/*
+Copyright (C) 1996-2001 Id Software, Inc.
+Copyright (C) 2002-2009 John Fitzgibbons and others
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// tasks.c -- worker thread pool
+
+#include "quakedef.h"
+
+/*
+the pool runs one job at a time.  a job is a function and a count, and
+the threads working on it, the calling thread among them, take indices
+from a shared counter until there are none left, so uneven items balance
+out by themselves.  callers should make each index a decent chunk of work;
+every index costs a mutex round trip.
+*/
+
+#define MAX_TASK_THREADS	32
+
+typedef struct
+{
+	taskfunc_t	func;
+	void		*data;
+	int			count;
+	int			next;		// next index to hand out
+	int			done;		// indices finished
+	int			numworkers;	// pool threads that joined
+	int			maxworkers;
+	int			generation;	// bumped for each new job
+} taskjob_t;
+
+static SDL_Thread	*tasks_threads[MAX_TASK_THREADS];
+static int			tasks_numthreads;	// pool threads, not counting the main thread
+static SDL_mutex	*tasks_mutex;
+static SDL_cond		*tasks_wake;		// a job was posted, or shutting down
+static SDL_cond		*tasks_finished;	// the last index of a job finished
+static taskjob_t	tasks_job;
+static qboolean		tasks_quit;
+
+/*
+=================
+Tasks_RunJob
+
+Takes indices of the current job until they run out.  called and returns
+with tasks_mutex held.
+=================
+*/
+static void Tasks_RunJob (void)
+{
+	taskfunc_t	func = tasks_job.func;
+	void		*data = tasks_job.data;
+	int			index;
+
+	while (tasks_job.next < tasks_job.count)
+	{
+		index = tasks_job.next++;
+		SDL_UnlockMutex (tasks_mutex);
+		func (data, index);
+		SDL_LockMutex (tasks_mutex);
+		if (++tasks_job.done == tasks_job.count)
+			SDL_CondBroadcast (tasks_finished);
+	}
+}
+
+/*
+=================
+Tasks_Worker
+=================
+*/
+static int SDLCALL Tasks_Worker (void *unused)
+{
+	int		generation = 0;
+
+	SDL_LockMutex (tasks_mutex);
+	for (;;)
+	{
+		while (!tasks_quit &&
+				(tasks_job.generation == generation ||
+				tasks_job.numworkers >= tasks_job.maxworkers ||
+				tasks_job.next >= tasks_job.count))
+			SDL_CondWait (tasks_wake, tasks_mutex);
+
+		if (tasks_quit)
+			break;
+
+		generation = tasks_job.generation;
+		tasks_job.numworkers++;
+		Tasks_RunJob ();
+	}
+	SDL_UnlockMutex (tasks_mutex);
+
+	return 0;
+}
+
+/*
+=================
+Tasks_Init
+
+one pool thread per extra cpu, or -threads to choose the total.
+=================
+*/
+void Tasks_Init (void)
+{
+	int		i, numthreads;
+
+	i = COM_CheckParm ("-threads");
+	if (i && i < com_argc-1)
+		numthreads = Q_atoi (com_argv[i+1]) - 1;
+	else
+		numthreads = host_parms->numcpus - 1;
+	numthreads = CLAMP (0, numthreads, MAX_TASK_THREADS);
+
+	if (!numthreads)
+		return;
+
+	tasks_mutex = SDL_CreateMutex ();
+	tasks_wake = SDL_CreateCond ();
+	tasks_finished = SDL_CreateCond ();
+	if (!tasks_mutex || !tasks_wake || !tasks_finished)
+	{
+		Con_Warning ("Couldn't create task mutex: %s\n", SDL_GetError());
+		return;
+	}
+
+	for (i=0 ; i<numthreads ; i++)
+	{
+#if defined(USE_SDL2)
+		tasks_threads[i] = SDL_CreateThread (Tasks_Worker, "task", NULL);
+#else
+		tasks_threads[i] = SDL_CreateThread (Tasks_Worker, NULL);
+#endif
+		if (!tasks_threads[i])
+		{
+			Con_Warning ("Couldn't create task thread: %s\n", SDL_GetError());
+			break;
+		}
+		tasks_numthreads++;
+	}
+
+	Con_Printf ("Task threads: %d\n", tasks_numthreads);
+}
+
+/*
+=================
+Tasks_Shutdown
+=================
+*/
+void Tasks_Shutdown (void)
+{
+	int		i;
+
+	if (!tasks_numthreads)
+		return;
+
+	SDL_LockMutex (tasks_mutex);
+	tasks_quit = true;
+	SDL_CondBroadcast (tasks_wake);
+	SDL_UnlockMutex (tasks_mutex);
+
+	for (i=0 ; i<tasks_numthreads ; i++)
+		SDL_WaitThread (tasks_threads[i], NULL);
+	tasks_numthreads = 0;
+}
+
+/*
+=================
+Tasks_NumThreads
+=================
+*/
+int Tasks_NumThreads (void)
+{
+	return tasks_numthreads + 1;
+}
+
+/*
+=================
+Tasks_ParallelFor
+=================
+*/
+void Tasks_ParallelFor (int count, int maxthreads, taskfunc_t func, void *data)
+{
+	int		i;
+
+	if (maxthreads <= 0 || maxthreads > tasks_numthreads + 1)
+		maxthreads = tasks_numthreads + 1;
+
+	// not worth waking anyone up
+	if (maxthreads == 1 || count < 2)
+	{
+		for (i=0 ; i<count ; i++)
+			func (data, i);
+		return;
+	}
+
+	SDL_LockMutex (tasks_mutex);
+	tasks_job.func = func;
+	tasks_job.data = data;
+	tasks_job.count = count;
+	tasks_job.next = 0;
+	tasks_job.done = 0;
+	tasks_job.numworkers = 0;
+	tasks_job.maxworkers = maxthreads - 1;
+	tasks_job.generation++;
+	SDL_CondBroadcast (tasks_wake);
+
+	Tasks_RunJob ();
+	while (tasks_job.done < tasks_job.count)
+		SDL_CondWait (tasks_finished, tasks_mutex);
+	SDL_UnlockMutex (tasks_mutex);
+}
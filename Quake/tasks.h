@@ -0,0 +1,43 @@
+/*
+Copyright (C) 1996-2001 Id Software, Inc.
+Copyright (C) 2002-2009 John Fitzgibbons and others
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#ifndef _QUAKE_TASKS_H
+#define _QUAKE_TASKS_H
+
+/* tasks.h -- worker thread pool */
+
+// called once for every index in [0, count), possibly from several threads
+// at once, in no particular order
+typedef void (*taskfunc_t) (void *data, int index);
+
+void Tasks_Init (void);
+void Tasks_Shutdown (void);
+
+// threads that can work on a job, counting the calling thread
+int Tasks_NumThreads (void);
+
+// runs func for every index in [0, count) on at most maxthreads threads
+// (0 for all of them), the calling thread included, and returns once every
+// call has finished.  must only be called from the main thread.
+void Tasks_ParallelFor (int count, int maxthreads, taskfunc_t func, void *data);
+
+#endif	/* _QUAKE_TASKS_H */
+
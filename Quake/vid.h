@@ -67,6 +67,7 @@ typedef struct
 } viddef_t;
 
 extern	viddef_t	vid;				// global video state
+extern	qboolean	vid_headless;		// offscreen context, no visible window
 
 extern void (*vid_menudrawfn)(void);
 extern void (*vid_menukeyfn)(int key);
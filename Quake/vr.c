@@ -105,6 +105,7 @@ static vec3_t lastOrientation = { 0, 0, 0 };
 static vec3_t lastAim = { 0, 0, 0 };
 
 static qboolean vr_initialized = false;
+static qboolean vr_nullhmd = false; // headless: fixed eyes instead of an OpenVR runtime
 static GLuint mirror_texture = 0;
 static GLuint mirror_fbo = 0;
 static int attempt_to_refocus_retry = 0;
@@ -455,9 +456,68 @@ void VID_VR_Init()
 
 
 
+// Headless runs have no runtime to ask for poses or a projection. Render two fixed,
+// forward-facing eyes the size of the window, so the stereo path can still be timed.
+#define VR_NULL_TAN 1.2f    // half-width tangent, roughly a 100 degree horizontal fov
+#define VR_NULL_IPD 0.064f  // meters
+
+static qboolean VR_EnableNull()
+{
+    int i;
+
+    if (!InitOpenGLExtensions()) {
+        Con_Printf("Failed to initialize OpenGL extensions");
+        return false;
+    }
+
+    for (i = 0; i < 2; i++) {
+        eyes[i].eye = i ? Eye_Right : Eye_Left;
+        eyes[i].index = i;
+        eyes[i].fbo = CreateFBO(glwidth, glheight);
+        eyes[i].fov_x = 2 * atan(VR_NULL_TAN) / M_PI_DIV_180;
+        eyes[i].fov_y = 2 * atan(VR_NULL_TAN * glheight / glwidth) / M_PI_DIV_180;
+        eyes[i].position.v[0] = (i ? 0.5f : -0.5f) * VR_NULL_IPD;
+        eyes[i].position.v[1] = 0;
+        eyes[i].position.v[2] = 0;
+        eyes[i].orientation.w = 1;
+        eyes[i].orientation.x = 0;
+        eyes[i].orientation.y = 0;
+        eyes[i].orientation.z = 0;
+    }
+
+    Con_Printf("VR: no runtime when headless, using fixed %dx%d eyes\n", glwidth, glheight);
+
+    vr_nullhmd = true;
+    vr_initialized = true;
+    return true;
+}
+
+// Same layout as the matrices IVRSystem_GetProjectionMatrix builds from the raw tangents
+static HmdMatrix44_t VR_NullProjection(float left, float right, float top, float bottom, float zNear, float zFar)
+{
+    HmdMatrix44_t p;
+    float idx = 1.0f / (right - left);
+    float idy = 1.0f / (bottom - top);
+    float idz = 1.0f / (zFar - zNear);
+
+    memset(&p, 0, sizeof(p));
+    p.m[0][0] = 2 * idx;
+    p.m[0][2] = (right + left) * idx;
+    p.m[1][1] = 2 * idy;
+    p.m[1][2] = (bottom + top) * idy;
+    p.m[2][2] = -zFar * idz;
+    p.m[2][3] = -zFar * zNear * idz;
+    p.m[3][2] = -1.0f;
+    return p;
+}
+
 qboolean VR_Enable()
 {
     EVRInitError eInit = VRInitError_None;
+
+    if (vid_headless)
+        return VR_EnableNull();
+
     ovrHMD = VR_Init(&eInit, VRApplication_Scene);
 
     if (eInit != VRInitError_None) {
@@ -509,8 +569,10 @@ void VID_VR_Disable()
     if (!vr_initialized)
         return;
 
-    VR_Shutdown();
+    if (!vr_nullhmd)
+        VR_Shutdown();
     ovrHMD = NULL;
+    vr_nullhmd = false;
 
     // Reset the view height
     cl.viewheight = DEFAULT_VIEWHEIGHT;
@@ -545,9 +607,18 @@ static void RenderScreenForCurrentEye_OVR()
 
     SCR_UpdateScreenContent();
 
+    // A screenshot this frame also saves each eye, read back while its FBO is bound
+    if (Capture_PendingName()) {
+        char name[MAX_QPATH];
+        q_snprintf(name, sizeof(name), "%s_%s.tga", Capture_PendingName(), current_eye->index ? "right" : "left");
+        Capture_ReadPixels(name, 0, 0, current_eye->fbo.size.width, current_eye->fbo.size.height, true);
+    }
+
     // Generate the eye texture and send it to the HMD
-    Texture_t eyeTexture = { (void*)current_eye->fbo.texture, TextureType_OpenGL, ColorSpace_Gamma };
-    IVRCompositor_Submit(VRCompositor(), current_eye->eye, &eyeTexture);
+    if (!vr_nullhmd) {
+        Texture_t eyeTexture = { (void*)current_eye->fbo.texture, TextureType_OpenGL, ColorSpace_Gamma };
+        IVRCompositor_Submit(VRCompositor(), current_eye->eye, &eyeTexture);
+    }
     
 
     // Reset
@@ -559,23 +630,8 @@ static void RenderScreenForCurrentEye_OVR()
     glFramebufferTexture2DEXT(GL_FRAMEBUFFER_EXT, GL_DEPTH_ATTACHMENT_EXT, GL_TEXTURE_2D, 0, 0);
 }
 
-void VR_UpdateScreenContent()
+static void VR_UpdatePoses()
 {
-    int i;
-    vec3_t orientation;
-    GLint w, h;
-
-    // Last chance to enable VR Mode - we get here when the game already start up with vr_enabled 1
-    // If enabling fails, unset the cvar and return.
-    if (!vr_initialized && !VR_Enable()) {
-        Cvar_Set("vr_enabled", "0");
-        return;
-    }
-
-    w = glwidth;
-    h = glheight;
-
-    // Update poses
     IVRCompositor_WaitGetPoses(VRCompositor(), ovr_DevicePose, k_unMaxTrackedDeviceCount, NULL, 0);
 
     // Get the VR devices' orientation and position
@@ -649,6 +705,27 @@ void VR_UpdateScreenContent()
             }
         }
     }
+}
+
+void VR_UpdateScreenContent()
+{
+    int i;
+    vec3_t orientation;
+    GLint w, h;
+
+    // Last chance to enable VR Mode - we get here when the game already start up with vr_enabled 1
+    // If enabling fails, unset the cvar and return.
+    if (!vr_initialized && !VR_Enable()) {
+        Cvar_Set("vr_enabled", "0");
+        return;
+    }
+
+    w = glwidth;
+    h = glheight;
+
+    // Update poses
+    if (!vr_nullhmd)
+        VR_UpdatePoses();
 
     // Reset the aim roll value before calculation, incase the user switches aimmode from 7 to another.
     cl.aimangles[ROLL] = 0.0;
@@ -774,7 +851,12 @@ void VR_SetMatrices() {
     HmdMatrix44_t projection;
 
     // Calculate HMD projection matrix and view offset position
-    projection = TransposeMatrix(IVRSystem_GetProjectionMatrix(ovrHMD, current_eye->eye, 4.f, gl_farclip.value));
+    if (vr_nullhmd) {
+        float tan_y = VR_NULL_TAN * current_eye->fbo.size.height / current_eye->fbo.size.width;
+        projection = TransposeMatrix(VR_NullProjection(-VR_NULL_TAN, VR_NULL_TAN, -tan_y, tan_y, 4.f, gl_farclip.value));
+    }
+    else
+        projection = TransposeMatrix(IVRSystem_GetProjectionMatrix(ovrHMD, current_eye->eye, 4.f, gl_farclip.value));
 
     // We need to scale the view offset position to quake units and rotate it by the current input angles (viewangle - eye orientation)
     QuatToYawPitchRoll(current_eye->orientation, orientation);
@@ -967,6 +1049,7 @@ void VR_Draw2D()
         SCR_CheckDrawCenterString();
         draw_sbar = true; //Sbar_Draw ();
         SCR_DrawDevStats(); //johnfitz
+        GLStats_Draw();
         SCR_DrawFPS(); //johnfitz
         SCR_DrawClock(); //johnfitz
         SCR_DrawConsole();
@@ -1031,13 +1114,17 @@ void VR_ResetOrientation()
     cl.aimangles[YAW] = cl.viewangles[YAW];
     cl.aimangles[PITCH] = cl.viewangles[PITCH];
     if (vr_enabled.value) {
-        IVRSystem_ResetSeatedZeroPose(ovrHMD);
+        if (!vr_nullhmd)
+            IVRSystem_ResetSeatedZeroPose(ovrHMD);
         VectorCopy(cl.aimangles, lastAim);
     }
 }
 
 void VR_SetTrackingSpace(int n)
 {
+    if (vr_nullhmd)
+        return;
+
     if ( n >= 0 || n < 3 )
         IVRCompositor_SetTrackingSpace(VRCompositor(), n);
 }
\ No newline at end of file